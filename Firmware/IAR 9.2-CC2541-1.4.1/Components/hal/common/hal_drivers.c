@@ -52,6 +52,9 @@
 #include "hal_dma.h"
 #endif
 #include "hal_drivers.h"
+#if (defined HAL_I2C_ASYNC) && (HAL_I2C_ASYNC == TRUE)
+#include "hal_i2c.h"
+#endif
 #include "hal_key.h"
 #include "hal_lcd.h"
 #include "hal_led.h"
@@ -285,6 +288,11 @@ void Hal_ProcessPoll ()
   HalSpiPoll();
 #endif
 
+  /* I2C Poll */
+#if (defined HAL_I2C_ASYNC) && (HAL_I2C_ASYNC == TRUE)
+  HalI2CPoll();
+#endif
+
   /* HID poll */
 #if (defined HAL_HID) && (HAL_HID == TRUE)
   usbHidProcessEvents();
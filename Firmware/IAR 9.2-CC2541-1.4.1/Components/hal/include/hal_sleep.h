@@ -74,6 +74,11 @@ extern void halSleepExit(void);
  */
 extern void halSetMaxSleepLoopTime(uint32 rolloverTime);
 
+/*
+ * Read the 24 bit sleep timer.
+ */
+extern uint32 halSleepReadTimer( void );
+
 /*********************************************************************
 *********************************************************************/
 
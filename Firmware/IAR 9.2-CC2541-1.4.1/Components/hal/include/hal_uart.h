@@ -70,6 +70,10 @@ extern "C"
 #define HAL_UART_BR_38400  0x02
 #define HAL_UART_BR_57600  0x03
 #define HAL_UART_BR_115200 0x04
+#define HAL_UART_BR_230400 0x05
+#define HAL_UART_BR_460800 0x06
+#define HAL_UART_BR_921600 0x07
+#define HAL_UART_BR_1000000 0x08
 
 /* Frame Format constant */
 
@@ -109,6 +113,11 @@ extern "C"
 #define HAL_UART_TX_FULL         0x08
 #define HAL_UART_TX_EMPTY        0x10
 
+/* Set to TRUE to keep buffer high-water marks and overflow counts, see HalUARTStats() */
+#if !defined HAL_UART_STATS
+#define HAL_UART_STATS           FALSE
+#endif
+
 /***************************************************************************************************
  *                                             TYPEDEFS
  ***************************************************************************************************/
@@ -151,6 +160,14 @@ typedef union
   bool flushControl;
 }halUARTIoctl_t;
 
+typedef struct
+{
+  uint16 rxHigh;   // Most bytes seen waiting in the Rx buffer
+  uint16 txHigh;   // Most bytes queued in the Tx buffer
+  uint16 rxFull;   // Polls that found the Rx buffer full, received bytes may have been lost
+  uint16 txFull;   // Writes refused for lack of room in the Tx buffer
+} halUARTStats_t;
+
 
 /***************************************************************************************************
  *                                           GLOBAL VARIABLES
@@ -225,6 +242,13 @@ extern void HalUARTSuspend(void);
  */
 extern void HalUARTResume(void);
 
+#if HAL_UART_STATS
+/*
+ * Read the buffer statistics of a port, optionally clearing them
+ */
+extern void HalUARTStats( uint8 port, halUARTStats_t *pStats, bool clear );
+#endif
+
 /***************************************************************************************************
 ***************************************************************************************************/
 
@@ -224,9 +224,14 @@
 #if !defined HAL_UART_DMA_HIGH
 #define HAL_UART_DMA_HIGH         (HAL_UART_DMA_RX_MAX - 1)
 #endif
+// Idle-line timeout in ST-ticks: with a non-zero value the Rx callback is made once no new byte
+// has come in for this long, instead of on every poll that finds Rx data.
 #if !defined HAL_UART_DMA_IDLE
 #define HAL_UART_DMA_IDLE         (0 * HAL_UART_MSECS_TO_TICKS)
 #endif
+#if (HAL_UART_DMA_IDLE > 254)
+#error HAL_UART_DMA_IDLE is timed with the 8-bit ST0 and must be at most 254 ticks.
+#endif
 #if !defined HAL_UART_DMA_FULL
 #define HAL_UART_DMA_FULL         (HAL_UART_DMA_RX_MAX - 16)
 #endif
@@ -255,9 +260,10 @@ typedef struct
 {
   uint16 rxBuf[HAL_UART_DMA_RX_MAX];
   rxIdx_t rxHead;
-  rxIdx_t rxTail;
+  rxIdx_t rxTail;  // End of the Rx bytes already counted, so only new ones are scanned.
 #if HAL_UART_DMA_IDLE
   uint8 rxTick;
+  uint16 rxIdleCnt;  // Rx byte count at the last change, to detect the idle line.
 #endif
 
 #if HAL_UART_TX_BY_ISR
@@ -278,6 +284,10 @@ typedef struct
 #endif
 
   halUARTCBack_t uartCB;
+
+#if HAL_UART_STATS
+  halUARTStats_t stats;
+#endif
 } uartDMACfg_t;
 
 /* ------------------------------------------------------------------------------------------------
@@ -322,6 +332,12 @@ typedef struct
   (dmaCfg.txHead - dmaCfg.txTail - 1) : \
   (HAL_UART_DMA_TX_MAX - dmaCfg.txTail + dmaCfg.txHead - 1))
 
+// Number of Rx buffer entries from the head up to, but not including, IDX.
+#define HAL_UART_DMA_RX_DIST(IDX) \
+  (((IDX) >= dmaCfg.rxHead) ? \
+  ((uint16)((IDX) - dmaCfg.rxHead)) : \
+  ((uint16)(HAL_UART_DMA_RX_MAX - dmaCfg.rxHead + (IDX))))
+
 /* ------------------------------------------------------------------------------------------------
  *                                           Local Variables
  * ------------------------------------------------------------------------------------------------
@@ -353,6 +369,10 @@ static uint16 HalUARTWriteDMA(uint8 *buf, uint16 len);
 static void HalUARTPollDMA(void);
 static uint16 HalUARTRxAvailDMA(void);
 static uint8 HalUARTBusyDMA(void);
+static uint16 HalUARTTxQueuedDMA(void);
+#if HAL_UART_STATS
+static void HalUARTStatsDMA(halUARTStats_t *pStats, bool clear);
+#endif
 #if !HAL_UART_TX_BY_ISR
 static void HalUARTPollTxTrigDMA(void);
 static void HalUARTArmTxDMA(void);
@@ -494,10 +514,17 @@ static void HalUARTOpenDMA(halUARTCfg_t *config)
                   (config->baudRate == HAL_UART_BR_19200) ||
                   (config->baudRate == HAL_UART_BR_38400) ||
                   (config->baudRate == HAL_UART_BR_57600) ||
-                  (config->baudRate == HAL_UART_BR_115200));
+                  (config->baudRate == HAL_UART_BR_115200) ||
+                  (config->baudRate == HAL_UART_BR_230400) ||
+                  (config->baudRate == HAL_UART_BR_460800) ||
+                  (config->baudRate == HAL_UART_BR_921600) ||
+                  (config->baudRate == HAL_UART_BR_1000000));
 
-  if (config->baudRate == HAL_UART_BR_57600 ||
-      config->baudRate == HAL_UART_BR_115200)
+  if (config->baudRate == HAL_UART_BR_1000000)
+  {
+    UxBAUD = 0;
+  }
+  else if (config->baudRate >= HAL_UART_BR_57600)
   {
     UxBAUD = 216;
   }
@@ -506,6 +533,7 @@ static void HalUARTOpenDMA(halUARTCfg_t *config)
     UxBAUD = 59;
   }
 
+  // Baud rate = (256 + BAUD_M) * 2^BAUD_E / 2^28 * 32 MHz; above 115200 each step doubles it.
   switch (config->baudRate)
   {
     case HAL_UART_BR_9600:
@@ -518,6 +546,18 @@ static void HalUARTOpenDMA(halUARTCfg_t *config)
     case HAL_UART_BR_57600:
       UxGCR = 10;
       break;
+    case HAL_UART_BR_230400:
+      UxGCR = 12;
+      break;
+    case HAL_UART_BR_460800:
+      UxGCR = 13;
+      break;
+    case HAL_UART_BR_921600:
+      UxGCR = 14;
+      break;
+    case HAL_UART_BR_1000000:
+      UxGCR = 15;
+      break;
     default:
       // HAL_UART_BR_115200
       UxGCR = 11;
@@ -532,6 +572,7 @@ static void HalUARTOpenDMA(halUARTCfg_t *config)
   else
   {
     UxUCR = UCR_STOP;                 // 8 bits/char; no parity; 1 stop bit; stop bit hi.
+    PxSEL &= ~HAL_UART_Px_CTS;        // The port may be re-opened without flow control.
   }
 
   UxCSR = (CSR_MODE | CSR_RE);
@@ -567,6 +608,7 @@ static void HalUARTOpenDMA(halUARTCfg_t *config)
  *****************************************************************************/
 static uint16 HalUARTReadDMA(uint8 *buf, uint16 len)
 {
+  uint16 counted = HAL_UART_DMA_RX_DIST(dmaCfg.rxTail);
   uint16 cnt;
 
   for (cnt = 0; cnt < len; cnt++)
@@ -580,8 +622,11 @@ static uint16 HalUARTReadDMA(uint8 *buf, uint16 len)
     HAL_UART_RX_IDX_T_INCR(dmaCfg.rxHead);
   }
 
-  /* Update pointers after reading the bytes */
-  dmaCfg.rxTail = dmaCfg.rxHead;
+  /* Update pointers after reading the bytes; the bytes counted but not read stay counted */
+  if (cnt >= counted)
+  {
+    dmaCfg.rxTail = dmaCfg.rxHead;
+  }
 
   if (!DMA_PM && (UxUCR & UCR_FLOW))
   {
@@ -608,6 +653,12 @@ static uint16 HalUARTWriteDMA(uint8 *buf, uint16 len)
   // Enforce all or none.
   if (HAL_UART_DMA_TX_AVAIL() < len)
   {
+#if HAL_UART_STATS
+    if (dmaCfg.stats.txFull != 0xFFFF)
+    {
+      dmaCfg.stats.txFull++;
+    }
+#endif
     return 0;
   }
 
@@ -628,6 +679,17 @@ static uint16 HalUARTWriteDMA(uint8 *buf, uint16 len)
     // Keep re-enabling ISR as it might be keeping up with this loop due to other ints.
     IEN2 |= UTXxIE;
   }
+
+#if HAL_UART_STATS
+  {
+    uint16 used = HAL_UART_DMA_TX_MAX - 1 - HAL_UART_DMA_TX_AVAIL();
+
+    if (used > dmaCfg.stats.txHigh)
+    {
+      dmaCfg.stats.txHigh = used;
+    }
+  }
+#endif
 #else
   txIdx_t txIdx;
   uint8 txSel;
@@ -641,9 +703,22 @@ static uint16 HalUARTWriteDMA(uint8 *buf, uint16 len)
   // Enforce all or none.
   if ((len + txIdx) > HAL_UART_DMA_TX_MAX)
   {
+#if HAL_UART_STATS
+    if (dmaCfg.stats.txFull != 0xFFFF)
+    {
+      dmaCfg.stats.txFull++;
+    }
+#endif
     return 0;
   }
 
+#if HAL_UART_STATS
+  if ((len + txIdx) > dmaCfg.stats.txHigh)
+  {
+    dmaCfg.stats.txHigh = len + txIdx;
+  }
+#endif
+
   (void)memcpy(&(dmaCfg.txBuf[txSel][txIdx]), buf, len);
 
   HAL_ENTER_CRITICAL_SECTION(his);
@@ -740,20 +815,27 @@ static void HalUARTPollDMA(void)
   cnt = HalUARTRxAvailDMA();  // Wait to call until after the above DMA Rx bug work-around.
 
 #if HAL_UART_DMA_IDLE
-  if (dmaCfg.rxTick)
+  if (cnt != dmaCfg.rxIdleCnt)
   {
-    // Use the LSB of the sleep timer (ST0 must be read first anyway) to measure the Rx timeout.
-    if ((ST0 - dmaCfg.rxTick) > HAL_UART_DMA_IDLE)
+    // Bytes came in or were read, so (re)start the idle-line timeout while any are waiting.
+    dmaCfg.rxIdleCnt = cnt;
+    dmaCfg.rxTick = 0;
+
+    if (cnt != 0)
     {
-      dmaCfg.rxTick = 0;
-      evt = HAL_UART_RX_TIMEOUT;
+      if ((dmaCfg.rxTick = ST0) == 0)  // Zero signifies that the Rx timeout is not running.
+      {
+        dmaCfg.rxTick = 0xFF;
+      }
     }
   }
-  else if (cnt != 0)
+  else if (dmaCfg.rxTick)
   {
-    if ((dmaCfg.rxTick = ST0) == 0)  // Zero signifies that the Rx timeout is not running.
+    // Use the LSB of the sleep timer (ST0 must be read first anyway) to measure the Rx timeout.
+    if ((uint8)(ST0 - dmaCfg.rxTick) > HAL_UART_DMA_IDLE)
     {
-      dmaCfg.rxTick = 0xFF;
+      dmaCfg.rxTick = 0;
+      evt = HAL_UART_RX_TIMEOUT;
     }
   }
 #else
@@ -763,6 +845,17 @@ static void HalUARTPollDMA(void)
   }
 #endif
 
+#if HAL_UART_STATS
+  if (cnt > dmaCfg.stats.rxHigh)
+  {
+    dmaCfg.stats.rxHigh = cnt;
+  }
+  if ((cnt >= HAL_UART_DMA_RX_MAX) && (dmaCfg.stats.rxFull != 0xFFFF))
+  {
+    dmaCfg.stats.rxFull++;
+  }
+#endif
+
   if (cnt >= HAL_UART_DMA_FULL)
   {
     evt |= HAL_UART_RX_FULL;
@@ -805,9 +898,11 @@ static void HalUARTPollDMA(void)
  **************************************************************************************************/
 static uint16 HalUARTRxAvailDMA(void)
 {
-  uint16 cnt = 0;
-  // First, synchronize the Rx tail marker with where the DMA Rx engine is working.
+  // First, synchronize the Rx tail marker with where the DMA Rx engine is working. The bytes up to
+  // the tail were counted by an earlier call, so only the ones after it need to be scanned, which
+  // keeps the cost of a poll independent of the buffer size.
   rxIdx_t tail = dmaCfg.rxTail;
+  uint16 cnt = HAL_UART_DMA_RX_DIST(tail);
 
 #ifndef POWER_SAVING
   if (!DMA_PM && (UxUCR & UCR_FLOW))
@@ -816,18 +911,16 @@ static uint16 HalUARTRxAvailDMA(void)
   }
 #endif
 
-  do
+  while (cnt < HAL_UART_DMA_RX_MAX)
   {
     if (!HAL_UART_DMA_NEW_RX_BYTE(tail))
     {
       break;
     }
-    else
-    {
-      cnt++;
-    }
+    cnt++;
     HAL_UART_RX_IDX_T_INCR(tail);
-  } while (cnt  < HAL_UART_DMA_RX_MAX);
+  }
+  dmaCfg.rxTail = tail;
 
 #ifndef POWER_SAVING
   if ( !DMA_PM && (UxUCR & UCR_FLOW) )
@@ -858,6 +951,47 @@ static uint8 HalUARTBusyDMA( void )
 #endif
 }
 
+/******************************************************************************
+ * @fn      HalUARTTxQueuedDMA
+ *
+ * @brief   Count the bytes written but not yet handed to the USART. The last byte handed over
+ *          may still be shifting out, which takes up to two byte-times.
+ *
+ * @param   None
+ *
+ * @return  Number of bytes queued for Tx
+ *****************************************************************************/
+static uint16 HalUARTTxQueuedDMA(void)
+{
+#if HAL_UART_TX_BY_ISR
+  return (HAL_UART_DMA_TX_MAX - 1 - HAL_UART_DMA_TX_AVAIL());
+#else
+  return (dmaCfg.txIdx[0] + dmaCfg.txIdx[1]);
+#endif
+}
+
+#if HAL_UART_STATS
+/******************************************************************************
+ * @fn      HalUARTStatsDMA
+ *
+ * @brief   Read the Rx and Tx buffer statistics.
+ *
+ * @param   pStats - where to copy the statistics
+ *          clear - TRUE to clear the statistics after reading them
+ *
+ * @return  None
+ *****************************************************************************/
+static void HalUARTStatsDMA(halUARTStats_t *pStats, bool clear)
+{
+  *pStats = dmaCfg.stats;
+
+  if (clear)
+  {
+    (void)memset(&dmaCfg.stats, 0, sizeof(dmaCfg.stats));
+  }
+}
+#endif
+
 #if !HAL_UART_TX_BY_ISR
 /******************************************************************************
  * @fn      HalUARTPollTxTrigDMA
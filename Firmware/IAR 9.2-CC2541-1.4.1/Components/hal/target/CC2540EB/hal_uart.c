@@ -41,6 +41,8 @@
  * INCLUDES
  */
 
+#include <string.h>
+
 #include "hal_board_cfg.h"
 #include "hal_defs.h"
 #include "hal_drivers.h"
@@ -352,6 +354,65 @@ uint16 Hal_UART_RxBufLen( uint8 port )
 #endif
 }
 
+/**************************************************************************************************
+ * @fn      Hal_UART_TxBufLen()
+ *
+ * @brief   Calculate Tx Buffer length - the number of bytes waiting to be sent. Only the DMA
+ *          driver counts them; the other drivers report zero.
+ *
+ * @param   port - UART port
+ *
+ * @return  length of current Tx Buffer
+ **************************************************************************************************/
+uint16 Hal_UART_TxBufLen( uint8 port )
+{
+#if (HAL_UART_DMA == 1)
+  if (port == HAL_UART_PORT_0)  return HalUARTTxQueuedDMA();
+#endif
+#if (HAL_UART_DMA == 2)
+  if (port == HAL_UART_PORT_1)  return HalUARTTxQueuedDMA();
+#endif
+
+  (void) port;   // unused argument
+  return 0;
+}
+
+#if HAL_UART_STATS
+/**************************************************************************************************
+ * @fn      HalUARTStats()
+ *
+ * @brief   Read the buffer statistics of a port. Only the DMA driver keeps them; the other
+ *          drivers report zeros.
+ *
+ * @param   port - UART port
+ *          pStats - where to copy the statistics
+ *          clear - TRUE to clear the statistics after reading them
+ *
+ * @return  none
+ **************************************************************************************************/
+void HalUARTStats(uint8 port, halUARTStats_t *pStats, bool clear)
+{
+#if (HAL_UART_DMA == 1)
+  if (port == HAL_UART_PORT_0)
+  {
+    HalUARTStatsDMA(pStats, clear);
+    return;
+  }
+#endif
+#if (HAL_UART_DMA == 2)
+  if (port == HAL_UART_PORT_1)
+  {
+    HalUARTStatsDMA(pStats, clear);
+    return;
+  }
+#endif
+
+  (void) port;   // unused argument
+  (void) clear;  // unused argument
+  (void)memset(pStats, 0, sizeof(halUARTStats_t));
+}
+#endif
+
 void HalUARTIsrDMA(void)
 {
 #if (HAL_UART_DMA && HAL_UART_SPI)  // When both are defined, port is run-time choice.
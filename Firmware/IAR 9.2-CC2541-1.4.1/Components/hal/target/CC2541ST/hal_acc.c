@@ -149,6 +149,9 @@
 * ------------------------------------------------------------------------------------------------
 */
 static void HalAccSelect(void);
+#if HAL_I2C_ASYNC
+static void HalAccReadDone(bool success);
+#endif
 
 /* ------------------------------------------------------------------------------------------------
 *                                           Local Variables
@@ -158,6 +161,13 @@ static uint8 accSensorConfig;
 static uint8 accSensorOff;
 static uint8 accRange;
 
+#if HAL_I2C_ASYNC
+// XOUT_H to ZOUT_H, read by HalAccReadAsync() in one go
+static uint8 accRaw[ACC_REG_ADDR_ZOUT_H - ACC_REG_ADDR_XOUT_H + 1];
+static uint8 *accBuf;                     // Where the data goes
+static halSensorCBack_t accCBack;
+#endif
+
 /**************************************************************************************************
 * @fn          HalAccInit
 *
@@ -251,6 +261,54 @@ bool HalAccRead(uint8 *pBuf )
   return success;
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+* @fn          HalAccTurnOn
+*
+* @brief       Turn the accelerometer on, for HalAccReadAsync()
+*
+* @return      None
+*/
+void HalAccTurnOn(void)
+{
+  HalAccSelect();
+  HalSensorWriteReg(ACC_REG_ADDR_CTRL_REG1, &accSensorConfig, sizeof(accSensorConfig));
+}
+
+/**************************************************************************************************
+* @fn          HalAccTurnOff
+*
+* @brief       Turn the accelerometer off
+*
+* @return      None
+*/
+void HalAccTurnOff(void)
+{
+  HalAccSelect();
+  HalSensorWriteReg(ACC_REG_ADDR_CTRL_REG1, &accSensorOff, sizeof(accSensorOff));
+}
+
+/**************************************************************************************************
+* @fn          HalAccReadAsync
+*
+* @brief       Queue the read of X, Y, Z on the I2C bus. The accelerometer is not turned on and
+*              off as by HalAccRead(), as the bus cannot wait for the measurement: it must have
+*              been turned on by HalAccTurnOn() at least 1.45 ms before.
+*
+* @param       pBuf - buffer for X, Y, Z, set at the callback
+* @param       cBack - called with TRUE if valid data
+*
+* @return      None
+*/
+void HalAccReadAsync(uint8 *pBuf, halSensorCBack_t cBack)
+{
+  accBuf = pBuf;
+  accCBack = cBack;
+  HalSensorReadRegAsync(HAL_KXTI9_I2C_ADDRESS, ACC_REG_ADDR_XOUT_H, accRaw, sizeof(accRaw),
+                        HalAccReadDone);
+}
+#endif
+
 
 /**************************************************************************************************
  * @fn          HalAccTest
@@ -301,6 +359,29 @@ static void HalAccSelect(void)
   HalI2CInit(HAL_KXTI9_I2C_ADDRESS,i2cClock_267KHZ);
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+* @fn          HalAccReadDone
+*
+* @brief       Store the high bytes of X, Y, Z
+*
+* @param       success - TRUE if the registers were read
+*
+* @return      None
+*/
+static void HalAccReadDone(bool success)
+{
+  if (success)
+  {
+    accBuf[0] = accRaw[ACC_REG_ADDR_XOUT_H - ACC_REG_ADDR_XOUT_H];
+    accBuf[1] = accRaw[ACC_REG_ADDR_YOUT_H - ACC_REG_ADDR_XOUT_H];
+    accBuf[2] = accRaw[ACC_REG_ADDR_ZOUT_H - ACC_REG_ADDR_XOUT_H];
+  }
+
+  accCBack(success);
+}
+#endif
+
 /*  Conversion algorithm for X, Y, Z
  *  ================================
  *
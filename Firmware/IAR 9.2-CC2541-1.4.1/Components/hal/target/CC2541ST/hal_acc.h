@@ -49,6 +49,7 @@ extern "C" {
  */
 
 #include "comdef.h"
+#include "hal_sensor.h"
 
 /* ------------------------------------------------------------------------------------------------
  *                                          Constants
@@ -72,6 +73,11 @@ void HalAccInit(void);
 bool HalAccRead(uint8 *pBuf);
 bool HalAccTest(void);
 void HalAccSetRange(uint8 range);
+#if HAL_I2C_ASYNC
+void HalAccTurnOn(void);
+void HalAccTurnOff(void);
+void HalAccReadAsync(uint8 *pBuf, halSensorCBack_t cBack);
+#endif
 
 
 /**************************************************************************************************
@@ -111,6 +111,10 @@
 * ------------------------------------------------------------------------------------------------
 */
 static void HalBarSelect(void);
+#if HAL_I2C_ASYNC
+static void HalBarStartDone(bool success);
+static void HalBarReadDone(bool success);
+#endif
 
 /* ------------------------------------------------------------------------------------------------
 *                                           Local Variables
@@ -120,6 +124,11 @@ static uint8 barData[4];
 static uint8 barCmd = C953_TEMP_READ_COMMAND;
 static bool  fCmdOk;
 
+#if HAL_I2C_ASYNC
+static uint8 *barBuf;                     // Where HalBarReadMeasurementAsync() puts the data
+static halSensorCBack_t barCBack;
+#endif
+
 /**************************************************************************************************
  * @fn          HalBarInit
  *
@@ -199,6 +208,57 @@ bool HalBarReadMeasurement(uint8 *pBuf)
 }
 
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalBarStartMeasurementAsync
+ *
+ * @brief       Queue the write of HalBarStartMeasurement() on the I2C bus
+ *
+ * @param       cBack - called with TRUE if the conversion was started
+ *
+ * @return      none
+ */
+void HalBarStartMeasurementAsync(halSensorCBack_t cBack)
+{
+  barCBack = cBack;
+  HalSensorWriteRegAsync(HAL_C953_I2C_ADDRESS, C953_REG_ADDR_COMMAND, &barCmd, sizeof(barCmd),
+                         HalBarStartDone);
+}
+
+
+/**************************************************************************************************
+ * @fn          HalBarReadMeasurementAsync
+ *
+ * @brief       Queue the read of HalBarReadMeasurement() on the I2C bus
+ *
+ * @param       pBuf - buffer for temperature and pressure (4 bytes), set at the callback
+ * @param       cBack - called with TRUE if valid data
+ *
+ * @return      none
+ */
+void HalBarReadMeasurementAsync(uint8 *pBuf, halSensorCBack_t cBack)
+{
+  uint8 dOffset = 0;
+
+  if (!fCmdOk)
+  {
+    cBack(FALSE);
+    return;
+  }
+
+  if (barCmd==C953_PRESS_READ_COMMAND)
+  {
+    dOffset = 2;
+  }
+
+  barBuf = pBuf;
+  barCBack = cBack;
+  HalSensorReadRegAsync(HAL_C953_I2C_ADDRESS, C953_REG_ADDR_PRESS_LSB, &barData[dOffset],
+                        C953_DATA_LEN, HalBarReadDone);
+}
+#endif
+
+
 /**************************************************************************************************
  * @fn          HalBarReadCalibration
  *
@@ -264,6 +324,54 @@ static void HalBarSelect(void)
   HalI2CInit(HAL_C953_I2C_ADDRESS,i2cClock_267KHZ);
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalBarStartDone
+ *
+ * @brief       Keep the outcome of the command, as HalBarStartMeasurement() does
+ *
+ * @param       success - TRUE if the command was written
+ *
+ * @return      none
+ */
+static void HalBarStartDone(bool success)
+{
+  fCmdOk = success;
+  barCBack(success);
+}
+
+/**************************************************************************************************
+ * @fn          HalBarReadDone
+ *
+ * @brief       Store the data and alternate the command, as HalBarReadMeasurement() does
+ *
+ * @param       success - TRUE if the data was read
+ *
+ * @return      none
+ */
+static void HalBarReadDone(bool success)
+{
+  if (success)
+  {
+    barBuf[0] = barData[0];
+    barBuf[1] = barData[1];
+    barBuf[2] = barData[2];
+    barBuf[3] = barData[3];
+
+    // Alternate
+    if (barCmd==C953_PRESS_READ_COMMAND)
+    {
+      barCmd = C953_TEMP_READ_COMMAND;
+    } else
+    {
+      barCmd = C953_PRESS_READ_COMMAND;
+    }
+  }
+
+  barCBack(success);
+}
+#endif
+
 /*  Conversion algorithm for barometer temperature
  *  ==============================================
  *  Formula from application note, rev_X:
@@ -48,6 +48,7 @@ extern "C"
  * INCLUDES
  */
 #include "hal_types.h"
+#include "hal_sensor.h"
 
 /*********************************************************************
  * CONSTANTS
@@ -65,6 +66,10 @@ void HalBarStartMeasurement(void);
 bool HalBarReadMeasurement(uint8 *pBuf);
 void HalBarReadCalibration(uint8 *pBuf);
 bool HalBarTest(void);
+#if HAL_I2C_ASYNC
+void HalBarStartMeasurementAsync(halSensorCBack_t cBack);
+void HalBarReadMeasurementAsync(uint8 *pBuf, halSensorCBack_t cBack);
+#endif
 
 /*********************************************************************
 *********************************************************************/
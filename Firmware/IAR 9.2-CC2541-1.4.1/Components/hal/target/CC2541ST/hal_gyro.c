@@ -141,6 +141,10 @@
 * ------------------------------------------------------------------------------------------------
 */
 static void HalGyroSelect(void);
+#if HAL_I2C_ASYNC
+static void HalGyroReadDone(bool success);
+static void HalGyroSleepDone(bool success);
+#endif
 
 /* ------------------------------------------------------------------------------------------------
 *                                           Local Variables
@@ -156,6 +160,13 @@ static uint8 mStatus;
 static uint8 mDisabledAxes;
 static uint8 cfgOn;
 
+#if HAL_I2C_ASYNC
+static uint8 gyroRaw[HAL_GYRO_DATA_SIZE];  // Registers read by HalGyroReadAsync()
+static uint8 *gyroBuf;                     // Where the data goes
+static bool gyroReadOk;
+static halSensorCBack_t gyroCBack;
+#endif
+
 /* ------------------------------------------------------------------------------------------------
 *                                           Public functions
 * -------------------------------------------------------------------------------------------------
@@ -319,6 +330,45 @@ bool HalGyroWakeUp(void)
 }
 
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalGyroReadAsync
+ *
+ * @brief       Queue the read of HalGyroRead() on the I2C bus, and putting the gyro back to sleep
+ *
+ * @param       pBuf - gyro data, as HalGyroRead() stores it, set at the callback
+ * @param       cBack - called with TRUE if valid data and the gyro is asleep
+ *
+ * @return      none
+ **************************************************************************************************/
+void HalGyroReadAsync(uint8 *pBuf, halSensorCBack_t cBack)
+{
+  gyroBuf = pBuf;
+  gyroCBack = cBack;
+  HalSensorReadRegAsync(HAL_GYRO_I2C_ADDRESS, HAL_GYRO_REG_GYRO_XOUT_H, gyroRaw,
+                        HAL_GYRO_DATA_SIZE, HalGyroReadDone);
+}
+
+
+/**************************************************************************************************
+ * @fn          HalGyroWakeUpAsync
+ *
+ * @brief       Queue the write of HalGyroWakeUp() on the I2C bus
+ *
+ * @param       cBack - called with TRUE if the gyro was woken up
+ *
+ * @return      none
+ **************************************************************************************************/
+void HalGyroWakeUpAsync(halSensorCBack_t cBack)
+{
+  mStatus = HAL_GYRO_DATA_READY;
+
+  // Wake up GYRO
+  HalSensorWriteRegAsync(HAL_GYRO_I2C_ADDRESS, HAL_GYRO_REG_PWR_MGM, &cfgOn, 1, cBack);
+}
+#endif
+
+
 /**************************************************************************************************
  * @fn          HalGyroStatus
  *
@@ -406,6 +456,52 @@ static void HalGyroSelect(void)
   HalI2CInit(HAL_GYRO_I2C_ADDRESS,   i2cClock_533KHZ);
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalGyroReadDone
+ *
+ * @brief       Store the data as HalGyroRead() does, then put the gyro back to sleep
+ *
+ * @param       success - TRUE if the data was read
+ *
+ * @return      none
+ **************************************************************************************************/
+static void HalGyroReadDone(bool success)
+{
+  uint8 val;
+
+  if (success)
+  {
+    // Result in LE
+    gyroBuf[0] = gyroRaw[1];
+    gyroBuf[1] = gyroRaw[0];
+    gyroBuf[2] = gyroRaw[3];
+    gyroBuf[3] = gyroRaw[2];
+    gyroBuf[4] = gyroRaw[5];
+    gyroBuf[5] = gyroRaw[4];
+  }
+  gyroReadOk = success;
+
+  val = HAL_GYRO_PWR_MGM_SLEEP;
+  HalSensorWriteRegAsync(HAL_GYRO_I2C_ADDRESS, HAL_GYRO_REG_PWR_MGM, &val, 1, HalGyroSleepDone);
+}
+
+/**************************************************************************************************
+ * @fn          HalGyroSleepDone
+ *
+ * @brief       The gyro is asleep
+ *
+ * @param       success - TRUE if the power management register was written
+ *
+ * @return      none
+ **************************************************************************************************/
+static void HalGyroSleepDone(bool success)
+{
+  mStatus = HAL_GYRO_SLEEP;
+  gyroCBack(gyroReadOk && success);
+}
+#endif
+
 /*  Conversion algorithm for X, Y, Z
  *  ================================
  *
@@ -49,6 +49,7 @@ extern "C"
  * INCLUDES
  */
 #include "comdef.h"
+#include "hal_sensor.h"
 
 /*********************************************************************
  * CONSTANTS
@@ -75,6 +76,10 @@ bool HalGyroRead(uint8 *irTempData);
 bool HalGyroTest(void);
 void HalGyroSelectAxes(uint8 axes);
 uint8 HalGyroStatus(void);
+#if HAL_I2C_ASYNC
+void HalGyroReadAsync(uint8 *pBuf, halSensorCBack_t cBack);
+void HalGyroWakeUpAsync(halSensorCBack_t cBack);
+#endif
 
 #ifdef __cplusplus
 }
@@ -86,6 +86,10 @@
 static void HalHumiSelect(void);
 static bool HalHumiReadData(uint8 *pBuf,uint8 nBytes);
 static bool HalHumiWriteCmd(uint8 cmd);
+#if HAL_I2C_ASYNC
+static void HalHumiSubmit(uint8 cmd, uint8 *pBuf, uint8 nBytes);
+static void HalHumiDone(halI2CTrans_t *pTrans);
+#endif
 
 /* ------------------------------------------------------------------------------------------------
 *                                           Local Variables
@@ -95,6 +99,13 @@ static uint8 usr;                         // Keeps user register value
 static uint8 buf[6];                      // Data buffer
 static bool  success;
 
+#if HAL_I2C_ASYNC
+static halI2CTrans_t humiTrans;           // Command or read queued on the bus
+static uint8 humiCmd;
+static uint8 humiState;                   // Step of HalHumiExecMeasurementStepAsync()
+static halSensorCBack_t humiCBack;
+#endif
+
 /**************************************************************************************************
 * @fn          HalHumiInit
 *
@@ -187,6 +198,58 @@ bool HalHumiReadMeasurement(uint8 *pBuf)
 }
 
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+* @fn          HalHumiExecMeasurementStepAsync
+*
+* @brief       Queue the measurement step of HalHumiExecMeasurementStep() on the I2C bus
+*
+* @param       state - HAL_HUM_MEAS_STATE_x
+* @param       cBack - called with TRUE if the step succeeded
+*
+* @return      none
+*/
+void HalHumiExecMeasurementStepAsync(uint8 state, halSensorCBack_t cBack)
+{
+  humiState = state;
+  humiCBack = cBack;
+
+  switch (state)
+  {
+    case HAL_HUM_MEAS_STATE_1:
+      // Turn on DC-DC control
+      HalDcDcControl(ST_HUMID,true);
+
+      // Start temperature read
+      HalHumiSubmit(SHT21_CMD_TEMP_T_NH, NULL, 0);
+      return;
+
+    case HAL_HUM_MEAS_STATE_2:
+      // Read and store temperature value, then start for humidity read
+      if (success)
+      {
+        HalHumiSubmit(0, buf, DATA_LEN);
+        return;
+      }
+      break;
+
+    case HAL_HUM_MEAS_STATE_3:
+      // Read and store humidity value
+      if (success)
+      {
+        HalHumiSubmit(0, buf+DATA_LEN, DATA_LEN);
+        return;
+      }
+
+      // Turn of DC-DC control
+      HalDcDcControl(ST_HUMID,false);
+      break;
+  }
+
+  cBack(success);
+}
+#endif
+
 
 /**************************************************************************************************
 * @fn          HalHumiTest
@@ -261,6 +324,62 @@ static bool HalHumiReadData(uint8 *pBuf, uint8 nBytes)
   return HalI2CRead(nBytes,pBuf ) == nBytes;
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+* @fn          HalHumiSubmit
+*
+* @brief       Queue a command, or a read, to the SHT21
+*
+* @param       cmd - command to write, if nBytes is 0
+* @param       pBuf - pointer to buffer to place data
+* @param       nBytes - number of bytes to read
+*
+* @return      none
+**************************************************************************************************/
+static void HalHumiSubmit(uint8 cmd, uint8 *pBuf, uint8 nBytes)
+{
+  humiCmd = cmd;
+  humiTrans.addr = HAL_SHT21_I2C_ADDRESS;
+  humiTrans.wrLen = (nBytes == 0) ? 1 : 0;
+  humiTrans.pWr = &humiCmd;
+  humiTrans.rdLen = nBytes;
+  humiTrans.pRd = pBuf;
+  humiTrans.callBackFunc = HalHumiDone;
+
+  HalI2CSubmit(&humiTrans);
+}
+
+/**************************************************************************************************
+* @fn          HalHumiDone
+*
+* @brief       I2C callback of HalHumiSubmit(); goes on with the measurement step
+*
+* @param       pTrans - the command or read
+*
+* @return      none
+**************************************************************************************************/
+static void HalHumiDone(halI2CTrans_t *pTrans)
+{
+  success = (pTrans->status == HAL_I2C_SUCCESS) &&
+            (pTrans->cnt == pTrans->wrLen + pTrans->rdLen);
+
+  if (humiState == HAL_HUM_MEAS_STATE_2 && pTrans->rdLen != 0 && success)
+  {
+    // Start for humidity read
+    HalHumiSubmit(SHT21_CMD_HUMI_T_NH, NULL, 0);
+    return;
+  }
+
+  if (humiState == HAL_HUM_MEAS_STATE_3)
+  {
+    // Turn of DC-DC control
+    HalDcDcControl(ST_HUMID,false);
+  }
+
+  humiCBack(success);
+}
+#endif
+
 /*  Conversion algorithm, humidity
  *
 double calcHumRel(uint16 rawH)
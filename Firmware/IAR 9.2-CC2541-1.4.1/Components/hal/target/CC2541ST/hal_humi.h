@@ -47,6 +47,7 @@ extern "C"
  * INCLUDES
  */
 #include "hal_types.h"
+#include "hal_sensor.h"
 
 /*********************************************************************
  * CONSTANTS
@@ -62,6 +63,9 @@ void HalHumiInit(void);
 bool HalHumiExecMeasurementStep(uint8 state);
 bool HalHumiReadMeasurement(uint8 *pBuf);
 bool HalHumiTest(void);
+#if HAL_I2C_ASYNC
+void HalHumiExecMeasurementStepAsync(uint8 state, halSensorCBack_t cBack);
+#endif
 
 /*********************************************************************/
 
@@ -45,6 +45,14 @@
 #include "hal_assert.h"
 #include "hal_board_cfg.h"
 #include "hal_i2c.h"
+#if HAL_I2C_ASYNC
+#include "OSAL.h"
+#include "OSAL_Timers.h"
+#if defined POWER_SAVING
+#include "hal_drivers.h"
+#include "OSAL_PwrMgr.h"
+#endif
+#endif
 
 /* ------------------------------------------------------------------------------------------------
  *                                          Constants
@@ -135,6 +143,98 @@ typedef enum
  */
 static uint8 i2cAddr;  // Target Slave address pre-shifted up by one leaving RD/WRn LSB as zero.
 
+#if HAL_I2C_ASYNC
+static halI2CTrans_t *i2cHead;      // Transaction on the bus, followed by the waiting ones.
+static halI2CTrans_t *i2cTail;
+static halI2CTrans_t *i2cDoneHead;  // Finished transactions waiting for their callback.
+static halI2CTrans_t *i2cDoneTail;
+static uint8 i2cIdx;                // Next byte of the write, then of the read.
+static bool i2cReading;
+static uint8 i2cSteps;              // Counts the interrupts and starts, to tell a stuck bus.
+static uint8 i2cPollSteps;          // i2cSteps at the last progress seen by HalI2CPoll().
+static uint32 i2cPollTime;          // System clock at the last progress seen by HalI2CPoll().
+#ifdef POWER_SAVING
+static bool i2cHold;                // The Hal task holds off power saving for the bus.
+#endif
+
+/**************************************************************************************************
+ * @fn          i2cSetup
+ *
+ * @brief       Prepare the state machine for a transaction about to be started.
+ *
+ * input parameters
+ *
+ * @param       pTrans - The transaction.
+ *
+ * @return      None.
+ */
+static void i2cSetup(halI2CTrans_t *pTrans)
+{
+  i2cIdx = 0;
+  i2cReading = (pTrans->wrLen == 0) && (pTrans->rdLen != 0);
+}
+
+/**************************************************************************************************
+ * @fn          i2cDone
+ *
+ * @brief       Hand a finished transaction to HalI2CPoll(). Called with interrupts off.
+ *
+ * input parameters
+ *
+ * @param       pTrans - The transaction, already taken off the queue.
+ * @param       status - Its HAL_I2C_xxx status.
+ *
+ * @return      None.
+ */
+static void i2cDone(halI2CTrans_t *pTrans, uint8 status)
+{
+  pTrans->next = NULL;
+  pTrans->status = status;
+  if (i2cDoneHead == NULL)
+  {
+    i2cDoneHead = pTrans;
+  }
+  else
+  {
+    i2cDoneTail->next = pTrans;
+  }
+  i2cDoneTail = pTrans;
+}
+
+/**************************************************************************************************
+ * @fn          i2cAbort
+ *
+ * @brief       Fail every queued transaction with HAL_I2C_TIMEOUT and reset the controller, which
+ *              lets go of SDA and SCL.
+ *
+ * input parameters
+ *
+ * None.
+ *
+ * @return      None.
+ */
+static void i2cAbort(void)
+{
+  halI2CTrans_t *pTrans;
+  halIntState_t intState;
+
+  HAL_ENTER_CRITICAL_SECTION(intState);
+
+  I2CCFG &= ~(I2C_STA | I2C_STO | I2C_SI);
+  I2C_DISABLE();
+  I2C_ENABLE();
+
+  while ((pTrans = i2cHead) != NULL)
+  {
+    i2cHead = pTrans->next;
+    i2cDone(pTrans, HAL_I2C_TIMEOUT);
+  }
+  i2cTail = NULL;
+
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+#endif
+
 /**************************************************************************************************
  * @fn          i2cMstStrt
  *
@@ -182,6 +282,12 @@ void HalI2CInit(uint8 address, i2cClock_t clockRate)
   I2CADDR = 0; // no multi master support at this time
   I2C_CLOCK_RATE(clockRate);
   I2C_ENABLE();
+
+#if HAL_I2C_ASYNC
+  // The I2C shares its interrupt with the port 2 pins, so it is left enabled for them. The
+  // controller only asks for the interrupt with SI, which stays clear between transactions.
+  IEN2 |= I2C_IE;
+#endif
 }
 
 /**************************************************************************************************
@@ -204,6 +310,13 @@ uint8 HalI2CRead(uint8 len, uint8 *pBuf)
 {
   uint8 cnt = 0;
 
+#if HAL_I2C_ASYNC
+  if (i2cHead != NULL)
+  {
+    return 0;  // The bus belongs to the transaction queue.
+  }
+#endif
+
   if (i2cMstStrt(I2C_MST_RD_BIT) != mstAddrAckR)
   {
     len = 0;
@@ -263,6 +376,13 @@ uint8 HalI2CRead(uint8 len, uint8 *pBuf)
  */
 uint8 HalI2CWrite(uint8 len, uint8 *pBuf)
 {
+#if HAL_I2C_ASYNC
+  if (i2cHead != NULL)
+  {
+    return 0;  // The bus belongs to the transaction queue.
+  }
+#endif
+
   if (i2cMstStrt(0) != mstAddrAckW)
   {
     len = 0;
@@ -311,5 +431,284 @@ void HalI2CDisable(void)
   I2C_DISABLE();
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalI2CSubmit
+ *
+ * @brief       Queue a transaction. It is run from the I2C interrupt once the transactions ahead
+ *              of it are done, and its callback is made from HalI2CPoll(). The bus must have been
+ *              set up by HalI2CInit(); the blocking HalI2CRead/Write() fail while the queue is busy.
+ *
+ * input parameters
+ *
+ * @param       pTrans - The transaction; it must stay put until its callback.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      None.
+ */
+void HalI2CSubmit(halI2CTrans_t *pTrans)
+{
+  halIntState_t intState;
+
+  pTrans->next = NULL;
+  pTrans->cnt = 0;
+  pTrans->status = HAL_I2C_PENDING;
+
+#ifdef POWER_SAVING
+  // The bus stops in PM2/3, so hold them off until the queue is empty.
+  if (!i2cHold)
+  {
+    i2cHold = TRUE;
+    (void)osal_pwrmgr_task_state(Hal_TaskID, PWRMGR_HOLD);
+  }
+#endif
+
+  HAL_ENTER_CRITICAL_SECTION(intState);
+
+  if (i2cHead == NULL)
+  {
+    i2cHead = i2cTail = pTrans;
+    i2cSetup(pTrans);
+    i2cSteps++;
+
+    // Start; the rest is done from the interrupt.
+    I2CCFG &= ~I2C_SI;
+    I2CCFG |= I2C_STA;
+  }
+  else
+  {
+    i2cTail->next = pTrans;
+    i2cTail = pTrans;
+  }
+
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+
+/**************************************************************************************************
+ * @fn          HalI2CBusy
+ *
+ * @brief       Check whether transactions are queued or on the bus.
+ *
+ * input parameters
+ *
+ * None.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      TRUE if the queue is busy; FALSE otherwise.
+ */
+uint8 HalI2CBusy(void)
+{
+  return (i2cHead != NULL);
+}
+
+/**************************************************************************************************
+ * @fn          HalI2CPoll
+ *
+ * @brief       Make the callbacks of the finished transactions, in the order they were queued.
+ *              A callback may queue another transaction. A bus that makes no progress for
+ *              HAL_I2C_STUCK_TIMEOUT is reset and its transactions fail with HAL_I2C_TIMEOUT,
+ *              so that a slave holding SCL or SDA low cannot hold off power saving for good.
+ *
+ * input parameters
+ *
+ * None.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      None.
+ */
+void HalI2CPoll(void)
+{
+  halI2CTrans_t *pTrans;
+  halIntState_t intState;
+
+  if (i2cHead != NULL)
+  {
+    uint32 now = osal_GetSystemClock();
+
+    if (i2cSteps != i2cPollSteps)
+    {
+      i2cPollSteps = i2cSteps;
+      i2cPollTime = now;
+    }
+    else if ((now - i2cPollTime) >= HAL_I2C_STUCK_TIMEOUT)
+    {
+      i2cAbort();
+    }
+  }
+
+  while (1)
+  {
+    HAL_ENTER_CRITICAL_SECTION(intState);
+    pTrans = i2cDoneHead;
+    if (pTrans != NULL)
+    {
+      i2cDoneHead = pTrans->next;
+      if (i2cDoneHead == NULL)
+      {
+        i2cDoneTail = NULL;
+      }
+      pTrans->next = NULL;
+    }
+    HAL_EXIT_CRITICAL_SECTION(intState);
+
+    if (pTrans == NULL)
+    {
+      break;
+    }
+
+    if (pTrans->callBackFunc != NULL)
+    {
+      pTrans->callBackFunc(pTrans);
+    }
+  }
+
+#ifdef POWER_SAVING
+  if (i2cHold && (i2cHead == NULL))
+  {
+    i2cHold = FALSE;
+    (void)osal_pwrmgr_task_state(Hal_TaskID, PWRMGR_CONSERVE);
+  }
+#endif
+}
+
+/**************************************************************************************************
+ * @fn          halI2CProcessInterrupt
+ *
+ * @brief       Advance the transaction on the bus by one step. Called from the I2C interrupt.
+ *
+ * input parameters
+ *
+ * None.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      None.
+ */
+void halI2CProcessInterrupt(void)
+{
+  halI2CTrans_t *pTrans = i2cHead;
+  uint8 status;
+
+  if ((pTrans == NULL) || ((I2CCFG & I2C_SI) == 0))
+  {
+    return;
+  }
+
+  i2cSteps++;
+
+  switch (I2CSTAT)
+  {
+  case mstStarted:
+  case mstRepStart:
+    I2CCFG &= ~I2C_STA;
+    I2CDATA = (pTrans->addr << 1) | (i2cReading ? I2C_MST_RD_BIT : 0);
+    I2CCFG &= ~I2C_SI;
+    return;
+
+  case mstDataAckW:
+    pTrans->cnt++;
+    // Fall through.
+  case mstAddrAckW:
+    if (i2cIdx < pTrans->wrLen)
+    {
+      I2CDATA = pTrans->pWr[i2cIdx++];
+      I2CCFG &= ~I2C_SI;
+      return;
+    }
+    if (pTrans->rdLen != 0)
+    {
+      // Repeated START for the read.
+      i2cReading = TRUE;
+      i2cIdx = 0;
+      I2CCFG |= I2C_STA;
+      I2CCFG &= ~I2C_SI;
+      return;
+    }
+    status = HAL_I2C_SUCCESS;
+    break;
+
+  case mstAddrAckR:
+    // All bytes are ACK'd except for the last one which is NACK'd.
+    if (pTrans->rdLen > 1)
+    {
+      I2C_SET_ACK();
+    }
+    else
+    {
+      I2C_SET_NACK();
+    }
+    I2CCFG &= ~I2C_SI;
+    return;
+
+  case mstDataAckR:
+    pTrans->pRd[i2cIdx++] = I2CDATA;
+    pTrans->cnt++;
+    if ((i2cIdx + 1) >= pTrans->rdLen)
+    {
+      I2C_SET_NACK();
+    }
+    I2CCFG &= ~I2C_SI;
+    return;
+
+  case mstDataNackR:
+    pTrans->pRd[i2cIdx++] = I2CDATA;
+    pTrans->cnt++;
+    status = HAL_I2C_SUCCESS;
+    break;
+
+  case mstDataNackW:
+    // A slave may NACK the last byte of a write, as HalI2CWrite() allows.
+    pTrans->cnt++;
+    status = ((i2cIdx == pTrans->wrLen) && (pTrans->rdLen == 0)) ? HAL_I2C_SUCCESS : HAL_I2C_NACK;
+    break;
+
+  case mstAddrNackW:
+  case mstAddrNackR:
+    status = HAL_I2C_NACK;
+    break;
+
+  case mstLostArb:
+    status = HAL_I2C_LOST_ARB;
+    break;
+
+  default:
+    status = HAL_I2C_BUS_ERROR;
+    break;
+  }
+
+  // The transaction is done, hand it to HalI2CPoll().
+  i2cHead = pTrans->next;
+  i2cDone(pTrans, status);
+
+  // After a lost arbitration the bus has already been released, so no STOP. With STO and STA
+  // both set the controller sends a STOP and then a START for the next transaction.
+  if (i2cHead != NULL)
+  {
+    i2cSetup(i2cHead);
+    I2CCFG |= (status == HAL_I2C_LOST_ARB) ? I2C_STA : (I2C_STO | I2C_STA);
+  }
+  else
+  {
+    i2cTail = NULL;
+    if (status != HAL_I2C_LOST_ARB)
+    {
+      I2CCFG |= I2C_STO;
+    }
+  }
+  I2CCFG &= ~I2C_SI;
+}
+#endif
+
 /*********************************************************************
 *********************************************************************/
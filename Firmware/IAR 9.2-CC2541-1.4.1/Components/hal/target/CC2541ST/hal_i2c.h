@@ -51,6 +51,24 @@
  */
 #define HAL_I2C_SLAVE_ADDR_DEF           0x41
 
+/* Set to TRUE for the interrupt driven transaction queue, see HalI2CSubmit() */
+#if !defined HAL_I2C_ASYNC
+#define HAL_I2C_ASYNC                    FALSE
+#endif
+
+/* Time in ms a queued transaction may go without progress before it is taken to be stuck */
+#if !defined HAL_I2C_STUCK_TIMEOUT
+#define HAL_I2C_STUCK_TIMEOUT            25
+#endif
+
+/* Transaction status */
+#define HAL_I2C_SUCCESS                  0x00
+#define HAL_I2C_PENDING                  0x01  // Queued or on the bus
+#define HAL_I2C_NACK                     0x02  // Slave did not acknowledge its address or data
+#define HAL_I2C_LOST_ARB                 0x03  // Another master took the bus
+#define HAL_I2C_BUS_ERROR                0x04  // Unexpected bus state
+#define HAL_I2C_TIMEOUT                  0x05  // No progress for HAL_I2C_STUCK_TIMEOUT, aborted
+
 /* ------------------------------------------------------------------------------------------------
  *                                           Typedefs
  * ------------------------------------------------------------------------------------------------
@@ -66,6 +84,27 @@ typedef enum
   i2cClock_533KHZ = 0x82
 } i2cClock_t;
 
+#if HAL_I2C_ASYNC
+struct halI2CTrans;
+typedef void (*halI2CCBack_t)(struct halI2CTrans *pTrans);
+
+/* A write of wrLen bytes, then a repeated START and a read of rdLen bytes, from one slave. Either
+ * length may be zero. The transaction belongs to the caller and must stay put until its callback.
+ */
+typedef struct halI2CTrans
+{
+  struct halI2CTrans *next;  // Used by the driver
+  uint8 addr;                // 7-bit slave address
+  uint8 wrLen;
+  uint8 *pWr;
+  uint8 rdLen;
+  uint8 *pRd;
+  uint8 cnt;                 // Bytes written, then read, by the time of the callback
+  uint8 status;              // HAL_I2C_xxx
+  halI2CCBack_t callBackFunc;  // Called from HalI2CPoll() when done; may be NULL
+} halI2CTrans_t;
+#endif
+
 
 /* ------------------------------------------------------------------------------------------------
  *                                       Global Functions
@@ -75,6 +114,12 @@ void     HalI2CInit(uint8 address, i2cClock_t clockRate);
 uint8    HalI2CRead(uint8 len, uint8 *pBuf);
 uint8    HalI2CWrite(uint8 len, uint8 *pBuf);
 void     HalI2CDisable(void);
+#if HAL_I2C_ASYNC
+void     HalI2CSubmit(halI2CTrans_t *pTrans);
+uint8    HalI2CBusy(void);
+void     HalI2CPoll(void);
+void     halI2CProcessInterrupt(void);
+#endif
 
 #endif
 /**************************************************************************************************
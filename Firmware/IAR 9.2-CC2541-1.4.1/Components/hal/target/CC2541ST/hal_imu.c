@@ -0,0 +1,393 @@
+/**************************************************************************************************
+  Filename:       hal_imu.c
+
+  Description:    Attitude estimation for the CC2541ST. A complementary filter
+                  integrates the gyro rates and pulls the result towards the
+                  tilt measured by the accelerometer and the tilt compensated
+                  heading measured by the magnetometer, estimating the gyro
+                  bias on the way like a Mahony filter. Angles are kept as
+                  binary angles (65536 = 360 degrees) so heading wraps by
+                  itself and everything is integer arithmetic.
+
+                  Axes: x forward, y left, z up, as on the SensorTag board.
+                  Heading is clockwise from magnetic north, pitch is positive
+                  nose up and roll is positive right side down. The gyro rates
+                  are applied to the angles directly, which holds for the
+                  small tilts of a vehicle.
+**************************************************************************************************/
+
+/* ------------------------------------------------------------------------------------------------
+*                                          Includes
+* ------------------------------------------------------------------------------------------------
+*/
+#include "hal_imu.h"
+
+/* ------------------------------------------------------------------------------------------------
+*                                           Macros and constants
+* ------------------------------------------------------------------------------------------------
+*/
+/* Angles in imuAngle */
+#define IMU_HEADING                           0
+#define IMU_PITCH                             1
+#define IMU_ROLL                              2
+#define IMU_NUM_ANGLES                        3
+
+/* Binary angles */
+#define IMU_ANGLE_90                          0x4000
+#define IMU_ANGLE_180                         0x8000
+
+/* Gyro: 65536/500 LSB per deg/s, giving 91 binary angle units << 16 per LSB per ms */
+#define IMU_GYRO_SCALE                        91
+
+/* atan(z) ~ z*pi/4 + 0.273*z*(1-z) for z in [0,1], the second coefficient in binary angle units */
+#define IMU_ATAN_K                            2847
+
+/* imuState */
+#define IMU_TILT_SET                          0x01
+#define IMU_HEADING_SET                       0x02
+
+/* ------------------------------------------------------------------------------------------------
+*                                           Local Functions
+* ------------------------------------------------------------------------------------------------
+*/
+static void   halImuCorrect(uint8 axis, int16 ref);
+static int16  halImuAtan2(int32 y, int32 x);
+static int16  halImuSin(uint16 a);
+static uint16 halImuSqrt(uint32 x);
+static int16  halImuCentiDeg(int16 a);
+
+/* ------------------------------------------------------------------------------------------------
+*                                           Local Variables
+* ------------------------------------------------------------------------------------------------
+*/
+/* Heading, pitch and roll as binary angles << 16 */
+static uint32 imuAngle[IMU_NUM_ANGLES];
+
+/* Gyro bias correction added in each update, same unit */
+static int32  imuBias[IMU_NUM_ANGLES];
+
+static int16  imuMagOffset[3];
+static uint32 imuGyroScale;
+static uint16 imuOneG;
+static uint8  imuState;
+
+/* sin() of 0 to 90 degrees in steps of 256 binary angle units, Q15 */
+static const int16 imuSinTable[65] =
+{
+      0,   804,  1608,  2411,  3212,  4011,  4808,  5602,
+   6393,  7180,  7962,  8740,  9512, 10279, 11039, 11793,
+  12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+  18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595,
+  23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+  27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957,
+  30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972,
+  32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758,
+  32767
+};
+
+/**************************************************************************************************
+ * @fn          HalImuInit
+ *
+ * @brief       Reset the filter. The attitude is taken from the first samples.
+ *
+ * @param       period - time between calls to HalImuUpdate() in ms
+ * @param       accOneG - accelerometer reading at 1 g, 16 in the 8 g range; samples more than 25%
+ *                        off 1 g are not used to correct the tilt
+ *
+ * @return      none
+ */
+void HalImuInit(uint16 period, uint8 accOneG)
+{
+  uint8 i;
+
+  for (i = 0; i < IMU_NUM_ANGLES; i++)
+  {
+    imuAngle[i] = 0;
+    imuBias[i] = 0;
+  }
+
+  imuGyroScale = (uint32)period * IMU_GYRO_SCALE;
+  imuOneG = accOneG;
+  imuState = 0;
+}
+
+/**************************************************************************************************
+ * @fn          HalImuSetMagOffset
+ *
+ * @brief       Set the hard iron offset of the magnetometer, the reading halfway between the
+ *              extremes of each axis seen while turning the board around.
+ *
+ * @param       x, y, z - offsets in magnetometer LSB
+ *
+ * @return      none
+ */
+void HalImuSetMagOffset(int16 x, int16 y, int16 z)
+{
+  imuMagOffset[0] = x;
+  imuMagOffset[1] = y;
+  imuMagOffset[2] = z;
+}
+
+/**************************************************************************************************
+ * @fn          HalImuUpdate
+ *
+ * @brief       Advance the filter by one period.
+ *
+ * @param       pAcc - accelerometer sample as from HalAccRead()
+ * @param       pGyro - gyro sample as from HalGyroRead()
+ * @param       pMag - magnetometer sample as from HalMagRead(), NULL if there is no new one
+ *
+ * @return      none
+ */
+void HalImuUpdate(uint8 *pAcc, uint8 *pGyro, uint8 *pMag)
+{
+  int8 ax = (int8)pAcc[0];
+  int8 ay = (int8)pAcc[1];
+  int8 az = (int8)pAcc[2];
+  uint32 g2;
+  uint16 yz2;
+  uint16 a2;
+  uint8 i;
+
+  // Integrate the gyro rates: heading turns the other way round from z
+  imuAngle[IMU_HEADING] -= (int32)(int16)BUILD_UINT16(pGyro[4], pGyro[5]) * imuGyroScale;
+  imuAngle[IMU_PITCH] -= (int32)(int16)BUILD_UINT16(pGyro[2], pGyro[3]) * imuGyroScale;
+  imuAngle[IMU_ROLL] += (int32)(int16)BUILD_UINT16(pGyro[0], pGyro[1]) * imuGyroScale;
+  for (i = 0; i < IMU_NUM_ANGLES; i++)
+  {
+    imuAngle[i] += imuBias[i];
+  }
+
+  // Tilt from the accelerometer, unless the board is being accelerated
+  yz2 = (uint16)(ay * ay) + (uint16)(az * az);
+  a2 = yz2 + (uint16)(ax * ax);
+  g2 = (uint32)imuOneG * imuOneG;
+  if (a2 >= g2 * 9 / 16 && a2 <= g2 * 25 / 16)
+  {
+    halImuCorrect(IMU_PITCH, halImuAtan2(ax, halImuSqrt(yz2)));
+    halImuCorrect(IMU_ROLL, halImuAtan2(ay, az));
+    imuState |= IMU_TILT_SET;
+  }
+
+  // Heading from the magnetometer, rotated back to level
+  if (pMag != NULL && (imuState & IMU_TILT_SET))
+  {
+    int16 mx = (int16)BUILD_UINT16(pMag[0], pMag[1]) - imuMagOffset[0];
+    int16 my = (int16)BUILD_UINT16(pMag[2], pMag[3]) - imuMagOffset[1];
+    int16 mz = (int16)BUILD_UINT16(pMag[4], pMag[5]) - imuMagOffset[2];
+    uint16 pitch = (uint16)(imuAngle[IMU_PITCH] >> 16);
+    uint16 roll = (uint16)(imuAngle[IMU_ROLL] >> 16);
+    int16 sp = halImuSin(pitch);
+    int16 cp = halImuSin(pitch + IMU_ANGLE_90);
+    int16 sr = halImuSin(roll);
+    int16 cr = halImuSin(roll + IMU_ANGLE_90);
+    int32 up;
+    int32 xh;
+    int32 yh;
+
+    up = ((int32)my * sr + (int32)mz * cr) >> 15;
+    xh = ((int32)mx * cp - up * sp) >> 15;
+    yh = ((int32)my * cr - (int32)mz * sr) >> 15;
+
+    halImuCorrect(IMU_HEADING, halImuAtan2(yh, xh));
+    imuState |= IMU_HEADING_SET;
+  }
+}
+
+/**************************************************************************************************
+ * @fn          HalImuGetAttitude
+ *
+ * @brief       Get the attitude: heading (0 to 35999), pitch and roll, in 0.01 degrees, each
+ *              16 bits LSB first
+ *
+ * @param       pBuf - buffer for HAL_IMU_ATTITUDE_LEN bytes
+ *
+ * @return      none
+ */
+void HalImuGetAttitude(uint8 *pBuf)
+{
+  uint16 heading;
+  int16 v;
+
+  heading = (uint16)(((uint32)(uint16)(imuAngle[IMU_HEADING] >> 16) * 36000) >> 16);
+  pBuf[0] = LO_UINT16(heading);
+  pBuf[1] = HI_UINT16(heading);
+
+  v = halImuCentiDeg((int16)(imuAngle[IMU_PITCH] >> 16));
+  pBuf[2] = LO_UINT16(v);
+  pBuf[3] = HI_UINT16(v);
+
+  v = halImuCentiDeg((int16)(imuAngle[IMU_ROLL] >> 16));
+  pBuf[4] = LO_UINT16(v);
+  pBuf[5] = HI_UINT16(v);
+}
+
+/* ------------------------------------------------------------------------------------------------
+*                                           Private functions
+* -------------------------------------------------------------------------------------------------
+*/
+
+/**************************************************************************************************
+ * @fn          halImuCorrect
+ *
+ * @brief       Pull an angle towards its reference and update the gyro bias estimate. The first
+ *              reference sets the angle.
+ *
+ * @param       axis - IMU_xxx
+ * @param       ref - reference angle
+ *
+ * @return      none
+ */
+static void halImuCorrect(uint8 axis, int16 ref)
+{
+  int16 err;
+
+  if (!(imuState & ((axis == IMU_HEADING) ? IMU_HEADING_SET : IMU_TILT_SET)))
+  {
+    imuAngle[axis] = (uint32)(uint16)ref << 16;
+    return;
+  }
+
+  // Binary angles: the difference wraps to the shortest way round
+  err = (int16)((uint16)ref - (uint16)(imuAngle[axis] >> 16));
+
+  imuAngle[axis] += (int32)err << (16 - HAL_IMU_KP_SHIFT);
+  imuBias[axis] += (int32)err << (16 - HAL_IMU_KI_SHIFT);
+}
+
+/**************************************************************************************************
+ * @fn          halImuAtan2
+ *
+ * @brief       atan2() to within 0.3 degrees
+ *
+ * @param       y, x - vector
+ *
+ * @return      binary angle
+ */
+static int16 halImuAtan2(int32 y, int32 x)
+{
+  uint32 ax = (x < 0) ? -x : x;
+  uint32 ay = (y < 0) ? -y : y;
+  uint32 z;
+  uint16 a;
+
+  if (ax == 0 && ay == 0)
+  {
+    return 0;
+  }
+
+  while (ax > 0x7FFF || ay > 0x7FFF)
+  {
+    ax >>= 1;
+    ay >>= 1;
+  }
+
+  // First octant, z in Q15
+  if (ay <= ax)
+  {
+    z = (ay << 15) / ax;
+  }
+  else
+  {
+    z = (ax << 15) / ay;
+  }
+  a = (uint16)((z >> 2) + ((IMU_ATAN_K * ((z * (32768 - z)) >> 15)) >> 15));
+
+  if (ay > ax)
+  {
+    a = IMU_ANGLE_90 - a;
+  }
+  if (x < 0)
+  {
+    a = IMU_ANGLE_180 - a;
+  }
+  if (y < 0)
+  {
+    a = -a;
+  }
+
+  return (int16)a;
+}
+
+/**************************************************************************************************
+ * @fn          halImuSin
+ *
+ * @brief       sin() by table lookup and linear interpolation
+ *
+ * @param       a - binary angle
+ *
+ * @return      sine, Q15
+ */
+static int16 halImuSin(uint16 a)
+{
+  uint16 i = a & (IMU_ANGLE_90 - 1);
+  uint8 idx;
+  int16 s;
+
+  if (a & IMU_ANGLE_90)
+  {
+    i = IMU_ANGLE_90 - i;
+  }
+
+  idx = (uint8)(i >> 8);
+  s = imuSinTable[idx];
+  if (idx < 64)
+  {
+    s += (int16)(((int32)(imuSinTable[idx + 1] - s) * (i & 0xFF)) >> 8);
+  }
+
+  return (a & IMU_ANGLE_180) ? -s : s;
+}
+
+/**************************************************************************************************
+ * @fn          halImuSqrt
+ *
+ * @brief       Integer square root
+ *
+ * @param       x - value
+ *
+ * @return      floor(sqrt(x))
+ */
+static uint16 halImuSqrt(uint32 x)
+{
+  uint32 root = 0;
+  uint32 bit = 1UL << 30;
+
+  while (bit > x)
+  {
+    bit >>= 2;
+  }
+
+  while (bit != 0)
+  {
+    if (x >= root + bit)
+    {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return (uint16)root;
+}
+
+/**************************************************************************************************
+ * @fn          halImuCentiDeg
+ *
+ * @brief       Convert a signed binary angle to 0.01 degrees
+ *
+ * @param       a - binary angle
+ *
+ * @return      angle in 0.01 degrees, -18000 to 17999
+ */
+static int16 halImuCentiDeg(int16 a)
+{
+  return (int16)(((int32)a * 36000) / 65536);
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,53 @@
+/**************************************************************************************************
+  Filename:       hal_imu.h
+
+  Description:    Attitude estimation for the CC2541ST. Fuses the accelerometer,
+                  gyro and magnetometer samples into heading, pitch and roll with
+                  a fixed point complementary filter.
+**************************************************************************************************/
+
+#ifndef HAL_IMU_H
+#define HAL_IMU_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "hal_types.h"
+
+/*********************************************************************
+ * CONSTANTS and MACROS
+ */
+
+/* Share of the accelerometer and magnetometer angles in each update is 1/2^HAL_IMU_KP_SHIFT */
+#if !defined HAL_IMU_KP_SHIFT
+#define HAL_IMU_KP_SHIFT                      5
+#endif
+
+/* Share of the angle error that goes into the gyro bias estimate is 1/2^HAL_IMU_KI_SHIFT */
+#if !defined HAL_IMU_KI_SHIFT
+#define HAL_IMU_KI_SHIFT                      11
+#endif
+
+/* Length of the attitude returned by HalImuGetAttitude() */
+#define HAL_IMU_ATTITUDE_LEN                  6
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+void HalImuInit(uint16 period, uint8 accOneG);
+void HalImuSetMagOffset(int16 x, int16 y, int16 z);
+void HalImuUpdate(uint8 *pAcc, uint8 *pGyro, uint8 *pMag);
+void HalImuGetAttitude(uint8 *pBuf);
+
+/*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_IMU_H */
@@ -101,6 +101,10 @@ HAL_ISR_FUNCTION( halI2CIsr, I2C_VECTOR )
 {
   HAL_ENTER_ISR();
 
+#if HAL_I2C_ASYNC
+  halI2CProcessInterrupt();
+#endif
+
   /*
     Clear the CPU interrupt flag for Port_2
     PxIFG has to be cleared before PxIF
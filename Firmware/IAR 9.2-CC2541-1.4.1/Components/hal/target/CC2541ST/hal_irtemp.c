@@ -79,6 +79,12 @@
 * ------------------------------------------------------------------------------------------------
 */
 static void HalIRTempSelect(void);
+#if HAL_I2C_ASYNC
+static void HalIRTempStatusDone(bool success);
+static void HalIRTempVoltageDone(bool success);
+static void HalIRTempReadDone(bool success);
+static void HalIRTempTurnOnDone(bool success);
+#endif
 
 
 /* ------------------------------------------------------------------------------------------------
@@ -91,6 +97,12 @@ static uint8 configSensorReset[2] = {0x80, 0x00};  // Sensor reset
 static uint8 configSensorOff[2] = {0x00, 0x80};    // Sensor standby
 static uint8 configSensorOn[2] =  {0x70, 0x00};    // Conversion time 0.25 sec
 
+#if HAL_I2C_ASYNC
+static uint8 irtRaw[2 * IRTEMP_REG_LEN];           // Registers read by HalIRTempReadAsync()
+static uint8 *irtBuf;                              // Where the data goes
+static halSensorCBack_t irtCBack;
+#endif
+
 /* ------------------------------------------------------------------------------------------------
 *                                           Public functions
 * -------------------------------------------------------------------------------------------------
@@ -225,6 +237,54 @@ IRTemperature_States_t HalIRTempStatus(void)
 }
 
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalIRTempReadAsync
+ *
+ * @brief       Queue the reads of HalIRTempStatus() and HalIRTempRead() on the I2C bus: the data
+ *              ready bit, then the sensor voltage and sensor temperature registers. Unlike
+ *              HalIRTempRead() it leaves the sensor on; HalIRTempTurnOnAsync() restarts it.
+ *
+ * @param       pBuf - voltage and temperature in raw format (2 + 2 bytes), set at the callback
+ * @param       cBack - called with TRUE if valid data
+ *
+ * @return      none
+ **************************************************************************************************/
+void HalIRTempReadAsync(uint8 *pBuf, halSensorCBack_t cBack)
+{
+  if (irtSensorState == TMP006_OFF)
+  {
+    cBack(FALSE);
+    return;
+  }
+
+  irtBuf = pBuf;
+  irtCBack = cBack;
+  HalSensorReadRegAsync(TMP006_I2C_ADDRESS, TMP006_REG_ADDR_CONFIG, irtRaw, IRTEMP_REG_LEN,
+                        HalIRTempStatusDone);
+}
+
+
+/**************************************************************************************************
+ * @fn          HalIRTempTurnOnAsync
+ *
+ * @brief       Queue the write of HalIRTempTurnOn() on the I2C bus
+ *
+ * @param       cBack - called with TRUE if the sensor is on
+ *
+ * @return      none
+ **************************************************************************************************/
+void HalIRTempTurnOnAsync(halSensorCBack_t cBack)
+{
+  HalDcDcControl(ST_IRTEMP,true);
+
+  irtCBack = cBack;
+  HalSensorWriteRegAsync(TMP006_I2C_ADDRESS, TMP006_REG_ADDR_CONFIG, configSensorOn,
+                         IRTEMP_REG_LEN, HalIRTempTurnOnDone);
+}
+#endif
+
+
 /**************************************************************************************************
  * @fn          HalIRTempTest
  *
@@ -292,6 +352,93 @@ static void HalIRTempSelect(void)
   HalI2CInit(TMP006_I2C_ADDRESS, i2cClock_533KHZ);
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalIRTempStatusDone
+ *
+ * @brief       Read the sensor voltage if the data is ready
+ *
+ * @param       success - TRUE if the configuration register was read
+ *
+ * @return      none
+ **************************************************************************************************/
+static void HalIRTempStatusDone(bool success)
+{
+  // In the byte order of the uint16 that HalIRTempStatus() reads it into
+  if (!success || !(BUILD_UINT16(irtRaw[0], irtRaw[1]) & DATA_RDY_BIT))
+  {
+    irtCBack(FALSE);
+    return;
+  }
+
+  irtSensorState = TMP006_DATA_READY;
+  HalSensorReadRegAsync(TMP006_I2C_ADDRESS, TMP006_REG_ADDR_VOLTAGE, irtRaw, IRTEMP_REG_LEN,
+                        HalIRTempVoltageDone);
+}
+
+/**************************************************************************************************
+ * @fn          HalIRTempVoltageDone
+ *
+ * @brief       Read the sensor temperature
+ *
+ * @param       success - TRUE if the sensor voltage was read
+ *
+ * @return      none
+ **************************************************************************************************/
+static void HalIRTempVoltageDone(bool success)
+{
+  if (!success)
+  {
+    irtCBack(FALSE);
+    return;
+  }
+
+  HalSensorReadRegAsync(TMP006_I2C_ADDRESS, TMP006_REG_ADDR_TEMPERATURE, &irtRaw[IRTEMP_REG_LEN],
+                        IRTEMP_REG_LEN, HalIRTempReadDone);
+}
+
+/**************************************************************************************************
+ * @fn          HalIRTempReadDone
+ *
+ * @brief       Store the values as HalIRTempRead() does
+ *
+ * @param       success - TRUE if the sensor temperature was read
+ *
+ * @return      none
+ **************************************************************************************************/
+static void HalIRTempReadDone(bool success)
+{
+  if (success)
+  {
+    irtBuf[0] = irtRaw[1];
+    irtBuf[1] = irtRaw[0];
+    irtBuf[2] = irtRaw[3];
+    irtBuf[3] = irtRaw[2];
+  }
+
+  irtCBack(success);
+}
+
+/**************************************************************************************************
+ * @fn          HalIRTempTurnOnDone
+ *
+ * @brief       The sensor is on if the configuration was written
+ *
+ * @param       success - TRUE if the configuration register was written
+ *
+ * @return      none
+ **************************************************************************************************/
+static void HalIRTempTurnOnDone(bool success)
+{
+  if (success)
+  {
+    irtSensorState = TMP006_IDLE;
+  }
+
+  irtCBack(success);
+}
+#endif
+
 /*  Conversion algorithm for die temperature
  *  ================================================
  *
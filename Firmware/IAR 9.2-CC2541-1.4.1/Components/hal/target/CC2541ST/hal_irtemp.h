@@ -48,6 +48,7 @@ extern "C"
  * INCLUDES
  */
 #include "comdef.h"
+#include "hal_sensor.h"
 
 /*********************************************************************
  * CONSTANTS
@@ -74,6 +75,10 @@ void HalIRTempTurnOff(void);
 bool HalIRTempRead(uint8 *irTempData);
 bool HalIRTempTest(void);
 IRTemperature_States_t HalIRTempStatus(void);
+#if HAL_I2C_ASYNC
+void HalIRTempReadAsync(uint8 *pBuf, halSensorCBack_t cBack);
+void HalIRTempTurnOnAsync(halSensorCBack_t cBack);
+#endif
 
 
 #ifdef __cplusplus
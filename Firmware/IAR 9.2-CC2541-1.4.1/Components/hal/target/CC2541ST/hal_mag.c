@@ -108,6 +108,10 @@
 * ------------------------------------------------------------------------------------------------
 */
 static void HalMagSelect(void);
+#if HAL_I2C_ASYNC
+static void HalMagStatusDone(bool success);
+static void HalMagReadDone(bool success);
+#endif
 
 /* ------------------------------------------------------------------------------------------------
 *                                           Local Variables
@@ -118,6 +122,12 @@ static uint8 halMagSensorConfig = MAG_REG_CTRL_ON;
 static uint8 halMagSensorOff = MAG_REG_CTRL_OFF;
 static uint8 halMagAutoMrstEn = MAG_REG_CTRL2_AMN;
 
+#if HAL_I2C_ASYNC
+static uint8 magRaw[MAG_REG_READ_ALL_LEN];  // Registers read by HalMagReadAsync()
+static uint8 *magBuf;                       // Where the data goes
+static halSensorCBack_t magCBack;
+#endif
+
 
 /**************************************************************************************************
  * @fn          HalMagInit
@@ -222,6 +232,35 @@ bool HalMagRead(uint8 *pBuf)
 }
 
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+* @fn          HalMagReadAsync
+*
+* @brief       Queue the reads of HalMagStatus() and HalMagRead() on the I2C bus
+*
+* @param       pBuf - buffer to hold the data, set at the callback
+* @param       cBack - called with TRUE if valid data
+*
+* @return      none
+*/
+void HalMagReadAsync(uint8 *pBuf, halSensorCBack_t cBack)
+{
+  magBuf = pBuf;
+  magCBack = cBack;
+
+  if (sensorState == MAG3110_IDLE)
+  {
+    HalSensorReadRegAsync(HAL_MAG3110_I2C_ADDRESS, MAG_REG_ADDR_DR_STATUS, magRaw, 1,
+                          HalMagStatusDone);
+  }
+  else
+  {
+    HalMagStatusDone(FALSE);
+  }
+}
+#endif
+
+
 /**************************************************************************************************
  * @fn          HalMagTest
  *
@@ -279,6 +318,60 @@ static void HalMagSelect(void)
   HalI2CInit(HAL_MAG3110_I2C_ADDRESS,i2cClock_267KHZ);
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+* @fn          HalMagStatusDone
+*
+* @brief       Read the data if it is ready
+*
+* @param       success - TRUE if the status register was read
+*
+* @return      none
+*/
+static void HalMagStatusDone(bool success)
+{
+  if (success && magRaw[0] != 0)
+  {
+    sensorState = MAG3110_DATA_READY;
+  }
+
+  if (sensorState != MAG3110_DATA_READY)
+  {
+    magCBack(FALSE);
+    return;
+  }
+
+  HalSensorReadRegAsync(HAL_MAG3110_I2C_ADDRESS, MAG_REG_ADDR_READ_START, magRaw,
+                        MAG_REG_READ_ALL_LEN, HalMagReadDone);
+}
+
+/**************************************************************************************************
+* @fn          HalMagReadDone
+*
+* @brief       Store the data as HalMagRead() does
+*
+* @param       success - TRUE if the data was read
+*
+* @return      none
+*/
+static void HalMagReadDone(bool success)
+{
+  if (success)
+  {
+    // Swap bytes in each value-pair
+    magBuf[0] = magRaw[1];
+    magBuf[1] = magRaw[0];
+    magBuf[2] = magRaw[3];
+    magBuf[3] = magRaw[2];
+    magBuf[4] = magRaw[5];
+    magBuf[5] = magRaw[4];
+  }
+  sensorState = MAG3110_IDLE;
+
+  magCBack(success);
+}
+#endif
+
 
 /*  Conversion algorithm for X, Y, Z
  *  ================================
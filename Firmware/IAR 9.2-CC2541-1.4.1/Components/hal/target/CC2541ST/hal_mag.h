@@ -47,6 +47,7 @@ extern "C" {
  * ------------------------------------------------------------------------------------------------
  */
 #include "comdef.h"
+#include "hal_sensor.h"
 
 /* ------------------------------------------------------------------------------------------------
  *                                          Constants
@@ -77,6 +78,9 @@ void HalMagTurnOff(void);
 bool HalMagRead(uint8 *pBuf);
 bool HalMagTest(void);
 Magnetometer_States_t HalMagStatus( void );
+#if HAL_I2C_ASYNC
+void HalMagReadAsync(uint8 *pBuf, halSensorCBack_t cBack);
+#endif
 
 /**************************************************************************************************
 */
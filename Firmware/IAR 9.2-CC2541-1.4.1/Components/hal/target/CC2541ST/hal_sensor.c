@@ -50,6 +50,9 @@
 #include "hal_mag.h"
 #include "hal_acc.h"
 #include "hal_gyro.h"
+#if HAL_SENSOR_SCHED
+#include "OSAL.h"
+#endif
 
 /* ------------------------------------------------------------------------------------------------
 *                                           Macros and constants
@@ -57,6 +60,38 @@
 */
 #define N_TEST_RUNS                           10
 
+#if HAL_I2C_ASYNC
+/* Longest register write queued by HalSensorWriteRegAsync(), in data bytes */
+#define SENSOR_WR_MAX                         4
+#endif
+
+#if HAL_SENSOR_SCHED
+/* Number of sensors; a sensor's slot is the bit number of its ST_xxx value */
+#define SCHED_NUM_SENSORS                     6
+
+/* Shortest sampling periods in ms, set by the conversion times of the sensors. The humidity
+ * sensor converts temperature and humidity one after the other, one conversion per burst, so it
+ * is scheduled at half its sampling period and its minimum is that of one conversion.
+ */
+#define SCHED_MIN_IRTEMP                      275
+#define SCHED_MIN_HUMID                       20
+#define SCHED_MIN_MAGN                        HAL_SENSOR_TICK
+#define SCHED_MIN_ACC                         HAL_SENSOR_TICK
+#define SCHED_MIN_PRESS                       80
+#define SCHED_MIN_GYRO                        60
+
+/* Sensors that convert between bursts; the others are read in one go */
+#define SCHED_PIPELINED                       ( ST_IRTEMP | ST_HUMID | ST_PRESS | ST_GYRO)
+
+/* Gyro axes enabled by the scheduler: X, Y and Z */
+#define SCHED_GYRO_AXES                       0x07
+
+#if HAL_I2C_ASYNC
+/* Bus clock of the bursts, one that all the sensors take */
+#define SCHED_I2C_CLOCK                       i2cClock_267KHZ
+#endif
+#endif
+
 /* ------------------------------------------------------------------------------------------------
 *                                           Local Variables
 * ------------------------------------------------------------------------------------------------
@@ -64,6 +99,60 @@
 static uint8 buffer[24];
 static uint8 halSensorEnableMap;
 
+#if HAL_I2C_ASYNC
+static halI2CTrans_t sensorTrans;         // Register access queued on the bus
+static halSensorCBack_t sensorCBack;      // Its completion
+static uint8 sensorWrBuf[1 + SENSOR_WR_MAX];  // Register address and data to write
+#endif
+
+#if HAL_SENSOR_SCHED
+/* Per sensor slot: period and next burst, in ticks of HAL_SENSOR_TICK ms; period 0 is off */
+static uint16 schedPeriod[SCHED_NUM_SENSORS];
+static uint32 schedDue[SCHED_NUM_SENSORS];
+
+static const uint16 schedMinPeriod[SCHED_NUM_SENSORS] =
+{
+  SCHED_MIN_IRTEMP, SCHED_MIN_HUMID, SCHED_MIN_MAGN, SCHED_MIN_ACC, SCHED_MIN_PRESS, SCHED_MIN_GYRO
+};
+
+static uint8 schedPending;                // Sensors with a conversion running
+static uint8 schedHumiStep;               // Next HalHumiExecMeasurementStep()
+
+#if HAL_I2C_ASYNC
+static halSensorSchedCBack_t schedCBack;  // Called at the end of each burst
+static halSensorFrame_t *schedFrame;      // Frame of the burst on the bus, NULL between bursts
+static uint8 schedToRead;                 // Sensors of the burst still to be read
+static uint8 schedToStart;                // Sensors of the burst still to start converting
+static uint8 schedValid;                  // Sensors of the burst read
+static uint8 schedOp;                     // ST_xxx of the sensor on the bus
+static bool  schedOpRead;                 // It is being read, else started
+static uint8 schedStartReq;               // Sensors started during the burst, and stopped,
+static uint8 schedStopReq;                // which are switched at its end
+#endif
+#endif
+
+/* ------------------------------------------------------------------------------------------------
+*                                           Local Functions
+* ------------------------------------------------------------------------------------------------
+*/
+#if HAL_I2C_ASYNC
+static void   halSensorSubmit(uint8 slave, uint8 wrLen, uint8 *pRd, uint8 rdLen,
+                              halSensorCBack_t cBack);
+static void   halSensorRegDone(halI2CTrans_t *pTrans);
+#endif
+#if HAL_SENSOR_SCHED
+static void   halSensorSchedStart(uint8 sensorID);
+static void   halSensorSchedStop(uint8 sensorID);
+#if HAL_I2C_ASYNC
+static void   halSensorSchedBurst(uint8 due, halSensorFrame_t *pFrame);
+static void   halSensorSchedStep(bool success);
+#else
+static uint8  halSensorSchedBurst(uint8 due, halSensorFrame_t *pFrame);
+#endif
+static uint8  halSensorSchedDone(uint8 valid, halSensorFrame_t *pFrame);
+static uint16 halSensorSchedDelay(void);
+#endif
+
 /**************************************************************************************************
  * @fn          HalSensorReadReg
  *
@@ -122,6 +211,108 @@ bool HalSensorWriteReg(uint8 addr, uint8 *pBuf, uint8 nBytes)
   return (i == nBytes);
 }
 
+#if HAL_I2C_ASYNC
+/**************************************************************************************************
+ * @fn          HalSensorReadRegAsync
+ *
+ * @brief       Queue a read from a sensor on the I2C bus, as HalSensorReadReg() does it, with a
+ *              repeated START in place of the STOP between the address and the data. One access
+ *              is queued at a time; the next one may be queued from the callback of the last.
+ *
+ * @param       slave - I2C address of the sensor
+ * @param       addr - which register to read
+ * @param       pBuf - pointer to buffer to place data, which must stay put until the callback
+ * @param       nBytes - number of bytes to read
+ * @param       cBack - called from HalI2CPoll() with TRUE if the required number of bytes are
+ *                      received
+ *
+ * @return      none
+ **************************************************************************************************/
+void HalSensorReadRegAsync(uint8 slave, uint8 addr, uint8 *pBuf, uint8 nBytes,
+                           halSensorCBack_t cBack)
+{
+  sensorWrBuf[0] = addr;
+  halSensorSubmit(slave, 1, pBuf, nBytes, cBack);
+}
+
+/**************************************************************************************************
+ * @fn          HalSensorWriteRegAsync
+ *
+ * @brief       Queue a write to a sensor on the I2C bus, as HalSensorWriteReg() does it. The data
+ *              is copied, so the buffer is free on return. One access is queued at a time.
+ *
+ * @param       slave - I2C address of the sensor
+ * @param       addr - which register to write
+ * @param       pBuf - pointer to buffer containing data to be written
+ * @param       nBytes - number of bytes to write, up to SENSOR_WR_MAX
+ * @param       cBack - called from HalI2CPoll() with TRUE if successful write; at once with
+ *                      FALSE if nBytes is too long
+ *
+ * @return      none
+ **************************************************************************************************/
+void HalSensorWriteRegAsync(uint8 slave, uint8 addr, uint8 *pBuf, uint8 nBytes,
+                            halSensorCBack_t cBack)
+{
+  uint8 i;
+
+  if (nBytes > SENSOR_WR_MAX)
+  {
+    cBack(FALSE);
+    return;
+  }
+
+  sensorWrBuf[0] = addr;
+  for (i = 0; i < nBytes; i++)
+  {
+    sensorWrBuf[1 + i] = pBuf[i];
+  }
+
+  halSensorSubmit(slave, 1 + nBytes, NULL, 0, cBack);
+}
+
+/**************************************************************************************************
+ * @fn          halSensorSubmit
+ *
+ * @brief       Queue the register access of HalSensorReadRegAsync() or HalSensorWriteRegAsync().
+ *
+ * @param       slave - I2C address of the sensor
+ * @param       wrLen - number of bytes of sensorWrBuf to write
+ * @param       pRd - pointer to buffer to place data read
+ * @param       rdLen - number of bytes to read after the write
+ * @param       cBack - completion
+ *
+ * @return      none
+ **************************************************************************************************/
+static void halSensorSubmit(uint8 slave, uint8 wrLen, uint8 *pRd, uint8 rdLen,
+                            halSensorCBack_t cBack)
+{
+  sensorTrans.addr = slave;
+  sensorTrans.wrLen = wrLen;
+  sensorTrans.pWr = sensorWrBuf;
+  sensorTrans.rdLen = rdLen;
+  sensorTrans.pRd = pRd;
+  sensorTrans.callBackFunc = halSensorRegDone;
+  sensorCBack = cBack;
+
+  HalI2CSubmit(&sensorTrans);
+}
+
+/**************************************************************************************************
+ * @fn          halSensorRegDone
+ *
+ * @brief       I2C callback of the register access; passes its outcome on.
+ *
+ * @param       pTrans - the register access
+ *
+ * @return      none
+ **************************************************************************************************/
+static void halSensorRegDone(halI2CTrans_t *pTrans)
+{
+  sensorCBack((pTrans->status == HAL_I2C_SUCCESS) &&
+              (pTrans->cnt == pTrans->wrLen + pTrans->rdLen));
+}
+#endif
+
 /*********************************************************************
  * @fn      HalSensorTest
  *
@@ -211,5 +402,582 @@ void HalDcDcControl(uint8 sensorID, bool powerOn)
   }
 }
 
+#if HAL_SENSOR_SCHED
+/*********************************************************************
+ * @fn      HalSensorSchedSet
+ *
+ * @brief   Set the sampling period of a sensor. The period is rounded up to a multiple of
+ *          HAL_SENSOR_TICK and to the shortest period of the sensor, and the bursts of the
+ *          sensor fall on multiples of it, so that sensors with periods that are multiples of
+ *          each other are read in the same bursts. Starting a sensor turns it on and starts its
+ *          first conversion; stopping it turns it off.
+ *
+ *          The application runs HalSensorSchedRun() from a timer started with the returned
+ *          delay, replacing the timer if one is running.
+ *
+ *          With HAL_I2C_ASYNC a sensor started or stopped while a burst is on the bus is
+ *          switched at the end of the burst. The sensors are switched with the blocking
+ *          driver calls, so the scheduler takes the I2C queue to be its own.
+ *
+ * @param   sensorID - ST_xxx bit of the sensor
+ * @param   period - sampling period in ms, 0 to stop sampling the sensor
+ *
+ * @return  delay in ms to the next burst, 0 if no sensor is sampled
+ */
+uint16 HalSensorSchedSet(uint8 sensorID, uint16 period)
+{
+  uint32 now;
+  uint16 ticks;
+  uint8 i;
+
+  for (i = 0; i < SCHED_NUM_SENSORS; i++)
+  {
+    if (sensorID == BV(i))
+    {
+      break;
+    }
+  }
+
+  if (i == SCHED_NUM_SENSORS)
+  {
+    return halSensorSchedDelay();
+  }
+
+  if (period == 0)
+  {
+    if (schedPeriod[i] != 0)
+    {
+      schedPeriod[i] = 0;
+      halSensorSchedStop(sensorID);
+    }
+    return halSensorSchedDelay();
+  }
+
+  if (sensorID == ST_HUMID)
+  {
+    period /= 2;
+  }
+  if (period < schedMinPeriod[i])
+  {
+    period = schedMinPeriod[i];
+  }
+  ticks = (uint16)(((uint32)period + HAL_SENSOR_TICK - 1) / HAL_SENSOR_TICK);
+
+  if (schedPeriod[i] == 0)
+  {
+    halSensorSchedStart(sensorID);
+  }
+#if HAL_SENSOR_IMU
+  // The gyro samples drive the attitude filter, so its period is that of the gyro
+  if (sensorID == ST_GYRO && schedPeriod[i] != ticks)
+  {
+    HalImuInit(ticks * HAL_SENSOR_TICK, HAL_SENSOR_IMU_ONE_G);
+  }
+#endif
+  schedPeriod[i] = ticks;
+
+  // First burst on the next multiple of the period
+  now = osal_GetSystemClock() / HAL_SENSOR_TICK;
+  schedDue[i] = now - (now % ticks) + ticks;
+
+  return halSensorSchedDelay();
+}
+
+/*********************************************************************
+ * @fn      HalSensorSchedRun
+ *
+ * @brief   Read all the sensors that are due in one burst: first the results of all of them,
+ *          then the conversions for the next burst are started. The results of the sensors that
+ *          convert between bursts (IR temperature, humidity, barometer and gyro) were converted
+ *          during the previous period. The barometer alternates temperature and pressure
+ *          conversions, so each of its samples refreshes one of the two values. With
+ *          HAL_SENSOR_IMU each gyro sample also advances the attitude filter.
+ *
+ *          With HAL_I2C_ASYNC the burst is queued on the I2C bus and goes on from
+ *          HalI2CPoll(); the frame is filled when the callback set by
+ *          HalSensorSchedRegister() is made, and must stay put until then. If the last burst
+ *          is still on the bus, or the bus is busy, the sensors due wait for their next burst.
+ *
+ * @param   pFrame - sample frame to update
+ *
+ * @return  delay in ms to the next burst, 0 if no sensor is sampled
+ */
+uint16 HalSensorSchedRun(halSensorFrame_t *pFrame)
+{
+  uint32 clock;
+  uint32 now;
+  uint8 due;
+  uint8 i;
+
+  clock = osal_GetSystemClock();
+  now = clock / HAL_SENSOR_TICK;
+
+  due = 0;
+  for (i = 0; i < SCHED_NUM_SENSORS; i++)
+  {
+    if (schedPeriod[i] != 0 && schedDue[i] <= now)
+    {
+      due |= BV(i);
+      schedDue[i] += schedPeriod[i];
+
+      // Skip the bursts that were missed, keeping the alignment
+      if (schedDue[i] <= now)
+      {
+        schedDue[i] = now - (now % schedPeriod[i]) + schedPeriod[i];
+      }
+    }
+  }
+
+#if HAL_I2C_ASYNC
+  if (schedFrame == NULL && !HalI2CBusy())
+  {
+    pFrame->time = clock;
+    halSensorSchedBurst(due, pFrame);
+  }
+#else
+  pFrame->time = clock;
+  pFrame->valid = halSensorSchedBurst(due, pFrame);
+#endif
+
+  return halSensorSchedDelay();
+}
+
+#if HAL_I2C_ASYNC
+/*********************************************************************
+ * @fn      HalSensorSchedRegister
+ *
+ * @brief   Set the function called at the end of each burst.
+ *
+ * @param   cBack - called from HalI2CPoll() with the frame of the burst, or NULL
+ *
+ * @return  none
+ */
+void HalSensorSchedRegister(halSensorSchedCBack_t cBack)
+{
+  schedCBack = cBack;
+}
+#endif
+
+/*********************************************************************
+ * @fn      halSensorSchedStart
+ *
+ * @brief   Turn a sensor on and start its first conversion.
+ *
+ * @param   sensorID - ST_xxx bit of the sensor
+ *
+ * @return  none
+ */
+static void halSensorSchedStart(uint8 sensorID)
+{
+#if HAL_I2C_ASYNC
+  if (schedFrame != NULL)
+  {
+    schedStartReq |= sensorID;
+    schedStopReq &= ~sensorID;
+    return;
+  }
+#endif
+
+  switch (sensorID)
+  {
+    case ST_IRTEMP:
+      HalIRTempTurnOn();
+      break;
+    case ST_HUMID:
+      HalHumiExecMeasurementStep(HAL_HUM_MEAS_STATE_1);
+      schedHumiStep = HAL_HUM_MEAS_STATE_2;
+      break;
+    case ST_MAGN:
+      HalMagTurnOn();
+      break;
+#if HAL_I2C_ASYNC
+    case ST_ACC:
+      // Left on, as the bursts cannot wait for its conversion
+      HalAccTurnOn();
+      break;
+#endif
+    case ST_PRESS:
+      HalBarStartMeasurement();
+      break;
+    case ST_GYRO:
+      HalGyroSelectAxes(SCHED_GYRO_AXES);
+      HalGyroTurnOn();
+      break;
+    default:
+      break;
+  }
+
+  schedPending |= sensorID & SCHED_PIPELINED;
+}
+
+/*********************************************************************
+ * @fn      halSensorSchedStop
+ *
+ * @brief   Turn a sensor off, abandoning its conversion.
+ *
+ * @param   sensorID - ST_xxx bit of the sensor
+ *
+ * @return  none
+ */
+static void halSensorSchedStop(uint8 sensorID)
+{
+#if HAL_I2C_ASYNC
+  if (schedFrame != NULL)
+  {
+    schedStopReq |= sensorID;
+    schedStartReq &= ~sensorID;
+    return;
+  }
+#endif
+
+  switch (sensorID)
+  {
+    case ST_IRTEMP:
+      HalIRTempTurnOff();
+      break;
+    case ST_HUMID:
+      HalDcDcControl(ST_HUMID, false);
+      break;
+    case ST_MAGN:
+      HalMagTurnOff();
+      break;
+#if HAL_I2C_ASYNC
+    case ST_ACC:
+      HalAccTurnOff();
+      break;
+#endif
+    case ST_PRESS:
+      HalBarInit();
+      break;
+    case ST_GYRO:
+      HalGyroTurnOff();
+      break;
+    default:
+      break;
+  }
+
+  schedPending &= ~sensorID;
+}
+
+#if HAL_I2C_ASYNC
+/*********************************************************************
+ * @fn      halSensorSchedBurst
+ *
+ * @brief   Queue the burst: the reads of the sensors that are due, then the starts of their
+ *          next conversions, one register access after the other.
+ *
+ * @param   due - ST_xxx of the sensors to read
+ * @param   pFrame - sample frame to update
+ *
+ * @return  none
+ */
+static void halSensorSchedBurst(uint8 due, halSensorFrame_t *pFrame)
+{
+  schedFrame = pFrame;
+  schedToRead = (due & ~SCHED_PIPELINED) | (due & schedPending);
+  schedToStart = due & SCHED_PIPELINED;
+  schedPending |= due & SCHED_PIPELINED;
+  schedValid = 0;
+  schedOp = 0;
+  schedOpRead = FALSE;
+
+  // The address is that of each access; the blocking drivers select their own again
+  HalI2CInit(0, SCHED_I2C_CLOCK);
+
+  halSensorSchedStep(TRUE);
+}
+
+/*********************************************************************
+ * @fn      halSensorSchedStep
+ *
+ * @brief   Take the outcome of the step of the burst just done and queue the next step. Each
+ *          step is a driver call that queues its register accesses and calls back here when
+ *          they are done, so the burst goes on from HalI2CPoll(). At the end of the burst the
+ *          frame is handed to the callback of HalSensorSchedRegister().
+ *
+ * @param   success - TRUE if the step succeeded
+ *
+ * @return  none
+ */
+static void halSensorSchedStep(bool success)
+{
+  halSensorFrame_t *pFrame = schedFrame;
+  uint8 i;
+
+  if (schedOp == ST_HUMID)
+  {
+    if (!schedOpRead)
+    {
+      schedHumiStep = HAL_HUM_MEAS_STATE_2;
+    }
+    else if (schedHumiStep == HAL_HUM_MEAS_STATE_2)
+    {
+      // Read the temperature and started the humidity conversion
+      schedHumiStep = HAL_HUM_MEAS_STATE_3;
+    }
+    else
+    {
+      if (success && HalHumiReadMeasurement(pFrame->humi))
+      {
+        schedValid |= ST_HUMID;
+      }
+      schedHumiStep = HAL_HUM_MEAS_STATE_1;
+    }
+  }
+  else if (schedOpRead && success)
+  {
+    schedValid |= schedOp;
+  }
+
+  if (schedToRead != 0)
+  {
+    schedOp = ST_IRTEMP;
+    while ((schedToRead & schedOp) == 0)
+    {
+      schedOp <<= 1;
+    }
+    schedToRead &= ~schedOp;
+    schedOpRead = TRUE;
+
+    switch (schedOp)
+    {
+      case ST_IRTEMP:
+        HalIRTempReadAsync(pFrame->irtemp, halSensorSchedStep);
+        break;
+      case ST_HUMID:
+        HalHumiExecMeasurementStepAsync(schedHumiStep, halSensorSchedStep);
+        break;
+      case ST_MAGN:
+        HalMagReadAsync(pFrame->mag, halSensorSchedStep);
+        break;
+      case ST_ACC:
+        HalAccReadAsync(pFrame->acc, halSensorSchedStep);
+        break;
+      case ST_PRESS:
+        HalBarReadMeasurementAsync(pFrame->bar, halSensorSchedStep);
+        break;
+      default:
+        HalGyroReadAsync(pFrame->gyro, halSensorSchedStep);
+        break;
+    }
+    return;
+  }
+
+  // Start the conversions for the next burst
+  if (schedHumiStep != HAL_HUM_MEAS_STATE_1)
+  {
+    schedToStart &= ~ST_HUMID;
+  }
+
+  if (schedToStart != 0)
+  {
+    schedOp = ST_IRTEMP;
+    while ((schedToStart & schedOp) == 0)
+    {
+      schedOp <<= 1;
+    }
+    schedToStart &= ~schedOp;
+    schedOpRead = FALSE;
+
+    switch (schedOp)
+    {
+      case ST_IRTEMP:
+        HalIRTempTurnOnAsync(halSensorSchedStep);
+        break;
+      case ST_HUMID:
+        HalHumiExecMeasurementStepAsync(HAL_HUM_MEAS_STATE_1, halSensorSchedStep);
+        break;
+      case ST_PRESS:
+        HalBarStartMeasurementAsync(halSensorSchedStep);
+        break;
+      default:
+        HalGyroWakeUpAsync(halSensorSchedStep);
+        break;
+    }
+    return;
+  }
+
+  pFrame->valid = halSensorSchedDone(schedValid, pFrame);
+  schedFrame = NULL;
+
+  // The sensors started or stopped during the burst, with the bus free again
+  for (i = ST_IRTEMP; i <= ST_GYRO; i <<= 1)
+  {
+    if (schedStopReq & i)
+    {
+      halSensorSchedStop(i);
+    }
+    if (schedStartReq & i)
+    {
+      halSensorSchedStart(i);
+    }
+  }
+  schedStopReq = 0;
+  schedStartReq = 0;
+
+  if (schedCBack != NULL)
+  {
+    schedCBack(pFrame);
+  }
+}
+#else
+/*********************************************************************
+ * @fn      halSensorSchedBurst
+ *
+ * @brief   Read the sensors that are due, then start their next conversions.
+ *
+ * @param   due - ST_xxx of the sensors to read
+ * @param   pFrame - sample frame to update
+ *
+ * @return  ST_xxx of the sensors read
+ */
+static uint8 halSensorSchedBurst(uint8 due, halSensorFrame_t *pFrame)
+{
+  uint8 valid = 0;
+  uint8 ready = due & schedPending;
+
+  if ((ready & ST_IRTEMP) && HalIRTempStatus() == TMP006_DATA_READY &&
+      HalIRTempRead(pFrame->irtemp))
+  {
+    valid |= ST_IRTEMP;
+  }
+
+  if (ready & ST_HUMID)
+  {
+    if (schedHumiStep == HAL_HUM_MEAS_STATE_2)
+    {
+      // Read the temperature and start the humidity conversion
+      HalHumiExecMeasurementStep(HAL_HUM_MEAS_STATE_2);
+      schedHumiStep = HAL_HUM_MEAS_STATE_3;
+    }
+    else
+    {
+      if (HalHumiExecMeasurementStep(HAL_HUM_MEAS_STATE_3) && HalHumiReadMeasurement(pFrame->humi))
+      {
+        valid |= ST_HUMID;
+      }
+      schedHumiStep = HAL_HUM_MEAS_STATE_1;
+    }
+  }
+
+  if ((due & ST_MAGN) && HalMagStatus() == MAG3110_DATA_READY && HalMagRead(pFrame->mag))
+  {
+    valid |= ST_MAGN;
+  }
+
+  if ((due & ST_ACC) && HalAccRead(pFrame->acc))
+  {
+    valid |= ST_ACC;
+  }
+
+  if ((ready & ST_PRESS) && HalBarReadMeasurement(pFrame->bar))
+  {
+    valid |= ST_PRESS;
+  }
+
+  if ((ready & ST_GYRO) && HalGyroRead(pFrame->gyro))
+  {
+    valid |= ST_GYRO;
+  }
+
+  valid = halSensorSchedDone(valid, pFrame);
+
+  // Start the conversions for the next burst
+  if (due & ST_IRTEMP)
+  {
+    HalIRTempTurnOn();
+  }
+
+  if ((due & ST_HUMID) && schedHumiStep == HAL_HUM_MEAS_STATE_1)
+  {
+    HalHumiExecMeasurementStep(HAL_HUM_MEAS_STATE_1);
+    schedHumiStep = HAL_HUM_MEAS_STATE_2;
+  }
+
+  if (due & ST_PRESS)
+  {
+    HalBarStartMeasurement();
+  }
+
+  if (due & ST_GYRO)
+  {
+    HalGyroWakeUp();
+  }
+
+  schedPending |= due & SCHED_PIPELINED;
+
+  return valid;
+}
+#endif
+
+/*********************************************************************
+ * @fn      halSensorSchedDone
+ *
+ * @brief   Finish the samples of a burst. With HAL_SENSOR_IMU a gyro sample advances the
+ *          attitude filter.
+ *
+ * @param   valid - ST_xxx of the sensors read
+ * @param   pFrame - sample frame of the burst
+ *
+ * @return  ST_xxx of the sensors read, and ST_ATTITUDE if the attitude was updated
+ */
+static uint8 halSensorSchedDone(uint8 valid, halSensorFrame_t *pFrame)
+{
+#if HAL_SENSOR_IMU
+  // With the latest accelerometer sample, and the magnetometer one if it is new
+  if (valid & ST_GYRO)
+  {
+    HalImuUpdate(pFrame->acc, pFrame->gyro, (valid & ST_MAGN) ? pFrame->mag : NULL);
+    HalImuGetAttitude(pFrame->attitude);
+    valid |= ST_ATTITUDE;
+  }
+#endif
+
+  return valid;
+}
+
+/*********************************************************************
+ * @fn      halSensorSchedDelay
+ *
+ * @brief   Time to the next burst.
+ *
+ * @param   none
+ *
+ * @return  delay in ms, 0 if no sensor is sampled
+ */
+static uint16 halSensorSchedDelay(void)
+{
+  uint32 clock;
+  uint32 next;
+  uint8 found;
+  uint8 i;
+
+  found = FALSE;
+  next = 0;
+  for (i = 0; i < SCHED_NUM_SENSORS; i++)
+  {
+    if (schedPeriod[i] != 0 && (!found || schedDue[i] < next))
+    {
+      next = schedDue[i];
+      found = TRUE;
+    }
+  }
+
+  if (!found)
+  {
+    return 0;
+  }
+
+  clock = osal_GetSystemClock();
+  next *= HAL_SENSOR_TICK;
+  if (next <= clock)
+  {
+    return 1;
+  }
+  next -= clock;
+
+  return (next > 0xFFFF) ? 0xFFFF : (uint16)next;
+}
+#endif
 /*********************************************************************
 *********************************************************************/
@@ -49,6 +49,8 @@ extern "C"
  * INCLUDES
  */
 #include "hal_types.h"
+#include "hal_i2c.h"
+#include "hal_imu.h"
 
 /*********************************************************************
  * CONSTANTS and MACROS
@@ -64,12 +66,68 @@ extern "C"
 
 #define HIGH_SUPPLY_SENSOR_MAP                ( ST_IRTEMP | ST_HUMID | ST_GYRO)
 
+/* Frame bit of the attitude from hal_imu.c; not a sensor */
+#define ST_ATTITUDE                           0x40
+
 /* Self test assertion; return FALSE (failed) if condition is not met */
 #define ST_ASSERT(cond) st( if (!(cond)) return FALSE; )
 
 /* Ative delay: 125 cycles ~1 msec */
 #define ST_HAL_DELAY(n) st( { volatile uint32 i; for (i=0; i<(n); i++) { }; } )
 
+/* Set to TRUE for the sampling scheduler, see HalSensorSchedSet() */
+#if !defined HAL_SENSOR_SCHED
+#define HAL_SENSOR_SCHED                      FALSE
+#endif
+
+/* Common tick of the scheduler in ms; all sampling periods are multiples of it */
+#if !defined HAL_SENSOR_TICK
+#define HAL_SENSOR_TICK                       10
+#endif
+
+/* Set to TRUE to run the attitude filter of hal_imu.c on each gyro sample of the scheduler */
+#if !defined HAL_SENSOR_IMU
+#define HAL_SENSOR_IMU                        FALSE
+#endif
+
+/* Accelerometer reading at 1 g, for the attitude filter; 16 in the default 8 g range */
+#if !defined HAL_SENSOR_IMU_ONE_G
+#define HAL_SENSOR_IMU_ONE_G                  16
+#endif
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+#if HAL_I2C_ASYNC
+/* Completion of a register access queued on the I2C bus, called from HalI2CPoll() */
+typedef void (*halSensorCBack_t)(bool success);
+#endif
+
+#if HAL_SENSOR_SCHED
+/* Sample frame filled by HalSensorSchedRun(). The data of each sensor is in the format of its
+ * driver's read function and is left unchanged in the bursts that do not read the sensor.
+ */
+typedef struct
+{
+  uint32 time;                  // osal_GetSystemClock() at the start of the burst
+  uint8  valid;                 // ST_xxx of the sensors read in this burst
+  uint8  irtemp[4];
+  uint8  humi[4];
+  uint8  mag[6];
+  uint8  acc[3];
+  uint8  bar[4];
+  uint8  gyro[6];
+#if HAL_SENSOR_IMU
+  uint8  attitude[HAL_IMU_ATTITUDE_LEN];  // HalImuGetAttitude() after each gyro sample
+#endif
+} halSensorFrame_t;
+
+#if HAL_I2C_ASYNC
+/* Completion of a burst started by HalSensorSchedRun(), with the frame it filled */
+typedef void (*halSensorSchedCBack_t)(halSensorFrame_t *pFrame);
+#endif
+#endif
+
 /*********************************************************************
  * FUNCTIONS
  */
@@ -77,6 +135,17 @@ bool   HalSensorReadReg(uint8 addr, uint8 *pBuf, uint8 nBytes);
 bool   HalSensorWriteReg(uint8 addr, uint8 *pBuf, uint8 nBytes);
 uint16 HalSensorTest(void);
 void   HalDcDcControl(uint8 sensorID, bool powerOn);
+#if HAL_I2C_ASYNC
+void   HalSensorReadRegAsync(uint8 slave, uint8 addr, uint8 *pBuf, uint8 nBytes, halSensorCBack_t cBack);
+void   HalSensorWriteRegAsync(uint8 slave, uint8 addr, uint8 *pBuf, uint8 nBytes, halSensorCBack_t cBack);
+#endif
+#if HAL_SENSOR_SCHED
+uint16 HalSensorSchedSet(uint8 sensorID, uint16 period);
+uint16 HalSensorSchedRun(halSensorFrame_t *pFrame);
+#if HAL_I2C_ASYNC
+void   HalSensorSchedRegister(halSensorSchedCBack_t cBack);
+#endif
+#endif
 
 /*********************************************************************/
 
@@ -52,11 +52,16 @@
 #include "OSAL_Memory.h"
 #include "OSAL_PwrMgr.h"
 #include "OSAL_Clock.h"
+#include "osal_trace.h"
 
 #include "OnBoard.h"
 
 /* HAL */
+#include "hal_assert.h"
 #include "hal_drivers.h"
+#if OSAL_PROFILE
+  #include "hal_sleep.h"
+#endif
 
 #ifdef IAR_ARMCM3_LM
   #include "FreeRTOSConfig.h"
@@ -71,9 +76,35 @@
  * MACROS
  */
 
+#if !defined ( CODE )
+  #define CODE
+#endif
+
+// Ready bitmap maintenance; must be called with interrupts held off.
+#define OSAL_READY_SET( idx ) \
+  st( osalReadyTbl[(idx) >> 3] |= BV( (idx) & 0x07 ); \
+      osalReadyGrp |= BV( (idx) >> 3 ); )
+
+#define OSAL_READY_CLR( idx ) \
+  st( if ( (osalReadyTbl[(idx) >> 3] &= ~BV( (idx) & 0x07 )) == 0 ) \
+      { \
+        osalReadyGrp &= ~BV( (idx) >> 3 ); \
+      } )
+
+#if OSAL_PROFILE
+// Sleep timer ticks from t0 to t1, saturated to 16 bits
+#define OSAL_PROFILE_TICKS( t0, t1 ) \
+  ( ( (((t1) - (t0)) & 0x00FFFFFF) > 0xFFFF ) ? 0xFFFF : (uint16)((t1) - (t0)) )
+#endif
+
 /*********************************************************************
  * CONSTANTS
  */
+
+// Maximum number of tasks that can be tracked by the ready bitmap
+#define OSAL_MAX_NUM_TASKS       64
+#define OSAL_READY_TBL_SIZE      ( OSAL_MAX_NUM_TASKS / 8 )
+
 #ifdef USE_ICALL
 // A bit mask to use to indicate a proxy OSAL task ID.
 #define OSAL_PROXY_ID_FLAG       0x80
@@ -83,13 +114,19 @@
  * TYPEDEFS
  */
 
+// Per-task message queue
+typedef struct
+{
+  osal_msg_q_t head;      // Next message to be received
+  osal_msg_q_t tail;      // Last message, for constant time append
+  uint16       depth;     // Number of messages queued
+  uint16       depthMax;  // High-water mark of depth
+} osalTaskMsgQ_t;
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
 
-// Message Pool Definitions
-osal_msg_q_t osal_qHead;
-
 #ifdef USE_ICALL
 // OSAL event loop hook function pointer
 void (*osal_eventloop_hook)(void) = NULL;
@@ -110,6 +147,30 @@ void (*osal_eventloop_hook)(void) = NULL;
 // Index of active task
 static uint8 activeTaskID = TASK_NO_TASK;
 
+// Message queues, one per task
+static osalTaskMsgQ_t *osalTaskMsgQ;
+
+// Ready bitmap: bit (idx & 7) of osalReadyTbl[idx >> 3] is set while
+// tasksEvents[idx] is non-zero, and bit n of osalReadyGrp is set while
+// osalReadyTbl[n] is non-zero.
+static uint8 osalReadyGrp;
+static uint8 osalReadyTbl[OSAL_READY_TBL_SIZE];
+
+#if OSAL_PROFILE
+// Event loop profiles, one per task followed by one for the selected events
+static osalProfile_t *osalProfile;
+
+// Task and events profiled on their own
+static uint8  osalProfileTask = TASK_NO_TASK;
+static uint16 osalProfileEvents;
+#endif
+
+// Index of the lowest set bit in a non-zero nibble
+static const uint8 CODE osalLowestBitTbl[16] =
+{
+  0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+
 #ifdef USE_ICALL
 // Maximum number of proxy tasks
 #ifndef OSAL_MAX_NUM_PROXY_TASKS
@@ -156,6 +217,10 @@ static uint8 osal_notask_entity;
 
 static uint8 osal_msg_enqueue_push( uint8 destination_task, uint8 *msg_ptr, uint8 urgent );
 
+#if OSAL_PROFILE
+static void osalProfileAdd( osalProfile_t *pProfile, uint16 run, uint16 lat );
+#endif
+
 #ifdef USE_ICALL
 static uint8 osal_alien2proxy(ICall_EntityID entity);
 static ICall_EntityID osal_proxy2alien(uint8 proxyid);
@@ -163,6 +228,10 @@ static uint8 osal_dispatch2id(ICall_EntityID entity);
 static void osal_msec_timer_cback(void *arg);
 #endif // USE_ICALL
 
+static uint8 osal_lowest_bit( uint8 bits );
+static uint8 osal_next_ready_task( void );
+static void osal_init_halt( void );
+
 /*********************************************************************
  * HELPER FUNCTIONS
  */
@@ -694,7 +763,8 @@ uint8 osal_msg_push_front( uint8 destination_task, uint8 *msg_ptr )
  *
  *    This function is called by a task to either enqueue (append to
  *    queue) or push (prepend to queue) a command message to the OSAL
- *    queue. The destination_task field must refer to a valid task,
+ *    queue of the destination task. Both operations take constant
+ *    time. The destination_task field must refer to a valid task,
  *    since the task ID will be used to send the message to. This
  *    function will also set a message ready event in the destination
  *    task's event list.
@@ -707,6 +777,9 @@ uint8 osal_msg_push_front( uint8 destination_task, uint8 *msg_ptr )
  */
 static uint8 osal_msg_enqueue_push( uint8 destination_task, uint8 *msg_ptr, uint8 push )
 {
+  osalTaskMsgQ_t *pQ;
+  halIntState_t   intState;
+
   if ( msg_ptr == NULL )
   {
     return ( INVALID_MSG_POINTER );
@@ -738,19 +811,46 @@ static uint8 osal_msg_enqueue_push( uint8 destination_task, uint8 *msg_ptr, uint
     return ( INVALID_MSG_POINTER );
   }
 
+  // Hold off interrupts
+  HAL_ENTER_CRITICAL_SECTION(intState);
+
   OSAL_MSG_ID( msg_ptr ) = destination_task;
+  pQ = &osalTaskMsgQ[destination_task];
 
   if ( push == TRUE )
   {
     // prepend the message
-    osal_msg_push( &osal_qHead, msg_ptr );
+    OSAL_MSG_NEXT( msg_ptr ) = pQ->head;
+    pQ->head = msg_ptr;
+    if ( pQ->tail == NULL )
+    {
+      pQ->tail = msg_ptr;
+    }
   }
   else
   {
     // append the message
-    osal_msg_enqueue( &osal_qHead, msg_ptr );
+    if ( pQ->tail == NULL )
+    {
+      pQ->head = msg_ptr;
+    }
+    else
+    {
+      OSAL_MSG_NEXT( pQ->tail ) = msg_ptr;
+    }
+    pQ->tail = msg_ptr;
+  }
+
+  // Every message takes heap, so the count cannot reach 0xFFFF
+  pQ->depth++;
+  if ( pQ->depth > pQ->depthMax )
+  {
+    pQ->depthMax = pQ->depth;
   }
 
+  // Release interrupts
+  HAL_EXIT_CRITICAL_SECTION(intState);
+
   // Signal the task that a message is waiting
   osal_set_event( destination_task, SYS_EVENT_MSG );
 
@@ -772,42 +872,37 @@ static uint8 osal_msg_enqueue_push( uint8 destination_task, uint8 *msg_ptr, uint
  */
 uint8 *osal_msg_receive( uint8 task_id )
 {
-  osal_msg_hdr_t *listHdr;
-  osal_msg_hdr_t *prevHdr = NULL;
-  osal_msg_hdr_t *foundHdr = NULL;
+  osalTaskMsgQ_t *pQ;
+  osal_msg_hdr_t *foundHdr;
   halIntState_t   intState;
 
+  if ( task_id >= tasksCnt )
+  {
+    return ( NULL );
+  }
+
   // Hold off interrupts
   HAL_ENTER_CRITICAL_SECTION(intState);
 
-  // Point to the top of the queue
-  listHdr = osal_qHead;
+  // Take the message at the head of the task's queue
+  pQ = &osalTaskMsgQ[task_id];
+  foundHdr = pQ->head;
 
-  // Look through the queue for a message that belongs to the asking task
-  while ( listHdr != NULL )
+  if ( foundHdr != NULL )
   {
-    if ( (listHdr - 1)->dest_id == task_id )
-    {
-      if ( foundHdr == NULL )
-      {
-        // Save the first one
-        foundHdr = listHdr;
-      }
-      else
-      {
-        // Second msg found, stop looking
-        break;
-      }
-    }
-    if ( foundHdr == NULL )
+    pQ->head = OSAL_MSG_NEXT( foundHdr );
+    if ( pQ->head == NULL )
     {
-      prevHdr = listHdr;
+      pQ->tail = NULL;
     }
-    listHdr = OSAL_MSG_NEXT( listHdr );
+    pQ->depth--;
+
+    OSAL_MSG_NEXT( foundHdr ) = NULL;
+    OSAL_MSG_ID( foundHdr ) = TASK_NO_TASK;
   }
 
-  // Is there more than one?
-  if ( listHdr != NULL )
+  // Is there more?
+  if ( pQ->head != NULL )
   {
     // Yes, Signal the task that a message is waiting
     osal_set_event( task_id, SYS_EVENT_MSG );
@@ -818,13 +913,6 @@ uint8 *osal_msg_receive( uint8 task_id )
     osal_clear_event( task_id, SYS_EVENT_MSG );
   }
 
-  // Did we find a message?
-  if ( foundHdr != NULL )
-  {
-    // Take out of the link list
-    osal_msg_extract( &osal_qHead, foundHdr, prevHdr );
-  }
-
   // Release interrupts
   HAL_EXIT_CRITICAL_SECTION(intState);
 
@@ -854,14 +942,19 @@ osal_event_hdr_t *osal_msg_find(uint8 task_id, uint8 event)
   osal_msg_hdr_t *pHdr;
   halIntState_t intState;
 
+  if (task_id >= tasksCnt)
+  {
+    return NULL;
+  }
+
   HAL_ENTER_CRITICAL_SECTION(intState);  // Hold off interrupts.
 
-  pHdr = osal_qHead;  // Point to the top of the queue.
+  pHdr = osalTaskMsgQ[task_id].head;  // Point to the top of the task's queue.
 
-  // Look through the queue for a message that matches the task_id and event parameters.
+  // Look through the queue for a message that matches the event parameter.
   while (pHdr != NULL)
   {
-    if (((pHdr-1)->dest_id == task_id) && (((osal_event_hdr_t *)pHdr)->event == event))
+    if (((osal_event_hdr_t *)pHdr)->event == event)
     {
       break;
     }
@@ -899,20 +992,32 @@ uint8 osal_msg_count( uint8 task_id, uint8 event )
   osal_msg_hdr_t *pHdr;
   halIntState_t intState;
 
-  HAL_ENTER_CRITICAL_SECTION(intState);  // Hold off interrupts.
+  if ( task_id >= tasksCnt )
+  {
+    return ( 0 );
+  }
 
-  pHdr = osal_qHead;  // Point to the top of the queue.
+  HAL_ENTER_CRITICAL_SECTION(intState);  // Hold off interrupts.
 
-  // Look through the queue for a message that matches the task_id and event parameters.
-  while (pHdr != NULL)
+  if ( event == 0xFF )
+  {
+    // All events, the queue keeps its own count.
+    count = ( osalTaskMsgQ[task_id].depth > 0xFF ) ? 0xFF : (uint8)osalTaskMsgQ[task_id].depth;
+  }
+  else
   {
-    if ( ((pHdr-1)->dest_id == task_id)
-        && ((event == 0xFF) || (((osal_event_hdr_t *)pHdr)->event == event)) )
+    pHdr = osalTaskMsgQ[task_id].head;  // Point to the top of the task's queue.
+
+    // Look through the queue for a message that matches the event parameter.
+    while (pHdr != NULL)
     {
-      count++;
-    }
+      if ( ((osal_event_hdr_t *)pHdr)->event == event )
+      {
+        count++;
+      }
 
-    pHdr = OSAL_MSG_NEXT(pHdr);
+      pHdr = OSAL_MSG_NEXT(pHdr);
+    }
   }
 
   HAL_EXIT_CRITICAL_SECTION(intState);  // Release interrupts.
@@ -920,6 +1025,180 @@ uint8 osal_msg_count( uint8 task_id, uint8 event )
   return ( count );
 }
 
+/**************************************************************************************************
+ * @fn          osal_msg_q_high_water
+ *
+ * @brief       This function returns the largest number of messages that were queued at the
+ *              same time for a given task ID since the system was initialized.
+ *
+ * input parameters
+ *
+ * @param       task_id - The OSAL task id of the queue.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      The high-water mark of the task's message queue depth,
+ *              saturated at 0xFF.
+ **************************************************************************************************
+ */
+uint8 osal_msg_q_high_water( uint8 task_id )
+{
+  if ( task_id >= tasksCnt )
+  {
+    return ( 0 );
+  }
+
+  if ( osalTaskMsgQ[task_id].depthMax > 0xFF )
+  {
+    return ( 0xFF );
+  }
+
+  return ( (uint8)osalTaskMsgQ[task_id].depthMax );
+}
+
+#if OSAL_PROFILE
+/*********************************************************************
+ * @fn      osalProfileAdd
+ *
+ * @brief   Add one handler call to an event loop profile.
+ *
+ * @param   pProfile - profile to update
+ * @param   run - time the handler ran, in sleep timer ticks
+ * @param   lat - time the events waited for the handler, in sleep timer ticks
+ *
+ * @return  none
+ */
+static void osalProfileAdd( osalProfile_t *pProfile, uint16 run, uint16 lat )
+{
+  uint8 bucket;
+
+  if ( pProfile->runs != 0xFFFF )
+  {
+    pProfile->runs++;
+  }
+  if ( run > pProfile->runMax )
+  {
+    pProfile->runMax = run;
+  }
+  if ( lat > pProfile->latMax )
+  {
+    pProfile->latMax = lat;
+  }
+
+  // The bucket is the number of significant bits of the time
+  for ( bucket = 0; ( run != 0 ) && ( bucket < OSAL_PROFILE_BUCKETS - 1 ); bucket++ )
+  {
+    run >>= 1;
+  }
+  if ( pProfile->runHist[bucket] != 0xFFFF )
+  {
+    pProfile->runHist[bucket]++;
+  }
+
+  for ( bucket = 0; ( lat != 0 ) && ( bucket < OSAL_PROFILE_BUCKETS - 1 ); bucket++ )
+  {
+    lat >>= 1;
+  }
+  if ( pProfile->latHist[bucket] != 0xFFFF )
+  {
+    pProfile->latHist[bucket]++;
+  }
+}
+
+/*********************************************************************
+ * @fn      osal_profile_get
+ *
+ * @brief
+ *
+ *    This function returns the event loop profile of a task, or of the
+ *    events selected with osal_profile_select() when the task ID is
+ *    OSAL_PROFILE_SELECTED.
+ *
+ * @param   uint8 task_id - OSAL task id or OSAL_PROFILE_SELECTED
+ *
+ * @return  pointer to the profile, NULL for an invalid task ID
+ */
+osalProfile_t *osal_profile_get( uint8 task_id )
+{
+  if ( task_id == OSAL_PROFILE_SELECTED )
+  {
+    task_id = tasksCnt;
+  }
+  else if ( task_id >= tasksCnt )
+  {
+    return ( NULL );
+  }
+
+  return ( &osalProfile[task_id] );
+}
+
+/*********************************************************************
+ * @fn      osal_profile_select
+ *
+ * @brief
+ *
+ *    This function selects task events to be profiled on their own, in
+ *    addition to the profile of their task. The handler calls that
+ *    process any of the selected events are counted. The profile of the
+ *    selected events is cleared.
+ *
+ * @param   uint8 task_id - OSAL task id
+ * @param   uint16 event_flag - events to profile
+ *
+ * @return  SUCCESS, INVALID_TASK
+ */
+uint8 osal_profile_select( uint8 task_id, uint16 event_flag )
+{
+  halIntState_t intState;
+
+  if ( task_id >= tasksCnt )
+  {
+    return ( INVALID_TASK );
+  }
+
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  osalProfileTask = task_id;
+  osalProfileEvents = event_flag;
+  VOID osal_memset( &osalProfile[tasksCnt], 0, sizeof( osalProfile_t ) );
+  osalProfile[tasksCnt].readyTime = halSleepReadTimer();
+  HAL_EXIT_CRITICAL_SECTION(intState);
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      osal_profile_reset
+ *
+ * @brief
+ *
+ *    This function clears the event loop profiles of all tasks and of
+ *    the selected events.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void osal_profile_reset( void )
+{
+  halIntState_t intState;
+  uint32 now;
+  uint8 i;
+
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  VOID osal_memset( osalProfile, 0, sizeof( osalProfile_t ) * (tasksCnt + 1) );
+
+  // Events already set are taken to wait from now on
+  now = halSleepReadTimer();
+  for ( i = 0; i <= tasksCnt; i++ )
+  {
+    osalProfile[i].readyTime = now;
+  }
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+#endif
+
 /*********************************************************************
  * @fn      osal_msg_enqueue
  *
@@ -1190,7 +1469,23 @@ uint8 osal_set_event( uint8 task_id, uint16 event_flag )
   {
     halIntState_t   intState;
     HAL_ENTER_CRITICAL_SECTION(intState);    // Hold off interrupts
+#if OSAL_PROFILE
+    if ( tasksEvents[task_id] == 0 )
+    {
+      // The task waits from now on
+      osalProfile[task_id].readyTime = halSleepReadTimer();
+    }
+    if ( ( task_id == osalProfileTask ) && ( event_flag & osalProfileEvents ) &&
+         !( tasksEvents[task_id] & osalProfileEvents ) )
+    {
+      osalProfile[tasksCnt].readyTime = halSleepReadTimer();
+    }
+#endif
     tasksEvents[task_id] |= event_flag;  // Stuff the event bit(s)
+    if ( tasksEvents[task_id] )
+    {
+      OSAL_READY_SET( task_id );             // Mark the task ready
+    }
     HAL_EXIT_CRITICAL_SECTION(intState);     // Release interrupts
 #ifdef USE_ICALL
     ICall_signal(osal_semaphore);
@@ -1223,6 +1518,10 @@ uint8 osal_clear_event( uint8 task_id, uint16 event_flag )
     halIntState_t   intState;
     HAL_ENTER_CRITICAL_SECTION(intState);    // Hold off interrupts
     tasksEvents[task_id] &= ~(event_flag);   // Clear the event bit(s)
+    if ( tasksEvents[task_id] == 0 )
+    {
+      OSAL_READY_CLR( task_id );             // Nothing left pending
+    }
     HAL_EXIT_CRITICAL_SECTION(intState);     // Release interrupts
     return ( SUCCESS );
   }
@@ -1333,8 +1632,33 @@ uint8 osal_init_system( void )
   osal_mem_init();
 #endif /* !defined USE_ICALL && !defined OSAL_PORT2TIRTOS */
 
-  // Initialize the message queue
-  osal_qHead = NULL;
+  // Initialize the message queues
+  osalTaskMsgQ = (osalTaskMsgQ_t *)osal_mem_alloc( sizeof( osalTaskMsgQ_t ) * tasksCnt );
+  if ( osalTaskMsgQ == NULL )
+  {
+    osal_init_halt();
+  }
+  VOID osal_memset( osalTaskMsgQ, 0, sizeof( osalTaskMsgQ_t ) * tasksCnt );
+
+  // Every task needs a bit in the ready bitmap
+  if ( tasksCnt > OSAL_MAX_NUM_TASKS )
+  {
+    osal_init_halt();
+  }
+
+  // Initialize the ready bitmap
+  osalReadyGrp = 0;
+  VOID osal_memset( osalReadyTbl, 0, sizeof( osalReadyTbl ) );
+
+#if OSAL_PROFILE
+  // Initialize the event loop profiles
+  osalProfile = (osalProfile_t *)osal_mem_alloc( sizeof( osalProfile_t ) * (tasksCnt + 1) );
+  if ( osalProfile == NULL )
+  {
+    osal_init_halt();
+  }
+  osal_profile_reset();
+#endif
 
   // Initialize the timers
   osalTimerInit();
@@ -1543,14 +1867,95 @@ ICall_Errno osal_service_entry(ICall_FuncArgsHdr *args)
 }
 #endif /* USE_ICALL */
 
+/*********************************************************************
+ * @fn      osal_init_halt
+ *
+ * @brief
+ *
+ *   Stop here when osal_init_system() cannot set up the task system.
+ *   The assert handler gets the first chance; since HALNODEBUG builds
+ *   compile it out, spin with interrupts off rather than run tasks
+ *   on a broken setup.
+ *
+ * @param   void
+ *
+ * @return  none
+ */
+static void osal_init_halt( void )
+{
+  HAL_ASSERT_FORCED();
+
+  HAL_DISABLE_INTERRUPTS();
+  for ( ;; )
+  {
+  }
+}
+
+/*********************************************************************
+ * @fn      osal_lowest_bit
+ *
+ * @brief
+ *
+ *   Find the index of the lowest set bit in a non-zero byte.
+ *
+ * @param   bits - byte to search, must not be zero
+ *
+ * @return  bit index (0..7)
+ */
+static uint8 osal_lowest_bit( uint8 bits )
+{
+  if ( bits & 0x0F )
+  {
+    return ( osalLowestBitTbl[bits & 0x0F] );
+  }
+  else
+  {
+    return ( 4 + osalLowestBitTbl[bits >> 4] );
+  }
+}
+
+/*********************************************************************
+ * @fn      osal_next_ready_task
+ *
+ * @brief
+ *
+ *   Look up the highest priority (lowest index) task with pending
+ *   events in the ready bitmap. The cost is constant regardless of
+ *   the number of tasks.
+ *
+ * @param   void
+ *
+ * @return  task index, or tasksCnt if no task is ready
+ */
+static uint8 osal_next_ready_task( void )
+{
+  uint8 grp;
+  uint8 idx;
+  halIntState_t intState;
+
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  if ( osalReadyGrp == 0 )
+  {
+    idx = tasksCnt;
+  }
+  else
+  {
+    grp = osal_lowest_bit( osalReadyGrp );
+    idx = (grp << 3) + osal_lowest_bit( osalReadyTbl[grp] );
+  }
+  HAL_EXIT_CRITICAL_SECTION(intState);
+
+  return ( idx );
+}
+
 /*********************************************************************
  * @fn      osal_run_system
  *
  * @brief
  *
- *   This function will make one pass through the OSAL taskEvents table
- *   and call the task_event_processor() function for the first task that
- *   is found with at least one event pending. If there are no pending
+ *   This function will look up the OSAL ready bitmap and call the
+ *   task_event_processor() function for the highest priority task
+ *   that has at least one event pending. If there are no pending
  *   events (all tasks), this function puts the processor into Sleep.
  *
  * @param   void
@@ -1559,7 +1964,7 @@ ICall_Errno osal_service_entry(ICall_FuncArgsHdr *args)
  */
 void osal_run_system( void )
 {
-  uint8 idx = 0;
+  uint8 idx;
 
 #ifdef USE_ICALL
   uint32 next_timeout_prior = osal_next_timeout();
@@ -1646,29 +2051,65 @@ void osal_run_system( void )
   }
 #endif /* USE_ICALL */
 
-  do {
-    if (tasksEvents[idx])  // Task is highest priority that is ready.
-    {
-      break;
-    }
-  } while (++idx < tasksCnt);
+  idx = osal_next_ready_task();  // Task is highest priority that is ready.
 
   if (idx < tasksCnt)
   {
     uint16 events;
     halIntState_t intState;
+#if OSAL_PROFILE
+    uint16 pending;
+    uint32 start, ready, selReady;
+#endif
 
     HAL_ENTER_CRITICAL_SECTION(intState);
     events = tasksEvents[idx];
     tasksEvents[idx] = 0;  // Clear the Events for this task.
+    OSAL_READY_CLR( idx );
+#if OSAL_PROFILE
+    start = halSleepReadTimer();
+    ready = osalProfile[idx].readyTime;
+    selReady = osalProfile[tasksCnt].readyTime;
+#endif
     HAL_EXIT_CRITICAL_SECTION(intState);
 
     activeTaskID = idx;
+#if OSAL_PROFILE
+    pending = events;
+#endif
+    OSAL_TRACE_REC( OSAL_TRACE_TASK_BEGIN, idx, events );
     events = (tasksArr[idx])( idx, events );
+    OSAL_TRACE_REC( OSAL_TRACE_TASK_END, idx, events );
     activeTaskID = TASK_NO_TASK;
 
     HAL_ENTER_CRITICAL_SECTION(intState);
+#if OSAL_PROFILE
+    {
+      uint32 end = halSleepReadTimer();
+      uint16 run = OSAL_PROFILE_TICKS( start, end );
+
+      osalProfileAdd( &osalProfile[idx], run, OSAL_PROFILE_TICKS( ready, start ) );
+      if ( ( idx == osalProfileTask ) && ( pending & ~events & osalProfileEvents ) )
+      {
+        osalProfileAdd( &osalProfile[tasksCnt], run, OSAL_PROFILE_TICKS( selReady, start ) );
+      }
+
+      // Events handed back have been waiting since before this call
+      if ( events )
+      {
+        osalProfile[idx].readyTime = ready;
+        if ( ( idx == osalProfileTask ) && ( events & osalProfileEvents ) )
+        {
+          osalProfile[tasksCnt].readyTime = selReady;
+        }
+      }
+    }
+#endif
     tasksEvents[idx] |= events;  // Add back unprocessed events to the current task.
+    if ( tasksEvents[idx] )
+    {
+      OSAL_READY_SET( idx );
+    }
     HAL_EXIT_CRITICAL_SECTION(intState);
   }
 #if defined( POWER_SAVING ) && !defined(USE_ICALL)
@@ -135,10 +135,7 @@
 // fast comparisons with zero to determine the end of the heap.
 #define OSALMEM_LASTBLK_IDX      ((MAXMEMHEAP / OSALMEM_HDRSZ) - 1)
 
-// For information about memory profiling, refer to SWRA204 "Heap Memory Management", section 1.5.
-#if !defined OSALMEM_PROFILER
-#define OSALMEM_PROFILER           FALSE  // Enable/disable the memory usage profiling buckets.
-#endif
+// OSALMEM_PROFILER defaults to FALSE in OSAL_Memory.h.
 #if !defined OSALMEM_PROFILER_LL
 #define OSALMEM_PROFILER_LL        FALSE  // Special profiling of the Long-Lived bucket.
 #endif
@@ -149,6 +146,23 @@
 #define OSALMEM_REIN              'F'
 #endif
 
+#if OSALMEM_SEGREGATED
+/* Block sizes, including the header, of the segregated size classes, and the number of blocks
+ * of each class carved off the end of the heap at init. The sizes must be increasing, even
+ * multiples of OSALMEM_HDRSZ and big enough to hold the header and a free list link.
+ * Adjust accordingly to match the allocation sizes seen most often when profiling the system:
+ * the pools are taken from the heap whether they are used or not.
+ */
+#if !defined OSALMEM_SEG_CLASSES
+#define OSALMEM_SEG_CLASSES        3
+#define OSALMEM_SEG_SIZES          OSALMEM_ROUND(12), OSALMEM_ROUND(32), OSALMEM_ROUND(48)
+#define OSALMEM_SEG_COUNTS         4, 14, 4
+#endif
+
+// Free list link kept in the data bytes of a block on a segregated free list.
+#define OSALMEM_SEG_NEXT(HDR)      (*(osalMemHdr_t **)((HDR) + 1))
+#endif
+
 /* ------------------------------------------------------------------------------------------------
  *                                           Typedefs
  * ------------------------------------------------------------------------------------------------
@@ -185,12 +199,29 @@ static osalMemHdr_t *ff1;  // First free block in the small-block bucket.
 
 static uint8 osalMemStat;            // Discrete status flags: 0x01 = kicked.
 
+#if OSALMEM_SEGREGATED
+static const uint16 osalMemSegSz[OSALMEM_SEG_CLASSES] = { OSALMEM_SEG_SIZES };
+static const uint8 osalMemSegCnt[OSALMEM_SEG_CLASSES] = { OSALMEM_SEG_COUNTS };
+// Free blocks of each size class. The pools lie past the end-of-heap NULL block, so the
+// first-fit search never walks them and their blocks never coalesce with the heap.
+static osalMemHdr_t *osalMemSegList[OSALMEM_SEG_CLASSES];
+static osalMemHdr_t *osalMemSegPool;  // First block of the pools.
+#endif
+
 #if OSALMEM_METRICS
 static uint16 blkMax;  // Max cnt of all blocks ever seen at once.
 static uint16 blkCnt;  // Current cnt of all blocks.
 static uint16 blkFree; // Current cnt of free blocks.
 static uint16 memAlo;  // Current total memory allocated.
 static uint16 memMax;  // Max total memory ever allocated at once.
+static uint16 failCnt; // Failed allocations.
+static uint16 failLen; // Size of the last failed allocation.
+// Failed allocations per task, in order of first failure. The task running is the best guess
+// at the call site that is available without a return address; an interrupt is not told apart
+// from the task it interrupted.
+static uint8  failTask[OSALMEM_FAIL_SITES];
+static uint16 failTaskCnt[OSALMEM_FAIL_SITES];
+static uint8  failSites;
 #endif
 
 #if OSALMEM_PROFILER
@@ -216,6 +247,20 @@ static uint16 proSmallBlkMiss;
 extern int dprintf(const char *fmt, ...);
 #endif /* DPRINTF_HEAPTRACE */
 
+/* ------------------------------------------------------------------------------------------------
+ *                                           Local Functions
+ * ------------------------------------------------------------------------------------------------
+ */
+
+static osalMemHdr_t *osalMemFirstFit(uint16 size);
+#if OSALMEM_METRICS
+static void osalMemFail(uint16 size);
+#endif
+#if OSALMEM_SEGREGATED
+static uint8 osalMemSegClass(uint16 len);
+static uint16 osalMemSegInit(void);
+#endif
+
 /**************************************************************************************************
  * @fn          osal_mem_init
  *
@@ -236,6 +281,9 @@ void osal_mem_init(void)
   HAL_ASSERT(((OSALMEM_MIN_BLKSZ % OSALMEM_HDRSZ) == 0));
   HAL_ASSERT(((OSALMEM_LL_BLKSZ % OSALMEM_HDRSZ) == 0));
   HAL_ASSERT(((OSALMEM_SMALL_BLKSZ % OSALMEM_HDRSZ) == 0));
+#if OSALMEM_SEGREGATED
+  HAL_ASSERT((osalMemSegSz[0] >= (OSALMEM_HDRSZ + sizeof(osalMemHdr_t *))));
+#endif
 
 #if OSALMEM_PROFILER
   (void)osal_memset(theHeap, OSALMEM_INIT, MAXMEMHEAP);
@@ -260,6 +308,11 @@ void osal_mem_init(void)
    */
   blkCnt = blkFree = 2;
 #endif
+
+#if OSALMEM_SEGREGATED
+  // Carve the pools off the end of the wilderness, behind a new end-of-heap NULL block.
+  theHeap[OSALMEM_BIGBLK_IDX].val -= osalMemSegInit();
+#endif
 }
 
 /**************************************************************************************************
@@ -320,10 +373,11 @@ void *osal_mem_alloc_dbg( uint16 size, const char *fname, unsigned lnum )
 void *osal_mem_alloc( uint16 size )
 #endif /* DPRINTF_OSALHEAPTRACE */
 {
-  osalMemHdr_t *prev = NULL;
   osalMemHdr_t *hdr;
   halIntState_t intState;
-  uint8 coal = 0;
+#if OSALMEM_SEGREGATED
+  uint8 cls;
+#endif
 
   size += OSALMEM_HDRSZ;
 
@@ -344,6 +398,116 @@ void *osal_mem_alloc( uint16 size )
 
   HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
 
+#if OSALMEM_SEGREGATED
+  hdr = NULL;
+
+  // Once the long-lived allocations are done, sizes of a class are served by its pool while it
+  // lasts, and by the heap after that.
+  cls = (osalMemStat != 0) ? osalMemSegClass(size) : OSALMEM_SEG_CLASSES;
+  if ((cls < OSALMEM_SEG_CLASSES) && (osalMemSegList[cls] != NULL))
+  {
+    hdr = osalMemSegList[cls];
+    osalMemSegList[cls] = OSALMEM_SEG_NEXT(hdr);
+    hdr->hdr.inUse = TRUE;
+
+#if ( OSALMEM_METRICS )
+    memAlo += hdr->hdr.len;
+    blkFree--;
+    if ( memMax < memAlo )
+    {
+      memMax = memAlo;
+    }
+#endif
+  }
+
+  if (hdr == NULL)
+#endif
+  {
+    hdr = osalMemFirstFit(size);
+  }
+
+  if ( hdr != NULL )
+  {
+#if ( OSALMEM_PROFILER )
+#if !OSALMEM_PROFILER_LL
+    if (osalMemStat != 0)  // Don't profile until after the LL block is filled.
+#endif
+    {
+      uint8 idx;
+
+      for ( idx = 0; idx < OSALMEM_PROMAX; idx++ )
+      {
+        if ( hdr->hdr.len <= proCnt[idx] )
+        {
+          break;
+        }
+      }
+      proCur[idx]++;
+      if ( proMax[idx] < proCur[idx] )
+      {
+        proMax[idx] = proCur[idx];
+      }
+      proTot[idx]++;
+
+      /* A small-block could not be allocated in the small-block bucket.
+       * When this occurs significantly frequently, increase the size of the
+       * bucket in order to restore better worst case run times. Set the first
+       * profiling bucket size in proCnt[] to the small-block bucket size and
+       * divide proSmallBlkMiss by the corresponding proTot[] size to get % miss.
+       * Best worst case time on TrasmitApp was achieved at a 0-15% miss rate
+       * during steady state Tx load, 0% during idle and steady state Rx load.
+       */
+      if ((hdr->hdr.len <= OSALMEM_SMALL_BLKSZ) && (hdr >= (theHeap + OSALMEM_BIGBLK_IDX)))
+      {
+        proSmallBlkMiss++;
+      }
+    }
+
+    (void)osal_memset((uint8 *)(hdr+1), OSALMEM_ALOC, (hdr->hdr.len - OSALMEM_HDRSZ));
+#endif
+
+    hdr++;
+  }
+#if ( OSALMEM_METRICS )
+  else
+  {
+    osalMemFail(size - OSALMEM_HDRSZ);
+  }
+#endif
+
+  HAL_EXIT_CRITICAL_SECTION( intState );  // Re-enable interrupts.
+
+  HAL_ASSERT(((size_t)hdr % sizeof(halDataAlign_t)) == 0);
+
+#ifdef DPRINTF_OSALHEAPTRACE
+  dprintf("osal_mem_alloc(%u)->%lx:%s:%u\n", size, (unsigned) hdr, fname, lnum);
+#endif /* DPRINTF_OSALHEAPTRACE */
+  return (void *)hdr;
+}
+
+/**************************************************************************************************
+ * @fn          osalMemFirstFit
+ *
+ * @brief       This function finds, splits and marks in-use the first free block of the heap that
+ *              is big enough, coalescing free blocks along the way.
+ *              Ints must be disabled.
+ *
+ * input parameters
+ *
+ * @param size - the block size needed, including the header.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      Pointer to the header of the block allocated, or NULL if none is big enough.
+ */
+static osalMemHdr_t *osalMemFirstFit(uint16 size)
+{
+  osalMemHdr_t *prev = NULL;
+  osalMemHdr_t *hdr;
+  uint8 coal = 0;
+
   // Smaller allocations are first attempted in the small-block bucket, and all long-lived
   // allocations are channeled into the LL block reserved within this bucket.
   if ((osalMemStat == 0) || (size <= OSALMEM_SMALL_BLKSZ))
@@ -437,60 +601,13 @@ void *osal_mem_alloc( uint16 size )
     }
 #endif
 
-#if ( OSALMEM_PROFILER )
-#if !OSALMEM_PROFILER_LL
-    if (osalMemStat != 0)  // Don't profile until after the LL block is filled.
-#endif
-    {
-      uint8 idx;
-
-      for ( idx = 0; idx < OSALMEM_PROMAX; idx++ )
-      {
-        if ( hdr->hdr.len <= proCnt[idx] )
-        {
-          break;
-        }
-      }
-      proCur[idx]++;
-      if ( proMax[idx] < proCur[idx] )
-      {
-        proMax[idx] = proCur[idx];
-      }
-      proTot[idx]++;
-
-      /* A small-block could not be allocated in the small-block bucket.
-       * When this occurs significantly frequently, increase the size of the
-       * bucket in order to restore better worst case run times. Set the first
-       * profiling bucket size in proCnt[] to the small-block bucket size and
-       * divide proSmallBlkMiss by the corresponding proTot[] size to get % miss.
-       * Best worst case time on TrasmitApp was achieved at a 0-15% miss rate
-       * during steady state Tx load, 0% during idle and steady state Rx load.
-       */
-      if ((hdr->hdr.len <= OSALMEM_SMALL_BLKSZ) && (hdr >= (theHeap + OSALMEM_BIGBLK_IDX)))
-      {
-        proSmallBlkMiss++;
-      }
-    }
-
-    (void)osal_memset((uint8 *)(hdr+1), OSALMEM_ALOC, (hdr->hdr.len - OSALMEM_HDRSZ));
-#endif
-
     if ((osalMemStat != 0) && (ff1 == hdr))
     {
       ff1 = (osalMemHdr_t *)((uint8 *)hdr + hdr->hdr.len);
     }
-
-    hdr++;
   }
 
-  HAL_EXIT_CRITICAL_SECTION( intState );  // Re-enable interrupts.
-
-  HAL_ASSERT(((size_t)hdr % sizeof(halDataAlign_t)) == 0);
-
-#ifdef DPRINTF_OSALHEAPTRACE
-  dprintf("osal_mem_alloc(%u)->%lx:%s:%u\n", size, (unsigned) hdr, fname, lnum);
-#endif /* DPRINTF_OSALHEAPTRACE */
-  return (void *)hdr;
+  return hdr;
 }
 
 /**************************************************************************************************
@@ -516,7 +633,6 @@ void osal_mem_free(void *ptr)
 {
   osalMemHdr_t *hdr = (osalMemHdr_t *)ptr - 1;
   halIntState_t intState;
-
 #ifdef DPRINTF_OSALHEAPTRACE
   dprintf("osal_mem_free(%lx):%s:%u\n", (unsigned) ptr, fname, lnum);
 #endif /* DPRINTF_OSALHEAPTRACE */
@@ -525,12 +641,6 @@ void osal_mem_free(void *ptr)
   HAL_ASSERT(hdr->hdr.inUse);
 
   HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
-  hdr->hdr.inUse = FALSE;
-
-  if (ff1 > hdr)
-  {
-    ff1 = hdr;
-  }
 
 #if OSALMEM_PROFILER
 #if !OSALMEM_PROFILER_LL
@@ -557,9 +667,121 @@ void osal_mem_free(void *ptr)
   blkFree++;
 #endif
 
+#if OSALMEM_SEGREGATED
+  if (hdr >= osalMemSegPool)
+  {
+    // A pool block goes back to the pool of its class, which it exactly fits.
+    uint8 cls = osalMemSegClass(hdr->hdr.len);
+
+    hdr->hdr.inUse = FALSE;
+    OSALMEM_SEG_NEXT(hdr) = osalMemSegList[cls];
+    osalMemSegList[cls] = hdr;
+  }
+  else
+#endif
+  {
+    hdr->hdr.inUse = FALSE;
+
+    if (ff1 > hdr)
+    {
+      ff1 = hdr;
+    }
+  }
+
   HAL_EXIT_CRITICAL_SECTION( intState );  // Re-enable interrupts.
 }
 
+#if OSALMEM_SEGREGATED
+/**************************************************************************************************
+ * @fn          osalMemSegClass
+ *
+ * @brief       This function finds the smallest segregated size class able to hold a block.
+ *
+ * input parameters
+ *
+ * @param len - the block size, including the header.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      The size class index, or OSALMEM_SEG_CLASSES if the block is bigger than all.
+ */
+static uint8 osalMemSegClass(uint16 len)
+{
+  uint8 cls;
+
+  for (cls = 0; cls < OSALMEM_SEG_CLASSES; cls++)
+  {
+    if (len <= osalMemSegSz[cls])
+    {
+      break;
+    }
+  }
+
+  return cls;
+}
+
+/**************************************************************************************************
+ * @fn          osalMemSegInit
+ *
+ * @brief       This function carves the pools of the segregated size classes off the end of the
+ *              heap, puts their blocks on the free lists and moves the end-of-heap NULL block in
+ *              front of them.
+ *
+ * input parameters
+ *
+ * None.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      The number of bytes taken from the wilderness.
+ */
+static uint16 osalMemSegInit(void)
+{
+  osalMemHdr_t *hdr = theHeap + OSALMEM_LASTBLK_IDX + 1;
+  uint16 total = 0;
+  uint8 cls;
+  uint8 cnt;
+
+  for (cls = 0; cls < OSALMEM_SEG_CLASSES; cls++)
+  {
+    HAL_ASSERT(((osalMemSegSz[cls] % OSALMEM_HDRSZ) == 0));
+    total += osalMemSegSz[cls] * osalMemSegCnt[cls];
+  }
+  HAL_ASSERT((total < (OSALMEM_BIGBLK_SZ / 2)));
+
+  // Lay the blocks out from the end of the heap back, the biggest class last.
+  for (cls = OSALMEM_SEG_CLASSES; cls-- != 0; )
+  {
+    osalMemSegList[cls] = NULL;
+
+    for (cnt = 0; cnt < osalMemSegCnt[cls]; cnt++)
+    {
+      hdr = (osalMemHdr_t *)((uint8 *)hdr - osalMemSegSz[cls]);
+      hdr->val = osalMemSegSz[cls];  // Set 'len' & clear 'inUse' field.
+      OSALMEM_SEG_NEXT(hdr) = osalMemSegList[cls];
+      osalMemSegList[cls] = hdr;
+    }
+  }
+
+  osalMemSegPool = hdr;
+  (hdr - 1)->val = 0;
+
+#if ( OSALMEM_METRICS )
+  for (cls = 0; cls < OSALMEM_SEG_CLASSES; cls++)
+  {
+    blkCnt += osalMemSegCnt[cls];
+    blkFree += osalMemSegCnt[cls];
+  }
+#endif
+
+  return total;
+}
+#endif
+
 #if OSALMEM_METRICS
 /*********************************************************************
  * @fn      osal_heap_block_max
@@ -616,9 +838,155 @@ uint16 osal_heap_mem_used( void )
 {
   return memAlo;
 }
+
+/**************************************************************************************************
+ * @fn          osalMemFail
+ *
+ * @brief       This function counts a failed allocation against the OSAL task that made it.
+ *              It must be called with interrupts held off.
+ *
+ * input parameters
+ *
+ * @param       size - The number of bytes requested, rounded up for alignment.
+ *
+ * output parameters
+ *
+ * None.
+ *
+ * @return      None.
+ */
+static void osalMemFail(uint16 size)
+{
+  uint8 taskId = osal_self();
+  uint8 idx;
+
+  if (failCnt != 0xFFFF)
+  {
+    failCnt++;
+  }
+  failLen = size;
+
+  for (idx = 0; idx < failSites; idx++)
+  {
+    if (failTask[idx] == taskId)
+    {
+      break;
+    }
+  }
+
+  if (idx == failSites)
+  {
+    if (failSites == OSALMEM_FAIL_SITES)
+    {
+      return;  // Only the total counts the tasks that do not fit.
+    }
+    failTask[idx] = taskId;
+    failTaskCnt[idx] = 0;
+    failSites++;
+  }
+
+  if (failTaskCnt[idx] != 0xFFFF)
+  {
+    failTaskCnt[idx]++;
+  }
+}
+
+/*********************************************************************
+ * @fn      osal_heap_fail_cnt
+ *
+ * @brief   Return the number of failed allocations.
+ *
+ * @param   none
+ *
+ * @return  Number of allocations that returned NULL.
+ */
+uint16 osal_heap_fail_cnt( void )
+{
+  return failCnt;
+}
+
+/*********************************************************************
+ * @fn      osal_heap_fail_len
+ *
+ * @brief   Return the size of the last failed allocation.
+ *
+ * @param   none
+ *
+ * @return  Bytes requested, rounded up for alignment, by the last allocation that returned NULL.
+ */
+uint16 osal_heap_fail_len( void )
+{
+  return failLen;
+}
+
+/*********************************************************************
+ * @fn      osal_heap_fail_site
+ *
+ * @brief   Return the failed allocations of one of the tasks that had any, in order of
+ *          their first failure. TASK_NO_TASK stands for initialization and for interrupts
+ *          taken between tasks. A failure in an interrupt taken while a task runs is counted
+ *          against that task, as osal_self() returns it.
+ *
+ * @param   idx - index of the task, from 0 to OSALMEM_FAIL_SITES-1
+ * @param   pTaskId - OSAL task id
+ * @param   pCnt - number of failed allocations of the task
+ *
+ * @return  TRUE if there is a task at the index, FALSE otherwise.
+ */
+uint8 osal_heap_fail_site( uint8 idx, uint8 *pTaskId, uint16 *pCnt )
+{
+  halIntState_t intState;
+  uint8 found = FALSE;
+
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  if (idx < failSites)
+  {
+    *pTaskId = failTask[idx];
+    *pCnt = failTaskCnt[idx];
+    found = TRUE;
+  }
+  HAL_EXIT_CRITICAL_SECTION(intState);
+
+  return found;
+}
+#endif
+
+#if OSALMEM_PROFILER
+/*********************************************************************
+ * @fn      osal_heap_profile_bucket
+ *
+ * @brief   Return the counts of one of the memory profiling buckets.
+ *
+ * @param   idx - index of the bucket, from 0 to OSALMEM_PROMAX-1
+ * @param   pSize - largest block size, including the header, counted by the bucket
+ * @param   pCur - number of blocks now allocated
+ * @param   pMax - maximum number of blocks ever allocated at once
+ * @param   pTot - total number of blocks allocated
+ *
+ * @return  TRUE if there is a bucket at the index, FALSE otherwise.
+ */
+uint8 osal_heap_profile_bucket( uint8 idx, uint16 *pSize, uint16 *pCur, uint16 *pMax,
+                                uint16 *pTot )
+{
+  halIntState_t intState;
+
+  if (idx >= OSALMEM_PROMAX)
+  {
+    return FALSE;
+  }
+
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  *pSize = proCnt[idx];
+  *pCur = proCur[idx];
+  *pMax = proMax[idx];
+  *pTot = proTot[idx];
+  HAL_EXIT_CRITICAL_SECTION(intState);
+
+  return TRUE;
+}
 #endif
 
-#if defined (ZTOOL_P1) || defined (ZTOOL_P2)
+#if ( OSALMEM_METRICS ) || defined (ZTOOL_P1) || defined (ZTOOL_P2)
 /*********************************************************************
  * @fn      osal_heap_high_water
  *
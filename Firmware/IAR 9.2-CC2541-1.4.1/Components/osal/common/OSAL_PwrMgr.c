@@ -64,10 +64,17 @@
  * MACROS
  */
 
+// Sleep timer ticks between two readings of the 24 bit sleep timer
+#define PWRMGR_TICKS( from, to )  ( ( (to) - (from) ) & 0x00FFFFFFUL )
+
 /*********************************************************************
  * CONSTANTS
  */
 
+#if OSAL_PWRMGR_STATS && !defined( POWER_SAVING ) && !(defined USE_ICALL || defined OSAL_PORT2TIRTOS)
+  #error OSAL_PWRMGR_STATS needs POWER_SAVING!
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -95,10 +102,19 @@ uint8 pwrmgr_initialized = FALSE;
  * LOCAL VARIABLES
  */
 
+#if OSAL_PWRMGR_STATS
+static pwrmgr_stats_t pwrmgr_stats;
+static uint32 pwrmgr_stats_time;    // Sleep timer at the last update
+#endif
+
 /*********************************************************************
  * LOCAL FUNCTION PROTOTYPES
  */
 
+#if OSAL_PWRMGR_STATS
+static void pwrmgrStatsAdd( uint32 *pTicks );
+#endif
+
 /*********************************************************************
  * FUNCTIONS
  *********************************************************************/
@@ -118,6 +134,9 @@ void osal_pwrmgr_init( void )
   pwrmgr_attribute.pwrmgr_device = PWRMGR_ALWAYS_ON; // Default to no power conservation.
 #endif /* USE_ICALL */
   pwrmgr_attribute.pwrmgr_task_state = 0;            // Cleared.  All set to conserve
+#if OSAL_PWRMGR_STATS
+  osal_pwrmgr_stats_reset();
+#endif
 #if defined USE_ICALL || defined OSAL_PORT2TIRTOS
   pwrmgr_initialized = TRUE;
 #endif /* defined USE_ICALL || defined OSAL_PORT2TIRTOS */
@@ -236,6 +255,10 @@ void osal_pwrmgr_powerconserve( void )
   // Should we even look into power conservation
   if ( pwrmgr_attribute.pwrmgr_device != PWRMGR_ALWAYS_ON )
   {
+#if OSAL_PWRMGR_STATS
+    pwrmgrStatsAdd( &pwrmgr_stats.awakeTicks );
+#endif
+
     // Are all tasks in agreement to conserve
     if ( pwrmgr_attribute.pwrmgr_task_state == 0 )
     {
@@ -250,10 +273,92 @@ void osal_pwrmgr_powerconserve( void )
 
       // Put the processor into sleep mode
       OSAL_SET_CPU_INTO_SLEEP( next );
+
+#if OSAL_PWRMGR_STATS
+      pwrmgrStatsAdd( &pwrmgr_stats.sleepTicks );
+      if ( pwrmgr_stats.sleeps != 0xFFFF )
+      {
+        pwrmgr_stats.sleeps++;
+      }
+      if ( ( next == 0 ) && ( pwrmgr_stats.untimedSleeps != 0xFFFF ) )
+      {
+        pwrmgr_stats.untimedSleeps++;
+      }
+#endif
     }
+#if OSAL_PWRMGR_STATS
+    else
+    {
+      if ( pwrmgr_stats.holds != 0xFFFF )
+      {
+        pwrmgr_stats.holds++;
+      }
+      pwrmgr_stats.holdTasks |= pwrmgr_attribute.pwrmgr_task_state;
+    }
+#endif
   }
 }
 #endif /* POWER_SAVING */
 
+#if OSAL_PWRMGR_STATS
+/*********************************************************************
+ * @fn      pwrmgrStatsAdd
+ *
+ * @brief   Add the sleep timer ticks since the last update to a time
+ *          counter. The sleep timer wraps after 512 seconds, so this
+ *          must be called more often than that.
+ *
+ * @param   pTicks - counter to add the time to
+ *
+ * @return  none
+ */
+static void pwrmgrStatsAdd( uint32 *pTicks )
+{
+  uint32 now = halSleepReadTimer();
+
+  *pTicks += PWRMGR_TICKS( pwrmgr_stats_time, now );
+  pwrmgr_stats_time = now;
+}
+
+/*********************************************************************
+ * @fn      osal_pwrmgr_stats
+ *
+ * @brief   Copy the sleep residency counters. The time since the last
+ *          sleep is added to the awake time first.
+ *
+ * @param   pStats - where to copy the counters
+ *
+ * @return  none
+ */
+void osal_pwrmgr_stats( pwrmgr_stats_t *pStats )
+{
+  halIntState_t intState;
+
+  HAL_ENTER_CRITICAL_SECTION( intState );
+  pwrmgrStatsAdd( &pwrmgr_stats.awakeTicks );
+  *pStats = pwrmgr_stats;
+  HAL_EXIT_CRITICAL_SECTION( intState );
+}
+
+/*********************************************************************
+ * @fn      osal_pwrmgr_stats_reset
+ *
+ * @brief   Clear the sleep residency counters.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void osal_pwrmgr_stats_reset( void )
+{
+  halIntState_t intState;
+
+  HAL_ENTER_CRITICAL_SECTION( intState );
+  osal_memset( &pwrmgr_stats, 0, sizeof( pwrmgr_stats ) );
+  pwrmgr_stats_time = halSleepReadTimer();
+  HAL_EXIT_CRITICAL_SECTION( intState );
+}
+#endif /* OSAL_PWRMGR_STATS */
+
 /*********************************************************************
 *********************************************************************/
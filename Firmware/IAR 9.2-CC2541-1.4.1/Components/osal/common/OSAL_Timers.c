@@ -46,6 +46,7 @@
 #include "OSAL.h"
 #include "OSAL_Timers.h"
 #include "hal_timer.h"
+#include "osal_trace.h"
 
 /*********************************************************************
  * MACROS
@@ -68,7 +69,7 @@ typedef union {
 typedef struct
 {
   void   *next;
-  osalTime_t timeout;
+  osalTime_t timeout;     // Delta to the expiry of the previous timer in the list
   uint16 event_flag;
   uint8  task_id;
   uint32 reloadTimeout;
@@ -78,6 +79,9 @@ typedef struct
  * GLOBAL VARIABLES
  */
 
+// Timer list, sorted by expiry time. Each timer holds its timeout as a
+// delta to the timer before it, so only the head needs to be updated
+// on a tick.
 osalTimerRec_t *timerHead;
 
 /*********************************************************************
@@ -94,12 +98,28 @@ osalTimerRec_t *timerHead;
 // Milliseconds since last reboot
 static uint32 osal_systemClock;
 
+// Number of timers in the timer list
+static uint8 osalTimerCnt;
+
+// Preallocated timer records and the list of unused ones
+static osalTimerRec_t osalTimerPool[OSAL_TIMERS_POOL_SIZE];
+static osalTimerRec_t *osalTimerFreeList;
+
+// Number of timer records that had to come from the heap
+static uint16 osalTimerPoolOverflow;
+
 /*********************************************************************
  * LOCAL FUNCTION PROTOTYPES
  */
 osalTimerRec_t  *osalAddTimer( uint8 task_id, uint16 event_flag, uint32 timeout );
 osalTimerRec_t *osalFindTimer( uint8 task_id, uint16 event_flag );
-void osalDeleteTimer( osalTimerRec_t *rmTimer );
+void osalDeleteTimer( osalTimerRec_t *rmTimer, osalTimerRec_t *prevTimer );
+
+static osalTimerRec_t *osalSearchTimer( uint8 task_id, uint16 event_flag,
+                                        osalTimerRec_t **prevTimer );
+static void osalInsertTimer( osalTimerRec_t *newTimer, uint32 timeout );
+static osalTimerRec_t *osalTimerRecAlloc( void );
+static void osalTimerRecFree( osalTimerRec_t *freeTimer );
 
 /*********************************************************************
  * FUNCTIONS
@@ -116,7 +136,125 @@ void osalDeleteTimer( osalTimerRec_t *rmTimer );
  */
 void osalTimerInit( void )
 {
+  uint8 i;
+
   osal_systemClock = 0;
+  timerHead = NULL;
+  osalTimerCnt = 0;
+
+  // Link all pool records into the free list
+  osalTimerFreeList = NULL;
+  for ( i = 0; i < OSAL_TIMERS_POOL_SIZE; i++ )
+  {
+    osalTimerPool[i].next = osalTimerFreeList;
+    osalTimerFreeList = &osalTimerPool[i];
+  }
+  osalTimerPoolOverflow = 0;
+}
+
+/*********************************************************************
+ * @fn      osalTimerRecAlloc
+ *
+ * @brief   Get a timer record from the pool. The heap is only used
+ *          when the pool is exhausted, which is counted as an overflow.
+ *          Ints must be disabled.
+ *
+ * @param   none
+ *
+ * @return  osalTimerRec_t * - timer record, or NULL if none available
+ */
+static osalTimerRec_t *osalTimerRecAlloc( void )
+{
+  osalTimerRec_t *newTimer;
+
+  newTimer = osalTimerFreeList;
+  if ( newTimer )
+  {
+    osalTimerFreeList = newTimer->next;
+  }
+  else
+  {
+    if ( osalTimerPoolOverflow < 0xFFFF )
+    {
+      osalTimerPoolOverflow++;
+    }
+
+    newTimer = osal_mem_alloc( sizeof( osalTimerRec_t ) );
+  }
+
+  return ( newTimer );
+}
+
+/*********************************************************************
+ * @fn      osalTimerRecFree
+ *
+ * @brief   Return a timer record to the pool, or to the heap if it
+ *          was allocated there.
+ *          Ints must be disabled.
+ *
+ * @param   freeTimer - timer record no longer in the timer list
+ *
+ * @return  none
+ */
+static void osalTimerRecFree( osalTimerRec_t *freeTimer )
+{
+  if ( (freeTimer >= &osalTimerPool[0]) &&
+       (freeTimer < &osalTimerPool[OSAL_TIMERS_POOL_SIZE]) )
+  {
+    freeTimer->next = osalTimerFreeList;
+    osalTimerFreeList = freeTimer;
+  }
+  else
+  {
+    osal_mem_free( freeTimer );
+  }
+}
+
+/*********************************************************************
+ * @fn      osalInsertTimer
+ *
+ * @brief   Insert a timer into the sorted timer list. Timers with the
+ *          same expiry time keep the order in which they were inserted.
+ *          Ints must be disabled.
+ *
+ * @param   newTimer - timer record not currently in the list
+ * @param   timeout - milliseconds from now until expiry
+ *
+ * @return  none
+ */
+static void osalInsertTimer( osalTimerRec_t *newTimer, uint32 timeout )
+{
+  osalTimerRec_t *srchTimer;
+  osalTimerRec_t *prevTimer;
+
+  srchTimer = timerHead;
+  prevTimer = NULL;
+
+  // Skip the timers that expire no later than the new one
+  while ( srchTimer && (srchTimer->timeout.time32 <= timeout) )
+  {
+    timeout -= srchTimer->timeout.time32;
+    prevTimer = srchTimer;
+    srchTimer = srchTimer->next;
+  }
+
+  newTimer->timeout.time32 = timeout;
+  newTimer->next = srchTimer;
+
+  // The following timer is now relative to the new one
+  if ( srchTimer )
+  {
+    srchTimer->timeout.time32 -= timeout;
+  }
+
+  if ( prevTimer == NULL )
+  {
+    timerHead = newTimer;
+  }
+  else
+  {
+    prevTimer->next = newTimer;
+  }
 }
 
 /*********************************************************************
@@ -134,76 +272,57 @@ void osalTimerInit( void )
 osalTimerRec_t * osalAddTimer( uint8 task_id, uint16 event_flag, uint32 timeout )
 {
   osalTimerRec_t *newTimer;
-  osalTimerRec_t *srchTimer;
+  osalTimerRec_t *prevTimer;
 
   // Look for an existing timer first
-  newTimer = osalFindTimer( task_id, event_flag );
+  newTimer = osalSearchTimer( task_id, event_flag, &prevTimer );
   if ( newTimer )
   {
-    // Timer is found - update it.
-    newTimer->timeout.time32 = timeout;
-
-    return ( newTimer );
+    // Timer is found - take it out and put it back at its new position.
+    osalDeleteTimer( newTimer, prevTimer );
   }
   else
   {
     // New Timer
-    newTimer = osal_mem_alloc( sizeof( osalTimerRec_t ) );
+    newTimer = osalTimerRecAlloc();
 
-    if ( newTimer )
-    {
-      // Fill in new timer
-      newTimer->task_id = task_id;
-      newTimer->event_flag = event_flag;
-      newTimer->timeout.time32 = timeout;
-      newTimer->next = (void *)NULL;
-      newTimer->reloadTimeout = 0;
-
-      // Does the timer list already exist
-      if ( timerHead == NULL )
-      {
-        // Start task list
-        timerHead = newTimer;
-      }
-      else
-      {
-        // Add it to the end of the timer list
-        srchTimer = timerHead;
-
-        // Stop at the last record
-        while ( srchTimer->next )
-          srchTimer = srchTimer->next;
-
-        // Add to the list
-        srchTimer->next = newTimer;
-      }
-
-      return ( newTimer );
-    }
-    else
+    if ( newTimer == NULL )
     {
       return ( (osalTimerRec_t *)NULL );
     }
+
+    // Fill in new timer
+    newTimer->task_id = task_id;
+    newTimer->event_flag = event_flag;
+    newTimer->reloadTimeout = 0;
   }
+
+  osalInsertTimer( newTimer, timeout );
+  osalTimerCnt++;
+
+  return ( newTimer );
 }
 
 /*********************************************************************
- * @fn      osalFindTimer
+ * @fn      osalSearchTimer
  *
- * @brief   Find a timer in a timer list.
+ * @brief   Find a timer in a timer list, along with the timer before it.
  *          Ints must be disabled.
  *
  * @param   task_id
  * @param   event_flag
+ * @param   prevTimer - set to the timer before the one found, or NULL
  *
  * @return  osalTimerRec_t *
  */
-osalTimerRec_t *osalFindTimer( uint8 task_id, uint16 event_flag )
+static osalTimerRec_t *osalSearchTimer( uint8 task_id, uint16 event_flag,
+                                        osalTimerRec_t **prevTimer )
 {
   osalTimerRec_t *srchTimer;
 
   // Head of the timer list
   srchTimer = timerHead;
+  *prevTimer = NULL;
 
   // Stop when found or at the end
   while ( srchTimer )
@@ -215,30 +334,69 @@ osalTimerRec_t *osalFindTimer( uint8 task_id, uint16 event_flag )
     }
 
     // Not this one, check another
+    *prevTimer = srchTimer;
     srchTimer = srchTimer->next;
   }
 
   return ( srchTimer );
 }
 
+/*********************************************************************
+ * @fn      osalFindTimer
+ *
+ * @brief   Find a timer in a timer list.
+ *          Ints must be disabled.
+ *
+ * @param   task_id
+ * @param   event_flag
+ *
+ * @return  osalTimerRec_t *
+ */
+osalTimerRec_t *osalFindTimer( uint8 task_id, uint16 event_flag )
+{
+  osalTimerRec_t *prevTimer;
+
+  return ( osalSearchTimer( task_id, event_flag, &prevTimer ) );
+}
+
 /*********************************************************************
  * @fn      osalDeleteTimer
  *
- * @brief   Delete a timer from a timer list.
+ * @brief   Take a timer out of the timer list. The caller owns the
+ *          record afterwards.
+ *          Ints must be disabled.
  *
- * @param   table
- * @param   rmTimer
+ * @param   rmTimer - timer to remove
+ * @param   prevTimer - timer before rmTimer in the list, or NULL
  *
  * @return  none
  */
-void osalDeleteTimer( osalTimerRec_t *rmTimer )
+void osalDeleteTimer( osalTimerRec_t *rmTimer, osalTimerRec_t *prevTimer )
 {
+  osalTimerRec_t *nextTimer;
+
   // Does the timer list really exist
   if ( rmTimer )
   {
-    // Clear the event flag and osalTimerUpdate() will delete
-    // the timer from the list.
-    rmTimer->event_flag = 0;
+    nextTimer = rmTimer->next;
+
+    // Hand the remaining delta over to the following timer
+    if ( nextTimer )
+    {
+      nextTimer->timeout.time32 += rmTimer->timeout.time32;
+    }
+
+    if ( prevTimer == NULL )
+    {
+      timerHead = nextTimer;
+    }
+    else
+    {
+      prevTimer->next = nextTimer;
+    }
+
+    rmTimer->next = NULL;
+    osalTimerCnt--;
   }
 }
 
@@ -324,14 +482,16 @@ uint8 osal_stop_timerEx( uint8 task_id, uint16 event_id )
 {
   halIntState_t intState;
   osalTimerRec_t *foundTimer;
+  osalTimerRec_t *prevTimer;
 
   HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
 
   // Find the timer to stop
-  foundTimer = osalFindTimer( task_id, event_id );
+  foundTimer = osalSearchTimer( task_id, event_id, &prevTimer );
   if ( foundTimer )
   {
-    osalDeleteTimer( foundTimer );
+    osalDeleteTimer( foundTimer, prevTimer );
+    osalTimerRecFree( foundTimer );
   }
 
   HAL_EXIT_CRITICAL_SECTION( intState );   // Re-enable interrupts.
@@ -353,15 +513,28 @@ uint32 osal_get_timeoutEx( uint8 task_id, uint16 event_id )
 {
   halIntState_t intState;
   uint32 rtrn = 0;
-  osalTimerRec_t *tmr;
+  osalTimerRec_t *srchTimer;
 
   HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
 
-  tmr = osalFindTimer( task_id, event_id );
+  // Sum the deltas up to the timer
+  srchTimer = timerHead;
+  while ( srchTimer )
+  {
+    rtrn += srchTimer->timeout.time32;
 
-  if ( tmr )
+    if ( srchTimer->event_flag == event_id &&
+         srchTimer->task_id == task_id )
+    {
+      break;
+    }
+
+    srchTimer = srchTimer->next;
+  }
+
+  if ( srchTimer == NULL )
   {
-    rtrn = tmr->timeout.time32;
+    rtrn = 0;
   }
 
   HAL_EXIT_CRITICAL_SECTION( intState );   // Re-enable interrupts.
@@ -380,31 +553,31 @@ uint32 osal_get_timeoutEx( uint8 task_id, uint16 event_id )
  */
 uint8 osal_timer_num_active( void )
 {
-  halIntState_t intState;
-  uint8 num_timers = 0;
-  osalTimerRec_t *srchTimer;
-
-  HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
-
-  // Head of the timer list
-  srchTimer = timerHead;
-
-  // Count timers in the list
-  while ( srchTimer != NULL )
-  {
-    num_timers++;
-    srchTimer = srchTimer->next;
-  }
-
-  HAL_EXIT_CRITICAL_SECTION( intState );   // Re-enable interrupts.
+  return osalTimerCnt;
+}
 
-  return num_timers;
+/*********************************************************************
+ * @fn      osal_timer_pool_overflow
+ *
+ * @brief
+ *
+ *   This function returns the number of times the timer record pool
+ *   was empty and a record had to be allocated from the heap. A
+ *   non-zero value means OSAL_TIMERS_POOL_SIZE is too small.
+ *
+ * @return  uint16 - number of pool overflows
+ */
+uint16 osal_timer_pool_overflow( void )
+{
+  return osalTimerPoolOverflow;
 }
 
 /*********************************************************************
  * @fn      osalTimerUpdate
  *
- * @brief   Update the timer structures for a timer tick.
+ * @brief   Update the timer structures for a timer tick. Only the
+ *          head of the timer list and the timers that expire are
+ *          touched.
  *
  * @param   none
  *
@@ -413,115 +586,58 @@ uint8 osal_timer_num_active( void )
 void osalTimerUpdate( uint32 updateTime )
 {
   halIntState_t intState;
-  osalTimerRec_t *srchTimer;
-  osalTimerRec_t *prevTimer;
-
-  osalTime_t timeUnion;
-  timeUnion.time32 = updateTime;
+  osalTimerRec_t *expTimer;
+  uint16 event_flag;
+  uint8 task_id;
 
   HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
   // Update the system time
   osal_systemClock += updateTime;
   HAL_EXIT_CRITICAL_SECTION( intState );   // Re-enable interrupts.
 
-  // Look for open timer slot
-  if ( timerHead != NULL )
+  for ( ;; )
   {
-    // Add it to the end of the timer list
-    srchTimer = timerHead;
-    prevTimer = (void *)NULL;
-
-    // Look for open timer slot
-    while ( srchTimer )
-    {
-      osalTimerRec_t *freeTimer = NULL;
+    HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
 
-      HAL_ENTER_CRITICAL_SECTION( intState );  // Hold off interrupts.
+    expTimer = timerHead;
 
-      // To minimize time in this critical section, avoid 32-bit math
-      if ((timeUnion.time16[1] == 0) && (timeUnion.time8[1] == 0))
-      {
-        // If upper 24 bits are zero, check lower 8 bits for roll over
-        if (srchTimer->timeout.time8[0] >= timeUnion.time8[0])
-        {
-          // 8-bit math
-          srchTimer->timeout.time8[0] -= timeUnion.time8[0];
-        }
-        else
-        {
-          // 32-bit math
-          if (srchTimer->timeout.time32 > timeUnion.time32)
-          {
-            srchTimer->timeout.time32 -= timeUnion.time32;
-          }
-          else
-          {
-            srchTimer->timeout.time32 = 0;
-          }
-        }
-      }
-      else
+    // Stop at the first timer that has not expired
+    if ( (expTimer == NULL) || (expTimer->timeout.time32 > updateTime) )
+    {
+      if ( expTimer )
       {
-          // 32-bit math
-        if (srchTimer->timeout.time32 > timeUnion.time32)
-        {
-          srchTimer->timeout.time32 -= timeUnion.time32;
-        }
-        else
-        {
-          srchTimer->timeout.time32 = 0;
-        }
+        expTimer->timeout.time32 -= updateTime;
       }
 
-      // Check for reloading
-      if ( (srchTimer->timeout.time16[0] == 0) && (srchTimer->timeout.time16[1] == 0) &&
-           (srchTimer->reloadTimeout) && (srchTimer->event_flag) )
-      {
-        // Notify the task of a timeout
-        osal_set_event( srchTimer->task_id, srchTimer->event_flag );
-
-        // Reload the timer timeout value
-        srchTimer->timeout.time32 = srchTimer->reloadTimeout;
-      }
+      HAL_EXIT_CRITICAL_SECTION( intState );   // Re-enable interrupts.
+      break;
+    }
 
-      // When timeout or delete (event_flag == 0)
-      if ( ((srchTimer->timeout.time16[0] == 0) && (srchTimer->timeout.time16[1] == 0)) ||
-            (srchTimer->event_flag == 0) )
-      {
-        // Take out of list
-        if ( prevTimer == NULL )
-        {
-          timerHead = srchTimer->next;
-        }
-        else
-        {
-          prevTimer->next = srchTimer->next;
-        }
-
-        // Setup to free memory
-        freeTimer = srchTimer;
-
-        // Next
-        srchTimer = srchTimer->next;
-      }
-      else
-      {
-        // Get next
-        prevTimer = srchTimer;
-        srchTimer = srchTimer->next;
-      }
+    // Take the expired timer off the head of the list
+    updateTime -= expTimer->timeout.time32;
+    timerHead = expTimer->next;
 
-      HAL_EXIT_CRITICAL_SECTION( intState );   // Re-enable interrupts.
+    task_id = expTimer->task_id;
+    event_flag = expTimer->event_flag;
 
-      if ( freeTimer )
-      {
-        if ( (freeTimer->timeout.time16[0] == 0) && (freeTimer->timeout.time16[1] == 0) )
-        {
-          osal_set_event( freeTimer->task_id, freeTimer->event_flag );
-        }
-        osal_mem_free( freeTimer );
-      }
+    if ( expTimer->reloadTimeout )
+    {
+      // Reload relative to the end of this update; the time still to be
+      // consumed from the list is added so the timer is not shortened.
+      osalInsertTimer( expTimer, expTimer->reloadTimeout + updateTime );
+      expTimer = NULL;
+    }
+    else
+    {
+      osalTimerCnt--;
+      osalTimerRecFree( expTimer );
     }
+
+    HAL_EXIT_CRITICAL_SECTION( intState );   // Re-enable interrupts.
+
+    // Notify the task of a timeout
+    OSAL_TRACE_REC( OSAL_TRACE_TIMER, task_id, event_flag );
+    osal_set_event( task_id, event_flag );
   }
 }
 
@@ -558,8 +674,9 @@ void osal_adjust_timers( void )
  *
  * @brief
  *
- *   Search timer table to return the lowest timeout value. If the
- *   timer list is empty, then the returned timeout will be zero.
+ *   Return the lowest timeout value, which is the one at the head of
+ *   the sorted timer list. If the timer list is empty, then the
+ *   returned timeout will be zero.
  *
  * @param   none
  *
@@ -568,23 +685,14 @@ void osal_adjust_timers( void )
 uint32 osal_next_timeout( void )
 {
   uint32 nextTimeout;
-  osalTimerRec_t *srchTimer;
 
   if ( timerHead != NULL )
   {
-    // Head of the timer list
-    srchTimer = timerHead;
-    nextTimeout = OSAL_TIMERS_MAX_TIMEOUT;
+    nextTimeout = timerHead->timeout.time32;
 
-    // Look for the next timeout timer
-    while ( srchTimer != NULL )
+    if ( nextTimeout > OSAL_TIMERS_MAX_TIMEOUT )
     {
-      if (srchTimer->timeout.time32 < nextTimeout)
-      {
-        nextTimeout = srchTimer->timeout.time32;
-      }
-      // Check next timer
-      srchTimer = srchTimer->next;
+      nextTimeout = OSAL_TIMERS_MAX_TIMEOUT;
     }
   }
   else
@@ -57,6 +57,11 @@
 /*********************************************************************
  * CONSTANTS
  */
+// Number of distinct payload offsets remembered for the descriptor lookup.
+// The stack moves its payload pointers by a few fixed header lengths.
+#if !defined ( BM_PAYLOAD_OFFSETS )
+  #define BM_PAYLOAD_OFFSETS  4
+#endif
 
 /*********************************************************************
  * TYPEDEFS
@@ -64,7 +69,9 @@
 typedef struct bm_desc
 {
   struct bm_desc *next_ptr;    // pointer to next buffer descriptor
+  struct bm_desc *prev_ptr;    // pointer to previous buffer descriptor
   uint16          payload_len; // length of user's buffer
+  struct bm_desc *self_ptr;    // pointer to this buffer descriptor
 } bm_desc_t;
 
 /*********************************************************************
@@ -81,10 +88,18 @@ typedef struct bm_desc
 // Linked list of allocated buffer descriptors
 static bm_desc_t *bm_list_ptr = NULL;
 
+// Offsets from the start of a buffer of the payload pointers handed out by
+// osal_bm_adjust_header and osal_bm_adjust_tail, the oldest replaced first
+static uint16 bm_offsets[BM_PAYLOAD_OFFSETS];
+static uint8 bm_offset_cnt = 0;
+static uint8 bm_offset_next = 0;
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
 static bm_desc_t *bm_desc_from_payload ( uint8 *payload_ptr );
+static uint8 bm_desc_valid ( bm_desc_t *bd_ptr, uint8 *payload_ptr );
+static void bm_offset_note ( uint16 offset );
 
 /*********************************************************************
  * @fn      osal_bm_alloc
@@ -112,9 +127,15 @@ void *osal_bm_alloc( uint16 size )
   {
     // set the buffer descriptor info
     bd_ptr->payload_len  = size;
+    bd_ptr->self_ptr     = bd_ptr;
 
     // add item to the beginning of the list
     bd_ptr->next_ptr = bm_list_ptr;
+    bd_ptr->prev_ptr = NULL;
+    if ( bm_list_ptr != NULL )
+    {
+      bm_list_ptr->prev_ptr = bd_ptr;
+    }
     bm_list_ptr = bd_ptr;
 
     // return start of the buffer
@@ -138,40 +159,31 @@ void *osal_bm_alloc( uint16 size )
 void osal_bm_free( void *payload_ptr )
 {
   halIntState_t cs;
-  bm_desc_t *loop_ptr;
-  bm_desc_t *prev_ptr;
+  bm_desc_t *bd_ptr;
 
   HAL_ENTER_CRITICAL_SECTION(cs);
 
-  prev_ptr = NULL;
-
-  loop_ptr = bm_list_ptr;
-  while ( loop_ptr != NULL )
+  bd_ptr = bm_desc_from_payload( (uint8 *)payload_ptr );
+  if ( bd_ptr != NULL )
   {
-    if ( payload_ptr >= (void *)START_PTR( loop_ptr ) &&
-         payload_ptr <= (void *)END_PTR( loop_ptr) )
+    // unlink item from the linked list
+    if ( bd_ptr->prev_ptr == NULL )
     {
-      // unlink item from the linked list
-      if ( prev_ptr == NULL )
-      {
-        // it's the first item on the list
-        bm_list_ptr = loop_ptr->next_ptr;
-      }
-      else
-      {
-        prev_ptr->next_ptr = loop_ptr->next_ptr;
-      }
-
-      // free the memory
-      osal_mem_free( loop_ptr );
-
-      // we're done here
-      break;
+      // it's the first item on the list
+      bm_list_ptr = bd_ptr->next_ptr;
+    }
+    else
+    {
+      bd_ptr->prev_ptr->next_ptr = bd_ptr->next_ptr;
     }
 
-    // move on to next item
-    prev_ptr = loop_ptr;
-    loop_ptr = loop_ptr->next_ptr;
+    if ( bd_ptr->next_ptr != NULL )
+    {
+      bd_ptr->next_ptr->prev_ptr = bd_ptr->prev_ptr;
+    }
+
+    // free the memory
+    osal_mem_free( bd_ptr );
   }
 
   HAL_EXIT_CRITICAL_SECTION(cs);
@@ -204,6 +216,8 @@ void *osal_bm_adjust_header( void *payload_ptr, int16 size )
     if ( new_payload_ptr >= (uint8 *)START_PTR( bd_ptr ) &&
          new_payload_ptr <= (uint8 *)END_PTR( bd_ptr ) )
     {
+      bm_offset_note( new_payload_ptr - (uint8 *)START_PTR( bd_ptr ) );
+
       // return new payload pointer
       return ( (void *)new_payload_ptr );
     }
@@ -238,6 +252,8 @@ void *osal_bm_adjust_tail( void *payload_ptr, int16 size )
     if ( new_payload_ptr >= (uint8 *)START_PTR( bd_ptr ) &&
          new_payload_ptr <= (uint8 *)END_PTR( bd_ptr ) )
     {
+      bm_offset_note( new_payload_ptr - (uint8 *)START_PTR( bd_ptr ) );
+
       // return new payload pointer
       return ( (void *)new_payload_ptr );
     }
@@ -250,7 +266,12 @@ void *osal_bm_adjust_tail( void *payload_ptr, int16 size )
 /*********************************************************************
  * @fn      bm_desc_from_payload
  *
- * @brief   Find buffer descriptor from payload pointer
+ * @brief   Find buffer descriptor from payload pointer. A payload pointer
+ *          at the start of its buffer, as returned by osal_bm_alloc, finds
+ *          its descriptor right in front of it, and one moved by
+ *          osal_bm_adjust_header or osal_bm_adjust_tail finds it one of
+ *          the remembered offsets further back. Other payload pointers are
+ *          looked up in the list of allocated buffer descriptors.
  *
  * @param   payload_ptr - pointer to payload
  *
@@ -259,6 +280,22 @@ void *osal_bm_adjust_tail( void *payload_ptr, int16 size )
 static bm_desc_t *bm_desc_from_payload ( uint8 *payload_ptr )
 {
   bm_desc_t *loop_ptr;
+  uint8 i;
+
+  loop_ptr = (bm_desc_t *)payload_ptr - 1;
+  if ( bm_desc_valid( loop_ptr, payload_ptr ) )
+  {
+    return ( loop_ptr );
+  }
+
+  for ( i = 0; i < bm_offset_cnt; i++ )
+  {
+    loop_ptr = (bm_desc_t *)( payload_ptr - bm_offsets[i] ) - 1;
+    if ( bm_desc_valid( loop_ptr, payload_ptr ) )
+    {
+      return ( loop_ptr );
+    }
+  }
 
   loop_ptr = bm_list_ptr;
   while ( loop_ptr != NULL )
@@ -277,6 +314,94 @@ static bm_desc_t *bm_desc_from_payload ( uint8 *payload_ptr )
   return ( loop_ptr );
 }
 
+/*********************************************************************
+ * @fn      bm_desc_valid
+ *
+ * @brief   Check whether a buffer descriptor candidate is an allocated
+ *          buffer descriptor that the payload pointer belongs to. The
+ *          candidate must point to itself and be linked both ways in the
+ *          list of allocated buffer descriptors, so that payload bytes are
+ *          not mistaken for a buffer descriptor.
+ *
+ * @param   bd_ptr - buffer descriptor candidate
+ * @param   payload_ptr - pointer to payload
+ *
+ * @return  TRUE if valid, FALSE otherwise
+ */
+static uint8 bm_desc_valid ( bm_desc_t *bd_ptr, uint8 *payload_ptr )
+{
+  if ( bd_ptr->self_ptr != bd_ptr )
+  {
+    return ( FALSE );
+  }
+
+  if ( payload_ptr < (uint8 *)START_PTR( bd_ptr ) ||
+       payload_ptr > (uint8 *)END_PTR( bd_ptr ) )
+  {
+    return ( FALSE );
+  }
+
+  if ( ( bd_ptr->next_ptr != NULL ) && ( bd_ptr->next_ptr->prev_ptr != bd_ptr ) )
+  {
+    return ( FALSE );
+  }
+
+  if ( bd_ptr->prev_ptr == NULL )
+  {
+    return ( bm_list_ptr == bd_ptr );
+  }
+
+  return ( bd_ptr->prev_ptr->next_ptr == bd_ptr );
+}
+
+/*********************************************************************
+ * @fn      bm_offset_note
+ *
+ * @brief   Remember the offset of a payload pointer from the start of its
+ *          buffer, unless it is 0 or already remembered. When all are
+ *          taken the oldest is replaced; its pointers are then found by
+ *          the walk of the list again.
+ *
+ * @param   offset - offset of the payload pointer
+ *
+ * @return  none
+ */
+static void bm_offset_note ( uint16 offset )
+{
+  halIntState_t cs;
+  uint8 i;
+
+  if ( offset == 0 )
+  {
+    return;
+  }
+
+  HAL_ENTER_CRITICAL_SECTION(cs);
+
+  for ( i = 0; i < bm_offset_cnt; i++ )
+  {
+    if ( bm_offsets[i] == offset )
+    {
+      break;
+    }
+  }
+
+  if ( i == bm_offset_cnt )
+  {
+    bm_offsets[bm_offset_next] = offset;
+    if ( ++bm_offset_next == BM_PAYLOAD_OFFSETS )
+    {
+      bm_offset_next = 0;
+    }
+    if ( bm_offset_cnt < BM_PAYLOAD_OFFSETS )
+    {
+      bm_offset_cnt++;
+    }
+  }
+
+  HAL_EXIT_CRITICAL_SECTION(cs);
+}
+
 
 /****************************************************************************
 ****************************************************************************/
@@ -7,7 +7,8 @@
                   provides 'callback' timers using the existing 'event' timers.
                   In other words, the registered callback function is called
                   instead of an OSAL event being sent to the owner of the timer
-                  when it expires.
+                  when it expires. All callback timers are kept in a queue
+                  ordered by expiry time, which runs on a single event timer.
 
 
   Copyright 2008-2015 Texas Instruments Incorporated. All rights reserved.
@@ -50,26 +51,37 @@
 /*********************************************************************
  * MACROS
  */
-// Macros to convert one-dimensional index 'timer id' to two-dimensional indices
-// 'task id' and 'event id'.
-
-// Find out event id using timer id
-#define EVENT_ID( timerId )            ( 0x0001 << ( ( timerId ) % NUM_CBTIMERS_PER_TASK ) )
-
-// Find out task id using timer id
-#define TASK_ID( timerId )             ( ( ( timerId ) / NUM_CBTIMERS_PER_TASK ) + baseTaskID )
-
-// Find out bank task id using task id
-#define BANK_TASK_ID( taskId )         ( ( baseTaskID - ( taskId ) ) * NUM_CBTIMERS )
+// Callback timer record of a timer id
+#define CBTIMER( timerId )             ( &cbTimers[( timerId )] )
 
 /*********************************************************************
  * CONSTANTS
  */
-// Number of callback timers supported per task (limited by the number of OSAL event timers)
+// Number of callback timers supported per task in the original design, where
+// each timer used an OSAL event of its own
 #define NUM_CBTIMERS_PER_TASK          15
 
-// Total number of callback timers
-#define NUM_CBTIMERS                   ( OSAL_CBTIMER_NUM_TASKS * NUM_CBTIMERS_PER_TASK )
+// Total number of callback timers. All of them share a single OSAL event
+// timer, so the count is only limited by RAM and the timer id range.
+#if !defined ( OSAL_CBTIMER_NUM_TIMERS )
+  #define OSAL_CBTIMER_NUM_TIMERS      ( OSAL_CBTIMER_NUM_TASKS * NUM_CBTIMERS_PER_TASK )
+#endif
+#define NUM_CBTIMERS                   OSAL_CBTIMER_NUM_TIMERS
+
+#if ( NUM_CBTIMERS >= TIMEOUT_TIMER_ID )
+  #error Too many callback timers for the timer id range!
+#endif
+
+// OSAL event of the base task that expires the head of the timer queue
+#define CBTIMER_EXPIRE_EVT             0x0001
+
+// End of a timer list
+#define CBTIMER_NONE                   INVALID_TIMER_ID
+
+// Callback timer states
+#define CBTIMER_FREE                   0 // on the free list
+#define CBTIMER_QUEUED                 1 // on the expiry queue
+#define CBTIMER_FIRING                 2 // callback function being called
 
 /*********************************************************************
  * TYPEDEFS
@@ -79,6 +91,11 @@ typedef struct
 {
   pfnCbTimer_t  pfnCbTimer; // callback function to be called when timer expires
   uint8        *pData;      // data to be passed in to callback function
+  uint32        timeout;    // time to expire after the previous timer in the queue
+  uint32        reload;     // reload timeout, 0 for a one-shot timer
+  uint8         next;       // next timer in the queue or on the free list
+  uint8         prev;       // previous timer in the queue
+  uint8         state;      // CBTIMER_FREE, CBTIMER_QUEUED or CBTIMER_FIRING
 } cbTimer_t;
 
 /*********************************************************************
@@ -103,6 +120,10 @@ uint16 baseTaskID = TASK_NO_TASK;
   cbTimer_t cbTimers[NUM_CBTIMERS];
 #endif
 
+// Expiry queue, in order of expiry, and free list of the timers
+static uint8 cbTimerHead = CBTIMER_NONE;
+static uint8 cbTimerFree = CBTIMER_NONE;
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -112,6 +133,11 @@ static Status_t cbTimerSetup( pfnCbTimer_t  pfnCbTimer,
                               uint32        timeout,
                               uint8        *pTimerId,
                               uint8         reload );
+static void cbTimerSync( void );
+static void cbTimerArm( void );
+static void cbTimerInsert( uint8 timerId, uint32 timeout );
+static void cbTimerRemove( uint8 timerId );
+static void cbTimerRelease( uint8 timerId );
 
 /*********************************************************************
  * API FUNCTIONS
@@ -123,6 +149,7 @@ static Status_t cbTimerSetup( pfnCbTimer_t  pfnCbTimer,
  *
  * @brief       Callback Timer task initialization function. This function
  *              can be called more than once (OSAL_CBTIMER_NUM_TASKS times).
+ *              All callback timers run on the first task.
  *
  * @param       taskId - Message Timer task ID.
  *
@@ -132,11 +159,21 @@ void osal_CbTimerInit( uint8 taskId )
 {
   if ( baseTaskID == TASK_NO_TASK )
   {
+    uint8 i;
+
     // Only initialize the base task id
     baseTaskID = taskId;
 
     // Initialize all timer structures
     osal_memset( cbTimers, 0, sizeof( cbTimers ) );
+
+    // Put all timers on the free list
+    for ( i = 0; i < NUM_CBTIMERS; i++ )
+    {
+      cbTimers[i].next = ( i + 1 < NUM_CBTIMERS ) ? ( i + 1 ) : CBTIMER_NONE;
+    }
+    cbTimerFree = 0;
+    cbTimerHead = CBTIMER_NONE;
   }
 }
 
@@ -161,51 +198,58 @@ uint16 osal_CbTimerProcessEvent( uint8 taskId, uint16 events )
     return ( events ^ SYS_EVENT_MSG );
   }
 
-  if ( events )
+  if ( events & CBTIMER_EXPIRE_EVT )
   {
-    uint8 i;
-    uint16 event = 0;
+    uint8 timerId = CBTIMER_NONE;
+    cbTimer_t *pTimer;
     halIntState_t cs;
 
     HAL_ENTER_CRITICAL_SECTION(cs);
 
-    // Process event timers
-    for ( i = 0; i < NUM_CBTIMERS_PER_TASK; i++ )
+    cbTimerSync();
+
+    // Take the first timer off the queue if it has expired
+    if ( ( cbTimerHead != CBTIMER_NONE ) && ( CBTIMER( cbTimerHead )->timeout == 0 ) )
     {
-      if ( ( events >> i ) & 0x0001 )
+      timerId = cbTimerHead;
+      pTimer = CBTIMER( timerId );
+      cbTimerRemove( timerId );
+
+      if ( pTimer->reload != 0 )
+      {
+        // Requeue the timer before calling back so that it does not drift
+        cbTimerInsert( timerId, pTimer->reload );
+      }
+      else
       {
-        cbTimer_t *pTimer = &cbTimers[BANK_TASK_ID( taskId )+i];
-
-        // Found the first event
-        event =  0x0001 << i;
-
-        // check there is a callback function to call
-        if ( pTimer->pfnCbTimer != NULL )
-        {
-          // Timer expired, call the registered callback function
-          pTimer->pfnCbTimer( pTimer->pData );
-        }
-
-        // check if the timer is still active
-        // Note: An active timer means the timer was started with reload!
-        if ( osal_get_timeoutEx( taskId, event ) == 0 )
-        {
-          // Mark entry as free
-          pTimer->pfnCbTimer = NULL;
-
-          // Null out data pointer
-          pTimer->pData = NULL;
-        }
-
-        // We only process one event at a time
-        break;
+        pTimer->state = CBTIMER_FIRING;
       }
     }
+    else
+    {
+      cbTimerArm();
+    }
 
     HAL_EXIT_CRITICAL_SECTION(cs);
 
+    if ( timerId != CBTIMER_NONE )
+    {
+      // Timer expired, call the registered callback function
+      pTimer->pfnCbTimer( pTimer->pData );
+
+      HAL_ENTER_CRITICAL_SECTION(cs);
+
+      // Free a one-shot timer, unless the callback function already stopped it
+      if ( pTimer->state == CBTIMER_FIRING )
+      {
+        cbTimerRelease( timerId );
+      }
+
+      HAL_EXIT_CRITICAL_SECTION(cs);
+    }
+
     // return unprocessed events
-    return ( events ^ event );
+    return ( events ^ CBTIMER_EXPIRE_EVT );
   }
 
   // If reach here, the events are unknown
@@ -303,18 +347,16 @@ Status_t osal_CbTimerUpdate( uint8 timerId, uint32 timeout )
   // Look for the existing timer
   if ( timerId < NUM_CBTIMERS )
   {
-    if ( cbTimers[timerId].pfnCbTimer != NULL )
+    // Make sure the timer is still running
+    if ( CBTIMER( timerId )->state == CBTIMER_QUEUED )
     {
-      // Make sure the corresponding OSAL event timer is still running
-      if ( osal_get_timeoutEx( TASK_ID( timerId ), EVENT_ID( timerId ) ) != 0 )
-      {
-        // Timer exists; update it
-        osal_start_timerEx( TASK_ID( timerId ), EVENT_ID( timerId ), timeout );
+      // Timer exists; update it
+      cbTimerRemove( timerId );
+      cbTimerInsert( timerId, timeout );
 
-        HAL_EXIT_CRITICAL_SECTION(cs);
+      HAL_EXIT_CRITICAL_SECTION(cs);
 
-        return (  SUCCESS );
-      }
+      return (  SUCCESS );
     }
   }
 
@@ -345,16 +387,16 @@ Status_t osal_CbTimerStop( uint8 timerId )
   // Look for the existing timer
   if ( timerId < NUM_CBTIMERS )
   {
-    if ( cbTimers[timerId].pfnCbTimer != NULL )
+    if ( CBTIMER( timerId )->state != CBTIMER_FREE )
     {
-      // Timer exists; stop the OSAL event timer first
-      osal_stop_timerEx( TASK_ID( timerId ), EVENT_ID( timerId ) );
+      // Timer exists; take it off the queue first
+      if ( CBTIMER( timerId )->state == CBTIMER_QUEUED )
+      {
+        cbTimerRemove( timerId );
+      }
 
       // Mark entry as free
-      cbTimers[timerId].pfnCbTimer = NULL;
-
-      // Null out data pointer
-      cbTimers[timerId].pData = NULL;
+      cbTimerRelease( timerId );
 
       HAL_EXIT_CRITICAL_SECTION(cs);
 
@@ -411,34 +453,29 @@ static Status_t cbTimerSetup( pfnCbTimer_t  pfnCbTimer,
     return ( INVALIDPARAMETER );
   }
 
-  // Look for an unused timer first
-  for ( i = 0; i < NUM_CBTIMERS; i++ )
+  // Take an unused timer off the free list
+  i = cbTimerFree;
+  if ( i != CBTIMER_NONE )
   {
-    if ( cbTimers[i].pfnCbTimer == NULL )
+    cbTimerFree = CBTIMER( i )->next;
+
+    // Set up the callback timer
+    CBTIMER( i )->pfnCbTimer = pfnCbTimer;
+    CBTIMER( i )->pData      = pData;
+    CBTIMER( i )->reload     = ( reload == TRUE ) ? timeout : 0;
+
+    cbTimerInsert( i, timeout );
+
+    // Check if the caller wants the timer Id
+    if ( pTimerId != NULL )
     {
-      // Start the OSAL event timer first
-      if ( ( (reload==TRUE)          ?
-             osal_start_reload_timer :
-             osal_start_timerEx )( TASK_ID( i ), EVENT_ID( i ), timeout ) == SUCCESS )
-      {
-        // Set up the callback timer
-        // Note: An odd pointer will be used to indicate to the process event
-        //       handler that the timer was started with reload.
-        cbTimers[i].pfnCbTimer = pfnCbTimer; //(pfnCbTimer_t)((uint32)pfnCbTimer | reload);
-        cbTimers[i].pData      = pData;
-
-        // Check if the caller wants the timer Id
-        if ( pTimerId != NULL )
-        {
-          // Caller is intreseted in the timer id
-          *pTimerId = i;
-        }
-
-        HAL_EXIT_CRITICAL_SECTION(cs);
-
-        return ( SUCCESS );
-      }
+      // Caller is intreseted in the timer id
+      *pTimerId = i;
     }
+
+    HAL_EXIT_CRITICAL_SECTION(cs);
+
+    return ( SUCCESS );
   }
 
   HAL_EXIT_CRITICAL_SECTION(cs);
@@ -447,5 +484,160 @@ static Status_t cbTimerSetup( pfnCbTimer_t  pfnCbTimer,
   return ( NO_TIMER_AVAIL );
 }
 
+/*********************************************************************
+ * @fn      cbTimerSync
+ *
+ * @brief   Bring the timeout of the first timer of the queue up to date
+ *          with the time left on the OSAL event timer. Ints must be
+ *          disabled.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void cbTimerSync( void )
+{
+  if ( cbTimerHead != CBTIMER_NONE )
+  {
+    CBTIMER( cbTimerHead )->timeout = osal_get_timeoutEx( baseTaskID, CBTIMER_EXPIRE_EVT );
+  }
+}
+
+/*********************************************************************
+ * @fn      cbTimerArm
+ *
+ * @brief   Start the OSAL event timer for the first timer of the queue.
+ *          Ints must be disabled.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void cbTimerArm( void )
+{
+  if ( cbTimerHead == CBTIMER_NONE )
+  {
+    osal_stop_timerEx( baseTaskID, CBTIMER_EXPIRE_EVT );
+  }
+  else if ( CBTIMER( cbTimerHead )->timeout == 0 )
+  {
+    // Already expired
+    osal_stop_timerEx( baseTaskID, CBTIMER_EXPIRE_EVT );
+    osal_set_event( baseTaskID, CBTIMER_EXPIRE_EVT );
+  }
+  else
+  {
+    osal_start_timerEx( baseTaskID, CBTIMER_EXPIRE_EVT, CBTIMER( cbTimerHead )->timeout );
+  }
+}
+
+/*********************************************************************
+ * @fn      cbTimerInsert
+ *
+ * @brief   Add a timer to the expiry queue. Timers expiring at the same
+ *          time expire in the order they were added. Ints must be disabled.
+ *
+ * @param   timerId - timer to add
+ * @param   timeout - time to expire in milliseconds
+ *
+ * @return  none
+ */
+static void cbTimerInsert( uint8 timerId, uint32 timeout )
+{
+  cbTimer_t *pTimer = CBTIMER( timerId );
+  uint8 prev = CBTIMER_NONE;
+  uint8 next;
+
+  cbTimerSync();
+
+  // Find the first timer expiring after this one
+  next = cbTimerHead;
+  while ( ( next != CBTIMER_NONE ) && ( timeout >= CBTIMER( next )->timeout ) )
+  {
+    timeout -= CBTIMER( next )->timeout;
+    prev = next;
+    next = CBTIMER( next )->next;
+  }
+
+  pTimer->timeout = timeout;
+  pTimer->prev = prev;
+  pTimer->next = next;
+  pTimer->state = CBTIMER_QUEUED;
+
+  if ( next != CBTIMER_NONE )
+  {
+    CBTIMER( next )->timeout -= timeout;
+    CBTIMER( next )->prev = timerId;
+  }
+
+  if ( prev != CBTIMER_NONE )
+  {
+    CBTIMER( prev )->next = timerId;
+  }
+  else
+  {
+    cbTimerHead = timerId;
+    cbTimerArm();
+  }
+}
+
+/*********************************************************************
+ * @fn      cbTimerRemove
+ *
+ * @brief   Take a timer off the expiry queue. Ints must be disabled.
+ *
+ * @param   timerId - timer to remove
+ *
+ * @return  none
+ */
+static void cbTimerRemove( uint8 timerId )
+{
+  cbTimer_t *pTimer = CBTIMER( timerId );
+
+  cbTimerSync();
+
+  if ( pTimer->next != CBTIMER_NONE )
+  {
+    // The next timer now expires relative to the previous one
+    CBTIMER( pTimer->next )->timeout += pTimer->timeout;
+    CBTIMER( pTimer->next )->prev = pTimer->prev;
+  }
+
+  if ( pTimer->prev != CBTIMER_NONE )
+  {
+    CBTIMER( pTimer->prev )->next = pTimer->next;
+  }
+  else
+  {
+    cbTimerHead = pTimer->next;
+    cbTimerArm();
+  }
+}
+
+/*********************************************************************
+ * @fn      cbTimerRelease
+ *
+ * @brief   Put a timer that is not queued back on the free list.
+ *          Ints must be disabled.
+ *
+ * @param   timerId - timer to release
+ *
+ * @return  none
+ */
+static void cbTimerRelease( uint8 timerId )
+{
+  cbTimer_t *pTimer = CBTIMER( timerId );
+
+  // Mark entry as free
+  pTimer->pfnCbTimer = NULL;
+
+  // Null out data pointer
+  pTimer->pData = NULL;
+
+  pTimer->state = CBTIMER_FREE;
+  pTimer->next = cbTimerFree;
+  cbTimerFree = timerId;
+}
+
 /****************************************************************************
 ****************************************************************************/
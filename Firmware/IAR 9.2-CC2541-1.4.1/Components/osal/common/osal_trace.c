@@ -0,0 +1,188 @@
+/**************************************************************************************************
+  Filename:       osal_trace.c
+
+  Description:    This file contains the OSAL event trace. Records are kept in
+                  a ring buffer in RAM, time stamped with the sleep timer, and
+                  read out oldest first. Recording a record takes a read of the
+                  sleep timer and a few stores with interrupts held off.
+**************************************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "comdef.h"
+#include "hal_mcu.h"
+#include "hal_sleep.h"
+#include "osal_trace.h"
+
+#if OSAL_TRACE
+
+/*********************************************************************
+ * MACROS
+ */
+// Index of the record following index idx
+#define TRACE_NEXT( idx )              ( ( (idx) + 1 ) & ( OSAL_TRACE_SIZE - 1 ) )
+
+/*********************************************************************
+ * CONSTANTS
+ */
+#if ( ( OSAL_TRACE_SIZE & ( OSAL_TRACE_SIZE - 1 ) ) != 0 ) || ( OSAL_TRACE_SIZE > 128 )
+  #error OSAL_TRACE_SIZE must be a power of 2 of at most 128!
+#endif
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+typedef struct
+{
+  uint8  tag;
+  uint8  arg;
+  uint16 data;
+  uint8  time[3];   // sleep timer ticks, LSB first
+} osalTraceRec_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+static osalTraceRec_t osalTraceBuf[OSAL_TRACE_SIZE];
+
+static uint8  osalTraceHead;    // Oldest record
+static uint8  osalTraceCnt;     // Number of records
+static uint16 osalTraceLost;    // Records overwritten before being read
+
+/*********************************************************************
+ * @fn      osal_trace
+ *
+ * @brief   Add a record to the trace, overwriting the oldest record
+ *          when the trace is full. May be called from an ISR.
+ *
+ * @param   tag - OSAL_TRACE_xxx tag of the record
+ * @param   arg - 8 bit argument
+ * @param   data - 16 bit argument
+ *
+ * @return  none
+ */
+void osal_trace( uint8 tag, uint8 arg, uint16 data )
+{
+  halIntState_t intState;
+  osalTraceRec_t *pRec;
+  uint32 time;
+
+  HAL_ENTER_CRITICAL_SECTION( intState );
+
+  time = halSleepReadTimer();
+
+  if ( osalTraceCnt < OSAL_TRACE_SIZE )
+  {
+    pRec = &osalTraceBuf[( osalTraceHead + osalTraceCnt ) & ( OSAL_TRACE_SIZE - 1 )];
+    osalTraceCnt++;
+  }
+  else
+  {
+    pRec = &osalTraceBuf[osalTraceHead];
+    osalTraceHead = TRACE_NEXT( osalTraceHead );
+    if ( osalTraceLost != 0xFFFF )
+    {
+      osalTraceLost++;
+    }
+  }
+
+  pRec->tag = tag;
+  pRec->arg = arg;
+  pRec->data = data;
+  pRec->time[0] = BREAK_UINT32( time, 0 );
+  pRec->time[1] = BREAK_UINT32( time, 1 );
+  pRec->time[2] = BREAK_UINT32( time, 2 );
+
+  HAL_EXIT_CRITICAL_SECTION( intState );
+}
+
+/*********************************************************************
+ * @fn      osal_trace_copy
+ *
+ * @brief   Copy the oldest records of the trace, OSAL_TRACE_REC_LEN bytes
+ *          each, without removing them. Call osal_trace_drop() once they
+ *          have been sent.
+ *
+ * @param   buf - buffer for the records
+ * @param   maxRecs - maximum number of records to copy
+ * @param   pLost - number of records overwritten before being read
+ *
+ * @return  number of records copied
+ */
+uint8 osal_trace_copy( uint8 *buf, uint8 maxRecs, uint16 *pLost )
+{
+  halIntState_t intState;
+  osalTraceRec_t *pRec;
+  uint8 idx;
+  uint8 i;
+
+  HAL_ENTER_CRITICAL_SECTION( intState );
+
+  if ( maxRecs > osalTraceCnt )
+  {
+    maxRecs = osalTraceCnt;
+  }
+  *pLost = osalTraceLost;
+
+  idx = osalTraceHead;
+  for ( i = 0; i < maxRecs; i++ )
+  {
+    pRec = &osalTraceBuf[idx];
+    *buf++ = pRec->tag;
+    *buf++ = pRec->arg;
+    *buf++ = LO_UINT16( pRec->data );
+    *buf++ = HI_UINT16( pRec->data );
+    *buf++ = pRec->time[0];
+    *buf++ = pRec->time[1];
+    *buf++ = pRec->time[2];
+    idx = TRACE_NEXT( idx );
+  }
+
+  HAL_EXIT_CRITICAL_SECTION( intState );
+
+  return ( maxRecs );
+}
+
+/*********************************************************************
+ * @fn      osal_trace_drop
+ *
+ * @brief   Remove the oldest records of the trace after they have been
+ *          copied by osal_trace_copy().
+ *
+ * @param   numRecs - number of records copied
+ * @param   lost - number of lost records reported by the copy
+ *
+ * @return  none
+ */
+void osal_trace_drop( uint8 numRecs, uint16 lost )
+{
+  halIntState_t intState;
+  uint16 over;
+
+  HAL_ENTER_CRITICAL_SECTION( intState );
+
+  // Records overwritten since the copy were the oldest, so the copied
+  // ones go first; they have been read and are not lost.
+  over = osalTraceLost - lost;
+  if ( over > numRecs )
+  {
+    over = numRecs;
+  }
+  osalTraceLost -= lost + over;
+  numRecs -= (uint8)over;
+
+  if ( numRecs > osalTraceCnt )
+  {
+    numRecs = osalTraceCnt;
+  }
+  osalTraceHead = ( osalTraceHead + numRecs ) & ( OSAL_TRACE_SIZE - 1 );
+  osalTraceCnt -= numRecs;
+
+  HAL_EXIT_CRITICAL_SECTION( intState );
+}
+
+#endif /* OSAL_TRACE */
+
+/*********************************************************************
+*********************************************************************/
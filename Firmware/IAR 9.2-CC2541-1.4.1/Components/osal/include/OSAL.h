@@ -90,6 +90,24 @@ extern "C"
 /*** Interrupts ***/
 #define INTS_ALL    0xFF
 
+/*
+ * Set to TRUE to time the task event handlers and the latency from an
+ * event being set to its handler being called, see osal_profile_get().
+ */
+#if !defined ( OSAL_PROFILE )
+  #define OSAL_PROFILE  FALSE
+#endif
+
+#if OSAL_PROFILE
+// Number of histogram buckets per profile
+#if !defined ( OSAL_PROFILE_BUCKETS )
+  #define OSAL_PROFILE_BUCKETS  8
+#endif
+
+// Task ID argument of osal_profile_get() for the events set by osal_profile_select()
+#define OSAL_PROFILE_SELECTED   0xFE
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -117,6 +135,21 @@ typedef struct
 
 typedef void * osal_msg_q_t;
 
+#if OSAL_PROFILE
+// Event loop profile. Times are in sleep timer ticks of 1/32768 s. Bucket 0
+// of a histogram counts times under one tick, bucket n counts times under
+// 2^n ticks and the last bucket counts all longer times.
+typedef struct
+{
+  uint32 readyTime;                       // Time the events were set
+  uint16 runs;                            // Number of handler calls
+  uint16 runMax;                          // Longest handler call
+  uint16 latMax;                          // Longest wait for the handler call
+  uint16 runHist[OSAL_PROFILE_BUCKETS];   // Handler call times
+  uint16 latHist[OSAL_PROFILE_BUCKETS];   // Waits for the handler call
+} osalProfile_t;
+#endif
+
 #ifdef USE_ICALL
 /* High resolution timer callback function type */
 typedef void (*osal_highres_timer_cback_t)(void *arg);
@@ -174,6 +207,11 @@ extern void (*osal_eventloop_hook)(void);
    */
   extern uint8 osal_msg_count(uint8 task_id, uint8 event);
 
+  /*
+   * High-water mark of the number of queued OSAL messages for a Task ID.
+   */
+  extern uint8 osal_msg_q_high_water(uint8 task_id);
+
   /*
    * Enqueue a Task Message
    */
@@ -281,6 +319,23 @@ extern void (*osal_eventloop_hook)(void);
    */
   extern uint8 osal_self( void );
 
+#if OSAL_PROFILE
+  /*
+   * Get the event loop profile of a task
+   */
+  extern osalProfile_t *osal_profile_get( uint8 task_id );
+
+  /*
+   * Select the task events to profile on their own
+   */
+  extern uint8 osal_profile_select( uint8 task_id, uint16 event_flag );
+
+  /*
+   * Clear all event loop profiles
+   */
+  extern void osal_profile_reset( void );
+#endif
+
 
 /*** Helper Functions ***/
 
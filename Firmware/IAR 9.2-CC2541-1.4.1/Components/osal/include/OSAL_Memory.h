@@ -58,6 +58,27 @@ extern "C"
   #define OSALMEM_METRICS  FALSE
 #endif
 
+// For information about memory profiling, refer to SWRA204 "Heap Memory Management", section 1.5.
+#if !defined ( OSALMEM_PROFILER )
+  #define OSALMEM_PROFILER  FALSE  // Enable/disable the memory usage profiling buckets.
+#endif
+
+#if ( OSALMEM_METRICS )
+// Number of tasks whose failed allocations are counted separately
+#if !defined ( OSALMEM_FAIL_SITES )
+  #define OSALMEM_FAIL_SITES  4
+#endif
+#endif
+
+/*
+ * Set to TRUE to carve a pool of blocks per size class off the end of the
+ * heap at init, so that common allocation sizes are served and freed in
+ * constant time instead of by a first-fit walk of the heap.
+ */
+#if !defined ( OSALMEM_SEGREGATED )
+  #define OSALMEM_SEGREGATED  FALSE
+#endif
+
 /*********************************************************************
  * MACROS
  */
@@ -126,9 +147,32 @@ extern "C"
   * Return the current number of bytes allocated.
   */
   uint16 osal_heap_mem_used( void );
+
+ /*
+  * Return the number of failed allocations.
+  */
+  uint16 osal_heap_fail_cnt( void );
+
+ /*
+  * Return the size of the last failed allocation.
+  */
+  uint16 osal_heap_fail_len( void );
+
+ /*
+  * Return the failed allocations of one of the tasks that had any.
+  */
+  uint8 osal_heap_fail_site( uint8 idx, uint8 *pTaskId, uint16 *pCnt );
+#endif
+
+#if ( OSALMEM_PROFILER )
+ /*
+  * Return the counts of one of the memory profiling buckets.
+  */
+  uint8 osal_heap_profile_bucket( uint8 idx, uint16 *pSize, uint16 *pCur, uint16 *pMax,
+                                  uint16 *pTot );
 #endif
 
-#if defined (ZTOOL_P1) || defined (ZTOOL_P2)
+#if ( OSALMEM_METRICS ) || defined (ZTOOL_P1) || defined (ZTOOL_P2)
  /*
   * Return the highest number of bytes ever used in the heap.
   */
@@ -53,6 +53,17 @@ extern "C"
  * MACROS
  */
 
+/*********************************************************************
+ * CONSTANTS
+ */
+
+/* Set to TRUE to count how much of the time the device sleeps, see
+ * osal_pwrmgr_stats(). Needs POWER_SAVING.
+ */
+#if !defined ( OSAL_PWRMGR_STATS )
+  #define OSAL_PWRMGR_STATS  FALSE
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -70,6 +81,19 @@ typedef struct
 #endif /* !defined USE_ICALL && !defined OSAL_PORT2TIRTOS */
 } pwrmgr_attribute_t;
 
+/* Sleep residency counters kept with OSAL_PWRMGR_STATS. Times are in
+ * 32 kHz sleep timer ticks, the counts stop at 0xFFFF.
+ */
+typedef struct
+{
+  uint32 awakeTicks;      // Time spent outside of the HAL sleep
+  uint32 sleepTicks;      // Time spent in the HAL sleep
+  uint16 sleeps;          // Calls to the HAL sleep
+  uint16 untimedSleeps;   // Calls to the HAL sleep with no OSAL timer running
+  uint16 holds;           // Idle passes with a task holding off power saving
+  uint16 holdTasks;       // Tasks seen holding off power saving, a bit per task
+} pwrmgr_stats_t;
+
 /* With PWRMGR_ALWAYS_ON selection, there is no power savings and the
  * device is most likely on mains power. The PWRMGR_BATTERY selection allows
  * the HAL sleep manager to enter SLEEP LITE state or SLEEP DEEP state.
@@ -131,6 +155,19 @@ extern pwrmgr_attribute_t pwrmgr_attribute;
    */
   extern void osal_pwrmgr_powerconserve( void );
 
+#if OSAL_PWRMGR_STATS
+  /*
+   * Copy the sleep residency counters, with the time since the last
+   * sleep added to the awake time.
+   */
+  extern void osal_pwrmgr_stats( pwrmgr_stats_t *pStats );
+
+  /*
+   * Clear the sleep residency counters.
+   */
+  extern void osal_pwrmgr_stats_reset( void );
+#endif
+
 /*********************************************************************
 *********************************************************************/
 
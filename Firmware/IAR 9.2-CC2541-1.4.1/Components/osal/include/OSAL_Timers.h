@@ -60,6 +60,15 @@ extern "C"
  */
  #define OSAL_TIMERS_MAX_TIMEOUT 0x28f5c28e /* unit is ms*/
 
+/*
+ * Number of timer records preallocated for OSAL timers, including the
+ * ones started on behalf of callback timers. Records are only taken
+ * from the heap when the pool runs out.
+ */
+#if !defined ( OSAL_TIMERS_POOL_SIZE )
+  #define OSAL_TIMERS_POOL_SIZE 16
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -118,6 +127,11 @@ extern "C"
    */
   extern uint8 osal_timer_num_active( void );
 
+  /*
+   * Count timer record pool overflows
+   */
+  extern uint16 osal_timer_pool_overflow( void );
+
   /*
    * Set the hardware timer interrupts for sleep mode.
    * These functions should only be called in OSAL_PwrMgr.c
@@ -51,11 +51,27 @@ extern "C"
  */
 
 #include "hal_types.h"
+#include "hal_board.h"
   
 /*********************************************************************
  * CONSTANTS
  */
 
+/*
+ * Set to TRUE to count NV writes, compactions and page erases, so that
+ * the NV usage of an application can be measured over time.
+ */
+#if !defined ( OSAL_SNV_STATS )
+  #define OSAL_SNV_STATS  FALSE
+#endif
+
+/*
+ * Returned by osal_snv_compact() when a compaction was started on the
+ * registered event, or was already running, but the page is not yet
+ * reclaimed.
+ */
+#define NV_OPER_PENDING   0x0D
+
 /*********************************************************************
  * MACROS
  */
@@ -72,6 +88,17 @@ extern "C"
   typedef uint8 osalSnvLen_t;
 #endif
 
+#if OSAL_SNV_STATS
+typedef struct
+{
+  uint32 writes;          // Items written to flash
+  uint32 unchanged;       // Writes skipped because the value was unchanged
+  uint16 compactions;     // Compactions started
+  uint16 blocking;        // Compactions run to completion by the caller
+  uint16 erases[HAL_NV_PAGE_CNT]; // Erases of each NV page, from HAL_NV_PAGE_BEG
+} osalSnvStats_t;
+#endif
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -126,11 +153,48 @@ extern uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf);
  * @param   threshold - compaction threshold
  *
  * @return  SUCCESS if successful,
+ *          NV_OPER_PENDING if left to osal_snv_compact_step(),
  *          NV_OPER_FAILED if failed, or
  *          INVALIDPARAMETER if threshold invalid.
  */
 extern uint8 osal_snv_compact( uint8 threshold );
 
+/*********************************************************************
+ * @fn      osal_snv_compact_register
+ *
+ * @brief   Register the OSAL task event that drives incremental compaction.
+ *
+ * @param   taskId - OSAL task ID.
+ * @param   event  - OSAL event, 0 to compact synchronously.
+ *
+ * @return  none
+ */
+extern void osal_snv_compact_register( uint8 taskId, uint16 event );
+
+/*********************************************************************
+ * @fn      osal_snv_compact_step
+ *
+ * @brief   Run one bounded step of the compaction in progress.
+ *
+ * @param   none
+ *
+ * @return  TRUE if the compaction needs more steps, FALSE otherwise.
+ */
+extern uint8 osal_snv_compact_step( void );
+
+#if OSAL_SNV_STATS
+/*********************************************************************
+ * @fn      osal_snv_stats
+ *
+ * @brief   Get the NV usage counters since power up.
+ *
+ * @param   none
+ *
+ * @return  pointer to the counters
+ */
+extern osalSnvStats_t *osal_snv_stats( void );
+#endif
+
 /*********************************************************************
 *********************************************************************/
 
@@ -0,0 +1,91 @@
+/**************************************************************************************************
+  Filename:       osal_trace.h
+
+  Description:    This file contains the interface to the OSAL event trace, a
+                  ring buffer of small time stamped records of what the tasks,
+                  timers and drivers did.
+**************************************************************************************************/
+
+#ifndef OSAL_TRACE_H
+#define OSAL_TRACE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "comdef.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+/*
+ * Set to TRUE to record trace events with OSAL_TRACE_REC(). No bridge
+ * configuration sets it: the cost of a record on the target has not been
+ * measured, so it is not yet known to be cheap enough for field builds.
+ */
+#if !defined ( OSAL_TRACE )
+  #define OSAL_TRACE  FALSE
+#endif
+
+// Number of records kept, must be a power of 2 of at most 128. When the
+// buffer is full the oldest record is overwritten.
+#if !defined ( OSAL_TRACE_SIZE )
+  #define OSAL_TRACE_SIZE  32
+#endif
+
+// Size of a record as returned by osal_trace_copy():
+// tag, arg, data (LSB first), sleep timer ticks (24 bits, LSB first)
+#define OSAL_TRACE_REC_LEN             7
+
+// Record tags                                   arg          data
+#define OSAL_TRACE_TASK_BEGIN          0x01   // task id      events
+#define OSAL_TRACE_TASK_END            0x02   // task id      events handed back
+#define OSAL_TRACE_TIMER               0x03   // task id      event
+#define OSAL_TRACE_UART_RX             0x04   // port         bytes received
+#define OSAL_TRACE_NOTIFY              0x05   // status       bytes notified
+
+// First tag free for the application
+#define OSAL_TRACE_USER                0x80
+
+/*********************************************************************
+ * MACROS
+ */
+#if OSAL_TRACE
+  #define OSAL_TRACE_REC( tag, arg, data )  osal_trace( (tag), (arg), (data) )
+#else
+  #define OSAL_TRACE_REC( tag, arg, data )
+#endif
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+#if OSAL_TRACE
+/*
+ * Add a record to the trace.
+ */
+extern void osal_trace( uint8 tag, uint8 arg, uint16 data );
+
+/*
+ * Copy the oldest records of the trace.
+ */
+extern uint8 osal_trace_copy( uint8 *buf, uint8 maxRecs, uint16 *pLost );
+
+/*
+ * Remove the oldest records of the trace.
+ */
+extern void osal_trace_drop( uint8 numRecs, uint16 lost );
+#endif
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OSAL_TRACE_H */
@@ -105,6 +105,23 @@
 #define OSAL_NV_MIN_COMPACT_THRESHOLD   70 // Minimum compaction threshold
 #define OSAL_NV_MAX_COMPACT_THRESHOLD   95 // Maximum compaction threshold
 
+// Number of item IDs whose latest offset in the active page is kept in RAM.
+// Items beyond this count are still found by searching the active page.
+#if !defined OSAL_NV_INDEX_SIZE
+#define OSAL_NV_INDEX_SIZE              32
+#endif
+
+// Number of item headers walked by each step of an incremental compaction.
+#if !defined OSAL_NV_COMPACT_STEP_ITEMS
+#define OSAL_NV_COMPACT_STEP_ITEMS      4
+#endif
+
+// Active page usage (in percent) at which a write starts an incremental
+// compaction, when a compaction event has been registered.
+#if !defined OSAL_NV_COMPACT_START_THRESHOLD
+#define OSAL_NV_COMPACT_START_THRESHOLD 80
+#endif
+
 /*********************************************************************
  * MACROS
  */
@@ -119,6 +136,13 @@
 # define  OSAL_NV_CHECK_BUS_VOLTAGE TRUE
 #endif
 
+// Macro to count an NV usage statistic
+#if OSAL_SNV_STATS
+# define  OSAL_NV_STATS_INC(field)  (nvStats.field++)
+#else
+# define  OSAL_NV_STATS_INC(field)
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -131,6 +155,13 @@ typedef struct
 } osalNvItemHdr_t;
 // Note that osalSnvId_t and osalSnvLen_t cannot be bigger than uint16
 
+// RAM index entry of an NV item
+typedef struct
+{
+  osalSnvId_t id;
+  uint16 offset;    // Offset of the latest item data in the active page
+} osalNvIndex_t;
+
 /*********************************************************************
  * EXTERNAL FUNCTIONS
  */
@@ -170,6 +201,50 @@ static uint16 pgOff;
 // another write or erase.
 static uint8 failF;
 
+// RAM index of the items in the active page
+static osalNvIndex_t nvIndex[OSAL_NV_INDEX_SIZE];
+
+// number of entries used in the RAM index
+static uint8 nvIndexCnt;
+
+// flag to indicate that the active page holds items that did not fit in
+// the RAM index, so an item missing from the index must still be searched for.
+static uint8 nvIndexFull;
+
+// page that an incremental compaction is copying items to,
+// OSAL_NV_PAGE_NULL when no compaction is in progress
+static uint8 xferDstPg;
+
+// page left to be erased by the last step of a compaction
+static uint8 eraseNvPg;
+
+// A compaction copies the latest value of every item of the active page
+// region [xferSrcBeg, xferSrcEnd) that is not already in the transfer page
+// region [xferDstBeg, xferDstOff). Items written to the active page while
+// compacting are copied by a further pass over the region they were written to.
+static uint16 xferSrcBeg;
+static uint16 xferSrcEnd;
+static uint16 xferSrcOff;   // header offset of the next item to copy
+static uint16 xferDstBeg;
+static uint16 xferDstOff;   // offset where the next item is copied to
+
+// lastId is used to speed up compacting in case the same item ID
+// items were neighboring each other contiguously.
+static osalSnvId_t xferLastId;
+
+// active page offset after the last compaction
+static uint16 compactOff;
+
+// task and event that drive incremental compaction, 0 event when compacting
+// synchronously
+static uint8 compactTaskId;
+static uint16 compactEvent;
+
+#if OSAL_SNV_STATS
+// NV usage counters
+static osalSnvStats_t nvStats;
+#endif
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -182,6 +257,14 @@ static void   erasePage( uint8 pg );
 static void   cleanErasedPage( uint8 pg );
 static void   findOffset( void );
 static void   compactPage( uint8 pg );
+static void   compactBegin( uint8 srcPg );
+static uint8  compactStep( uint8 cnt );
+static void   compactStart( void );
+
+static osalNvIndex_t *indexFind( osalSnvId_t id );
+static void   indexSet( osalSnvId_t id, uint16 offset );
+static void   indexBuild( void );
+static uint16 lookupItem( osalSnvId_t id );
 
 static void   writeWord( uint8 pg, uint16 offset, uint8 *pBuf );
 static void   writeWordM( uint8 pg, uint16 offset, uint8 *pBuf, osalSnvLen_t cnt );
@@ -209,6 +292,9 @@ static uint8 initNV( void )
 
   failF = FALSE;
   activePg = OSAL_NV_PAGE_NULL;
+  xferDstPg = OSAL_NV_PAGE_NULL;
+  eraseNvPg = OSAL_NV_PAGE_NULL;
+  compactOff = OSAL_NV_PAGE_HDR_SIZE;
 
   // Pick active page and clean up erased page if necessary
   for ( pg = OSAL_NV_PAGE_BEG; pg <= OSAL_NV_PAGE_END; pg++ )
@@ -322,6 +408,14 @@ static void setXferPage(void)
 {
   uint32 pgHdr;
 
+  if (eraseNvPg != OSAL_NV_PAGE_NULL)
+  {
+    // The page left over by the last compaction is still in xfer state.
+    // Erase it first so that only one page is ever in xfer state.
+    erasePage(eraseNvPg);
+    eraseNvPg = OSAL_NV_PAGE_NULL;
+  }
+
   // erase difference bit between active state and xfer state
   pgHdr = OSAL_NV_XFER_PAGE_STATE;
 
@@ -346,6 +440,7 @@ static void erasePage( uint8 pg )
   }
 
   HalFlashErase(pg);
+  OSAL_NV_STATS_INC(erases[pg - OSAL_NV_PAGE_BEG]);
 
   {
     // Verify the erase operation
@@ -427,15 +522,17 @@ static void findOffset(void)
  *                     search up.
  *                     Usually this paramter is set to the empty space
  *                     offset.
+ * @param   begOff   - offset in the NV page where to stop searching.
+ *                     Usually this parameter is set to the page header size.
  * @param   id       - NV item ID to search for
  *
  * @return  offset of the item, 0 when not found
  */
-static uint16 findItem(uint8 pg, uint16 offset, osalSnvId_t id)
+static uint16 findItem(uint8 pg, uint16 offset, uint16 begOff, osalSnvId_t id)
 {
   offset -= OSAL_NV_WORD_SIZE;
 
-  while (offset >= OSAL_NV_PAGE_HDR_SIZE)
+  while (offset >= begOff)
   {
     osalNvItemHdr_t hdr;
 
@@ -473,6 +570,128 @@ static uint16 findItem(uint8 pg, uint16 offset, osalSnvId_t id)
   return 0;
 }
 
+/*********************************************************************
+ * @fn      indexFind
+ *
+ * @brief   find the RAM index entry of an item
+ *
+ * @param   id - NV item ID to search for
+ *
+ * @return  pointer to the index entry, NULL when not indexed
+ */
+static osalNvIndex_t *indexFind( osalSnvId_t id )
+{
+  uint8 i;
+
+  for (i = 0; i < nvIndexCnt; i++)
+  {
+    if (nvIndex[i].id == id)
+    {
+      return &nvIndex[i];
+    }
+  }
+  return NULL;
+}
+
+/*********************************************************************
+ * @fn      indexSet
+ *
+ * @brief   record the latest offset of an item in the RAM index
+ *
+ * @param   id     - NV item ID
+ * @param   offset - offset of the item data in the active page
+ *
+ * @return  none
+ */
+static void indexSet( osalSnvId_t id, uint16 offset )
+{
+  osalNvIndex_t *pEntry = indexFind(id);
+
+  if (pEntry == NULL)
+  {
+    if (nvIndexCnt == OSAL_NV_INDEX_SIZE)
+    {
+      // No room left. The item has to be searched for in the active page.
+      nvIndexFull = TRUE;
+      return;
+    }
+    pEntry = &nvIndex[nvIndexCnt++];
+    pEntry->id = id;
+  }
+  pEntry->offset = offset;
+}
+
+/*********************************************************************
+ * @fn      indexBuild
+ *
+ * @brief   build the RAM index from the items in the active page
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void indexBuild( void )
+{
+  uint16 offset = pgOff - OSAL_NV_WORD_SIZE;
+
+  nvIndexCnt = 0;
+  nvIndexFull = FALSE;
+
+  // Walk from the latest item back so that the first one found of each ID
+  // is its latest value.
+  while (offset >= OSAL_NV_PAGE_HDR_SIZE)
+  {
+    osalNvItemHdr_t hdr;
+
+    HalFlashRead(activePg, offset, (uint8 *) &hdr, OSAL_NV_WORD_SIZE);
+
+    if (!(hdr.id & OSAL_NV_INVALID_ID_MARK) && (indexFind((osalSnvId_t) hdr.id) == NULL))
+    {
+      indexSet((osalSnvId_t) hdr.id, offset - (hdr.len & ~OSAL_NV_INVALID_LEN_MARK));
+    }
+
+    if (hdr.len & OSAL_NV_INVALID_LEN_MARK)
+    {
+      offset -= OSAL_NV_WORD_SIZE;
+    }
+    else if (hdr.len + OSAL_NV_WORD_SIZE <= offset)
+    {
+      offset -= hdr.len + OSAL_NV_WORD_SIZE;
+    }
+    else
+    {
+      // active page is corrupt. Leave the rest of it to findItem.
+      nvIndexFull = TRUE;
+      break;
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      lookupItem
+ *
+ * @brief   find the latest value of an item in the active page,
+ *          using the RAM index when possible
+ *
+ * @param   id - NV item ID to search for
+ *
+ * @return  offset of the item, 0 when not found
+ */
+static uint16 lookupItem( osalSnvId_t id )
+{
+  osalNvIndex_t *pEntry = indexFind(id);
+
+  if (pEntry != NULL)
+  {
+    return pEntry->offset;
+  }
+  else if (nvIndexFull)
+  {
+    return findItem(activePg, pgOff, OSAL_NV_PAGE_HDR_SIZE, id);
+  }
+  return 0;
+}
+
 /*********************************************************************
  * @fn      writeItem
  *
@@ -556,41 +775,89 @@ static void xferItem( uint8 pg, uint16 offset, uint16 alignedLen, uint16 srcOff
  */
 static void compactPage( uint8 srcPg )
 {
-  uint16 srcOff, dstOff;
-  uint8 dstPg;
-  osalSnvId_t lastId = (osalSnvId_t) 0xFFFF;
+  OSAL_NV_STATS_INC(blocking);
+  compactBegin(srcPg);
 
-  dstPg = (srcPg == OSAL_NV_PAGE_BEG)? OSAL_NV_PAGE_END : OSAL_NV_PAGE_BEG;
+  while (compactStep(0xFF))
+  {
+    // Run the compaction to completion.
+  }
+}
 
-  dstOff = OSAL_NV_PAGE_HDR_SIZE;
+/*********************************************************************
+ * @fn      compactBegin
+ *
+ * @brief   Sets up the compaction of the page specified, to be run by
+ *          compactStep.
+ *
+ * @param   srcPg - Valid NV page to compact from, in xfer state.
+ *
+ * @return  none.
+ */
+static void compactBegin( uint8 srcPg )
+{
+  OSAL_NV_STATS_INC(compactions);
+
+  xferDstPg = (srcPg == OSAL_NV_PAGE_BEG)? OSAL_NV_PAGE_END : OSAL_NV_PAGE_BEG;
+
+  xferDstBeg = xferDstOff = OSAL_NV_PAGE_HDR_SIZE;
+  xferSrcBeg = OSAL_NV_PAGE_HDR_SIZE;
+  xferSrcEnd = pgOff;
+  xferLastId = (osalSnvId_t) 0xFFFF;
 
   // Read from the latest value
-  srcOff = pgOff - sizeof(osalNvItemHdr_t);
+  xferSrcOff = pgOff - sizeof(osalNvItemHdr_t);
+}
 
-  while (srcOff >= OSAL_NV_PAGE_HDR_SIZE)
+/*********************************************************************
+ * @fn      compactStep
+ *
+ * @brief   Runs one bounded step of the compaction set up by compactBegin.
+ *          The step copies items, or activates the transfer page once all
+ *          items are copied, or erases the old active page.
+ *
+ * @param   cnt - maximum number of item headers to walk in this step
+ *
+ * @return  TRUE if the compaction needs more steps, FALSE otherwise.
+ */
+static uint8 compactStep( uint8 cnt )
+{
+  if (xferDstPg == OSAL_NV_PAGE_NULL)
+  {
+    if (eraseNvPg != OSAL_NV_PAGE_NULL)
+    {
+      // Erase the previously active page
+      erasePage(eraseNvPg);
+      eraseNvPg = OSAL_NV_PAGE_NULL;
+    }
+    return FALSE;
+  }
+
+  while (cnt-- && (xferSrcOff >= xferSrcBeg))
   {
     osalNvItemHdr_t hdr;
 
     if (failF)
     {
       // Failure during transfer item will make next findItem error prone.
-      return;
+      xferDstPg = OSAL_NV_PAGE_NULL;
+      return FALSE;
     }
 
-    HalFlashRead(srcPg, srcOff, (uint8 *) &hdr, OSAL_NV_WORD_SIZE);
+    HalFlashRead(activePg, xferSrcOff, (uint8 *) &hdr, OSAL_NV_WORD_SIZE);
 
     if (hdr.id == 0xFFFF)
     {
       // Invalid entry. Skip this one.
       if (hdr.len & OSAL_NV_INVALID_LEN_MARK)
       {
-        srcOff -= OSAL_NV_WORD_SIZE;
+        xferSrcOff -= OSAL_NV_WORD_SIZE;
       }
       else
       {
-        if (hdr.len + OSAL_NV_WORD_SIZE <= srcOff)
+        if (hdr.len + OSAL_NV_WORD_SIZE <= xferSrcOff)
         {
-          srcOff -= hdr.len + OSAL_NV_WORD_SIZE;
+          xferSrcOff -= hdr.len + OSAL_NV_WORD_SIZE;
         }
         else
         {
@@ -606,10 +873,11 @@ static void compactPage( uint8 srcPg )
           // (with all entries removed).
           // However, it might be still better not to attempt erasing the page
           // just to see if this very rare case actually happened.
-          //erasePage(srcPg);
+          //erasePage(activePg);
 
           HAL_ASSERT_FORCED();
-          return;
+          xferDstPg = OSAL_NV_PAGE_NULL;
+          return FALSE;
         }
       }
 
@@ -617,38 +885,78 @@ static void compactPage( uint8 srcPg )
     }
 
     // Consider only valid item
-    if (!(hdr.id & OSAL_NV_INVALID_ID_MARK) && hdr.id != lastId)
+    if (!(hdr.id & OSAL_NV_INVALID_ID_MARK) && hdr.id != xferLastId)
     {
-      // lastId is used to speed up compacting in case the same item ID
-      // items were neighboring each other contiguously.
-      lastId = (osalSnvId_t) hdr.id;
+      xferLastId = (osalSnvId_t) hdr.id;
 
       // Check if the latest value of the item was already written
-      if (findItem(dstPg, dstOff, lastId) == 0)
+      if (findItem(xferDstPg, xferDstOff, xferDstBeg, xferLastId) == 0)
       {
         // This item was not copied over yet.
         // This must be the latest value.
         // Write the latest value to the destination page
 
-        xferItem(dstPg, dstOff, hdr.len, srcOff - hdr.len);
+        xferItem(xferDstPg, xferDstOff, hdr.len, xferSrcOff - hdr.len);
 
-        dstOff += hdr.len + OSAL_NV_WORD_SIZE;
+        xferDstOff += hdr.len + OSAL_NV_WORD_SIZE;
       }
     }
-    srcOff -= hdr.len + OSAL_NV_WORD_SIZE;
+    xferSrcOff -= hdr.len + OSAL_NV_WORD_SIZE;
+  }
+
+  if (xferSrcOff >= xferSrcBeg)
+  {
+    // More items to copy in this pass
+    return TRUE;
+  }
+
+  if (pgOff != xferSrcEnd)
+  {
+    // Items were written while compacting. Copy them over in another pass,
+    // after the items copied so far so that they supersede them.
+    xferSrcBeg = xferSrcEnd;
+    xferSrcEnd = pgOff;
+    xferSrcOff = pgOff - sizeof(osalNvItemHdr_t);
+    xferDstBeg = xferDstOff;
+    xferLastId = (osalSnvId_t) 0xFFFF;
+    return TRUE;
   }
 
   // All items copied.
   // Activate the new page
-  setActivePage(dstPg);
+  eraseNvPg = activePg;
+  setActivePage(xferDstPg);
+  xferDstPg = OSAL_NV_PAGE_NULL;
 
   if (!failF)
   {
-    pgOff = dstOff; // update active page offset
+    pgOff = xferDstOff; // update active page offset
   }
+  compactOff = pgOff;
+
+  // Item offsets have all moved to the new page
+  indexBuild();
+
+  // The currently active page is erased by the next step
+  return TRUE;
+}
+
+/*********************************************************************
+ * @fn      compactStart
+ *
+ * @brief   Starts an incremental compaction of the active page, to be
+ *          run step by step on the registered compaction event.
+ *
+ * @param   none
+ *
+ * @return  none.
+ */
+static void compactStart( void )
+{
+  setXferPage();
+  compactBegin(activePg);
 
-  // Erase the currently active page
-  erasePage(srcPg);
+  osal_set_event(compactTaskId, compactEvent);
 }
 
 /*********************************************************************
@@ -744,6 +1052,8 @@ uint8 osal_snv_init( void )
     return FAILURE;
   }
 
+  indexBuild();
+
   return SUCCESS;
 }
 
@@ -763,7 +1073,7 @@ uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
   uint16 alignedLen;
 
   {
-    uint16 offset = findItem(activePg, pgOff, id);
+    uint16 offset = lookupItem(id);
 
     if (offset > 0)
     {
@@ -784,6 +1094,7 @@ uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
       {
         // Changed value is the same value as before.
         // Return here instead of re-writing the same value to NV.
+        OSAL_NV_STATS_INC(unchanged);
         return SUCCESS;
       }
     }
@@ -793,8 +1104,20 @@ uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
 
   if ( pgOff + alignedLen + OSAL_NV_WORD_SIZE > OSAL_NV_PAGE_SIZE )
   {
-    setXferPage();
-    compactPage(activePg);
+    // Complete any compaction in progress, which may free up enough space.
+    if (xferDstPg != OSAL_NV_PAGE_NULL)
+    {
+      OSAL_NV_STATS_INC(blocking);
+    }
+    while (compactStep(0xFF))
+    {
+    }
+
+    if ( pgOff + alignedLen + OSAL_NV_WORD_SIZE > OSAL_NV_PAGE_SIZE )
+    {
+      setXferPage();
+      compactPage(activePg);
+    }
   }
 
   // pBuf shall be referenced beyond its valid length to save code size.
@@ -804,8 +1127,19 @@ uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
     return NV_OPER_FAILED;
   }
 
+  OSAL_NV_STATS_INC(writes);
+  indexSet(id, pgOff);
   pgOff += alignedLen + OSAL_NV_WORD_SIZE;
 
+  // Start compacting ahead of running out of space, provided that enough was
+  // written since the last compaction for it to be worth a page erase.
+  if ( compactEvent && (xferDstPg == OSAL_NV_PAGE_NULL) &&
+       ( ( (uint32)pgOff * 100 ) >= ( OSAL_NV_PAGE_SIZE * (uint32)OSAL_NV_COMPACT_START_THRESHOLD ) ) &&
+       ( (pgOff - compactOff) >= (OSAL_NV_PAGE_SIZE / 4) ) )
+  {
+    compactStart();
+  }
+
   return SUCCESS;
 }
 
@@ -823,7 +1157,7 @@ uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
  */
 uint8 osal_snv_read( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
 {
-  uint16 offset = findItem(activePg, pgOff, id);
+  uint16 offset = lookupItem(id);
 
   if (offset != 0)
   {
@@ -837,10 +1171,14 @@ uint8 osal_snv_read( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
  * @fn      osal_snv_compact
  *
  * @brief   Compacts NV if its usage has reached a specific threshold.
+ *          With a compaction event registered, the compaction is only
+ *          started; the page is reclaimed once osal_snv_compact_step()
+ *          returns FALSE.
  *
  * @param   threshold - compaction threshold
  *
  * @return  SUCCESS if successful,
+ *          NV_OPER_PENDING if left to osal_snv_compact_step(),
  *          NV_OPER_FAILED if failed, or
  *          INVALIDPARAMETER if threshold invalid.
  */
@@ -852,17 +1190,81 @@ uint8 osal_snv_compact( uint8 threshold )
     return INVALIDPARAMETER;
   }
 
+  if (xferDstPg != OSAL_NV_PAGE_NULL)
+  {
+    // Compaction already in progress
+    return NV_OPER_PENDING;
+  }
+
   // See if NV active page usage has reached compaction threshold
   if ( ( (uint32)pgOff * 100 ) >= ( OSAL_NV_PAGE_SIZE * (uint32)threshold ) )
   {
+    if (compactEvent)
+    {
+      compactStart();
+      return NV_OPER_PENDING;
+    }
+
     setXferPage();
     compactPage(activePg);
-
     return SUCCESS;
   }
 
   return NV_OPER_FAILED;
 }
 
+/*********************************************************************
+ * @fn      osal_snv_compact_register
+ *
+ * @brief   Registers the OSAL task event that drives incremental
+ *          compaction. Once registered, compaction no longer blocks the
+ *          caller of osal_snv_compact or osal_snv_write (unless the active
+ *          page is out of space) and the event is set whenever a compaction
+ *          starts. The task must then call osal_snv_compact_step on the
+ *          event until it returns FALSE.
+ *
+ * @param   taskId - OSAL task ID
+ * @param   event  - OSAL event, 0 to compact synchronously
+ *
+ * @return  none
+ */
+void osal_snv_compact_register( uint8 taskId, uint16 event )
+{
+  compactTaskId = taskId;
+  compactEvent = event;
+}
+
+/*********************************************************************
+ * @fn      osal_snv_compact_step
+ *
+ * @brief   Runs one bounded step of the compaction in progress. Each step
+ *          copies a few items, activates the compacted page or erases the
+ *          old page, so it is best called right after a connection event.
+ *
+ * @param   none
+ *
+ * @return  TRUE if the compaction needs more steps, FALSE otherwise.
+ */
+uint8 osal_snv_compact_step( void )
+{
+  return compactStep(OSAL_NV_COMPACT_STEP_ITEMS);
+}
+
+#if OSAL_SNV_STATS
+/*********************************************************************
+ * @fn      osal_snv_stats
+ *
+ * @brief   Get the NV usage counters since power up.
+ *
+ * @param   none
+ *
+ * @return  pointer to the counters
+ */
+osalSnvStats_t *osal_snv_stats( void )
+{
+  return &nvStats;
+}
+#endif
+
 /*********************************************************************
 *********************************************************************/
@@ -46,6 +46,8 @@
 #include "OSAL_PwrMgr.h"
 
 #include "OnBoard.h"
+#include "osal_snv.h"
+#include "osal_trace.h"
 #include "hal_adc.h"
 #include "hal_uart.h"
 #include "gatt.h"
@@ -55,7 +57,7 @@
 #include "gapgattserver.h"
 #include "gattservapp.h"
 #include "devinfoservice.h"
-#include "simpleGATTprofile.h"
+#include "simpleGATTprofile_Bridge.h"
 
 #include "peripheral.h"
 
@@ -66,6 +68,8 @@
 #include "serialInterface.h"
 #include "FrameParser.h"
 #include "PWM_Control.h"
+#include "cmdAuth.h"
+#include "blackBox.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -78,9 +82,16 @@
  * CONSTANTS
  */
 
-// How often to perform periodic event
+// How often to poll the serial buffer for data to send while connected
 #define SBP_SEND_EVT_PERIOD                       7
 
+// How often the supply voltage is measured while connected, ms
+#define SBP_BATT_EVT_PERIOD                       1000
+
+// Change in the supply voltage that goes into the black box, mV; 10-bit
+// readings step by about 7 mV
+#define SBP_BATT_DELTA                            50
+
 // What is the advertising interval when device is discoverable (units of 625us, 160=100ms)
 #define DEFAULT_ADVERTISING_INTERVAL          160
 
@@ -152,6 +163,15 @@ static bool connected_state = FALSE;  //whether to try to send data or not from
 
 static uint16 buffer_tail = 0;  //last data byte sent from SerialBuffer
 
+// NV compaction in progress, and whether it is stepped after connection events
+static uint8 snvCompacting = FALSE;
+static uint8 connEventNotice = FALSE;
+
+#if BLACKBOX
+// Whether the next step after a connection event is the black box's
+static uint8 blackBoxTurn = FALSE;
+#endif
+
 // GAP - SCAN RSP data (max size = 31 bytes)
 uint8 scanRspData[31] =
 {
@@ -219,6 +239,15 @@ static void BLE_Bridge_ProcessOSALMsg( osal_event_hdr_t *pMsg );
 static void peripheralStateNotificationCB( gaprole_States_t newState );
 static uint8 sendData(uint16 diff);
 static void simpleProfileChangeCB( uint8 paramID );
+static uint8 simpleProfileDiagReadCB( uint8 *pValue, uint8 maxLen );
+static void connEventNoticeUpdate( void );
+#if CMD_AUTH
+static void simpleProfileCmdAuthCounter( void );
+#endif
+#if BLACKBOX
+static void blackBoxDuty( void );
+static void blackBoxBatt( void );
+#endif
 
 /*********************************************************************
  * PROFILE CALLBACKS
@@ -328,12 +357,27 @@ void BLE_Bridge_Init( uint8 task_id )
     SimpleProfile_SetParameter( SIMPLEPROFILE_CHAR5, SIMPLEPROFILE_CHAR5_LEN, charValue5 );
   }
 
+#if CMD_AUTH
+  // Motor commands are sealed; let clients read the counter to go on from
+  CmdAuth_Init();
+  simpleProfileCmdAuthCounter();
+#endif
+
   // Register callback with SimpleGATTprofile
   VOID SimpleProfile_RegisterAppCBs( &simpleBLEPeripheral_SimpleProfileCBs );
+  SimpleProfile_RegisterDiagCB( simpleProfileDiagReadCB );
 
   //disable halt during RF (needed for UART / SPI)
   HCI_EXT_HaltDuringRfCmd(HCI_EXT_HALT_DURING_RF_DISABLE);
 
+  // Compact NV in steps on our task instead of stalling the caller
+  osal_snv_compact_register( BLE_Bridge_TaskID, SBP_SNV_COMPACT_EVT );
+
+#if BLACKBOX
+  // Keep the last commands, duties, supply voltage and link events in flash
+  BlackBox_Init( BLE_Bridge_TaskID, SBP_BLACKBOX_EVT );
+#endif
+
   // Setup a delayed profile startup
   osal_set_event( BLE_Bridge_TaskID, SBP_START_DEVICE_EVT );
 }
@@ -374,19 +418,11 @@ uint16 BLE_Bridge_ProcessEvent( uint8 task_id, uint16 events )
 
   if ( events & SBP_START_DEVICE_EVT )
   {
-        // Start Information
-        uint8 start[5];
-
         // Start the Device
         VOID GAPRole_StartDevice( &BLE_Bridge_PeripheralCBs );
 
-        // Start timer for polling to see if there is data to send from SerialBuffer
-        osal_start_timerEx( BLE_Bridge_TaskID, SBP_SEND_EVT, SBP_SEND_EVT_PERIOD );
-
-        if(NULL != FramePack((uint8*) start, CMD_ACK_DEVICE_RESET, NULL, 0))
-        {
-            HalUARTWrite(NPI_UART_PORT, (uint8*)start, 5);
-        }
+        // Start Information
+        SerialInterface_TxFrame(CMD_ACK_DEVICE_RESET, NULL, 0);
 
         /*
         // Init Motor
@@ -402,8 +438,9 @@ uint16 BLE_Bridge_ProcessEvent( uint8 task_id, uint16 events )
 
   if ( events & SBP_SEND_EVT )
   {
-    // Restart timer
-    if ( SBP_SEND_EVT_PERIOD )
+    // Restart timer, only while connected so that the device can sleep
+    // between advertising events
+    if ( SBP_SEND_EVT_PERIOD && (connected_flag == TRUE) )
     {
       osal_start_timerEx( BLE_Bridge_TaskID, SBP_SEND_EVT, SBP_SEND_EVT_PERIOD );
     }
@@ -432,6 +469,73 @@ uint16 BLE_Bridge_ProcessEvent( uint8 task_id, uint16 events )
     return (events ^ SBP_SEND_EVT);
   }
 
+  if ( events & SBP_SNV_COMPACT_EVT )
+  {
+    // Set when a compaction starts and, while connected with a compaction
+    // or black box writes pending, at the end of every connection event,
+    // which leaves the most time for a step before the next one.
+#if BLACKBOX
+    // Either step may erase a page, which halts the CPU for 20 ms, so a
+    // gap gets one of them and they take turns
+    if ( (connected_state == TRUE) && blackBoxTurn && BlackBox_Pending() )
+    {
+      BlackBox_Step();
+      blackBoxTurn = FALSE;
+
+      // The event may as well have been a compaction starting; it has
+      // the next gap
+      snvCompacting = TRUE;
+    }
+    else
+#endif
+    {
+      snvCompacting = osal_snv_compact_step();
+#if BLACKBOX
+      blackBoxTurn = TRUE;
+#endif
+
+      if ( snvCompacting && (connected_state != TRUE) )
+      {
+        osal_set_event( BLE_Bridge_TaskID, SBP_SNV_COMPACT_EVT );
+      }
+    }
+
+    connEventNoticeUpdate();
+
+    return (events ^ SBP_SNV_COMPACT_EVT);
+  }
+
+#if BLACKBOX
+  if ( events & SBP_BLACKBOX_EVT )
+  {
+    if ( connected_state == TRUE )
+    {
+      // Write the black box log after the connection events
+      connEventNoticeUpdate();
+    }
+    else
+    {
+      // Not connected, write it on its own timer
+      BlackBox_Step();
+    }
+
+    return (events ^ SBP_BLACKBOX_EVT);
+  }
+
+  if ( events & SBP_BATT_EVT )
+  {
+    // Measured only while connected, so that the device sleeps otherwise
+    if ( connected_state == TRUE )
+    {
+      osal_start_timerEx( BLE_Bridge_TaskID, SBP_BATT_EVT, SBP_BATT_EVT_PERIOD );
+    }
+
+    blackBoxBatt();
+
+    return (events ^ SBP_BATT_EVT);
+  }
+#endif
+
   if(events & SBP_MOTOR_EVT);
   {
       static int index = 0;
@@ -443,6 +547,9 @@ uint16 BLE_Bridge_ProcessEvent( uint8 task_id, uint16 events )
         M_PWM_SET_DUTY(2, 0);
         M_PWM_SET_DUTY(3, 0);
         M_PWM_SET_DUTY(4, 0);
+#if BLACKBOX
+        blackBoxDuty();
+#endif
       }
 
       //osal_start_timerEx( BLE_Bridge_TaskID, SBP_MOTOR_EVT, 1000 );
@@ -454,6 +561,21 @@ uint16 BLE_Bridge_ProcessEvent( uint8 task_id, uint16 events )
   return 0;
 }
 
+/*********************************************************************
+ * @fn      BLE_Bridge_KickSend
+ *
+ * @brief   Run the serial buffer poll now, to answer a request from
+ *          the host also while not connected.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void BLE_Bridge_KickSend( void )
+{
+  osal_set_event( BLE_Bridge_TaskID, SBP_SEND_EVT );
+}
+
 /*********************************************************************
  * @fn      BLE_Bridge_ProcessOSALMsg
  *
@@ -494,6 +616,9 @@ static void peripheralStateNotificationCB( gaprole_States_t newState )
       {
         uint8 ownAddress[B_ADDR_LEN];
         GAPRole_GetParameter(GAPROLE_BD_ADDR, ownAddress);
+#if CMD_AUTH
+        CmdAuth_SetAddress(ownAddress);
+#endif
         uint8* mac = bdAddr2Str(ownAddress);
         //uint8* name_default = "FANDAO SLBM04";
         uint8* name_default =   "IOT--- SLBM05";
@@ -528,6 +653,9 @@ static void peripheralStateNotificationCB( gaprole_States_t newState )
     case GAPROLE_CONNECTED:
       {
         connected_flag = TRUE;
+
+        // Start polling the serial buffer for data to send
+        osal_start_timerEx( BLE_Bridge_TaskID, SBP_SEND_EVT, SBP_SEND_EVT_PERIOD );
       }
       break;
 
@@ -538,13 +666,39 @@ static void peripheralStateNotificationCB( gaprole_States_t newState )
 
   if(GAPROLE_CONNECTED == newState)
   {
+#if BLACKBOX
+      if ( connected_state != TRUE )
+      {
+        osal_set_event( BLE_Bridge_TaskID, SBP_BATT_EVT );
+      }
+#endif
+
       connected_state = TRUE;
   }
   else
   {
+#if BLACKBOX
+      osal_stop_timerEx( BLE_Bridge_TaskID, SBP_BATT_EVT );
+#endif
+
+      // A compaction stepped after connection events goes on right away
+      if ( (connected_state == TRUE) && snvCompacting )
+      {
+        osal_set_event( BLE_Bridge_TaskID, SBP_SNV_COMPACT_EVT );
+      }
+
       connected_state = FALSE;
   }
 
+  // Step a compaction in progress between connection events from now on,
+  // and no longer after a disconnect
+  connEventNoticeUpdate();
+
+#if BLACKBOX
+  BlackBox_Record(BLACKBOX_REC_LINK, &SystemState, 1);
+  BlackBox_SetConnected(connected_state);
+#endif
+
   osal_start_timerEx( BLE_Bridge_TaskID, SBP_MOTOR_EVT, 10 );
 }
 
@@ -616,7 +770,34 @@ static void simpleProfileChangeCB( uint8 paramID )
     case SIMPLEPROFILE_CHAR1:
         {
             SimpleProfile_GetParameter( SIMPLEPROFILE_CHAR1, data );
+#if CMD_AUTH
+            {
+                MotorCtl_t motor;
+                uint8 status = CmdAuth_Open(data, (uint8*)&motor);
+
+                if(SUCCESS == status)
+                {
+                    MotorContrlExe(&motor);
+#if BLACKBOX
+                    BlackBox_Record(BLACKBOX_REC_CMD, (uint8*)&motor, sizeof(MotorCtl_t));
+                    blackBoxDuty();
+#endif
+                }
+#if BLACKBOX
+                else
+                {
+                    BlackBox_Record(BLACKBOX_REC_REJECT, &status, 1);
+                }
+#endif
+                simpleProfileCmdAuthCounter();
+            }
+#else
             MotorContrlExe((MotorCtl_t*)data);
+#if BLACKBOX
+            BlackBox_Record(BLACKBOX_REC_CMD, data, sizeof(MotorCtl_t));
+            blackBoxDuty();
+#endif
+#endif
             // TODO
             // Send Data to PC
         }
@@ -625,6 +806,10 @@ static void simpleProfileChangeCB( uint8 paramID )
     case SIMPLEPROFILE_CHAR3:
       SimpleProfile_GetParameter( SIMPLEPROFILE_CHAR3, &data );
       len = data[0];
+      if ( len > sizeof( data ) - 1 )
+      {
+        len = sizeof( data ) - 1;
+      }
       //keep trying to send data until it is a success. this may not be the desirable approach
       sendDataToHost(&data[1], len);
       break;
@@ -635,6 +820,148 @@ static void simpleProfileChangeCB( uint8 paramID )
   }
 }
 
+/*********************************************************************
+ * @fn      simpleProfileDiagReadCB
+ *
+ * @brief   Callback from SimpleBLEProfile to fill in the diagnostics
+ *          characteristic, which reports the heap statistics.
+ *
+ * @param   pValue - buffer for the value
+ * @param   maxLen - size of the buffer
+ *
+ * @return  length of the value
+ */
+static uint8 simpleProfileDiagReadCB( uint8 *pValue, uint8 maxLen )
+{
+  return buildHeapStats( pValue, HEAP_STATS_PAGE_METRICS, maxLen );
+}
+
+#if CMD_AUTH
+/*********************************************************************
+ * @fn      simpleProfileCmdAuthCounter
+ *
+ * @brief   Replace the sealed command in SIMPLEPROFILE_CHAR1 by the lowest
+ *          counter the next command may have, so a client can read it.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void simpleProfileCmdAuthCounter( void )
+{
+  uint8 value[SIMPLEPROFILE_CHAR1_LEN];
+  uint32 cnt = CmdAuth_GetCounter();
+
+  osal_memset( value, 0, SIMPLEPROFILE_CHAR1_LEN );
+  value[0] = BREAK_UINT32( cnt, 0 );
+  value[1] = BREAK_UINT32( cnt, 1 );
+  value[2] = BREAK_UINT32( cnt, 2 );
+  value[3] = BREAK_UINT32( cnt, 3 );
+
+  SimpleProfile_SetParameter( SIMPLEPROFILE_CHAR1, SIMPLEPROFILE_CHAR1_LEN, value );
+}
+#endif
+
+/*********************************************************************
+ * @fn      connEventNoticeUpdate
+ *
+ * @brief   Have SBP_SNV_COMPACT_EVT set at the end of every connection
+ *          event while connected with an NV compaction in progress or
+ *          black box writes pending, and not otherwise.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void connEventNoticeUpdate( void )
+{
+  uint8 notice = snvCompacting;
+
+#if BLACKBOX
+  notice = notice || BlackBox_Pending();
+#endif
+  notice = notice && ( connected_state == TRUE );
+
+  if ( notice != connEventNotice )
+  {
+    HCI_EXT_ConnEventNoticeCmd( 0, BLE_Bridge_TaskID, notice ? SBP_SNV_COMPACT_EVT : 0 );
+    connEventNotice = notice;
+  }
+}
+
+#if BLACKBOX
+/*********************************************************************
+ * @fn      blackBoxDuty
+ *
+ * @brief   Record the PWM frequency and the duties if they changed since
+ *          they were last recorded.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void blackBoxDuty( void )
+{
+  static uint8 last[2 + 4 * 2];
+  uint8 duty[2 + 4 * 2];
+  uint16 dummy;
+  uint16 value;
+  uint8 ch;
+
+  value = PWM_GetFrequency();
+  duty[0] = LO_UINT16( value );
+  duty[1] = HI_UINT16( value );
+  for ( ch = 1; ch <= 4; ch++ )
+  {
+    value = PWM_GetPercent( ch, &dummy );
+    duty[ch * 2] = LO_UINT16( value );
+    duty[ch * 2 + 1] = HI_UINT16( value );
+  }
+
+  if ( osal_memcmp( duty, last, sizeof( duty ) ) == FALSE )
+  {
+    BlackBox_Record( BLACKBOX_REC_DUTY, duty, sizeof( duty ) );
+    osal_memcpy( last, duty, sizeof( duty ) );
+  }
+}
+
+/*********************************************************************
+ * @fn      blackBoxBatt
+ *
+ * @brief   Record the supply voltage, measured as VDD/3 against the
+ *          internal reference, if it moved by SBP_BATT_DELTA since it
+ *          was last recorded.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void blackBoxBatt( void )
+{
+  static uint16 last = 0;
+  uint16 adc;
+  uint16 mv;
+  uint8 batt[2];
+
+  HalAdcSetReference( HAL_ADC_REF_125V );
+  adc = HalAdcRead( HAL_ADC_CHN_VDD3, HAL_ADC_RESOLUTION_10 );
+  HalAdcSetReference( HAL_ADC_REF_AVDD );
+
+  // A reading of 409 is 3.0 V
+  mv = (uint16)( (uint32)adc * 3000 / 409 );
+  if ( ( mv < last + SBP_BATT_DELTA ) && ( mv + SBP_BATT_DELTA > last ) )
+  {
+    return;
+  }
+
+  batt[0] = LO_UINT16( mv );
+  batt[1] = HI_UINT16( mv );
+
+  BlackBox_Record( BLACKBOX_REC_BATT, batt, sizeof( batt ) );
+  last = mv;
+}
+#endif
+
 /*********************************************************************
  * @fn      sendData
  *
@@ -655,6 +982,7 @@ static uint8 sendData( uint16 diff )
   uint8 bytes_sent = 0;
 
   attHandleValueNoti_t noti;
+  bStatus_t status;
   uint16 len;
   //dummy handle
   noti.handle = 0x2E;
@@ -675,7 +1003,9 @@ static uint8 sendData( uint16 diff )
         noti.pValue[i] = serialBuffer[circular_add(buffer_tail , bytes_sent+i)];
       }
       //connection handle currently hardcoded
-      if (!(GATT_Notification(0, &noti, FALSE))) //if sucessful
+      status = GATT_Notification(0, &noti, FALSE);
+      OSAL_TRACE_REC(OSAL_TRACE_NOTIFY, status, noti.len);
+      if (SUCCESS == status) //if sucessful
       {
         bytes_sent += 20;
         diff -= 20;
@@ -701,7 +1031,9 @@ static uint8 sendData( uint16 diff )
       noti.pValue[i] = serialBuffer[circular_add(buffer_tail, bytes_sent + i)];
       }
         //connection handle currently hardcoded
-      if (!(GATT_Notification(0, &noti, FALSE))) //if sucessful
+      status = GATT_Notification(0, &noti, FALSE);
+      OSAL_TRACE_REC(OSAL_TRACE_NOTIFY, status, noti.len);
+      if (SUCCESS == status) //if sucessful
       {
         bytes_sent += i;
         diff -= i;//amount of data sent
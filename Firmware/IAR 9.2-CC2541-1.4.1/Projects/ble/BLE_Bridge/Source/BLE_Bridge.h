@@ -56,6 +56,9 @@ extern "C"
 #define SBP_ADV_IN_CONNECTION_EVT                         0x0004
 #define SBP_SEND_EVT                                      0x0008
 #define SBP_MOTOR_EVT                                     0x0010
+#define SBP_SNV_COMPACT_EVT                               0x0020
+#define SBP_BLACKBOX_EVT                                  0x0040
+#define SBP_BATT_EVT                                      0x0080
 
 /*********************************************************************
  * MACROS
@@ -91,6 +94,11 @@ extern void BLE_Bridge_Init( uint8 task_id );
  */
 extern uint16 BLE_Bridge_ProcessEvent( uint8 task_id, uint16 events );
 
+/*
+ * Poll the serial buffer now
+ */
+extern void BLE_Bridge_KickSend( void );
+
 /*********************************************************************
 *********************************************************************/
 
@@ -0,0 +1,649 @@
+/**************************************************************************************************
+  Filename:       blackBox.c
+
+  Description:    Black box recorder. Records are batched in RAM chunks and
+                  written a chunk at a time to a ring of flash pages. Writing
+                  is left to BlackBox_Step(), which the application calls
+                  right after a connection event, so that neither a flash write
+                  nor a page erase holds up the link or the motor commands.
+**************************************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "bcomdef.h"
+#include "OSAL.h"
+#include "hal_board.h"
+#include "hal_adc.h"
+#include "hal_flash.h"
+#include "hal_sleep.h"
+#include "blackBox.h"
+
+#if BLACKBOX
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+#if ( HAL_FLASH_PAGE_SIZE % BLACKBOX_CHUNK_SIZE ) != 0 || ( BLACKBOX_CHUNK_SIZE % HAL_FLASH_WORD_SIZE ) != 0
+#error BLACKBOX_CHUNK_SIZE must be a multiple of the flash word that divides the page
+#endif
+#if BLACKBOX_CHUNK_SIZE < BLACKBOX_REC_HDR_LEN + BLACKBOX_REC_MAX_LEN
+#error BLACKBOX_CHUNK_SIZE must hold the longest record
+#endif
+#if BLACKBOX_STEP_WORDS < BLACKBOX_CHUNK_SIZE / HAL_FLASH_WORD_SIZE
+#error BLACKBOX_STEP_WORDS must cover a chunk
+#endif
+
+#define BLACKBOX_PAGE_CHUNKS          ( HAL_FLASH_PAGE_SIZE / BLACKBOX_CHUNK_SIZE )
+#define BLACKBOX_CHUNK_WORDS          ( BLACKBOX_CHUNK_SIZE / HAL_FLASH_WORD_SIZE )
+
+#define BLACKBOX_ERASED               0xFF
+
+// Header byte of a record
+#define BLACKBOX_HDR( type, len )     ( (uint8)(((type) << 4) | (len)) )
+
+// Length of the PAGE record that opens every page
+#define BLACKBOX_PAGE_LEN             ( BLACKBOX_REC_HDR_LEN + 8 )
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static uint8 blackBoxTaskId;
+static uint16 blackBoxEvent;
+static uint8 blackBoxConnected = FALSE;
+static uint8 blackBoxDumping = FALSE;
+static uint8 blackBoxAsked = FALSE;         // Event set for the steps after connection events
+
+// Chunks waiting in RAM: blackBoxCnt closed ones up to blackBoxHead, which
+// is the open one unless all are closed
+static uint8 blackBoxRam[BLACKBOX_RAM_CHUNKS][BLACKBOX_CHUNK_SIZE];
+static uint32 blackBoxBase[BLACKBOX_RAM_CHUNKS];   // Time the first record of each counts from
+static uint8 blackBoxHead = 0;
+static uint8 blackBoxCnt = 0;
+static uint8 blackBoxFill = 0;              // Bytes used in the open chunk
+static uint32 blackBoxOpened;               // Time the open chunk got its first record
+
+static uint32 blackBoxLast;                 // Time of the last record stored
+static uint16 blackBoxLost = 0;             // Records dropped since the last LOST record
+
+// Where the next chunk goes: page of the ring and chunk in the page. A page
+// is erased before its first chunk is written.
+static uint8 blackBoxPage = 0;
+static uint8 blackBoxSlot = 0;
+static uint8 blackBoxErased = FALSE;
+static uint32 blackBoxSeq = 0;              // Sequence number of the last page opened
+
+// Dump: first page and chunks in each page, taken at BlackBox_DumpStart()
+static uint8 blackBoxDumpPage;
+static uint8 blackBoxDumpCnt[BLACKBOX_PAGE_CNT];
+
+// Chunk being written from outside the RAM ring; the flash DMA reads XDATA
+static uint8 blackBoxBuf[BLACKBOX_CHUNK_SIZE];
+
+static blackBoxStats_t blackBoxStats;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static uint8 blackBoxPut( uint8 type, uint8 *pData, uint8 len, uint32 now );
+static uint8 blackBoxFit( uint8 len );
+static void blackBoxClose( void );
+static void blackBoxWrite( uint8 slot, uint8 *pBuf );
+static uint8 blackBoxUsed( uint8 page );
+static void blackBoxArm( void );
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      BlackBox_Init
+ *
+ * @brief   Find the page with the highest sequence number and its first
+ *          free chunk, and record the boot.
+ *
+ * @param   taskId - task that calls BlackBox_Step() on event
+ * @param   event - event set when there is something to write
+ *
+ * @return  none
+ */
+void BlackBox_Init( uint8 taskId, uint16 event )
+{
+  uint8 hdr[BLACKBOX_PAGE_LEN];
+  uint8 found = FALSE;
+  uint8 data[5];
+  uint32 now = osal_GetSystemClock();
+  uint8 page;
+
+  blackBoxTaskId = taskId;
+  blackBoxEvent = event;
+
+  for ( page = 0; page < BLACKBOX_PAGE_CNT; page++ )
+  {
+    HalFlashRead( BLACKBOX_PAGE_BEG + page, 0, hdr, BLACKBOX_PAGE_LEN );
+
+    if ( hdr[0] == BLACKBOX_HDR( BLACKBOX_REC_PAGE, 8 ) )
+    {
+      uint32 seq = BUILD_UINT32( hdr[3], hdr[4], hdr[5], hdr[6] );
+
+      if ( !found || ( seq > blackBoxSeq ) )
+      {
+        found = TRUE;
+        blackBoxSeq = seq;
+        blackBoxPage = page;
+      }
+    }
+  }
+
+  if ( found )
+  {
+    blackBoxSlot = blackBoxUsed( blackBoxPage );
+    blackBoxErased = TRUE;
+  }
+
+  blackBoxLast = now;
+
+  data[0] = SLEEPSTA;
+  data[1] = BREAK_UINT32( now, 0 );
+  data[2] = BREAK_UINT32( now, 1 );
+  data[3] = BREAK_UINT32( now, 2 );
+  data[4] = BREAK_UINT32( now, 3 );
+  BlackBox_Record( BLACKBOX_REC_BOOT, data, sizeof( data ) );
+}
+
+/*********************************************************************
+ * @fn      BlackBox_Record
+ *
+ * @brief   Add a record to the open RAM chunk. It is dropped, and counted
+ *          in a LOST record later, when all RAM chunks wait to be written.
+ *
+ * @param   type - BLACKBOX_REC_xxx
+ * @param   pData - record data
+ * @param   len - data length, at most BLACKBOX_REC_MAX_LEN
+ *
+ * @return  none
+ */
+void BlackBox_Record( uint8 type, uint8 *pData, uint8 len )
+{
+  uint32 now = osal_GetSystemClock();
+
+  if ( len > BLACKBOX_REC_MAX_LEN )
+  {
+    len = BLACKBOX_REC_MAX_LEN;
+  }
+
+  if ( blackBoxLost )
+  {
+    uint8 lost[2];
+
+    lost[0] = LO_UINT16( blackBoxLost );
+    lost[1] = HI_UINT16( blackBoxLost );
+    if ( blackBoxPut( BLACKBOX_REC_LOST, lost, sizeof( lost ), now ) == SUCCESS )
+    {
+      blackBoxLost = 0;
+    }
+  }
+
+  if ( ( blackBoxLost == 0 ) && ( blackBoxPut( type, pData, len, now ) == SUCCESS ) )
+  {
+    blackBoxStats.records++;
+  }
+  else
+  {
+    blackBoxLost++;
+    blackBoxStats.dropped++;
+  }
+
+  blackBoxArm();
+}
+
+/*********************************************************************
+ * @fn      BlackBox_SetConnected
+ *
+ * @brief   Tell whether BlackBox_Step() is called after connection
+ *          events, or has to be asked for with the event.
+ *
+ * @param   connected - TRUE while in a connection
+ *
+ * @return  none
+ */
+void BlackBox_SetConnected( uint8 connected )
+{
+  blackBoxConnected = connected;
+  blackBoxAsked = FALSE;
+
+  blackBoxArm();
+}
+
+/*********************************************************************
+ * @fn      BlackBox_Step
+ *
+ * @brief   Close the open chunk once it is BLACKBOX_FLUSH_DELAY old and
+ *          write closed chunks, BLACKBOX_STEP_WORDS at most. A page erase
+ *          is a step of its own.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void BlackBox_Step( void )
+{
+  uint16 words = 0;
+  uint32 start;
+  uint32 ticks;
+
+  if ( blackBoxDumping )
+  {
+    return;
+  }
+
+  if ( blackBoxFill && ( blackBoxCnt < BLACKBOX_RAM_CHUNKS ) &&
+       ( osal_GetSystemClock() - blackBoxOpened >= BLACKBOX_FLUSH_DELAY ) )
+  {
+    blackBoxClose();
+  }
+
+  start = halSleepReadTimer();
+
+  while ( blackBoxCnt && ( words + BLACKBOX_CHUNK_WORDS <= BLACKBOX_STEP_WORDS ) )
+  {
+    uint8 tail = ( blackBoxHead + BLACKBOX_RAM_CHUNKS - blackBoxCnt ) % BLACKBOX_RAM_CHUNKS;
+
+    if ( blackBoxSlot == BLACKBOX_PAGE_CHUNKS )
+    {
+      blackBoxPage = ( blackBoxPage + 1 ) % BLACKBOX_PAGE_CNT;
+      blackBoxSlot = 0;
+      blackBoxErased = FALSE;
+    }
+
+    if ( !blackBoxErased )
+    {
+      // The CPU halts for the erase, so it only starts a step
+      if ( words || !HalAdcCheckVdd( VDD_MIN_NV ) )
+      {
+        break;
+      }
+
+      HalFlashErase( BLACKBOX_PAGE_BEG + blackBoxPage );
+      blackBoxErased = TRUE;
+      blackBoxStats.erases++;
+      blackBoxArm();
+      return;
+    }
+
+    if ( blackBoxSlot == 0 )
+    {
+      // Sequence number and the time the next chunk counts from
+      blackBoxSeq++;
+      osal_memset( blackBoxBuf, BLACKBOX_ERASED, BLACKBOX_CHUNK_SIZE );
+      blackBoxBuf[0] = BLACKBOX_HDR( BLACKBOX_REC_PAGE, 8 );
+      blackBoxBuf[1] = 0;
+      blackBoxBuf[2] = 0;
+      blackBoxBuf[3] = BREAK_UINT32( blackBoxSeq, 0 );
+      blackBoxBuf[4] = BREAK_UINT32( blackBoxSeq, 1 );
+      blackBoxBuf[5] = BREAK_UINT32( blackBoxSeq, 2 );
+      blackBoxBuf[6] = BREAK_UINT32( blackBoxSeq, 3 );
+      blackBoxBuf[7] = BREAK_UINT32( blackBoxBase[tail], 0 );
+      blackBoxBuf[8] = BREAK_UINT32( blackBoxBase[tail], 1 );
+      blackBoxBuf[9] = BREAK_UINT32( blackBoxBase[tail], 2 );
+      blackBoxBuf[10] = BREAK_UINT32( blackBoxBase[tail], 3 );
+      blackBoxWrite( 0, blackBoxBuf );
+    }
+    else
+    {
+      blackBoxWrite( blackBoxSlot, blackBoxRam[tail] );
+      blackBoxCnt--;
+      blackBoxStats.writes++;
+    }
+
+    blackBoxSlot++;
+    words += BLACKBOX_CHUNK_WORDS;
+  }
+
+  // The sleep timer is 24 bits wide
+  ticks = ( halSleepReadTimer() - start ) & 0x00FFFFFF;
+  if ( words && ( ticks > blackBoxStats.stepMax ) )
+  {
+    blackBoxStats.stepMax = ( ticks > 0xFFFF ) ? 0xFFFF : (uint16)ticks;
+  }
+
+  if ( !BlackBox_Pending() )
+  {
+    blackBoxAsked = FALSE;
+  }
+
+  blackBoxArm();
+}
+
+/*********************************************************************
+ * @fn      BlackBox_Pending
+ *
+ * @brief   Tell whether BlackBox_Step() has something to write: closed
+ *          chunks, or an open one that is due. Nothing is written during
+ *          a dump.
+ *
+ * @param   none
+ *
+ * @return  TRUE if a step would write
+ */
+uint8 BlackBox_Pending( void )
+{
+  if ( blackBoxDumping )
+  {
+    return FALSE;
+  }
+
+  return ( blackBoxCnt != 0 ) ||
+         ( blackBoxFill && ( osal_GetSystemClock() - blackBoxOpened >= BLACKBOX_FLUSH_DELAY ) );
+}
+
+/*********************************************************************
+ * @fn      BlackBox_GetStats
+ *
+ * @brief   Read the counts.
+ *
+ * @param   pStats - where to copy the counts
+ *
+ * @return  none
+ */
+void BlackBox_GetStats( blackBoxStats_t *pStats )
+{
+  *pStats = blackBoxStats;
+}
+
+/*********************************************************************
+ * @fn      BlackBox_DumpStart
+ *
+ * @brief   Hold off writing and count the chunks of the log, from the
+ *          oldest page on. Records taken meanwhile still go to RAM.
+ *
+ * @param   none
+ *
+ * @return  number of chunks
+ */
+uint16 BlackBox_DumpStart( void )
+{
+  uint16 cnt = 0;
+  uint8 page;
+  uint8 i;
+
+  blackBoxDumping = TRUE;
+
+  // The oldest page follows the one being written; a page waiting for its
+  // erase still holds the oldest chunks
+  blackBoxDumpPage = blackBoxErased ? ( blackBoxPage + 1 ) % BLACKBOX_PAGE_CNT : blackBoxPage;
+
+  for ( i = 0; i < BLACKBOX_PAGE_CNT; i++ )
+  {
+    page = ( blackBoxDumpPage + i ) % BLACKBOX_PAGE_CNT;
+
+    blackBoxDumpCnt[i] = ( ( page == blackBoxPage ) && blackBoxErased ) ?
+                         blackBoxSlot : blackBoxUsed( page );
+    cnt += blackBoxDumpCnt[i];
+  }
+
+  return cnt + blackBoxCnt + ( blackBoxFill ? 1 : 0 );
+}
+
+/*********************************************************************
+ * @fn      BlackBox_DumpRead
+ *
+ * @brief   Copy a chunk of the dump, from flash or from RAM.
+ *
+ * @param   idx - chunk, below the count BlackBox_DumpStart() returned
+ * @param   pBuf - where to copy BLACKBOX_CHUNK_SIZE bytes
+ *
+ * @return  none
+ */
+void BlackBox_DumpRead( uint16 idx, uint8 *pBuf )
+{
+  uint8 i;
+
+  for ( i = 0; i < BLACKBOX_PAGE_CNT; i++ )
+  {
+    if ( idx < blackBoxDumpCnt[i] )
+    {
+      HalFlashRead( BLACKBOX_PAGE_BEG + ( blackBoxDumpPage + i ) % BLACKBOX_PAGE_CNT,
+                    idx * BLACKBOX_CHUNK_SIZE, pBuf, BLACKBOX_CHUNK_SIZE );
+      return;
+    }
+    idx -= blackBoxDumpCnt[i];
+  }
+
+  // Nothing is written during the dump, so the RAM chunks stay in place
+  i = ( blackBoxHead + BLACKBOX_RAM_CHUNKS - blackBoxCnt + idx ) % BLACKBOX_RAM_CHUNKS;
+  osal_memcpy( pBuf, blackBoxRam[i], BLACKBOX_CHUNK_SIZE );
+}
+
+/*********************************************************************
+ * @fn      BlackBox_DumpEnd
+ *
+ * @brief   Resume writing.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void BlackBox_DumpEnd( void )
+{
+  blackBoxDumping = FALSE;
+  blackBoxAsked = FALSE;
+
+  blackBoxArm();
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      blackBoxPut
+ *
+ * @brief   Store a record in the open chunk, after a TIME record if the
+ *          time since the last one does not fit 16 bits.
+ *
+ * @param   type - BLACKBOX_REC_xxx
+ * @param   pData - record data
+ * @param   len - data length
+ * @param   now - system clock
+ *
+ * @return  SUCCESS, or FAILURE if there is no room
+ */
+static uint8 blackBoxPut( uint8 type, uint8 *pData, uint8 len, uint32 now )
+{
+  uint32 dt = now - blackBoxLast;
+  uint8 *p;
+
+  if ( dt > 0xFFFF )
+  {
+    if ( !blackBoxFit( BLACKBOX_REC_HDR_LEN + 4 ) )
+    {
+      return FAILURE;
+    }
+
+    p = &blackBoxRam[blackBoxHead][blackBoxFill];
+    *p++ = BLACKBOX_HDR( BLACKBOX_REC_TIME, 4 );
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = BREAK_UINT32( now, 0 );
+    *p++ = BREAK_UINT32( now, 1 );
+    *p++ = BREAK_UINT32( now, 2 );
+    *p++ = BREAK_UINT32( now, 3 );
+    blackBoxFill += BLACKBOX_REC_HDR_LEN + 4;
+    blackBoxLast = now;
+    dt = 0;
+  }
+
+  if ( !blackBoxFit( BLACKBOX_REC_HDR_LEN + len ) )
+  {
+    return FAILURE;
+  }
+
+  p = &blackBoxRam[blackBoxHead][blackBoxFill];
+  *p++ = BLACKBOX_HDR( type, len );
+  *p++ = LO_UINT16( (uint16)dt );
+  *p++ = HI_UINT16( (uint16)dt );
+  osal_memcpy( p, pData, len );
+  blackBoxFill += BLACKBOX_REC_HDR_LEN + len;
+  blackBoxLast = now;
+
+  return SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      blackBoxFit
+ *
+ * @brief   Make room for len bytes in the open chunk, closing it and
+ *          opening the next one if need be.
+ *
+ * @param   len - bytes needed
+ *
+ * @return  TRUE if there is room
+ */
+static uint8 blackBoxFit( uint8 len )
+{
+  if ( ( blackBoxCnt < BLACKBOX_RAM_CHUNKS ) && ( blackBoxFill + len > BLACKBOX_CHUNK_SIZE ) )
+  {
+    blackBoxClose();
+  }
+
+  if ( blackBoxCnt == BLACKBOX_RAM_CHUNKS )
+  {
+    return FALSE;
+  }
+
+  if ( blackBoxFill == 0 )
+  {
+    osal_memset( blackBoxRam[blackBoxHead], BLACKBOX_ERASED, BLACKBOX_CHUNK_SIZE );
+    blackBoxBase[blackBoxHead] = blackBoxLast;
+    blackBoxOpened = osal_GetSystemClock();
+  }
+
+  return TRUE;
+}
+
+/*********************************************************************
+ * @fn      blackBoxClose
+ *
+ * @brief   Queue the open chunk for writing; the next record opens the
+ *          next one.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void blackBoxClose( void )
+{
+  blackBoxHead = ( blackBoxHead + 1 ) % BLACKBOX_RAM_CHUNKS;
+  blackBoxCnt++;
+  blackBoxFill = 0;
+}
+
+/*********************************************************************
+ * @fn      blackBoxWrite
+ *
+ * @brief   Write a chunk to the current page.
+ *
+ * @param   slot - chunk in the page
+ * @param   pBuf - BLACKBOX_CHUNK_SIZE bytes
+ *
+ * @return  none
+ */
+static void blackBoxWrite( uint8 slot, uint8 *pBuf )
+{
+  uint16 addr = ( (uint16)( BLACKBOX_PAGE_BEG + blackBoxPage ) << 9 ) +
+                ( (uint16)slot * BLACKBOX_CHUNK_WORDS );
+
+  HalFlashWrite( addr, pBuf, BLACKBOX_CHUNK_WORDS );
+}
+
+/*********************************************************************
+ * @fn      blackBoxUsed
+ *
+ * @brief   Count the chunks written to a page: none unless it starts with
+ *          a PAGE record, else up to the first erased one.
+ *
+ * @param   page - page of the ring
+ *
+ * @return  number of chunks
+ */
+static uint8 blackBoxUsed( uint8 page )
+{
+  uint8 hdr;
+  uint8 slot;
+
+  for ( slot = 0; slot < BLACKBOX_PAGE_CHUNKS; slot++ )
+  {
+    HalFlashRead( BLACKBOX_PAGE_BEG + page, slot * BLACKBOX_CHUNK_SIZE, &hdr, 1 );
+
+    if ( ( slot == 0 ) ? ( hdr != BLACKBOX_HDR( BLACKBOX_REC_PAGE, 8 ) ) : ( hdr == BLACKBOX_ERASED ) )
+    {
+      break;
+    }
+  }
+
+  return slot;
+}
+
+/*********************************************************************
+ * @fn      blackBoxArm
+ *
+ * @brief   Set the task event when there is something to write: soon for
+ *          closed chunks, once it is due for the open one. While
+ *          connected the event is set once, when the steps after the
+ *          connection events are first needed.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void blackBoxArm( void )
+{
+  uint32 delay;
+  uint32 timeout;
+
+  if ( blackBoxDumping )
+  {
+    return;
+  }
+
+  if ( blackBoxConnected && BlackBox_Pending() )
+  {
+    if ( !blackBoxAsked )
+    {
+      blackBoxAsked = TRUE;
+      osal_set_event( blackBoxTaskId, blackBoxEvent );
+    }
+    return;
+  }
+
+  if ( blackBoxCnt )
+  {
+    delay = BLACKBOX_IDLE_PERIOD;
+  }
+  else if ( blackBoxFill )
+  {
+    delay = osal_GetSystemClock() - blackBoxOpened;
+    delay = ( delay < BLACKBOX_FLUSH_DELAY ) ? BLACKBOX_FLUSH_DELAY - delay : 1;
+  }
+  else
+  {
+    return;
+  }
+
+  // Leave a step that comes sooner as it is
+  timeout = osal_get_timeoutEx( blackBoxTaskId, blackBoxEvent );
+  if ( timeout && ( timeout <= delay ) )
+  {
+    return;
+  }
+
+  osal_start_timerEx( blackBoxTaskId, blackBoxEvent, delay );
+}
+
+#endif // BLACKBOX
+
+/*********************************************************************
+*********************************************************************/
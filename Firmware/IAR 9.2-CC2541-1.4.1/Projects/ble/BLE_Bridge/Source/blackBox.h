@@ -0,0 +1,160 @@
+/**************************************************************************************************
+  Filename:       blackBox.h
+
+  Description:    Black box recorder. Keeps the last motor commands, duties,
+                  battery voltage and link events in a ring of flash pages, so
+                  that they can be read back after a crash.
+**************************************************************************************************/
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "hal_types.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Record to flash
+#if !defined BLACKBOX
+#define BLACKBOX                      FALSE
+#endif
+
+// Flash pages of the ring, right below the NV pages. They must coincide with
+// the BLACKBOX_ADDRESS_SPACE segment in the project *.xcl file. Every pass
+// of the ring erases each page once; the flash is good for 20000 erases.
+#if !defined BLACKBOX_PAGE_CNT
+#define BLACKBOX_PAGE_CNT             4
+#endif
+#define BLACKBOX_PAGE_BEG             ( HAL_NV_PAGE_BEG - BLACKBOX_PAGE_CNT )
+
+// Records are collected in RAM chunks and written a chunk at a time. A chunk
+// is a multiple of the flash word and divides the page; a record never
+// spans two chunks, and the unused end of a chunk stays 0xFF.
+#if !defined BLACKBOX_CHUNK_SIZE
+#define BLACKBOX_CHUNK_SIZE           32
+#endif
+#if !defined BLACKBOX_RAM_CHUNKS
+#define BLACKBOX_RAM_CHUNKS           4
+#endif
+
+// A chunk that is not full is written once it is this old, ms
+#if !defined BLACKBOX_FLUSH_DELAY
+#define BLACKBOX_FLUSH_DELAY          2000
+#endif
+
+// Flash words written by one BlackBox_Step(), two chunks by default; a word
+// takes about 20 us. A page erase halts the CPU for about 20 ms and takes a
+// step of its own.
+#if !defined BLACKBOX_STEP_WORDS
+#define BLACKBOX_STEP_WORDS           ( 2 * BLACKBOX_CHUNK_SIZE / 4 )
+#endif
+
+// Time between steps while not connected, ms
+#if !defined BLACKBOX_IDLE_PERIOD
+#define BLACKBOX_IDLE_PERIOD          100
+#endif
+
+// Record: a header byte of the type (high nibble) and the data length (low
+// nibble), the time since the previous record in ms (16 bits), then the
+// data; all values LSB first. A header of 0xFF ends the chunk.
+#define BLACKBOX_REC_HDR_LEN          3
+#define BLACKBOX_REC_MAX_LEN          15
+
+// Record types and their data
+#define BLACKBOX_REC_PAGE             0x0   // page sequence (32), time (32); first in a page
+#define BLACKBOX_REC_BOOT             0x1   // reset cause (SLEEPSTA), time (32)
+#define BLACKBOX_REC_TIME             0x2   // time (32), when a gap does not fit 16 bits
+#define BLACKBOX_REC_LOST             0x3   // records dropped for lack of RAM (16)
+#define BLACKBOX_REC_CMD              0x4   // motor command, as written to SIMPLEPROFILE_CHAR1
+#define BLACKBOX_REC_DUTY             0x5   // PWM frequency (16), duty of channels 1-4 (16 each, 0.1%)
+#define BLACKBOX_REC_BATT             0x6   // supply voltage, mV (16)
+#define BLACKBOX_REC_LINK             0x7   // GAP role state (gaprole_States_t)
+#define BLACKBOX_REC_REJECT           0x8   // CmdAuth_Open() status of a refused command
+#define BLACKBOX_REC_END              0xF
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint16 records;                           // Records taken
+  uint16 dropped;                           // Records dropped for lack of RAM
+  uint16 writes;                            // Chunks written
+  uint16 erases;                            // Pages erased
+  uint16 stepMax;                           // Longest step without an erase, 32 kHz ticks
+} blackBoxStats_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*
+ * BlackBox_Init - Find the end of the log and record the boot.
+ *
+ *    taskId, event - set when there is something to write. While not
+ *                    connected the task then calls BlackBox_Step(); while
+ *                    connected it has BlackBox_Step() called after the
+ *                    connection events for as long as BlackBox_Pending().
+ */
+extern void BlackBox_Init( uint8 taskId, uint16 event );
+
+/*
+ * BlackBox_Record - Add a record. It only takes a copy to RAM.
+ */
+extern void BlackBox_Record( uint8 type, uint8 *pData, uint8 len );
+
+/*
+ * BlackBox_SetConnected - While connected the task calls BlackBox_Step()
+ *          right after every connection event instead.
+ */
+extern void BlackBox_SetConnected( uint8 connected );
+
+/*
+ * BlackBox_Step - Write what is due within the step budget.
+ */
+extern void BlackBox_Step( void );
+
+/*
+ * BlackBox_Pending - TRUE while BlackBox_Step() has something to write.
+ */
+extern uint8 BlackBox_Pending( void );
+
+/*
+ * BlackBox_GetStats - Read the counts.
+ */
+extern void BlackBox_GetStats( blackBoxStats_t *pStats );
+
+/*
+ * BlackBox_DumpStart - Hold off writing and return the number of chunks in
+ *          the log, oldest first, including those still in RAM.
+ */
+extern uint16 BlackBox_DumpStart( void );
+
+/*
+ * BlackBox_DumpRead - Copy chunk idx of the dump to pBuf.
+ */
+extern void BlackBox_DumpRead( uint16 idx, uint8 *pBuf );
+
+/*
+ * BlackBox_DumpEnd - Resume writing.
+ */
+extern void BlackBox_DumpEnd( void );
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLACKBOX_H */
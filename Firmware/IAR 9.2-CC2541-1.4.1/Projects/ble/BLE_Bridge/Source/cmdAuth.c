@@ -0,0 +1,309 @@
+/**************************************************************************************************
+  Filename:       cmdAuth.c
+
+  Description:    Authenticated motor commands, AES-CCM on the hardware AES
+                  engine. The engine is used in ECB mode block by block, with
+                  the key loaded again for every block: the link layer shares
+                  the engine and may load its own key in between.
+**************************************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "bcomdef.h"
+#include "OSAL.h"
+#include "osal_snv.h"
+#include "hal_mcu.h"
+#include "hal_aes.h"
+#include "hal_sleep.h"
+#include "cmdAuth.h"
+
+#if CMD_AUTH
+
+// The key is kept out of the project and the repository
+#if !defined CMD_AUTH_KEY
+#include "cmdAuthKey.h"
+#endif
+
+#if !defined CMD_AUTH_KEY
+#error CMD_AUTH needs the pre-shared CMD_AUTH_KEY
+#endif
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Nonce: counter, BD address, 3 zero bytes
+#define CMD_AUTH_NONCE_LEN      13
+
+// CCM flags of B0 (MIC length, length field size) and of the counter blocks
+#define CMD_AUTH_FLAGS_B0       ( (((CMD_AUTH_MIC_LEN - 2) / 2) << 3) | (15 - CMD_AUTH_NONCE_LEN - 1) )
+#define CMD_AUTH_FLAGS_A        ( 15 - CMD_AUTH_NONCE_LEN - 1 )
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// In RAM, the DMA reads the key from XDATA
+static uint8 cmdAuthKey[KEY_BLENGTH] = { CMD_AUTH_KEY };
+
+static uint8 cmdAuthNonce[CMD_AUTH_NONCE_LEN];
+
+static uint32 cmdAuthLast = 0;              // Counter of the last command accepted
+static uint32 cmdAuthSaved = 0;             // Counter saved in NV; none above it was accepted
+
+static cmdAuthStats_t cmdAuthStats;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void cmdAuthEncrypt( uint8 *pBlock );
+static void cmdAuthBlock( uint8 *pBlock, uint8 flags, uint8 idx );
+static uint8 cmdAuthCcm( uint8 *pData, uint8 *pMic );
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      CmdAuth_Init
+ *
+ * @brief   Restore the counter from NV. Every counter up to the saved one
+ *          may have been used before the reset, so they are all refused.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void CmdAuth_Init( void )
+{
+  if ( osal_snv_read( CMD_AUTH_NVID, sizeof( uint32 ), &cmdAuthSaved ) != SUCCESS )
+  {
+    cmdAuthSaved = 0;
+  }
+
+  cmdAuthLast = cmdAuthSaved;
+}
+
+/*********************************************************************
+ * @fn      CmdAuth_SetAddress
+ *
+ * @brief   Set the BD address that goes into the nonce, so that a command
+ *          sealed for one bridge is refused by the others.
+ *
+ * @param   pAddr - BD address, LSB first
+ *
+ * @return  none
+ */
+void CmdAuth_SetAddress( uint8 *pAddr )
+{
+  osal_memset( cmdAuthNonce, 0, CMD_AUTH_NONCE_LEN );
+  osal_memcpy( &cmdAuthNonce[CMD_AUTH_CNT_LEN], pAddr, B_ADDR_LEN );
+}
+
+/*********************************************************************
+ * @fn      CmdAuth_Open
+ *
+ * @brief   Check a sealed command and decrypt it.
+ *
+ * @param   pCmd - sealed command, CMD_AUTH_LEN bytes
+ * @param   pOut - decrypted command, CMD_AUTH_DATA_LEN bytes
+ *
+ * @return  SUCCESS, CMD_AUTH_ERR_MIC, CMD_AUTH_ERR_REPLAY or CMD_AUTH_ERR_NV
+ */
+uint8 CmdAuth_Open( uint8 *pCmd, uint8 *pOut )
+{
+  uint8 data[CMD_AUTH_DATA_LEN];
+  uint32 cnt = BUILD_UINT32( pCmd[0], pCmd[1], pCmd[2], pCmd[3] );
+
+  if ( cnt <= cmdAuthLast )
+  {
+    cmdAuthStats.replays++;
+    return CMD_AUTH_ERR_REPLAY;
+  }
+
+  osal_memcpy( cmdAuthNonce, pCmd, CMD_AUTH_CNT_LEN );
+  osal_memcpy( data, &pCmd[CMD_AUTH_CNT_LEN], CMD_AUTH_DATA_LEN );
+
+  if ( cmdAuthCcm( data, &pCmd[CMD_AUTH_CNT_LEN + CMD_AUTH_DATA_LEN] ) != SUCCESS )
+  {
+    cmdAuthStats.micErrors++;
+    return CMD_AUTH_ERR_MIC;
+  }
+
+  // Save ahead of the counter, so that NV is only written once per step
+  if ( cnt >= cmdAuthSaved )
+  {
+    uint32 saved = ( cnt > 0xFFFFFFFF - CMD_AUTH_SAVE_STEP ) ? 0xFFFFFFFF : cnt + CMD_AUTH_SAVE_STEP;
+
+    if ( osal_snv_write( CMD_AUTH_NVID, sizeof( uint32 ), &saved ) != SUCCESS )
+    {
+      return CMD_AUTH_ERR_NV;
+    }
+    cmdAuthSaved = saved;
+  }
+
+  cmdAuthLast = cnt;
+  cmdAuthStats.accepted++;
+  osal_memcpy( pOut, data, CMD_AUTH_DATA_LEN );
+
+  return SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      CmdAuth_GetCounter
+ *
+ * @brief   Lowest counter that is not refused as a replay.
+ *
+ * @param   none
+ *
+ * @return  counter
+ */
+uint32 CmdAuth_GetCounter( void )
+{
+  return cmdAuthLast + 1;
+}
+
+/*********************************************************************
+ * @fn      CmdAuth_GetStats
+ *
+ * @brief   Read and optionally clear the command counts.
+ *
+ * @param   pStats - where to copy the counts
+ * @param   clear - clear the counts after reading them
+ *
+ * @return  none
+ */
+void CmdAuth_GetStats( cmdAuthStats_t *pStats, uint8 clear )
+{
+  *pStats = cmdAuthStats;
+
+  if ( clear )
+  {
+    osal_memset( &cmdAuthStats, 0, sizeof( cmdAuthStats ) );
+  }
+}
+
+/*********************************************************************
+ * @fn      CmdAuth_Bench
+ *
+ * @brief   Measure the cost of opening a command: the CBC-MAC and CTR
+ *          blocks and the MIC check, as CmdAuth_Open() does them. The
+ *          interrupts that hit meanwhile are included, as they are for a
+ *          real command. The counter and the counts are left alone.
+ *
+ * @param   runs - number of commands to open
+ *
+ * @return  time taken in 32 kHz sleep timer ticks
+ */
+uint32 CmdAuth_Bench( uint8 runs )
+{
+  uint8 cmd[CMD_AUTH_LEN];
+  uint8 data[CMD_AUTH_DATA_LEN];
+  uint32 start;
+
+  osal_memset( cmd, 0, CMD_AUTH_LEN );
+
+  start = halSleepReadTimer();
+  while ( runs-- )
+  {
+    osal_memcpy( data, &cmd[CMD_AUTH_CNT_LEN], CMD_AUTH_DATA_LEN );
+    VOID cmdAuthCcm( data, &cmd[CMD_AUTH_CNT_LEN + CMD_AUTH_DATA_LEN] );
+  }
+
+  // The sleep timer is 24 bits wide
+  return ( halSleepReadTimer() - start ) & 0x00FFFFFF;
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      cmdAuthEncrypt
+ *
+ * @brief   Encrypt a block in place with the pre-shared key. Interrupts are
+ *          held off for one block only.
+ *
+ * @param   pBlock - block of STATE_BLENGTH bytes
+ *
+ * @return  none
+ */
+static void cmdAuthEncrypt( uint8 *pBlock )
+{
+  halIntState_t intState;
+
+  HAL_ENTER_CRITICAL_SECTION( intState );
+  ssp_HW_KeyInit( cmdAuthKey );
+  sspAesEncryptHW( cmdAuthKey, pBlock );
+  HAL_EXIT_CRITICAL_SECTION( intState );
+}
+
+/*********************************************************************
+ * @fn      cmdAuthBlock
+ *
+ * @brief   Build B0 or a counter block: flags, nonce, and the command
+ *          length or the block index, MSB first.
+ *
+ * @param   pBlock - block of STATE_BLENGTH bytes
+ * @param   flags - CMD_AUTH_FLAGS_B0 or CMD_AUTH_FLAGS_A
+ * @param   idx - length or block index
+ *
+ * @return  none
+ */
+static void cmdAuthBlock( uint8 *pBlock, uint8 flags, uint8 idx )
+{
+  pBlock[0] = flags;
+  osal_memcpy( &pBlock[1], cmdAuthNonce, CMD_AUTH_NONCE_LEN );
+  pBlock[STATE_BLENGTH - 2] = 0;
+  pBlock[STATE_BLENGTH - 1] = idx;
+}
+
+/*********************************************************************
+ * @fn      cmdAuthCcm
+ *
+ * @brief   Decrypt a command in place and check its MIC, with the nonce
+ *          in cmdAuthNonce.
+ *
+ * @param   pData - command, CMD_AUTH_DATA_LEN bytes
+ * @param   pMic - MIC, CMD_AUTH_MIC_LEN bytes
+ *
+ * @return  SUCCESS if the MIC matches, FAILURE if not
+ */
+static uint8 cmdAuthCcm( uint8 *pData, uint8 *pMic )
+{
+  uint8 x[STATE_BLENGTH];                   // CBC-MAC
+  uint8 s[STATE_BLENGTH];                   // Key stream
+  uint8 diff = 0;
+  uint8 i;
+
+  // The command fits one block: X1 = E(B0), S1 = E(A1), X2 = E(X1 ^ P)
+  cmdAuthBlock( x, CMD_AUTH_FLAGS_B0, CMD_AUTH_DATA_LEN );
+  cmdAuthEncrypt( x );
+
+  cmdAuthBlock( s, CMD_AUTH_FLAGS_A, 1 );
+  cmdAuthEncrypt( s );
+
+  for ( i = 0; i < CMD_AUTH_DATA_LEN; i++ )
+  {
+    pData[i] ^= s[i];
+    x[i] ^= pData[i];
+  }
+  cmdAuthEncrypt( x );
+
+  // MIC = X2 ^ S0, compared without an early exit
+  cmdAuthBlock( s, CMD_AUTH_FLAGS_A, 0 );
+  cmdAuthEncrypt( s );
+
+  for ( i = 0; i < CMD_AUTH_MIC_LEN; i++ )
+  {
+    diff |= pMic[i] ^ x[i] ^ s[i];
+  }
+
+  return ( diff == 0 ) ? SUCCESS : FAILURE;
+}
+
+#endif // CMD_AUTH
+
+/*********************************************************************
+*********************************************************************/
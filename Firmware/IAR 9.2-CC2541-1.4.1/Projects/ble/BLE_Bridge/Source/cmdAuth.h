@@ -0,0 +1,118 @@
+/**************************************************************************************************
+  Filename:       cmdAuth.h
+
+  Description:    Authenticated motor commands. A command written to
+                  SIMPLEPROFILE_CHAR1 is sealed with AES-CCM under a pre-shared
+                  key and carries a counter, so only a client that holds the key
+                  can drive the motors and a recorded command cannot be replayed.
+**************************************************************************************************/
+
+#ifndef CMDAUTH_H
+#define CMDAUTH_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "hal_types.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Accept only authenticated motor commands. The 16 byte key is defined as a
+// list of bytes in cmdAuthKey.h next to cmdAuth.c, which each builder writes
+// and git ignores, e.g.
+//   #define CMD_AUTH_KEY    0x.., 0x.., ..., 0x..
+// Each bridge and its clients need a key of their own, from a random source.
+#if !defined CMD_AUTH
+#define CMD_AUTH                      FALSE
+#endif
+
+// Sealed command: counter (LSB first), encrypted command, MIC.
+//
+// AES-CCM with a 4 byte MIC, a 2 byte length field and a 13 byte nonce of
+// the counter (LSB first), the bridge's BD address (LSB first) and 3 zero
+// bytes, without additional data. The counter must be higher than that of
+// the last command accepted; reading SIMPLEPROFILE_CHAR1 returns the lowest
+// counter that is refused in its first 4 bytes (LSB first), the rest zero.
+// A client must never seal two commands with the same counter.
+#define CMD_AUTH_CNT_LEN              4
+#define CMD_AUTH_DATA_LEN             8     // sizeof( MotorCtl_t )
+#define CMD_AUTH_MIC_LEN              4
+#define CMD_AUTH_LEN                  ( CMD_AUTH_CNT_LEN + CMD_AUTH_DATA_LEN + CMD_AUTH_MIC_LEN )
+
+// The counter is saved in NV once per this many commands, and after a reset
+// counting goes on from the saved value
+#if !defined CMD_AUTH_SAVE_STEP
+#define CMD_AUTH_SAVE_STEP            256
+#endif
+
+// NV item holding the counter
+#define CMD_AUTH_NVID                 BLE_NVID_CUST_START
+
+// CmdAuth_Open() status
+#define CMD_AUTH_ERR_MIC              0x01  // wrong key, or the command was altered
+#define CMD_AUTH_ERR_REPLAY           0x02  // counter not above the last one accepted
+#define CMD_AUTH_ERR_NV               0x03  // the counter could not be saved
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint16 accepted;                          // Commands opened
+  uint16 micErrors;                         // Commands refused for their MIC
+  uint16 replays;                           // Commands refused for their counter
+} cmdAuthStats_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*
+ * CmdAuth_Init - Restore the counter from NV.
+ */
+extern void CmdAuth_Init( void );
+
+/*
+ * CmdAuth_SetAddress - Set the BD address that goes into the nonce.
+ */
+extern void CmdAuth_SetAddress( uint8 *pAddr );
+
+/*
+ * CmdAuth_Open - Check a sealed command of CMD_AUTH_LEN bytes and decrypt
+ *          it into pOut, CMD_AUTH_DATA_LEN bytes. pOut is only written
+ *          on SUCCESS.
+ */
+extern uint8 CmdAuth_Open( uint8 *pCmd, uint8 *pOut );
+
+/*
+ * CmdAuth_GetCounter - Lowest counter that is not refused as a replay.
+ */
+extern uint32 CmdAuth_GetCounter( void );
+
+/*
+ * CmdAuth_GetStats - Read and optionally clear the command counts.
+ */
+extern void CmdAuth_GetStats( cmdAuthStats_t *pStats, uint8 clear );
+
+/*
+ * CmdAuth_Bench - Open a command runs times and return the time it took,
+ *          in 32 kHz sleep timer ticks.
+ */
+extern uint32 CmdAuth_Bench( uint8 runs );
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CMDAUTH_H */
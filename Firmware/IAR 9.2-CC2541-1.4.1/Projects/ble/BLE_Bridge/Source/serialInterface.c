@@ -7,9 +7,112 @@
 #include "ll.h"
 #include "hci.h"
 #include "peripheral.h"
+#include "osal_trace.h"
+#include "OSAL_PwrMgr.h"
+#include "cmdAuth.h"
+#include "blackBox.h"
+
+// Trace records sent per CMD_ACK_TRACE frame, after the 2 byte lost count
+#define TRACE_FRAME_RECS    16
+
+// Largest CMD_ACK_HEAP_STATS payload
+#define HEAP_STATS_MAX_LEN  64
+
+// Bytes taken from the UART driver at a time by SerialPacketParser
+#define RX_CHUNK_SIZE       16
+
+// Poll period while the CMD_ACK_BAUD before a switch is going out, ms; at
+// least the two byte-times at 9600 baud the last byte may still take
+#define BAUD_DRAIN_PERIOD   5
+
+// Baud rate switch states
+#define BAUD_STATE_IDLE     0
+#define BAUD_STATE_DRAIN    1   // waiting for the Tx buffer to empty
+#define BAUD_STATE_SETTLE   2   // waiting for the last byte to shift out
+#define BAUD_STATE_CONFIRM  3   // switched, waiting for the host to confirm
+
+// Size of the Tx queue, a power of 2; it must hold the largest frame
+#if !defined SER_TX_QUEUE_SIZE
+#define SER_TX_QUEUE_SIZE   512
+#endif
+#if ( SER_TX_QUEUE_SIZE & ( SER_TX_QUEUE_SIZE - 1 ) ) != 0 || SER_TX_QUEUE_SIZE < 5 + 255
+#error SER_TX_QUEUE_SIZE must be a power of 2 that holds a frame of 255 data bytes
+#endif
+
+// Most bytes handed to the UART driver at a time by SerialInterface_TxDrain
+#define SER_TX_CHUNK        32
+
+// serialTxGate while the whole Tx queue may go out
+#define SER_TX_GATE_OPEN    0xFFFF
+
+// Time BLE data for the host is collected before it goes out as one frame,
+// ms; 0 sends a frame per write
+#if !defined SER_COALESCE_DELAY
+#define SER_COALESCE_DELAY  5
+#endif
+
+// Largest frame payload FrameUnpack() accepts
+#define SER_COALESCE_MAX    250
+
+// Black box chunks per dump frame, after the index of the first; kept to 4
+// so that serialReplyBuf stays small
+#define SER_BLACKBOX_CHUNKS 4
+
+// Replies too big for the 640 byte XDATA stack of the SPI and PM builds are
+// built in serialReplyBuf: a dump frame, or else a trace frame, or else the
+// heap statistics
+#if BLACKBOX
+#define SER_REPLY_MAX       ( 2 + SER_BLACKBOX_CHUNKS * BLACKBOX_CHUNK_SIZE )
+#elif OSAL_TRACE
+#define SER_REPLY_MAX       ( 2 + TRACE_FRAME_RECS * OSAL_TRACE_REC_LEN )
+#else
+#define SER_REPLY_MAX       HEAP_STATS_MAX_LEN
+#endif
+#if ( SER_REPLY_MAX < HEAP_STATS_MAX_LEN ) || \
+    ( OSAL_TRACE && ( SER_REPLY_MAX < 2 + TRACE_FRAME_RECS * OSAL_TRACE_REC_LEN ) ) || \
+    ( OSAL_PROFILE && ( SER_REPLY_MAX < 1 + 2 * ( 3 + 2 * OSAL_PROFILE_BUCKETS ) ) )
+#error SER_REPLY_MAX must hold every reply built in serialReplyBuf
+#endif
+
+// Poll period of a dump while the Tx queue is full, ms; the Tx events of the
+// UART driver usually move it on sooner
+#define SER_BLACKBOX_PERIOD 5
+
+// A dump that could not queue a frame for this long, ms, as with the host
+// holding CTS, is given up so that the black box records again
+#define SER_BLACKBOX_TIMEOUT 2000
 
 //local function
 static void SerialInterface_ProcessOSALMsg( osal_event_hdr_t *pMsg );
+#if OSAL_PROFILE
+static void SerialInterface_SendProfile( uint8 task_id );
+#endif
+#if OSAL_TRACE
+static void SerialInterface_SendTrace( void );
+#endif
+#if OSAL_PWRMGR_STATS
+static void SerialInterface_SendPowerStats( uint8 clear );
+#endif
+#if HAL_UART_STATS
+static void SerialInterface_SendUartStats( uint8 clear );
+#endif
+#if CMD_AUTH
+static void SerialInterface_SendAuthStats( uint8 clear );
+static void SerialInterface_SendAuthBench( uint8 runs );
+#endif
+#if BLACKBOX
+static void SerialInterface_SendBlackBoxStats( void );
+static void SerialInterface_BlackBoxDump( void );
+#endif
+#if HAL_UART_DMA
+static void SerialInterface_SendBaud( uint8 baud, uint8 flow );
+static void SerialInterface_BaudSwitch( void );
+static void SerialInterface_BaudOpen( uint8 baud, uint8 flow );
+#endif
+static void SerialInterface_TxDrain( void );
+#if SER_COALESCE_DELAY
+static void SerialInterface_FlushDown( void );
+#endif
 
 uint8 serialInterface_TaskID;   // Task ID for internal task/event processing
 
@@ -23,6 +126,42 @@ uint8 SystemState = 0;
 uint8 FlushTxReq = 0;
 uint8 FlushRxReq = 0;
 
+#if HAL_UART_DMA
+static uint8 serialBaud = NPI_UART_BR;        // Confirmed rate, fallen back to on error
+static uint8 serialFlow = NPI_UART_FC;
+static uint8 serialNewBaud;                   // Rate being switched to
+static uint8 serialNewFlow;
+static uint8 serialBaudState = BAUD_STATE_IDLE;
+#endif
+
+// Tx queue: every frame for the host is built here and handed to the UART
+// driver in order as its Tx buffer frees up
+static uint8  serialTxQ[SER_TX_QUEUE_SIZE];
+static uint16 serialTxHead = 0;               // Oldest byte
+static uint16 serialTxCnt = 0;
+static uint16 serialTxGate = SER_TX_GATE_OPEN; // Bytes that may go out before a baud switch
+#if HAL_UART_STATS
+static uint16 serialTxHigh = 0;               // Most bytes queued
+static uint16 serialTxDrops = 0;              // Frames that did not fit
+#endif
+
+#if BLACKBOX
+static uint8  serialDumping = FALSE;
+static uint16 serialDumpIdx;                  // Next black box chunk to send
+static uint16 serialDumpCnt;
+static uint32 serialDumpTime;                 // When a frame was last queued
+#endif
+
+#if SER_COALESCE_DELAY
+// BLE data for the host not yet framed
+static uint8 serialDownBuf[SER_COALESCE_MAX];
+static uint8 serialDownLen = 0;
+#endif
+
+// Payload of the larger replies; each is copied into the Tx queue before
+// the buffer is used again
+static uint8 serialReplyBuf[SER_REPLY_MAX];
+
 static void SerialPacketParser( uint8 port, uint8 events );
 
 void SerialInterface_Init( uint8 task_id )
@@ -53,6 +192,44 @@ uint16 SerialInterface_ProcessEvent( uint8 task_id, uint16 events )
     return (events ^ SYS_EVENT_MSG);
   }
 
+#if HAL_UART_DMA
+  if ( events & SER_BAUD_SWITCH_EVT )
+  {
+    SerialInterface_BaudSwitch();
+
+    return (events ^ SER_BAUD_SWITCH_EVT);
+  }
+
+  if ( events & SER_BAUD_CONFIRM_EVT )
+  {
+    // The host did not confirm the new rate, go back to the old one
+    SerialInterface_BaudOpen( serialBaud, serialFlow );
+    serialBaudState = BAUD_STATE_IDLE;
+    serialTxGate = SER_TX_GATE_OPEN;
+    FrameErrorAck( CMD_ERR_BAUD );
+
+    return (events ^ SER_BAUD_CONFIRM_EVT);
+  }
+#endif
+
+#if SER_COALESCE_DELAY
+  if ( events & SER_COALESCE_EVT )
+  {
+    SerialInterface_FlushDown();
+
+    return (events ^ SER_COALESCE_EVT);
+  }
+#endif
+
+#if BLACKBOX
+  if ( events & SER_BLACKBOX_EVT )
+  {
+    SerialInterface_BlackBoxDump();
+
+    return (events ^ SER_BLACKBOX_EVT);
+  }
+#endif
+
   // Discard unknown events
   return 0;
 }
@@ -83,20 +260,8 @@ static void SerialInterface_MsgDispatch( SerialMsg_t* pMsg )
         case CMD_REQ_DEVICE_VERSION:
             {
                 uint8 len = strlen(DEVICE_VERSION) + 1;
-                Packet = (Packet_t*) osal_mem_alloc(5 + len);
-                if (Packet)
-                {
-                    if(NULL != FramePack((uint8_t*) Packet, CMD_ACK_DEVICE_VERSION, DEVICE_VERSION, len))
-                    {
-                        HalUARTWrite(NPI_UART_PORT, (uint8*)Packet, len + 5);
-                    }
-                    osal_mem_free(Packet);
-                }
-                else
-                {
-                    // Error Frame Ack
-                    FrameErrorAck(CMD_ERR_DEVICE_VERSION);
-                }
+
+                SerialInterface_TxFrame(CMD_ACK_DEVICE_VERSION, (uint8*)DEVICE_VERSION, len);
             }
             break;
         case CMD_REQ_CHANGE_NAME:
@@ -122,21 +287,16 @@ static void SerialInterface_MsgDispatch( SerialMsg_t* pMsg )
                     GAPRole_SetParameter( GAPROLE_SCAN_RSP_DATA, sizeof ( scanRspData ), scanRspData );
 
                     // Send Ack
-                    Packet = (Packet_t*) osal_mem_alloc(5 + 20);
-                    if (Packet)
-                    {
-                        if(NULL != FramePack((uint8_t*) Packet, CMD_ACK_CHANGE_NAME, &scanRspData[ADV_NAME_INDEX_START], 20))
-                        {
-                            HalUARTWrite(NPI_UART_PORT, (uint8*)Packet, 5 + 20);
-                        }
-                        osal_mem_free(Packet);
-                    }
+                    SerialInterface_TxFrame(CMD_ACK_CHANGE_NAME, &scanRspData[ADV_NAME_INDEX_START], 20);
                 }
             }
             break;
         case CMD_REQ_FLUSH_TX:
             {
                 FlushTxReq = 1;
+
+                // The serial buffer is only polled on a timer while connected
+                BLE_Bridge_KickSend();
             }
             break;
         case CMD_REQ_FLUSH_RX:
@@ -171,6 +331,173 @@ static void SerialInterface_MsgDispatch( SerialMsg_t* pMsg )
                 }
             }
             break;
+        case CMD_REQ_PROFILE:
+            {
+#if OSAL_PROFILE
+                // No data: clear, task id: dump, task id and events: select
+                if(0 == Packet->len)
+                {
+                    osal_profile_reset();
+                    FrameErrorAck(CMD_ACK_PROFILE);
+                }
+                else if(1 == Packet->len)
+                {
+                    SerialInterface_SendProfile(Packet->data[0]);
+                }
+                else if((3 == Packet->len) &&
+                        (SUCCESS == osal_profile_select(Packet->data[0],
+                                                        BUILD_UINT16(Packet->data[1], Packet->data[2]))))
+                {
+                    FrameErrorAck(CMD_ACK_PROFILE);
+                }
+                else
+                {
+                    FrameErrorAck(CMD_ERR_PROFILE);
+                }
+#else
+                FrameErrorAck(CMD_ERR_PROFILE);
+#endif
+            }
+            break;
+        case CMD_REQ_HEAP_STATS:
+            {
+                uint8 page = (0 == Packet->len) ? HEAP_STATS_PAGE_METRICS : Packet->data[0];
+                uint8 len;
+
+                len = buildHeapStats(serialReplyBuf, page, HEAP_STATS_MAX_LEN);
+                if (0 == len)
+                {
+                    FrameErrorAck(CMD_ERR_HEAP_STATS);
+                }
+                else
+                {
+                    SerialInterface_TxFrame(CMD_ACK_HEAP_STATS, serialReplyBuf, len);
+                }
+            }
+            break;
+        case CMD_REQ_TRACE:
+            {
+#if OSAL_TRACE
+                SerialInterface_SendTrace();
+#else
+                FrameErrorAck(CMD_ERR_TRACE);
+#endif
+            }
+            break;
+        case CMD_REQ_POWER_STATS:
+            {
+#if OSAL_PWRMGR_STATS
+                // No data: read, any data: read and clear
+                SerialInterface_SendPowerStats(0 != Packet->len);
+#else
+                FrameErrorAck(CMD_ERR_POWER_STATS);
+#endif
+            }
+            break;
+        case CMD_REQ_UART_STATS:
+            {
+#if HAL_UART_STATS
+                // No data: read, any data: read and clear
+                SerialInterface_SendUartStats(0 != Packet->len);
+#else
+                FrameErrorAck(CMD_ERR_UART_STATS);
+#endif
+            }
+            break;
+        case CMD_REQ_BAUD:
+            {
+#if HAL_UART_DMA
+                if((0 == Packet->len) && (BAUD_STATE_CONFIRM == serialBaudState))
+                {
+                    // The host got here at the new rate, let the held frames go
+                    osal_stop_timerEx(serialInterface_TaskID, SER_BAUD_CONFIRM_EVT);
+                    serialBaud = serialNewBaud;
+                    serialFlow = serialNewFlow;
+                    serialBaudState = BAUD_STATE_IDLE;
+                    serialTxGate = SER_TX_GATE_OPEN;
+                    SerialInterface_SendBaud(serialBaud, serialFlow);
+                }
+                else if((0 == Packet->len) && (BAUD_STATE_IDLE == serialBaudState))
+                {
+                    SerialInterface_SendBaud(serialBaud, serialFlow);
+                }
+                else if((0 != Packet->len) && (BAUD_STATE_IDLE == serialBaudState) &&
+                        (Packet->data[0] <= HAL_UART_BR_1000000))
+                {
+                    serialNewBaud = Packet->data[0];
+                    serialNewFlow = ((Packet->len > 1) && (0 != Packet->data[1])) ? TRUE : FALSE;
+
+                    // Answer at the current rate and hold back what is queued
+                    // after the answer; switch once the answer is out
+                    SerialInterface_SendBaud(serialNewBaud, serialNewFlow);
+                    serialTxGate = serialTxCnt;
+                    serialBaudState = BAUD_STATE_DRAIN;
+                    osal_start_timerEx(serialInterface_TaskID, SER_BAUD_SWITCH_EVT, BAUD_DRAIN_PERIOD);
+                }
+                else
+                {
+                    FrameErrorAck(CMD_ERR_BAUD);
+                }
+#else
+                FrameErrorAck(CMD_ERR_BAUD);
+#endif
+            }
+            break;
+        case CMD_REQ_AUTH:
+            {
+#if CMD_AUTH
+                // No data: read, 0: read and clear, runs: benchmark
+                if((0 == Packet->len) || (0 == Packet->data[0]))
+                {
+                    SerialInterface_SendAuthStats(0 != Packet->len);
+                }
+                else
+                {
+                    SerialInterface_SendAuthBench(Packet->data[0]);
+                }
+#else
+                FrameErrorAck(CMD_ERR_AUTH);
+#endif
+            }
+            break;
+        case CMD_REQ_BLACKBOX:
+            {
+#if BLACKBOX
+                // No data: counts, BLACKBOX_DUMP: dump the log
+                if(0 == Packet->len)
+                {
+                    SerialInterface_SendBlackBoxStats();
+                }
+                else if((BLACKBOX_DUMP == Packet->data[0]) && (FALSE == serialDumping))
+                {
+                    uint8 data[3];
+
+                    serialDumpCnt = BlackBox_DumpStart();
+                    serialDumpIdx = 0;
+
+                    data[0] = LO_UINT16(serialDumpCnt);
+                    data[1] = HI_UINT16(serialDumpCnt);
+                    data[2] = BLACKBOX_CHUNK_SIZE;
+                    if(SUCCESS == SerialInterface_TxFrame(CMD_ACK_BLACKBOX, data, sizeof(data)))
+                    {
+                        serialDumping = TRUE;
+                        serialDumpTime = osal_GetSystemClock();
+                        osal_set_event(serialInterface_TaskID, SER_BLACKBOX_EVT);
+                    }
+                    else
+                    {
+                        BlackBox_DumpEnd();
+                    }
+                }
+                else
+                {
+                    FrameErrorAck(CMD_ERR_BLACKBOX);
+                }
+#else
+                FrameErrorAck(CMD_ERR_BLACKBOX);
+#endif
+            }
+            break;
         default:
             {
                 FrameErrorAck(CMD_ERR_SEND_DATA);
@@ -179,28 +506,406 @@ static void SerialInterface_MsgDispatch( SerialMsg_t* pMsg )
     }
 }
 
-static void SerialInterface_ProcessOSALMsg( osal_event_hdr_t *pMsg )
+#if OSAL_PROFILE
+static void SerialInterface_SendProfile( uint8 task_id )
 {
-    switch ( pMsg->event )
+    // Task id, runs, longest run, longest latency and both histograms, LSB first
+    uint8 len = 1 + 2 * (3 + 2 * OSAL_PROFILE_BUCKETS);
+    osalProfile_t* pProfile = osal_profile_get(task_id);
+
+    if(NULL == pProfile)
     {
-        case SER_NEW_MSG_EVT:
-            {
-                SerialMsg_t* Msg = (SerialMsg_t*)pMsg;
+        FrameErrorAck(CMD_ERR_PROFILE);
+        return;
+    }
 
-                SerialInterface_MsgDispatch(Msg);
-                // Dispatch Message
-                osal_mem_free(Msg->data);
+    {
+        uint8* p = serialReplyBuf;
+
+        *p++ = task_id;
+        *p++ = LO_UINT16(pProfile->runs);
+        *p++ = HI_UINT16(pProfile->runs);
+        *p++ = LO_UINT16(pProfile->runMax);
+        *p++ = HI_UINT16(pProfile->runMax);
+        *p++ = LO_UINT16(pProfile->latMax);
+        *p++ = HI_UINT16(pProfile->latMax);
+        for(uint8 i = 0; i < OSAL_PROFILE_BUCKETS; i++)
+        {
+            *p++ = LO_UINT16(pProfile->runHist[i]);
+            *p++ = HI_UINT16(pProfile->runHist[i]);
+        }
+        for(uint8 i = 0; i < OSAL_PROFILE_BUCKETS; i++)
+        {
+            *p++ = LO_UINT16(pProfile->latHist[i]);
+            *p++ = HI_UINT16(pProfile->latHist[i]);
+        }
+    }
+
+    SerialInterface_TxFrame(CMD_ACK_PROFILE, serialReplyBuf, len);
+}
+#endif
+
+#if OSAL_TRACE
+static void SerialInterface_SendTrace( void )
+{
+    // Lost record count, LSB first, then the oldest records; the host
+    // repeats the request until a frame comes back without records
+    uint16 lost;
+    uint8 num;
+
+    num = osal_trace_copy(&serialReplyBuf[2], TRACE_FRAME_RECS, &lost);
+    serialReplyBuf[0] = LO_UINT16(lost);
+    serialReplyBuf[1] = HI_UINT16(lost);
+
+    if(SUCCESS == SerialInterface_TxFrame(CMD_ACK_TRACE, serialReplyBuf,
+                                          2 + num * OSAL_TRACE_REC_LEN))
+    {
+        // Only drop the records once they are on their way
+        osal_trace_drop(num, lost);
+    }
+}
+#endif
+
+#if OSAL_PWRMGR_STATS
+static void SerialInterface_SendPowerStats( uint8 clear )
+{
+    // Awake and sleep ticks, then the sleep, untimed sleep, hold and
+    // holding task counts, LSB first
+    uint8 buf[2 * 4 + 4 * 2];
+    pwrmgr_stats_t stats;
+
+    osal_pwrmgr_stats(&stats);
+    if(clear)
+    {
+        osal_pwrmgr_stats_reset();
+    }
+
+    {
+        uint8* p = buf;
+
+        *p++ = BREAK_UINT32(stats.awakeTicks, 0);
+        *p++ = BREAK_UINT32(stats.awakeTicks, 1);
+        *p++ = BREAK_UINT32(stats.awakeTicks, 2);
+        *p++ = BREAK_UINT32(stats.awakeTicks, 3);
+        *p++ = BREAK_UINT32(stats.sleepTicks, 0);
+        *p++ = BREAK_UINT32(stats.sleepTicks, 1);
+        *p++ = BREAK_UINT32(stats.sleepTicks, 2);
+        *p++ = BREAK_UINT32(stats.sleepTicks, 3);
+        *p++ = LO_UINT16(stats.sleeps);
+        *p++ = HI_UINT16(stats.sleeps);
+        *p++ = LO_UINT16(stats.untimedSleeps);
+        *p++ = HI_UINT16(stats.untimedSleeps);
+        *p++ = LO_UINT16(stats.holds);
+        *p++ = HI_UINT16(stats.holds);
+        *p++ = LO_UINT16(stats.holdTasks);
+        *p++ = HI_UINT16(stats.holdTasks);
+    }
+
+    SerialInterface_TxFrame(CMD_ACK_POWER_STATS, buf, sizeof(buf));
+}
+#endif
+
+#if HAL_UART_STATS
+static void SerialInterface_SendUartStats( uint8 clear )
+{
+    // Rx and Tx high-water marks, Rx full polls and refused writes of the
+    // driver, then the Tx queue high-water mark and dropped frames, LSB first
+    uint8 buf[6 * 2];
+    halUARTStats_t stats;
+
+    HalUARTStats(NPI_UART_PORT, &stats, clear);
+
+    {
+        uint8* p = buf;
+
+        *p++ = LO_UINT16(stats.rxHigh);
+        *p++ = HI_UINT16(stats.rxHigh);
+        *p++ = LO_UINT16(stats.txHigh);
+        *p++ = HI_UINT16(stats.txHigh);
+        *p++ = LO_UINT16(stats.rxFull);
+        *p++ = HI_UINT16(stats.rxFull);
+        *p++ = LO_UINT16(stats.txFull);
+        *p++ = HI_UINT16(stats.txFull);
+        *p++ = LO_UINT16(serialTxHigh);
+        *p++ = HI_UINT16(serialTxHigh);
+        *p++ = LO_UINT16(serialTxDrops);
+        *p++ = HI_UINT16(serialTxDrops);
+    }
+
+    if(clear)
+    {
+        serialTxHigh = serialTxCnt;
+        serialTxDrops = 0;
+    }
+
+    SerialInterface_TxFrame(CMD_ACK_UART_STATS, buf, sizeof(buf));
+}
+#endif
+
+#if CMD_AUTH
+static void SerialInterface_SendAuthStats( uint8 clear )
+{
+    // Accepted, MIC errors, replays and the next counter, LSB first
+    uint8 buf[3 * 2 + 4];
+    uint8* p = buf;
+    uint32 cnt = CmdAuth_GetCounter();
+    cmdAuthStats_t stats;
+
+    CmdAuth_GetStats(&stats, clear);
+
+    *p++ = LO_UINT16(stats.accepted);
+    *p++ = HI_UINT16(stats.accepted);
+    *p++ = LO_UINT16(stats.micErrors);
+    *p++ = HI_UINT16(stats.micErrors);
+    *p++ = LO_UINT16(stats.replays);
+    *p++ = HI_UINT16(stats.replays);
+    *p++ = BREAK_UINT32(cnt, 0);
+    *p++ = BREAK_UINT32(cnt, 1);
+    *p++ = BREAK_UINT32(cnt, 2);
+    *p++ = BREAK_UINT32(cnt, 3);
+
+    SerialInterface_TxFrame(CMD_ACK_AUTH, buf, sizeof(buf));
+}
+
+static void SerialInterface_SendAuthBench( uint8 runs )
+{
+    // Runs, ticks and us per command, LSB first
+    uint8 buf[1 + 4 + 2];
+    uint32 ticks = CmdAuth_Bench(runs);
+    uint16 us = (uint16)((ticks * 15625 / 512) / runs);   // 1000000 / 32768 us per tick
+
+    buf[0] = runs;
+    buf[1] = BREAK_UINT32(ticks, 0);
+    buf[2] = BREAK_UINT32(ticks, 1);
+    buf[3] = BREAK_UINT32(ticks, 2);
+    buf[4] = BREAK_UINT32(ticks, 3);
+    buf[5] = LO_UINT16(us);
+    buf[6] = HI_UINT16(us);
+
+    SerialInterface_TxFrame(CMD_ACK_AUTH, buf, sizeof(buf));
+}
+#endif
+
+#if BLACKBOX
+static void SerialInterface_SendBlackBoxStats( void )
+{
+    // Records, dropped, chunks written, pages erased and the longest step,
+    // LSB first, then the pages and the chunk size
+    uint8 buf[5 * 2 + 2];
+    uint8* p = buf;
+    blackBoxStats_t stats;
+
+    BlackBox_GetStats(&stats);
+
+    *p++ = LO_UINT16(stats.records);
+    *p++ = HI_UINT16(stats.records);
+    *p++ = LO_UINT16(stats.dropped);
+    *p++ = HI_UINT16(stats.dropped);
+    *p++ = LO_UINT16(stats.writes);
+    *p++ = HI_UINT16(stats.writes);
+    *p++ = LO_UINT16(stats.erases);
+    *p++ = HI_UINT16(stats.erases);
+    *p++ = LO_UINT16(stats.stepMax);
+    *p++ = HI_UINT16(stats.stepMax);
+    *p++ = BLACKBOX_PAGE_CNT;
+    *p++ = BLACKBOX_CHUNK_SIZE;
+
+    SerialInterface_TxFrame(CMD_ACK_BLACKBOX, buf, sizeof(buf));
+}
+
+/*
+ * Queue dump frames while the Tx queue has room for them, and come back
+ * on the next Tx event of the driver or after SER_BLACKBOX_PERIOD. The
+ * host sees a dump given up after SER_BLACKBOX_TIMEOUT end short of the
+ * count it was acknowledged with.
+ */
+static void SerialInterface_BlackBoxDump( void )
+{
+    uint8 n;
+
+    while(serialDumpIdx < serialDumpCnt)
+    {
+        n = SER_BLACKBOX_CHUNKS;
+        if(n > serialDumpCnt - serialDumpIdx)
+        {
+            n = (uint8)(serialDumpCnt - serialDumpIdx);
+        }
+
+        if((SER_TX_QUEUE_SIZE - serialTxCnt) < (5 + 2 + (uint16)n * BLACKBOX_CHUNK_SIZE))
+        {
+            if((osal_GetSystemClock() - serialDumpTime) >= SER_BLACKBOX_TIMEOUT)
+            {
+                break;
             }
+
+            osal_start_timerEx(serialInterface_TaskID, SER_BLACKBOX_EVT, SER_BLACKBOX_PERIOD);
+            return;
+        }
+
+        serialReplyBuf[0] = LO_UINT16(serialDumpIdx);
+        serialReplyBuf[1] = HI_UINT16(serialDumpIdx);
+        for(uint8 i = 0; i < n; i++)
+        {
+            BlackBox_DumpRead(serialDumpIdx++, &serialReplyBuf[2 + i * BLACKBOX_CHUNK_SIZE]);
+        }
+
+        SerialInterface_TxFrame(CMD_ACK_BLACKBOX, serialReplyBuf, 2 + n * BLACKBOX_CHUNK_SIZE);
+        serialDumpTime = osal_GetSystemClock();
+    }
+
+    osal_stop_timerEx(serialInterface_TaskID, SER_BLACKBOX_EVT);
+    serialDumping = FALSE;
+    BlackBox_DumpEnd();
+}
+#endif
+
+#if HAL_UART_DMA
+static void SerialInterface_SendBaud( uint8 baud, uint8 flow )
+{
+    uint8 data[2];
+
+    data[0] = baud;
+    data[1] = flow;
+    SerialInterface_TxFrame(CMD_ACK_BAUD, data, 2);
+}
+
+static void SerialInterface_BaudSwitch( void )
+{
+    if((0 != serialTxGate) || (0 != NPI_TxBufLen()))
+    {
+        serialBaudState = BAUD_STATE_DRAIN;
+    }
+    else if(BAUD_STATE_DRAIN == serialBaudState)
+    {
+        // The last byte may still be in the shift register
+        serialBaudState = BAUD_STATE_SETTLE;
+    }
+    else
+    {
+        SerialInterface_BaudOpen(serialNewBaud, serialNewFlow);
+        serialBaudState = BAUD_STATE_CONFIRM;
+        osal_start_timerEx(serialInterface_TaskID, SER_BAUD_CONFIRM_EVT, BAUD_CONFIRM_TIMEOUT);
+        return;
+    }
+
+    osal_start_timerEx(serialInterface_TaskID, SER_BAUD_SWITCH_EVT, BAUD_DRAIN_PERIOD);
+}
+
+static void SerialInterface_BaudOpen( uint8 baud, uint8 flow )
+{
+    uint8 chunk[RX_CHUNK_SIZE];
+
+    NPI_OpenTransport(SerialPacketParser, baud, flow);
+
+    // Whatever came in around the switch was sampled at the wrong rate
+    while(0 != NPI_ReadTransport(chunk, sizeof(chunk)))
+    {
+    }
+}
+#endif
+
+/*
+ * Queue a frame for the host, built as FramePack() would. Returns SUCCESS,
+ * or FAILURE if the frame does not fit; it is then dropped and counted.
+ */
+uint8 SerialInterface_TxFrame( uint8 type, uint8* pData, uint8 len )
+{
+    uint16 idx;
+    uint8 xor;
+
+#if SER_COALESCE_DELAY
+    // BLE data collected before this frame was built goes out ahead of it
+    if((CMD_REQ_APP_DATA) != type)
+    {
+        SerialInterface_FlushDown();
+    }
+#endif
+
+    if((SER_TX_QUEUE_SIZE - serialTxCnt) < (5 + (uint16)len))
+    {
+#if HAL_UART_STATS
+        if(serialTxDrops != 0xFFFF)
+        {
+            serialTxDrops++;
+        }
+#endif
+        return FAILURE;
+    }
+
+    idx = serialTxHead + serialTxCnt;
+    serialTxQ[idx++ & (SER_TX_QUEUE_SIZE - 1)] = PACKET_MEM_HEADER_0;
+    serialTxQ[idx++ & (SER_TX_QUEUE_SIZE - 1)] = PACKET_MEM_HEADER_1;
+    serialTxQ[idx++ & (SER_TX_QUEUE_SIZE - 1)] = type;
+    serialTxQ[idx++ & (SER_TX_QUEUE_SIZE - 1)] = len;
+    xor = PACKET_MEM_HEADER_0 ^ PACKET_MEM_HEADER_1 ^ type ^ len;
+    for(uint8 i = 0; i < len; i++)
+    {
+        xor ^= pData[i];
+        serialTxQ[idx++ & (SER_TX_QUEUE_SIZE - 1)] = pData[i];
+    }
+    serialTxQ[idx & (SER_TX_QUEUE_SIZE - 1)] = xor;
+    serialTxCnt += 5 + len;
+
+#if HAL_UART_STATS
+    if(serialTxHigh < serialTxCnt)
+    {
+        serialTxHigh = serialTxCnt;
+    }
+#endif
+
+    SerialInterface_TxDrain();
+
+    return SUCCESS;
+}
+
+/*
+ * Hand queued bytes to the UART driver until its Tx buffer is full; the rest
+ * goes when the driver reports HAL_UART_TX_EMPTY.
+ */
+static void SerialInterface_TxDrain( void )
+{
+    uint16 n;
+
+    while((0 != serialTxCnt) && (0 != serialTxGate))
+    {
+        // Up to the end of the ring, then from its start
+        n = SER_TX_QUEUE_SIZE - serialTxHead;
+        if(n > serialTxCnt)
+        {
+            n = serialTxCnt;
+        }
+        if(n > serialTxGate)
+        {
+            n = serialTxGate;
+        }
+        if(n > SER_TX_CHUNK)
+        {
+            n = SER_TX_CHUNK;
+        }
+
+        if(0 == HalUARTWrite(NPI_UART_PORT, &serialTxQ[serialTxHead], n))
+        {
             break;
+        }
+
+        serialTxHead = (serialTxHead + n) & (SER_TX_QUEUE_SIZE - 1);
+        serialTxCnt -= n;
+        if(SER_TX_GATE_OPEN != serialTxGate)
+        {
+            serialTxGate -= n;
+        }
+    }
+}
 
-        case SER_APP_MSG_EVT:
+static void SerialInterface_ProcessOSALMsg( osal_event_hdr_t *pMsg )
+{
+    switch ( pMsg->event )
+    {
+        case SER_NEW_MSG_EVT:
             {
-                // App Data
-                // Down Stream
                 SerialMsg_t* Msg = (SerialMsg_t*)pMsg;
 
-                HalUARTWrite(NPI_UART_PORT, (uint8*)Msg->data, Msg->len);
-
+                SerialInterface_MsgDispatch(Msg);
                 // Dispatch Message
                 osal_mem_free(Msg->data);
             }
@@ -216,39 +921,67 @@ void SerialPacketParser( uint8 port, uint8 events )
 {
     //unused input parameters
     (void)port;
-    (void)events;
 
     uint8* result = NULL;
-    uint8  tmp;
-    uint8 numBytes;
+    uint8  chunk[RX_CHUNK_SIZE];
+    uint16 numBytes;
+    uint8  n;
 
-   // get the number of available bytes to process
+   // Room in the Tx buffer for queued frames; not every driver reports
+   // HAL_UART_TX_EMPTY, so try on any event
+   SerialInterface_TxDrain();
+
+#if BLACKBOX
+   // The queue may have room for the next frames of a dump
+   if(serialDumping)
+   {
+       osal_set_event(serialInterface_TaskID, SER_BLACKBOX_EVT);
+   }
+#endif
+
+   // Tx events carry no Rx data
+   if(0 == (events & (HAL_UART_RX_FULL | HAL_UART_RX_ABOUT_FULL | HAL_UART_RX_TIMEOUT)))
+   {
+       return;
+   }
+
+   // get the number of available bytes to process, the Rx buffer may hold more than 255
    numBytes = NPI_RxBufLen();
+   OSAL_TRACE_REC(OSAL_TRACE_UART_RX, port, numBytes);
 
-   for(uint8 i = 0; i < numBytes; i++)
+   for(; numBytes != 0; numBytes -= n)
    {
-       (void)NPI_ReadTransport((uint8 *)&tmp, 1);
-       result = FrameUnpack(tmp);
-       if(NULL != result)
+       n = (numBytes > RX_CHUNK_SIZE) ? RX_CHUNK_SIZE : (uint8)numBytes;
+       n = (uint8)NPI_ReadTransport(chunk, n);
+       if(0 == n)
        {
-            SerialMsg_t* Msg;
-            Packet_t* Packet = (Packet_t*)result;
+           break;
+       }
 
-            // TODO: Send Message to App layer
-            Msg = (SerialMsg_t*)osal_msg_allocate( sizeof(SerialMsg_t));
-            if(NULL != Msg)
-            {
-                Msg->data = osal_mem_alloc( 2 + 1 + 1+ Packet->len + 1);
-                if(NULL != Msg->data)
+       for(uint8 i = 0; i < n; i++)
+       {
+           result = FrameUnpack(chunk[i]);
+           if(NULL != result)
+           {
+                SerialMsg_t* Msg;
+                Packet_t* Packet = (Packet_t*)result;
+
+                // TODO: Send Message to App layer
+                Msg = (SerialMsg_t*)osal_msg_allocate( sizeof(SerialMsg_t));
+                if(NULL != Msg)
                 {
-                    Msg->hdr.event = SER_NEW_MSG_EVT;
-                    Msg->len = 2 + 1 + 1 + Packet->len + 1;
-                    Msg->type = Packet->type;
-                    memcpy(Msg->data, result, Msg->len);
+                    Msg->data = osal_mem_alloc( 2 + 1 + 1+ Packet->len + 1);
+                    if(NULL != Msg->data)
+                    {
+                        Msg->hdr.event = SER_NEW_MSG_EVT;
+                        Msg->len = 2 + 1 + 1 + Packet->len + 1;
+                        Msg->type = Packet->type;
+                        memcpy(Msg->data, result, Msg->len);
 
-                    osal_msg_send( serialInterface_TaskID, (uint8 *)Msg );
+                        osal_msg_send( serialInterface_TaskID, (uint8 *)Msg );
+                    }
                 }
-            }
+           }
        }
    }
 }
@@ -320,64 +1053,137 @@ void cSerialPacketParser( uint8 port, uint8 events )
 
 uint8 SendMessage(uint8 cmd, uint8 info_sent)
 {
-    Packet_t Packet;
+    return SerialInterface_TxFrame(cmd, &info_sent, 1);
+}
+
+uint8 sendAckMessage(uint8 bytes_sent)
+{
+    return SendMessage(CMD_ACK_SEND_DATA, bytes_sent);
+}
 
-    if(NULL != FramePack((uint8_t*) &Packet, cmd, &info_sent, 1))
+/*
+ * Send BLE data to the host. Writes arriving within SER_COALESCE_DELAY of
+ * the first one are sent together, in frames of up to SER_COALESCE_MAX bytes.
+ */
+uint8 sendDataToHost(uint8* data, uint8 len)
+{
+#if SER_COALESCE_DELAY
+    if((uint16)serialDownLen + len > SER_COALESCE_MAX)
     {
-        if(6 != HalUARTWrite(NPI_UART_PORT, (uint8*)&Packet, 6))
-        {
-            return SUCCESS;
-        }
-        else
+        SerialInterface_FlushDown();
+
+        if(len > SER_COALESCE_MAX)
         {
-            return FAILURE;
+            return SerialInterface_TxFrame(CMD_REQ_APP_DATA, data, len);
         }
     }
 
-    return FAILURE;
+    if(0 == serialDownLen)
+    {
+        osal_start_timerEx(serialInterface_TaskID, SER_COALESCE_EVT, SER_COALESCE_DELAY);
+    }
+
+    osal_memcpy(&serialDownBuf[serialDownLen], data, len);
+    serialDownLen += len;
+
+    if(SER_COALESCE_MAX == serialDownLen)
+    {
+        SerialInterface_FlushDown();
+    }
+
+    return SUCCESS;
+#else
+    return SerialInterface_TxFrame(CMD_REQ_APP_DATA, data, len);
+#endif
 }
 
-uint8 sendAckMessage(uint8 bytes_sent)
+#if SER_COALESCE_DELAY
+/*
+ * Frame the collected BLE data, on its timer, when the buffer fills, or
+ * ahead of any other frame so that the host sees them in order. If the Tx
+ * queue is full it is dropped and counted like any other frame.
+ */
+static void SerialInterface_FlushDown( void )
 {
-    return SendMessage(CMD_ACK_SEND_DATA, bytes_sent);
+    if(0 != serialDownLen)
+    {
+        osal_stop_timerEx(serialInterface_TaskID, SER_COALESCE_EVT);
+        SerialInterface_TxFrame(CMD_REQ_APP_DATA, serialDownBuf, serialDownLen);
+        serialDownLen = 0;
+    }
 }
+#endif
 
-uint8 sendDataToHost(uint8* data, uint8 len)
+/*
+ * Heap statistics, uint16 values LSB first. Only whole values that fit in
+ * maxLen are written. Returns the length, 0 if the page is not available.
+ *
+ * HEAP_STATS_PAGE_METRICS:  heap size, bytes used, most bytes used,
+ *   blocks, free blocks, most blocks, failed allocations, size of the
+ *   last failed allocation, then task id (1 byte) and failed allocations
+ *   of each task that had any.
+ * HEAP_STATS_PAGE_PROFILER: largest size, blocks, most blocks and total
+ *   allocations of each profiling bucket.
+ */
+uint8 buildHeapStats(uint8* buf, uint8 page, uint8 maxLen)
 {
-    SerialMsg_t* Msg;
-    Packet_t*    Packet;
+    uint8* p = buf;
 
-    Msg = (SerialMsg_t*)osal_msg_allocate( sizeof(SerialMsg_t));
-    if(NULL != Msg)
+    (void)page;
+    (void)maxLen;
+
+#if OSALMEM_METRICS
+    if (HEAP_STATS_PAGE_METRICS == page)
     {
-        Msg->data = osal_mem_alloc( 2 + 1 + 1+ len + 1);
-        if(NULL != Msg->data)
-        {
-            Packet = (Packet_t*)Msg->data;
+        uint16 val[8];
+        uint8 taskId;
+        uint16 cnt;
 
-            Msg->hdr.event = SER_APP_MSG_EVT;
-            Msg->len = 2 + 1 + 1 + len + 1;
-            Msg->type = CMD_REQ_APP_DATA;
-            FramePack(Msg->data, CMD_REQ_APP_DATA, data, len);
+        val[0] = MAXMEMHEAP;
+        val[1] = osal_heap_mem_used();
+        val[2] = osal_heap_high_water();
+        val[3] = osal_heap_block_cnt();
+        val[4] = osal_heap_block_free();
+        val[5] = osal_heap_block_max();
+        val[6] = osal_heap_fail_cnt();
+        val[7] = osal_heap_fail_len();
 
-            osal_msg_send( serialInterface_TaskID, (uint8 *)Msg );
+        for (uint8 i = 0; (i < 8) && (p + 2 <= buf + maxLen); i++)
+        {
+            *p++ = LO_UINT16(val[i]);
+            *p++ = HI_UINT16(val[i]);
+        }
+        for (uint8 i = 0; (p + 3 <= buf + maxLen) && osal_heap_fail_site(i, &taskId, &cnt); i++)
+        {
+            *p++ = taskId;
+            *p++ = LO_UINT16(cnt);
+            *p++ = HI_UINT16(cnt);
         }
     }
+#endif
+#if OSALMEM_PROFILER
+    if (HEAP_STATS_PAGE_PROFILER == page)
+    {
+        uint16 val[4];
 
-    return 0;
+        for (uint8 i = 0; (p + sizeof(val) <= buf + maxLen) &&
+                          osal_heap_profile_bucket(i, &val[0], &val[1], &val[2], &val[3]); i++)
+        {
+            for (uint8 k = 0; k < 4; k++)
+            {
+                *p++ = LO_UINT16(val[k]);
+                *p++ = HI_UINT16(val[k]);
+            }
+        }
+    }
+#endif
+
+    return (uint8)(p - buf);
 }
 
 uint8 FrameErrorAck(uint8 err)
 {
-    Packet_t Packet;
-    uint8 bytes_sent = 0;
-
-    if(NULL != FramePack((uint8_t*) &Packet, err, NULL, 0))
-    {
-        bytes_sent = HalUARTWrite(NPI_UART_PORT, (uint8*)&Packet, 5);
-    }
-
-    return bytes_sent;
+    return (SUCCESS == SerialInterface_TxFrame(err, NULL, 0)) ? 5 : 0;
 }
 
 uint16 circular_diff(uint16 offset, uint16 tail)
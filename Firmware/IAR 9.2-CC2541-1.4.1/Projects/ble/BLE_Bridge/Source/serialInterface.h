@@ -8,7 +8,10 @@
 
 // BLE_Bridge Task Events
 #define SER_NEW_MSG_EVT                              0x0001
-#define SER_APP_MSG_EVT                              0x0002
+#define SER_BAUD_SWITCH_EVT                          0x0004
+#define SER_BAUD_CONFIRM_EVT                         0x0008
+#define SER_COALESCE_EVT                             0x0010
+#define SER_BLACKBOX_EVT                             0x0020
 
 #define DEVICE_VERSION                  "FanDao SLBM04 V4.0.0 2015-09-05"
 
@@ -36,6 +39,14 @@
 #define FRAME_COMMAD_CMD_FLUSH_RX       0x05
 #define FRAME_COMMAD_CMD_STATE          0x06
 #define FRAME_COMMAD_CMD_POWER          0x07
+#define FRAME_COMMAD_CMD_PROFILE        0x08
+#define FRAME_COMMAD_CMD_TRACE          0x09
+#define FRAME_COMMAD_CMD_HEAP_STATS     0x0A
+#define FRAME_COMMAD_CMD_POWER_STATS    0x0B
+#define FRAME_COMMAD_CMD_UART_STATS     0x0C
+#define FRAME_COMMAD_CMD_BAUD           0x0D
+#define FRAME_COMMAD_CMD_AUTH           0x0E
+#define FRAME_COMMAD_CMD_BLACKBOX       0x0F
 
 /*--- Cmd Lists ---*/
 
@@ -64,6 +75,30 @@
 #define CMD_REQ_DEVICE_POWER            FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
                                         FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_POWER
 
+#define CMD_REQ_PROFILE                 FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_PROFILE
+
+#define CMD_REQ_TRACE                   FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_TRACE
+
+#define CMD_REQ_HEAP_STATS              FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_HEAP_STATS
+
+#define CMD_REQ_POWER_STATS             FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_POWER_STATS
+
+#define CMD_REQ_UART_STATS              FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_UART_STATS
+
+#define CMD_REQ_BAUD                    FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_BAUD
+
+#define CMD_REQ_AUTH                    FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_AUTH
+
+#define CMD_REQ_BLACKBOX                FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_UP |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_BLACKBOX
+
 // Down
 #define CMD_REQ_APP_DATA                FRAME_COMMAD_VALUE_REQ | FRAME_COMMAD_VALUE_DOWN |\
                                         FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_DATA
@@ -92,6 +127,30 @@
 #define CMD_ACK_DEVICE_POWER            FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
                                         FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_POWER
 
+#define CMD_ACK_PROFILE                 FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_PROFILE
+
+#define CMD_ACK_TRACE                   FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_TRACE
+
+#define CMD_ACK_HEAP_STATS              FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_HEAP_STATS
+
+#define CMD_ACK_POWER_STATS             FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_POWER_STATS
+
+#define CMD_ACK_UART_STATS              FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_UART_STATS
+
+#define CMD_ACK_BAUD                    FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_BAUD
+
+#define CMD_ACK_AUTH                    FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_AUTH
+
+#define CMD_ACK_BLACKBOX                FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_SUCCESS | FRAME_COMMAD_CMD_BLACKBOX
+
 // Error
 #define CMD_ERR_SEND_DATA               FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
                                         FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_DATA
@@ -117,6 +176,58 @@
 #define CMD_ERR_DEVICE_POWER            FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
                                         FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_POWER
 
+#define CMD_ERR_PROFILE                 FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_PROFILE
+
+#define CMD_ERR_TRACE                   FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_TRACE
+
+#define CMD_ERR_HEAP_STATS              FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_HEAP_STATS
+
+#define CMD_ERR_POWER_STATS             FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_POWER_STATS
+
+#define CMD_ERR_UART_STATS              FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_UART_STATS
+
+#define CMD_ERR_BAUD                    FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_BAUD
+
+#define CMD_ERR_AUTH                    FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_AUTH
+
+#define CMD_ERR_BLACKBOX                FRAME_COMMAD_VALUE_ACK | FRAME_COMMAD_VALUE_DOWN |\
+                                        FRAME_COMMAD_VALUE_FAILURE | FRAME_COMMAD_CMD_BLACKBOX
+
+// CMD_REQ_HEAP_STATS pages
+#define HEAP_STATS_PAGE_METRICS         0x00
+#define HEAP_STATS_PAGE_PROFILER        0x01
+
+// CMD_REQ_BAUD: with a HAL_UART_BR_xxx rate and a flow control flag (RTS/CTS
+// if not 0) the bridge acknowledges at the current rate, then switches once the
+// acknowledgement is out. The host switches on the acknowledgement and sends
+// CMD_REQ_BAUD without data at the new rate, which the bridge acknowledges; if
+// that does not arrive within BAUD_CONFIRM_TIMEOUT the bridge goes back to the
+// previous rate and sends CMD_ERR_BAUD there. Without data it also reads the
+// current rate. Both acknowledgements carry the rate and the flow control flag.
+#define BAUD_CONFIRM_TIMEOUT            1000
+
+// CMD_REQ_AUTH: without data, or with 0 to also clear them, the bridge answers
+// with the command counts of cmdAuthStats_t and the next counter (32 bits).
+// With a number of runs it opens that many commands and answers with the
+// runs, the time taken in 32 kHz ticks (32 bits) and the time per command in
+// us. Both need CMD_AUTH.
+
+// CMD_REQ_BLACKBOX: without data the bridge answers with the recorder counts
+// of blackBoxStats_t, the number of flash pages and the chunk size. With
+// BLACKBOX_DUMP it answers with the number of chunks in the log (16 bits) and
+// the chunk size, then sends the chunks oldest first, as fast as the UART
+// takes them, in frames of the index of their first chunk (16 bits) and as
+// many chunks as fit 250 bytes. Nothing is written to flash until the last
+// chunk is queued. Both need BLACKBOX.
+#define BLACKBOX_DUMP                   0x01
+
 //===================================================
 
 /* States for CRC parser */
@@ -174,6 +285,10 @@ extern uint8 sendAckMessage(uint8 bytes_sent);
 
 extern uint8 sendDataToHost(uint8* data, uint8 len);
 
+extern uint8 SerialInterface_TxFrame( uint8 type, uint8* pData, uint8 len );
+
+extern uint8 buildHeapStats(uint8* buf, uint8 page, uint8 maxLen);
+
 extern uint16 circular_add(uint16 x, uint16 y);
 
 extern uint16 circular_diff(uint16 offset, uint16 tail);
\ No newline at end of file
@@ -0,0 +1,869 @@
+/**************************************************************************************************
+  Filename:       telemetryservice.c
+
+  Description:    Telemetry service. The application stores the samples of
+                  the sensors with Telemetry_SetSample() and sends them with
+                  Telemetry_Notify(), packed into one notification behind a
+                  small header. Sensors whose sample changed little since the
+                  previous notification are delta coded, and sensors that do
+                  not fit are sent first in the next notification.
+**************************************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "bcomdef.h"
+#include "OSAL.h"
+#include "linkdb.h"
+#include "gatt.h"
+#include "gatt_uuid.h"
+#include "gattservapp.h"
+
+#include "telemetryservice.h"
+#include "st_util.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+/* Service configuration values */
+#define SENSOR_SERVICE_UUID     TELEMETRY_SERV_UUID
+#define SENSOR_DATA_UUID        TELEMETRY_DATA_UUID
+#define SENSOR_CONFIG_UUID      TELEMETRY_CONF_UUID
+#define SENSOR_PERIOD_UUID      TELEMETRY_PERI_UUID
+
+#define SENSOR_SERVICE          TELEMETRY_SERVICE
+
+#ifdef USER_DESCRIPTION
+#define SENSOR_DATA_DESCR       "Telemetry Data"
+#define SENSOR_CONFIG_DESCR     "Telemetry Conf."
+#define SENSOR_PERIOD_DESCR     "Telemetry Period"
+#endif
+
+// Total length of the samples of all sensors
+#define TELEMETRY_SAMPLES_LEN   33
+
+#if TELEMETRY_MAX_LEN < TELEMETRY_HDR_LEN + 6
+  #error TELEMETRY_MAX_LEN must hold the header and the longest sample!
+#endif
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+ * GLOBAL VARIABLES
+ */
+
+// Service UUID
+static CONST uint8 sensorServiceUUID[TI_UUID_SIZE] =
+{
+  TI_UUID(SENSOR_SERVICE_UUID),
+};
+
+// Characteristic UUID: data
+static CONST uint8 sensorDataUUID[TI_UUID_SIZE] =
+{
+  TI_UUID(SENSOR_DATA_UUID),
+};
+
+// Characteristic UUID: config
+static CONST uint8 sensorCfgUUID[TI_UUID_SIZE] =
+{
+  TI_UUID(SENSOR_CONFIG_UUID),
+};
+
+// Characteristic UUID: period
+static CONST uint8 sensorPeriodUUID[TI_UUID_SIZE] =
+{
+  TI_UUID(SENSOR_PERIOD_UUID),
+};
+
+// Length and offset in telemetrySample of the sample of each sensor, in bit order
+static CONST uint8 telemetrySampleLen[TELEMETRY_NUM_SENSORS] = { 4, 4, 6, 3, 4, 6, 6 };
+static CONST uint8 telemetrySampleOfs[TELEMETRY_NUM_SENSORS] = { 0, 4, 8, 14, 17, 21, 27 };
+
+/*********************************************************************
+ * EXTERNAL VARIABLES
+ */
+
+/*********************************************************************
+ * EXTERNAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static sensorCBs_t *sensor_AppCBs = NULL;
+
+static uint8 telemetrySample[TELEMETRY_SAMPLES_LEN];  // Latest samples
+static uint8 telemetryRef[TELEMETRY_SAMPLES_LEN];     // Samples last sent
+static uint8 telemetryDirty;                          // Sensors with a sample not sent yet
+static uint8 telemetryRefValid;                       // Sensors the clients have telemetryRef of
+static uint8 telemetryNext;                           // Sensor to start packing at
+static uint8 telemetrySeq;
+static uint8 telemetryKeyCnt;                         // Notifications to the next key notification
+static uint8 telemetryLen;                            // Length of sensorData
+static bStatus_t telemetryStatus;                     // Status of the last notification
+
+/*********************************************************************
+ * Profile Attributes - variables
+ */
+
+// Profile Service attribute
+static CONST gattAttrType_t sensorService = { TI_UUID_SIZE, sensorServiceUUID };
+
+// Characteristic Value: data, the last notification
+static uint8 sensorData[TELEMETRY_MAX_LEN];
+
+// Characteristic Properties: data
+static uint8 sensorDataProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
+
+// Characteristic Configuration: data
+static gattCharCfg_t *sensorDataConfig;
+
+#ifdef USER_DESCRIPTION
+// Characteristic User Description: data
+static uint8 sensorDataUserDescr[] = SENSOR_DATA_DESCR;
+#endif
+
+// Characteristic Properties: configuration
+static uint8 sensorCfgProps = GATT_PROP_READ | GATT_PROP_WRITE;
+
+// Characteristic Value: configuration
+static uint8 sensorCfg = 0;
+
+#ifdef USER_DESCRIPTION
+// Characteristic User Description: configuration
+static uint8 sensorCfgUserDescr[] = SENSOR_CONFIG_DESCR;
+#endif
+
+// Characteristic Properties: period
+static uint8 sensorPeriodProps = GATT_PROP_READ | GATT_PROP_WRITE;
+
+// Characteristic Value: period
+static uint8 sensorPeriod = TELEMETRY_MIN_UPDATE_PERIOD / SENSOR_PERIOD_RESOLUTION;
+
+#ifdef USER_DESCRIPTION
+// Characteristic User Description: period
+static uint8 sensorPeriodUserDescr[] = SENSOR_PERIOD_DESCR;
+#endif
+
+/*********************************************************************
+ * Profile Attributes - Table
+ */
+
+static gattAttribute_t sensorAttrTable[] =
+{
+  {
+    { ATT_BT_UUID_SIZE, primaryServiceUUID }, /* type */
+    GATT_PERMIT_READ,                         /* permissions */
+    0,                                        /* handle */
+    (uint8 *)&sensorService                   /* pValue */
+  },
+
+    // Characteristic Declaration
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &sensorDataProps
+    },
+
+      // Characteristic Value "Data"
+      {
+        { TI_UUID_SIZE, sensorDataUUID },
+        GATT_PERMIT_READ,
+        0,
+        sensorData
+      },
+
+      // Characteristic configuration
+      {
+        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0,
+        (uint8 *)&sensorDataConfig
+      },
+#ifdef USER_DESCRIPTION
+      // Characteristic User Description
+      {
+        { ATT_BT_UUID_SIZE, charUserDescUUID },
+        GATT_PERMIT_READ,
+        0,
+        sensorDataUserDescr
+      },
+#endif
+    // Characteristic Declaration
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &sensorCfgProps
+    },
+
+      // Characteristic Value "Configuration"
+      {
+        { TI_UUID_SIZE, sensorCfgUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0,
+        &sensorCfg
+      },
+#ifdef USER_DESCRIPTION
+      // Characteristic User Description
+      {
+        { ATT_BT_UUID_SIZE, charUserDescUUID },
+        GATT_PERMIT_READ,
+        0,
+        sensorCfgUserDescr
+      },
+#endif
+     // Characteristic Declaration "Period"
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &sensorPeriodProps
+    },
+
+      // Characteristic Value "Period"
+      {
+        { TI_UUID_SIZE, sensorPeriodUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0,
+        &sensorPeriod
+      },
+#ifdef USER_DESCRIPTION
+      // Characteristic User Description "Period"
+      {
+        { ATT_BT_UUID_SIZE, charUserDescUUID },
+        GATT_PERMIT_READ,
+        0,
+        sensorPeriodUserDescr
+      },
+#endif
+};
+
+// Index of the data value in sensorAttrTable
+#define SENSOR_DATA_IDX         2
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static uint8 sensor_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                            uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen, uint8 method );
+static bStatus_t sensor_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                 uint8 *pValue, uint8 len, uint16 offset,
+                                 uint8 method  );
+static uint8 telemetryDelta( uint8 idx, uint8 *pBuf );
+static void telemetryNotifyCB( linkDBItem_t *pLinkItem );
+
+/*********************************************************************
+ * PROFILE CALLBACKS
+ */
+// Telemetry Service Callbacks
+static CONST gattServiceCBs_t sensorCBs =
+{
+  sensor_ReadAttrCB,  // Read callback function pointer
+  sensor_WriteAttrCB, // Write callback function pointer
+  NULL                // Authorization callback function pointer
+};
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Telemetry_AddService
+ *
+ * @brief   Initializes the Telemetry service by registering
+ *          GATT attributes with the GATT server.
+ *
+ * @return  Success or Failure
+ */
+bStatus_t Telemetry_AddService( void )
+{
+  bStatus_t ret;
+
+  ret = util_initCharacteristicConfig(&sensorDataConfig);
+  if (ret != SUCCESS)
+  {
+    return ret;
+  }
+
+  // Register GATT attribute list and CBs with GATT Server App
+  return GATTServApp_RegisterService( sensorAttrTable,
+                                      GATT_NUM_ATTRS (sensorAttrTable),
+                                      GATT_MAX_ENCRYPT_KEY_SIZE,
+                                      &sensorCBs );
+}
+
+
+/*********************************************************************
+ * @fn      Telemetry_RegisterAppCBs
+ *
+ * @brief   Registers the application callback function. Only call
+ *          this function once.
+ *
+ * @param   callbacks - pointer to application callbacks.
+ *
+ * @return  SUCCESS or bleAlreadyInRequestedMode
+ */
+bStatus_t Telemetry_RegisterAppCBs( sensorCBs_t *appCallbacks )
+{
+  if ( sensor_AppCBs == NULL)
+  {
+    if ( appCallbacks != NULL)
+    {
+      sensor_AppCBs = appCallbacks;
+    }
+
+    return ( SUCCESS );
+  }
+
+  return ( bleAlreadyInRequestedMode );
+}
+
+/*********************************************************************
+ * @fn      Telemetry_SetParameter
+ *
+ * @brief   Set a parameter.
+ *
+ * @param   param - Profile parameter ID
+ * @param   len - length of data to write
+ * @param   value - pointer to data to write.  This is dependent on
+ *          the parameter ID and WILL be cast to the appropriate
+ *          data type (example: data type of uint16 will be cast to
+ *          uint16 pointer).
+ *
+ * @return  bStatus_t
+ */
+bStatus_t Telemetry_SetParameter( uint8 param, uint8 len, void *value )
+{
+  bStatus_t ret = SUCCESS;
+
+  switch ( param )
+  {
+    case SENSOR_CONF:
+      if ( len == sizeof ( uint8 ) )
+      {
+        sensorCfg = *((uint8*)value);
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
+    case SENSOR_PERI:
+      if ( len == sizeof ( uint8 ) )
+      {
+        sensorPeriod = *((uint8*)value);
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
+    default:
+      ret = INVALIDPARAMETER;
+      break;
+  }
+
+  return ( ret );
+}
+
+/*********************************************************************
+ * @fn      Telemetry_GetParameter
+ *
+ * @brief   Get a Telemetry service parameter.
+ *
+ * @param   param - Profile parameter ID
+ * @param   value - pointer to data to put.  This is dependent on
+ *          the parameter ID and WILL be cast to the appropriate
+ *          data type (example: data type of uint16 will be cast to
+ *          uint16 pointer).
+ *
+ * @return  bStatus_t
+ */
+bStatus_t Telemetry_GetParameter( uint8 param, void *value )
+{
+  bStatus_t ret = SUCCESS;
+
+  switch ( param )
+  {
+    case SENSOR_DATA:
+      VOID osal_memcpy( value, sensorData, telemetryLen );
+      break;
+
+    case SENSOR_CONF:
+      *((uint8*)value) = sensorCfg;
+      break;
+
+    case SENSOR_PERI:
+      *((uint8*)value) = sensorPeriod;
+      break;
+
+    default:
+      ret = INVALIDPARAMETER;
+      break;
+  }
+
+  return ( ret );
+}
+
+/*********************************************************************
+ * @fn      Telemetry_SetSample
+ *
+ * @brief   Store the latest sample of a sensor. It is sent by the next
+ *          Telemetry_Notify() if the sensor is enabled in the
+ *          configuration; a sample stored before the previous one was
+ *          sent replaces it.
+ *
+ * @param   sensor - TELEMETRY_xxx bit of the sensor
+ * @param   pData - sample, in the format of the sensor's HAL read function
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+bStatus_t Telemetry_SetSample( uint8 sensor, uint8 *pData )
+{
+  uint8 i;
+
+  for ( i = 0; i < TELEMETRY_NUM_SENSORS; i++ )
+  {
+    if ( sensor == BV( i ) )
+    {
+      VOID osal_memcpy( &telemetrySample[telemetrySampleOfs[i]], pData, telemetrySampleLen[i] );
+      telemetryDirty |= sensor;
+
+      return ( SUCCESS );
+    }
+  }
+
+  return ( INVALIDPARAMETER );
+}
+
+/*********************************************************************
+ * @fn      Telemetry_Notify
+ *
+ * @brief   Pack the samples stored since the last notification into one
+ *          notification and send it to every client that enabled
+ *          notifications. Samples that do not fit are sent first the
+ *          next time.
+ *
+ *          A delta coded sample is the difference to the previous
+ *          sample of the same sensor in the notifications, so a client
+ *          ignores the delta coded samples of a sensor after a gap in
+ *          the sequence numbers until it gets one in full. Every
+ *          TELEMETRY_KEY_INTERVAL notifications, after a failed
+ *          notification and when a client enables notifications, each
+ *          sensor is sent in full once.
+ *
+ * @return  SUCCESS, or the status of the notification that failed
+ */
+bStatus_t Telemetry_Notify( void )
+{
+  uint8 pending;
+  uint8 map;
+  uint8 delta;
+  uint8 len;
+  uint8 size;
+  uint8 idx;
+  uint8 n;
+  uint8 *p;
+
+  pending = telemetryDirty & sensorCfg & TELEMETRY_CFG_SENSORS;
+  if ( pending == 0 )
+  {
+    return ( SUCCESS );
+  }
+
+  if ( telemetryKeyCnt == 0 )
+  {
+    telemetryRefValid = 0;
+    telemetryKeyCnt = TELEMETRY_KEY_INTERVAL;
+  }
+  telemetryKeyCnt--;
+
+  // Pick the sensors, starting after the last one sent so that all of
+  // them get their turn when they do not fit in one notification
+  map = 0;
+  delta = 0;
+  len = TELEMETRY_HDR_LEN;
+  idx = telemetryNext;
+  for ( n = 0; n < TELEMETRY_NUM_SENSORS; n++ )
+  {
+    if ( pending & BV( idx ) )
+    {
+      size = telemetrySampleLen[idx];
+      if ( ( sensorCfg & TELEMETRY_CFG_DELTA ) && ( telemetryRefValid & BV( idx ) ) &&
+           telemetryDelta( idx, NULL ) )
+      {
+        size /= 2;
+        delta |= BV( idx );
+      }
+
+      if ( len + size <= TELEMETRY_MAX_LEN )
+      {
+        map |= BV( idx );
+        len += size;
+        telemetryNext = idx + 1;
+      }
+      else
+      {
+        delta &= ~BV( idx );
+      }
+    }
+
+    if ( ++idx == TELEMETRY_NUM_SENSORS )
+    {
+      idx = 0;
+    }
+  }
+  if ( telemetryNext == TELEMETRY_NUM_SENSORS )
+  {
+    telemetryNext = 0;
+  }
+
+  // Build the notification, sensors in bit order
+  p = sensorData;
+  *p++ = telemetrySeq++;
+  *p++ = map;
+  *p++ = delta;
+  for ( idx = 0; idx < TELEMETRY_NUM_SENSORS; idx++ )
+  {
+    if ( delta & BV( idx ) )
+    {
+      VOID telemetryDelta( idx, p );
+      p += telemetrySampleLen[idx] / 2;
+    }
+    else if ( map & BV( idx ) )
+    {
+      VOID osal_memcpy( p, &telemetrySample[telemetrySampleOfs[idx]], telemetrySampleLen[idx] );
+      p += telemetrySampleLen[idx];
+    }
+
+    if ( map & BV( idx ) )
+    {
+      VOID osal_memcpy( &telemetryRef[telemetrySampleOfs[idx]],
+                        &telemetrySample[telemetrySampleOfs[idx]], telemetrySampleLen[idx] );
+    }
+  }
+  telemetryLen = len;
+  telemetryDirty &= ~map;
+
+  telemetryStatus = SUCCESS;
+  linkDB_PerformFunc( telemetryNotifyCB );
+
+  if ( telemetryStatus == SUCCESS )
+  {
+    telemetryRefValid |= map;
+  }
+  else
+  {
+    // A client missed the notification: resend every sensor in full
+    telemetryRefValid = 0;
+  }
+
+  return ( telemetryStatus );
+}
+
+/*********************************************************************
+ * @fn          telemetryDelta
+ *
+ * @brief       Delta code the sample of a sensor against the sample last
+ *              sent, one signed byte per 16 bit word.
+ *
+ * @param       idx - bit number of the sensor
+ * @param       pBuf - buffer for the delta coded sample, or NULL to only
+ *                     check that it can be delta coded
+ *
+ * @return      TRUE if every difference fits in a byte
+ */
+static uint8 telemetryDelta( uint8 idx, uint8 *pBuf )
+{
+  uint8 *pCur = &telemetrySample[telemetrySampleOfs[idx]];
+  uint8 *pRef = &telemetryRef[telemetrySampleOfs[idx]];
+  uint8 len = telemetrySampleLen[idx];
+  int16 diff;
+  uint8 i;
+
+  // Single byte values gain nothing from delta coding
+  if ( len & 1 )
+  {
+    return ( FALSE );
+  }
+
+  for ( i = 0; i < len; i += 2 )
+  {
+    if ( BV( idx ) == TELEMETRY_IRTEMP )
+    {
+      diff = (int16)( BUILD_UINT16( pCur[i + 1], pCur[i] ) - BUILD_UINT16( pRef[i + 1], pRef[i] ) );
+    }
+    else
+    {
+      diff = (int16)( BUILD_UINT16( pCur[i], pCur[i + 1] ) - BUILD_UINT16( pRef[i], pRef[i + 1] ) );
+    }
+
+    if ( diff < -128 || diff > 127 )
+    {
+      return ( FALSE );
+    }
+
+    if ( pBuf != NULL )
+    {
+      *pBuf++ = (uint8)diff;
+    }
+  }
+
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn          telemetryNotifyCB
+ *
+ * @brief       Send the notification on a connection if the client
+ *              enabled notifications.
+ *
+ * @param       pLinkItem - linkDB item
+ *
+ * @return      none
+ */
+static void telemetryNotifyCB( linkDBItem_t *pLinkItem )
+{
+  attHandleValueNoti_t noti;
+  bStatus_t status;
+
+  if ( !( pLinkItem->stateFlags & LINK_CONNECTED ) ||
+       !( GATTServApp_ReadCharCfg( pLinkItem->connectionHandle, sensorDataConfig ) &
+          GATT_CLIENT_CFG_NOTIFY ) )
+  {
+    return;
+  }
+
+  if ( linkDB_MTU( pLinkItem->connectionHandle ) < telemetryLen + 3 )
+  {
+    telemetryStatus = bleInvalidRange;
+    return;
+  }
+
+  noti.pValue = GATT_bm_alloc( pLinkItem->connectionHandle, ATT_HANDLE_VALUE_NOTI,
+                               telemetryLen, NULL );
+  if ( noti.pValue == NULL )
+  {
+    telemetryStatus = bleMemAllocError;
+    return;
+  }
+
+  noti.handle = sensorAttrTable[SENSOR_DATA_IDX].handle;
+  noti.len = telemetryLen;
+  VOID osal_memcpy( noti.pValue, sensorData, telemetryLen );
+
+  status = GATT_Notification( pLinkItem->connectionHandle, &noti, FALSE );
+  if ( status != SUCCESS )
+  {
+    GATT_bm_free( (gattMsg_t *)&noti, ATT_HANDLE_VALUE_NOTI );
+    telemetryStatus = status;
+  }
+}
+
+/*********************************************************************
+ * @fn          sensor_ReadAttrCB
+ *
+ * @brief       Read an attribute.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pAttr - pointer to attribute
+ * @param       pValue - pointer to data to be read
+ * @param       pLen - length of data to be read
+ * @param       offset - offset of the first octet to be read
+ * @param       maxLen - maximum length of data to be read
+ *
+ * @return      Success or Failure
+ */
+static uint8 sensor_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                            uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen, uint8 method )
+{
+  uint16 uuid;
+  bStatus_t status = SUCCESS;
+
+  // If attribute permissions require authorization to read, return error
+  if ( gattPermitAuthorRead( pAttr->permissions ) )
+  {
+    // Insufficient authorization
+    return ( ATT_ERR_INSUFFICIENT_AUTHOR );
+  }
+
+  // Make sure it's not a blob operation (no attributes in the profile are long)
+  if ( offset > 0 )
+  {
+    return ( ATT_ERR_ATTR_NOT_LONG );
+  }
+
+  if (utilExtractUuid16(pAttr,&uuid) == FAILURE) {
+    // Invalid handle
+    *pLen = 0;
+    return ATT_ERR_INVALID_HANDLE;
+  }
+
+  switch ( uuid )
+  {
+    // No need for "GATT_SERVICE_UUID" or "GATT_CLIENT_CHAR_CFG_UUID" cases;
+    // gattserverapp handles those reads
+    case SENSOR_DATA_UUID:
+      *pLen = ( telemetryLen < maxLen ) ? telemetryLen : maxLen;
+      VOID osal_memcpy( pValue, pAttr->pValue, *pLen );
+      break;
+
+    case SENSOR_CONFIG_UUID:
+    case SENSOR_PERIOD_UUID:
+      *pLen = 1;
+      pValue[0] = *pAttr->pValue;
+      break;
+
+    default:
+      *pLen = 0;
+      status = ATT_ERR_ATTR_NOT_FOUND;
+      break;
+    }
+
+  return ( status );
+}
+
+/*********************************************************************
+* @fn      sensor_WriteAttrCB
+*
+* @brief   Validate attribute data prior to a write operation
+*
+* @param   connHandle - connection message was received on
+* @param   pAttr - pointer to attribute
+* @param   pValue - pointer to data to be written
+* @param   len - length of data
+* @param   offset - offset of the first octet to be written
+*
+* @return  Success or Failure
+*/
+static bStatus_t sensor_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                 uint8 *pValue, uint8 len, uint16 offset,
+                                 uint8 method  )
+{
+  bStatus_t status = SUCCESS;
+  uint8 notifyApp = 0xFF;
+  uint16 uuid;
+
+  // If attribute permissions require authorization to write, return error
+  if ( gattPermitAuthorWrite( pAttr->permissions ) )
+  {
+    // Insufficient authorization
+    return ( ATT_ERR_INSUFFICIENT_AUTHOR );
+  }
+
+  if (utilExtractUuid16(pAttr,&uuid) == FAILURE) {
+    // Invalid handle
+    return ATT_ERR_INVALID_HANDLE;
+  }
+
+  switch ( uuid )
+  {
+    case SENSOR_DATA_UUID:
+      // Should not get here
+      break;
+
+    case SENSOR_CONFIG_UUID:
+      // Validate the value
+      // Make sure it's not a blob oper
+      if ( offset == 0 )
+      {
+        if ( len != 1 )
+        {
+          status = ATT_ERR_INVALID_VALUE_SIZE;
+        }
+      }
+      else
+      {
+        status = ATT_ERR_ATTR_NOT_LONG;
+      }
+
+      // Write the value
+      if ( status == SUCCESS )
+      {
+        uint8 *pCurValue = (uint8 *)pAttr->pValue;
+
+        *pCurValue = pValue[0];
+
+        if( pAttr->pValue == &sensorCfg )
+        {
+          notifyApp = SENSOR_CONF;
+        }
+      }
+      break;
+
+    case SENSOR_PERIOD_UUID:
+      // Validate the value
+      // Make sure it's not a blob oper
+      if ( offset == 0 )
+      {
+        if ( len != 1 )
+        {
+          status = ATT_ERR_INVALID_VALUE_SIZE;
+        }
+      }
+      else
+      {
+        status = ATT_ERR_ATTR_NOT_LONG;
+      }
+      // Write the value
+      if ( status == SUCCESS )
+      {
+        if (pValue[0]>=(TELEMETRY_MIN_UPDATE_PERIOD/SENSOR_PERIOD_RESOLUTION))
+        {
+
+          uint8 *pCurValue = (uint8 *)pAttr->pValue;
+          *pCurValue = pValue[0];
+
+          if( pAttr->pValue == &sensorPeriod )
+          {
+            notifyApp = SENSOR_PERI;
+          }
+        }
+        else
+        {
+           status = ATT_ERR_INVALID_VALUE;
+        }
+      }
+      break;
+
+    case GATT_CLIENT_CHAR_CFG_UUID:
+      status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
+                                              offset, GATT_CLIENT_CFG_NOTIFY );
+      if ( status == SUCCESS )
+      {
+        // The new client has none of the samples sent so far
+        telemetryRefValid = 0;
+      }
+      break;
+
+    default:
+      // Should never get here!
+      status = ATT_ERR_ATTR_NOT_FOUND;
+      break;
+  }
+
+  // If a charactersitic value changed then callback function to notify application of change
+  if ( (notifyApp != 0xFF ) && sensor_AppCBs && sensor_AppCBs->pfnSensorChange )
+  {
+    sensor_AppCBs->pfnSensorChange( notifyApp );
+  }
+
+  return ( status );
+}
+
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,138 @@
+/**************************************************************************************************
+  Filename:       telemetryservice.h
+
+  Description:    Telemetry service. Packs the latest samples of several sensors
+                  into one notification, so streaming them costs one ATT header
+                  per packet instead of one per sensor.
+**************************************************************************************************/
+
+#ifndef TELEMETRYSERVICE_H
+#define TELEMETRYSERVICE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "st_util.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Service UUID
+#define TELEMETRY_SERV_UUID             0xAA90  // F000AA90-0451-4000-B000-00000000-0000
+#define TELEMETRY_DATA_UUID             0xAA91
+#define TELEMETRY_CONF_UUID             0xAA92
+#define TELEMETRY_PERI_UUID             0xAA93
+
+// Sensor Profile Services bit fields
+#define TELEMETRY_SERVICE               0x00000040
+
+// Sensors, the same bits as ST_xxx in hal_sensor.h. Their samples are in the
+// format of the HAL driver's read function.
+#define TELEMETRY_IRTEMP                0x01    // 4 bytes, two big endian words
+#define TELEMETRY_HUMID                 0x02    // 4 bytes
+#define TELEMETRY_MAGN                  0x04    // 6 bytes
+#define TELEMETRY_ACC                   0x08    // 3 bytes, never delta coded
+#define TELEMETRY_PRESS                 0x10    // 4 bytes
+#define TELEMETRY_GYRO                  0x20    // 6 bytes
+#define TELEMETRY_ATTITUDE              0x40    // 6 bytes, heading, pitch and roll from HalImuGetAttitude()
+#define TELEMETRY_NUM_SENSORS           7
+
+// Configuration: the sensors to stream, and delta coding
+#define TELEMETRY_CFG_SENSORS           0x7F
+#define TELEMETRY_CFG_DELTA             0x80
+
+// Notification: sequence number, sensor map, delta map, then the sample of
+// each sensor in the sensor map in bit order. A sensor in the delta map is
+// sent as one signed byte per 16 bit word, the difference to its previous
+// sample; the others are sent in full.
+#define TELEMETRY_HDR_LEN               3
+
+// Longest notification; must fit the ATT MTU of every connection
+#if !defined TELEMETRY_MAX_LEN
+  #define TELEMETRY_MAX_LEN             ( ATT_MTU_SIZE - 3 )
+#endif
+
+// Every this many notifications all sensors are sent in full once, so that
+// a client that missed a notification gets back in step
+#if !defined TELEMETRY_KEY_INTERVAL
+  #define TELEMETRY_KEY_INTERVAL        16
+#endif
+
+// Shortest period that can be set, in ms
+#define TELEMETRY_MIN_UPDATE_PERIOD     SENSOR_PERIOD_RESOLUTION
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * API FUNCTIONS
+ */
+
+/*
+ * Telemetry_AddService - Initializes the Telemetry service by registering
+ *          GATT attributes with the GATT server.
+ */
+extern bStatus_t Telemetry_AddService( void );
+
+/*
+ * Telemetry_RegisterAppCBs - Registers the application callback function.
+ *                    Only call this function once.
+ *
+ *    appCallbacks - pointer to application callbacks.
+ */
+extern bStatus_t Telemetry_RegisterAppCBs( sensorCBs_t *appCallbacks );
+
+/*
+ * Telemetry_SetParameter - Set a Telemetry service parameter: SENSOR_CONF
+ *          or SENSOR_PERI. The application writes back the period it could
+ *          actually set, which is what the client then reads.
+ *
+ *    param - Profile parameter ID
+ *    len - length of data to write
+ *    value - pointer to data to write
+ */
+extern bStatus_t Telemetry_SetParameter( uint8 param, uint8 len, void *value );
+
+/*
+ * Telemetry_GetParameter - Get a Telemetry service parameter.
+ *
+ *    param - Profile parameter ID
+ *    value - pointer to data to read
+ */
+extern bStatus_t Telemetry_GetParameter( uint8 param, void *value );
+
+/*
+ * Telemetry_SetSample - Store the latest sample of a sensor for the next
+ *          notification.
+ *
+ *    sensor - TELEMETRY_xxx bit of the sensor
+ *    pData - sample, in the format of the sensor's HAL read function
+ */
+extern bStatus_t Telemetry_SetSample( uint8 sensor, uint8 *pData );
+
+/*
+ * Telemetry_Notify - Send the samples stored since the last notification
+ *          to the clients that enabled notifications.
+ */
+extern bStatus_t Telemetry_Notify( void );
+
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRYSERVICE_H */
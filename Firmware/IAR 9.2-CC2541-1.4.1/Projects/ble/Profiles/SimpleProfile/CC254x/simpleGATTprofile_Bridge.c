@@ -59,7 +59,7 @@
  * CONSTANTS
  */
 
-#define SERVAPP_NUM_ATTR_SUPPORTED        17
+#define SERVAPP_NUM_ATTR_SUPPORTED        20
 
 /*********************************************************************
  * TYPEDEFS
@@ -104,6 +104,12 @@ CONST uint8 simpleProfilechar5UUID[ATT_BT_UUID_SIZE] =
   LO_UINT16(SIMPLEPROFILE_CHAR5_UUID), HI_UINT16(SIMPLEPROFILE_CHAR5_UUID)
 };
 
+// Characteristic 6 UUID: 0xFFF6
+CONST uint8 simpleProfilechar6UUID[ATT_BT_UUID_SIZE] =
+{
+  LO_UINT16(SIMPLEPROFILE_CHAR6_UUID), HI_UINT16(SIMPLEPROFILE_CHAR6_UUID)
+};
+
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
@@ -118,6 +124,8 @@ CONST uint8 simpleProfilechar5UUID[ATT_BT_UUID_SIZE] =
 
 static simpleProfileCBs_t *simpleProfile_AppCBs = NULL;
 
+static simpleProfileDiagRead_t simpleProfile_DiagRead = NULL;
+
 /*********************************************************************
  * Profile Attributes - variables
  */
@@ -182,6 +190,15 @@ static uint8 simpleProfileChar5[SIMPLEPROFILE_CHAR5_LEN] = { 0, 0, 0, 0, 0 };
 static uint8 simpleProfileChar5UserDesp[17] = "Characteristic 5\0";
 
 
+// Simple Profile Characteristic 6 Properties
+static uint8 simpleProfileChar6Props = GATT_PROP_READ;
+
+// Characteristic 6 has no value of its own, it is filled in by simpleProfile_DiagRead
+
+// Simple Profile Characteristic 6 User Description
+static uint8 simpleProfileChar6UserDesp[12] = "Diagnostics\0";
+
+
 /*********************************************************************
  * Profile Attributes - Table
  */
@@ -323,6 +340,30 @@ static gattAttribute_t simpleProfileAttrTbl[SERVAPP_NUM_ATTR_SUPPORTED] =
         0,
         simpleProfileChar5UserDesp
       },
+
+    // Characteristic 6 Declaration
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &simpleProfileChar6Props
+    },
+
+      // Characteristic Value 6
+      {
+        { ATT_BT_UUID_SIZE, simpleProfilechar6UUID },
+        GATT_PERMIT_READ,
+        0,
+        NULL
+      },
+
+      // Characteristic 6 User Description
+      {
+        { ATT_BT_UUID_SIZE, charUserDescUUID },
+        GATT_PERMIT_READ,
+        0,
+        simpleProfileChar6UserDesp
+      },
 };
 
 /*********************************************************************
@@ -417,6 +458,21 @@ bStatus_t SimpleProfile_RegisterAppCBs( simpleProfileCBs_t *appCallbacks )
   }
 }
 
+/*********************************************************************
+ * @fn      SimpleProfile_RegisterDiagCB
+ *
+ * @brief   Registers the function that fills in the diagnostics
+ *          characteristic when it is read.
+ *
+ * @param   pfnDiagRead - diagnostics read callback, NULL for an empty value
+ *
+ * @return  none
+ */
+void SimpleProfile_RegisterDiagCB( simpleProfileDiagRead_t pfnDiagRead )
+{
+  simpleProfile_DiagRead = pfnDiagRead;
+}
+
 /*********************************************************************
  * @fn      SimpleProfile_SetParameter
  *
@@ -615,6 +671,15 @@ static uint8 simpleProfile_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr
         VOID osal_memcpy( pValue, pAttr->pValue, SIMPLEPROFILE_CHAR5_LEN );
         break;
 
+      case SIMPLEPROFILE_CHAR6_UUID:
+        // Filled in at read time, so the client always sees current values
+        *pLen = 0;
+        if ( simpleProfile_DiagRead )
+        {
+          *pLen = simpleProfile_DiagRead( pValue, MIN( maxLen, SIMPLEPROFILE_CHAR6_LEN ) );
+        }
+        break;
+
       default:
         // Should never get here! (characteristics 3 and 4 do not have read permissions)
         *pLen = 0;
@@ -59,6 +59,7 @@ extern "C"
 #define SIMPLEPROFILE_CHAR3                   2  // RW uint8 - Profile Characteristic 3 value
 #define SIMPLEPROFILE_CHAR4                   3  // RW uint8 - Profile Characteristic 4 value
 #define SIMPLEPROFILE_CHAR5                   4  // RW uint8 - Profile Characteristic 4 value
+#define SIMPLEPROFILE_CHAR6                   5  // R - Diagnostics, read through a callback
   
 // Simple Profile Service UUID
 #define SIMPLEPROFILE_SERV_UUID               0xFFF0
@@ -69,6 +70,7 @@ extern "C"
 #define SIMPLEPROFILE_CHAR3_UUID            0xFFF3
 #define SIMPLEPROFILE_CHAR4_UUID            0xFFF4
 #define SIMPLEPROFILE_CHAR5_UUID            0xFFF5
+#define SIMPLEPROFILE_CHAR6_UUID            0xFFF6   // Diagnostics
   
 // Simple Keys Profile Services bit fields
 #define SIMPLEPROFILE_SERVICE               0x00000001
@@ -76,6 +78,9 @@ extern "C"
 // Length of Characteristic 5 in bytes
 #define SIMPLEPROFILE_CHAR5_LEN           5  
 
+// Maximum length of Characteristic 6 in bytes
+#define SIMPLEPROFILE_CHAR6_LEN           20
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -97,6 +102,10 @@ typedef struct
   simpleProfileChange_t        pfnSimpleProfileChange;  // Called when characteristic value changes
 } simpleProfileCBs_t;
 
+// Callback to fill in the value of Characteristic 6 when it is read.
+// Returns the length of the value, at most maxLen.
+typedef uint8 (*simpleProfileDiagRead_t)( uint8 *pValue, uint8 maxLen );
+
     
 
 /*********************************************************************
@@ -122,6 +131,14 @@ extern bStatus_t SimpleProfile_AddService( uint32 services );
  */
 extern bStatus_t SimpleProfile_RegisterAppCBs( simpleProfileCBs_t *appCallbacks );
 
+/*
+ * SimpleProfile_RegisterDiagCB - Registers the function that fills in
+ *                    the diagnostics characteristic when it is read.
+ *
+ *    pfnDiagRead - diagnostics read callback, NULL for an empty value.
+ */
+extern void SimpleProfile_RegisterDiagCB( simpleProfileDiagRead_t pfnDiagRead );
+
 /*
  * SimpleProfile_SetParameter - Set a Simple GATT Profile parameter.
  *
@@ -94,13 +94,41 @@
  * @return      None.
  */
 void NPI_InitTransport( npiCBack_t npiCBack )
+{
+  NPI_OpenTransport( npiCBack, NPI_UART_BR, NPI_UART_FC );
+
+  return;
+}
+
+
+/*******************************************************************************
+ * @fn          NPI_OpenTransport
+ *
+ * @brief       This routine opens, or re-opens, the port of the device with
+ *              the given baud rate and flow control. Bytes still queued for
+ *              Tx go out at the new rate, so wait for NPI_TxBufLen() to drop
+ *              to zero and the last byte to shift out before a re-open.
+ *
+ * input parameters
+ *
+ * @param       npiCback - User callback function when data is available.
+ * @param       baudRate - HAL_UART_BR_xxx baud rate.
+ * @param       flowControl - TRUE for RTS/CTS flow control.
+ *
+ * output parameters
+ *
+ * @param       None.
+ *
+ * @return      None.
+ */
+void NPI_OpenTransport( npiCBack_t npiCBack, uint8 baudRate, uint8 flowControl )
 {
   halUARTCfg_t uartConfig;
 
   // configure UART
   uartConfig.configured           = TRUE;
-  uartConfig.baudRate             = NPI_UART_BR;
-  uartConfig.flowControl          = NPI_UART_FC;
+  uartConfig.baudRate             = baudRate;
+  uartConfig.flowControl          = flowControl;
   uartConfig.flowControlThreshold = NPI_UART_FC_THRESHOLD;
   uartConfig.rx.maxBufSize        = NPI_UART_RX_BUF_SIZE;
   uartConfig.tx.maxBufSize        = NPI_UART_TX_BUF_SIZE;
@@ -182,6 +210,27 @@ uint16 NPI_RxBufLen( void )
 }
 
 
+/*******************************************************************************
+ * @fn          NPI_TxBufLen
+ *
+ * @brief       This routine returns the number of bytes waiting to be sent.
+ *
+ * input parameters
+ *
+ * @param       None.
+ *
+ * output parameters
+ *
+ * @param       None.
+ *
+ * @return      Returns the number of bytes in the transmit buffer.
+ */
+uint16 NPI_TxBufLen( void )
+{
+  return( Hal_UART_TxBufLen( NPI_UART_PORT ) );
+}
+
+
 /*******************************************************************************
  * @fn          NPI_GetMaxRxBufSize
  *
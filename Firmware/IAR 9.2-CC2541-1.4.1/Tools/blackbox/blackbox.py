@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""
+Read the black box log of a bridge built with BLACKBOX over the NPI UART and
+decode it.
+
+stats sends CMD_REQ_BLACKBOX and prints the recorder counts. dump has the
+bridge send every chunk of the log, oldest first, and prints the records;
+--out also saves the raw chunks, for decode to print again later. The
+dump goes as fast as the UART allows; switch the bridge to a higher rate with
+setbaud.py first to make it quicker.
+
+Records are described in blackBox.h. Times are in seconds since the boot
+they belong to; a BOOT record starts a new run.
+
+Needs pyserial for stats and dump.
+
+    blackbox.py stats /dev/ttyUSB0 [--baud 115200]
+    blackbox.py dump /dev/ttyUSB0 [--baud 115200] [--out log.bin]
+    blackbox.py decode log.bin [--chunk 32]
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+HEADER = b'\xAB\x55'
+CMD_REQ_BLACKBOX = 0x0F
+CMD_ACK_BLACKBOX = 0xCF
+CMD_ERR_BLACKBOX = 0xDF
+
+DUMP = 0x01
+
+REC_PAGE = 0x0
+REC_BOOT = 0x1
+REC_TIME = 0x2
+REC_LOST = 0x3
+REC_CMD = 0x4
+REC_DUTY = 0x5
+REC_BATT = 0x6
+REC_LINK = 0x7
+REC_REJECT = 0x8
+
+# gaprole_States_t in peripheral.h
+GAPROLE_STATES = ('init', 'started', 'advertising', 'advertising nonconn', 'waiting',
+                  'waiting after timeout', 'connected', 'connected adv', 'error')
+
+# CmdAuth_Open() status
+AUTH_ERRORS = {1: 'bad MIC', 2: 'replay', 3: 'NV failure'}
+
+
+def frame(cmd, payload=b''):
+    body = HEADER + bytes((cmd, len(payload))) + payload
+    x = 0
+    for b in body:
+        x ^= b
+    return body + bytes((x,))
+
+
+class Reader:
+    """Pick valid frames out of the byte stream."""
+
+    def __init__(self, port):
+        self.port = port
+        self.buf = bytearray()
+
+    def next(self, cmds, timeout):
+        end = time.monotonic() + timeout
+        while True:
+            while True:
+                i = self.buf.find(HEADER)
+                if i < 0:
+                    del self.buf[:-1]
+                    break
+                del self.buf[:i]
+                if len(self.buf) < 5 or len(self.buf) < 5 + self.buf[3]:
+                    break
+                n = self.buf[3]
+                x = 0
+                for b in self.buf[:4 + n]:
+                    x ^= b
+                if x != self.buf[4 + n]:
+                    del self.buf[:1]
+                    continue
+                cmd, payload = self.buf[2], bytes(self.buf[4:4 + n])
+                del self.buf[:5 + n]
+                if cmd in cmds:
+                    return cmd, payload
+            if time.monotonic() >= end:
+                return None, None
+            self.buf += self.port.read(self.port.in_waiting or 1)
+
+
+def describe(kind, data):
+    if kind == REC_PAGE and len(data) == 8:
+        return 'PAGE   seq %d' % struct.unpack_from('<I', data)[0]
+    if kind == REC_BOOT and len(data) == 5:
+        return 'BOOT   SLEEPSTA 0x%02X' % data[0]
+    if kind == REC_TIME:
+        return 'TIME'
+    if kind == REC_LOST and len(data) == 2:
+        return 'LOST   %d records' % struct.unpack('<H', data)
+    if kind == REC_CMD and len(data) == 8:
+        modify, control, freq = struct.unpack_from('<BBH', data)
+        return 'CMD    modify 0x%02X control %d frequency %d duty %s' % (
+            modify, control, freq, ' '.join('%d' % d for d in data[4:]))
+    if kind == REC_DUTY and len(data) == 10:
+        v = struct.unpack('<5H', data)
+        return 'DUTY   %d Hz %s' % (v[0], ' '.join('%.1f%%' % (d / 10.0) for d in v[1:]))
+    if kind == REC_BATT and len(data) == 2:
+        return 'BATT   %d mV' % struct.unpack('<H', data)
+    if kind == REC_LINK and len(data) >= 1:
+        state = data[0]
+        return 'LINK   %s' % (GAPROLE_STATES[state] if state < len(GAPROLE_STATES) else state)
+    if kind == REC_REJECT and len(data) == 1:
+        return 'REJECT %s' % AUTH_ERRORS.get(data[0], data[0])
+    return 'TYPE %X  %s' % (kind, data.hex())
+
+
+def decode(log, chunk):
+    """Print the records of the raw chunks, oldest first."""
+    t = None
+    for base in range(0, len(log) - chunk + 1, chunk):
+        c = log[base:base + chunk]
+        i = 0
+        while i + 3 <= chunk and c[i] != 0xFF:
+            kind, n = c[i] >> 4, c[i] & 0x0F
+            dt = struct.unpack_from('<H', c, i + 1)[0]
+            data = bytes(c[i + 3:i + 3 + n])
+            i += 3 + n
+            if kind in (REC_PAGE, REC_BOOT, REC_TIME) and len(data) >= 4:
+                # Absolute time: at the end of a PAGE, after the cause of a BOOT
+                t = struct.unpack_from('<I', data, len(data) - 4)[0]
+            elif t is not None:
+                t += dt
+            stamp = '%10.3f' % (t / 1000.0) if t is not None else '         ?'
+            print('%s  %s' % (stamp, describe(kind, data)))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    sub = ap.add_subparsers(dest='what', required=True)
+
+    for name in ('stats', 'dump'):
+        sp = sub.add_parser(name)
+        sp.add_argument('port')
+        sp.add_argument('--baud', type=int, default=115200)
+    sub.choices['dump'].add_argument('--out', help='save the raw chunks')
+
+    sp = sub.add_parser('decode', help='print a saved dump')
+    sp.add_argument('file')
+    sp.add_argument('--chunk', type=int, default=32, help='BLACKBOX_CHUNK_SIZE')
+    args = ap.parse_args()
+
+    if args.what == 'decode':
+        with open(args.file, 'rb') as f:
+            decode(f.read(), args.chunk)
+        return
+
+    import serial
+
+    port = serial.Serial(args.port, args.baud, timeout=0.05)
+    reader = Reader(port)
+    cmds = (CMD_ACK_BLACKBOX, CMD_ERR_BLACKBOX)
+
+    if args.what == 'stats':
+        port.write(frame(CMD_REQ_BLACKBOX))
+        cmd, payload = reader.next(cmds, 2.0)
+        if cmd != CMD_ACK_BLACKBOX:
+            sys.exit('no answer, is BLACKBOX enabled?')
+        records, dropped, writes, erases, step, pages, chunk = struct.unpack('<5H2B', payload)
+        print('%d records, %d dropped, %d chunks written, %d pages erased' %
+              (records, dropped, writes, erases))
+        print('longest step %.2f ms, %d pages of %d byte chunks' %
+              (step * 1000.0 / 32768, pages, chunk))
+        return
+
+    # The chunk count and size, then frames of the index of their first
+    # chunk and the chunks
+    port.write(frame(CMD_REQ_BLACKBOX, bytes((DUMP,))))
+    cmd, payload = reader.next(cmds, 2.0)
+    if cmd != CMD_ACK_BLACKBOX or len(payload) != 3:
+        sys.exit('refused, is BLACKBOX enabled and no other dump running?')
+    count, chunk = struct.unpack('<HB', payload)
+    log = bytearray()
+    start = time.monotonic()
+    while len(log) < count * chunk:
+        cmd, payload = reader.next((CMD_ACK_BLACKBOX,), 2.0)
+        if cmd is None:
+            sys.exit('dump stopped after %d of %d chunks' % (len(log) // chunk, count))
+        if struct.unpack_from('<H', payload)[0] != len(log) // chunk:
+            sys.exit('chunk %d missing' % (len(log) // chunk))
+        log += payload[2:]
+    took = time.monotonic() - start
+
+    print('%d chunks in %.2f s, %.0f bytes/s' % (count, took, len(log) / took if took else 0),
+          file=sys.stderr)
+    if args.out:
+        with open(args.out, 'wb') as f:
+            f.write(log)
+    decode(log, chunk)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+Seal motor commands for a bridge built with CMD_AUTH, and read its command
+counts or benchmark the command check over the NPI UART.
+
+seal prints the 16 bytes to write to SIMPLEPROFILE_CHAR1 (0xFFF1) as hex:
+the counter, the motor command encrypted with AES-CCM and a 4 byte MIC, see
+cmdAuth.h. The counter must be above the last one the bridge accepted;
+reading the characteristic returns the lowest one it takes in its first 4
+bytes. Never seal two commands with the same counter.
+
+stats sends CMD_REQ_AUTH and prints the commands accepted and refused and
+the next counter; bench has the bridge open --runs commands and prints the
+time each took, interrupts included.
+
+Needs cryptography for seal and pyserial for stats and bench.
+
+    cmdauth.py seal KEY ADDR COUNTER --modify 4 --duty 50 50 0 0
+    cmdauth.py stats /dev/ttyUSB0 [--baud 115200] [--clear]
+    cmdauth.py bench /dev/ttyUSB0 [--baud 115200] [--runs 100]
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+HEADER = b'\xAB\x55'
+CMD_REQ_AUTH = 0x0E
+CMD_ACK_AUTH = 0xCE
+CMD_ERR_AUTH = 0xDE
+
+# MotorCtl_t in BLE_Bridge.c
+MOTOR_INDEX_CTL = 0x01
+MOTOR_INDEX_FRE = 0x02
+MOTOR_INDEX_CH = 0x04
+
+MIC_LEN = 4
+
+
+def nonce(counter, addr):
+    """Counter and BD address LSB first, then 3 zero bytes."""
+    return struct.pack('<I', counter) + addr[::-1] + bytes(3)
+
+
+def seal(key, addr, counter, command):
+    from cryptography.hazmat.primitives.ciphers.aead import AESCCM
+
+    sealed = AESCCM(key, tag_length=MIC_LEN).encrypt(nonce(counter, addr), command, None)
+    return struct.pack('<I', counter) + sealed
+
+
+def frame(cmd, payload=b''):
+    body = HEADER + bytes((cmd, len(payload))) + payload
+    x = 0
+    for b in body:
+        x ^= b
+    return body + bytes((x,))
+
+
+def read_frame(port, cmds, timeout=1.0):
+    """Return the payload of the next valid frame with a type in cmds."""
+    buf = bytearray()
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        buf += port.read(port.in_waiting or 1)
+        while True:
+            i = buf.find(HEADER)
+            if i < 0:
+                del buf[:-1]
+                break
+            del buf[:i]
+            if len(buf) < 5 or len(buf) < 5 + buf[3]:
+                break
+            n = buf[3]
+            x = 0
+            for b in buf[:4 + n]:
+                x ^= b
+            if x != buf[4 + n]:
+                del buf[:1]
+                continue
+            cmd, payload = buf[2], bytes(buf[4:4 + n])
+            del buf[:5 + n]
+            if cmd in cmds:
+                return cmd, payload
+    return None, None
+
+
+def request(args, payload):
+    import serial
+
+    port = serial.Serial(args.port, args.baud, timeout=0.05)
+    port.write(frame(CMD_REQ_AUTH, payload))
+    cmd, payload = read_frame(port, (CMD_ACK_AUTH, CMD_ERR_AUTH), timeout=2.0)
+    if cmd != CMD_ACK_AUTH:
+        sys.exit('no answer, is CMD_AUTH enabled?')
+    return payload
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    sub = ap.add_subparsers(dest='what', required=True)
+
+    sp = sub.add_parser('seal', help='seal a motor command')
+    sp.add_argument('key', help='pre-shared key, 32 hex digits')
+    sp.add_argument('addr', help='BD address of the bridge, as 00:11:22:33:44:55')
+    sp.add_argument('counter', type=int)
+    sp.add_argument('--modify', type=lambda s: int(s, 0), default=MOTOR_INDEX_CH,
+                    help='MOTOR_INDEX_xxx bits of the fields to apply')
+    sp.add_argument('--control', type=int, default=0)
+    sp.add_argument('--frequency', type=int, default=4000, help='PWM frequency, Hz')
+    sp.add_argument('--duty', type=int, nargs=4, default=(0, 0, 0, 0),
+                    help='duty of the 4 channels, percent')
+
+    for name in ('stats', 'bench'):
+        sp = sub.add_parser(name)
+        sp.add_argument('port')
+        sp.add_argument('--baud', type=int, default=115200)
+    sub.choices['stats'].add_argument('--clear', action='store_true', help='clear the counts')
+    sub.choices['bench'].add_argument('--runs', type=int, default=100, choices=range(1, 256),
+                                      metavar='1..255')
+    args = ap.parse_args()
+
+    if args.what == 'seal':
+        key = bytes.fromhex(args.key)
+        addr = bytes.fromhex(args.addr.replace(':', ''))
+        if len(key) != 16 or len(addr) != 6:
+            sys.exit('the key takes 16 bytes and the address 6')
+        command = struct.pack('<BBH4B', args.modify, args.control, args.frequency, *args.duty)
+        print(seal(key, addr, args.counter, command).hex())
+    elif args.what == 'stats':
+        payload = request(args, b'\x00' if args.clear else b'')
+        accepted, mic, replays, counter = struct.unpack('<3HI', payload)
+        print('accepted %d, bad MIC %d, replayed %d, next counter %d'
+              % (accepted, mic, replays, counter))
+    else:
+        payload = request(args, bytes((args.runs,)))
+        runs, ticks, us = struct.unpack('<BIH', payload)
+        print('%d commands in %.2f ms, %d us each' % (runs, ticks * 1000.0 / 32768, us))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Poll the OSAL heap statistics of the bridge over the NPI UART and plot them.
+
+Sends CMD_REQ_HEAP_STATS every period, prints one CSV line per answer and,
+unless --no-plot is given, plots heap use against the heap size when it is
+stopped with Ctrl-C. The firmware must be built with OSALMEM_METRICS=TRUE;
+add OSALMEM_PROFILER=TRUE to also get the profiling buckets with --buckets.
+
+Needs pyserial, and matplotlib for the plot.
+
+    heapstats.py /dev/ttyUSB0 [--baud 115200] [--period 1.0] [--csv out.csv]
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+HEADER = b'\xAB\x55'
+CMD_REQ_HEAP_STATS = 0x0A
+CMD_ACK_HEAP_STATS = 0xCA
+CMD_ERR_HEAP_STATS = 0xDA
+PAGE_METRICS = 0
+PAGE_PROFILER = 1
+
+METRICS = ('heap', 'used', 'used_max', 'blocks', 'blocks_free', 'blocks_max',
+           'fails', 'fail_len')
+
+
+def frame(cmd, payload=b''):
+    body = HEADER + bytes((cmd, len(payload))) + payload
+    x = 0
+    for b in body:
+        x ^= b
+    return body + bytes((x,))
+
+
+def read_frame(port, cmds, timeout=1.0):
+    """Return the payload of the next valid frame with a type in cmds."""
+    buf = bytearray()
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        buf += port.read(port.in_waiting or 1)
+        while True:
+            i = buf.find(HEADER)
+            if i < 0:
+                del buf[:-1]
+                break
+            del buf[:i]
+            if len(buf) < 5 or len(buf) < 5 + buf[3]:
+                break
+            n = buf[3]
+            x = 0
+            for b in buf[:4 + n]:
+                x ^= b
+            if x != buf[4 + n]:
+                del buf[:1]
+                continue
+            cmd, payload = buf[2], bytes(buf[4:4 + n])
+            del buf[:5 + n]
+            if cmd in cmds:
+                return cmd, payload
+    return None, None
+
+
+def request(port, page):
+    port.write(frame(CMD_REQ_HEAP_STATS, bytes((page,))))
+    cmd, payload = read_frame(port, (CMD_ACK_HEAP_STATS, CMD_ERR_HEAP_STATS))
+    if cmd != CMD_ACK_HEAP_STATS:
+        return None
+    return payload
+
+
+def parse_metrics(payload):
+    values = dict(zip(METRICS, struct.unpack_from('<8H', payload)))
+    sites = []
+    for off in range(16, len(payload) - 2, 3):
+        task, cnt = struct.unpack_from('<BH', payload, off)
+        sites.append((task, cnt))
+    return values, sites
+
+
+def parse_buckets(payload):
+    return [struct.unpack_from('<4H', payload, off) for off in range(0, len(payload), 8)]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    ap.add_argument('port')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--period', type=float, default=1.0)
+    ap.add_argument('--csv', help='also write the samples to this file')
+    ap.add_argument('--buckets', action='store_true', help='print the profiling buckets')
+    ap.add_argument('--no-plot', action='store_true')
+    args = ap.parse_args()
+
+    port = serial.Serial(args.port, args.baud, timeout=0.05)
+    out = open(args.csv, 'w') if args.csv else None
+    header = 'time,' + ','.join(METRICS) + ',fail_sites'
+    print(header)
+    if out:
+        print(header, file=out)
+
+    samples = []
+    start = time.monotonic()
+    try:
+        while True:
+            payload = request(port, PAGE_METRICS)
+            now = time.monotonic() - start
+            if payload is None or len(payload) < 16:
+                print('no answer, is OSALMEM_METRICS enabled?', file=sys.stderr)
+            else:
+                values, sites = parse_metrics(payload)
+                samples.append((now, values))
+                line = '%.2f,%s,%s' % (now, ','.join(str(values[k]) for k in METRICS),
+                                       ' '.join('%d:%d' % s for s in sites))
+                print(line)
+                if out:
+                    print(line, file=out)
+                    out.flush()
+
+            if args.buckets:
+                payload = request(port, PAGE_PROFILER)
+                if payload:
+                    for size, cur, mx, tot in parse_buckets(payload):
+                        print('  <=%5d bytes: %4d now %4d max %6d total' % (size, cur, mx, tot))
+
+            time.sleep(args.period)
+    except KeyboardInterrupt:
+        pass
+
+    if args.no_plot or not samples:
+        return
+
+    import matplotlib.pyplot as plt
+
+    t = [s[0] for s in samples]
+    fig, (ax1, ax2) = plt.subplots(2, 1, sharex=True)
+    ax1.plot(t, [s[1]['used'] for s in samples], label='used')
+    ax1.plot(t, [s[1]['used_max'] for s in samples], label='high water')
+    ax1.axhline(samples[-1][1]['heap'], color='k', linestyle='--', label='MAXMEMHEAP')
+    ax1.set_ylabel('bytes')
+    ax1.legend()
+    ax2.plot(t, [s[1]['blocks'] for s in samples], label='blocks')
+    ax2.plot(t, [s[1]['blocks_free'] for s in samples], label='free blocks')
+    ax2.plot(t, [s[1]['fails'] for s in samples], label='failed allocations')
+    ax2.set_xlabel('seconds')
+    ax2.legend()
+    plt.show()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,267 @@
+/**************************************************************************************************
+  Filename:       blackboxsim.c
+
+  Description:    Host test of how the black box in blackBox.c asks for its
+                  steps, on the flash of flashsim.c.
+
+                  While connected the application steps the black box after
+                  the connection events it has notices of, and has notices
+                  only while BlackBox_Pending(). The test plays the
+                  application: the task event turns the notices on, and each
+                  modeled connection event runs a step and turns them off once
+                  nothing is pending.
+
+                  The checks: records while connected set the task event once
+                  until the writes are done, an open chunk is asked for once it
+                  is due, a step erases a page or writes chunks but never both,
+                  nothing is pending during a dump and the steps resume after
+                  it, and the records come back from the dump.
+
+                  Build:  sh build.sh blackboxsim flashsim.c -I../../Components/ble/include
+                  Usage:  blackboxsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#define BLACKBOX               TRUE
+
+uint8 SLEEPSTA;
+
+#include "../../Projects/ble/BLE_Bridge/Source/blackBox.c"
+
+#include "flashsim.h"
+
+#define SIM_TASK               1
+#define SIM_EVT                0x0040
+#define SIM_CONN_INTERVAL      30       // ms
+
+static uint32 simMs;
+static uint16 simEvents;
+static uint32 simTimerDue;              // 0 when the timer is not running
+static int simEventSets;                // osal_set_event() calls
+static uint8 simNotice;                 // Connection event notices on
+
+static int simFails;
+
+uint32 osal_GetSystemClock( void )
+{
+  return ( simMs );
+}
+
+uint8 osal_set_event( uint8 task_id, uint16 event_flag )
+{
+  simEvents |= event_flag;
+  simEventSets++;
+  return ( SUCCESS );
+}
+
+uint8 osal_start_timerEx( uint8 taskID, uint16 event_id, uint32 timeout_value )
+{
+  simTimerDue = simMs + timeout_value;
+  return ( SUCCESS );
+}
+
+uint32 osal_get_timeoutEx( uint8 task_id, uint16 event_id )
+{
+  return ( simTimerDue ? simTimerDue - simMs : 0 );
+}
+
+void *osal_memcpy( void *dst, const void GENERIC *src, unsigned int len )
+{
+  return ( memcpy( dst, src, len ) );
+}
+
+void *osal_memset( void *dest, uint8 value, int len )
+{
+  return ( memset( dest, value, len ) );
+}
+
+uint8 HalAdcCheckVdd( uint8 vdd )
+{
+  return ( TRUE );
+}
+
+uint32 halSleepReadTimer( void )
+{
+  return ( 0 );
+}
+
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+/*
+ * The application's handling of the task event: a step while not
+ * connected, the notices turned on while connected.
+ */
+static void simTask( uint8 connected )
+{
+  if ( simTimerDue && ( simMs >= simTimerDue ) )
+  {
+    simTimerDue = 0;
+    simEvents |= SIM_EVT;
+  }
+
+  if ( simEvents & SIM_EVT )
+  {
+    simEvents &= ~SIM_EVT;
+    if ( connected )
+    {
+      simNotice = BlackBox_Pending();
+    }
+    else
+    {
+      BlackBox_Step();
+    }
+  }
+}
+
+/*
+ * Run connection events for ms; FALSE if a step erased and wrote.
+ */
+static uint8 simConnected( uint32 ms )
+{
+  uint32 end = simMs + ms;
+  uint8 clean = TRUE;
+
+  while ( simMs < end )
+  {
+    simMs += SIM_CONN_INTERVAL;
+    simTask( TRUE );
+
+    if ( simNotice )
+    {
+      uint64_t words = flashsim->words;
+      uint32 erases = 0;
+      uint8 pg;
+
+      for ( pg = 0; pg < FLASHSIM_PAGES; pg++ )
+      {
+        erases += flashsim->erases[pg];
+      }
+      BlackBox_Step();
+      for ( pg = 0; pg < FLASHSIM_PAGES; pg++ )
+      {
+        erases -= flashsim->erases[pg];
+      }
+
+      if ( erases && ( flashsim->words != words ) )
+      {
+        clean = FALSE;
+      }
+      simNotice = BlackBox_Pending();
+    }
+  }
+
+  return ( clean );
+}
+
+static void simRecord( uint8 n )
+{
+  uint8 data[BLACKBOX_REC_MAX_LEN];
+
+  memset( data, n, sizeof( data ) );
+  BlackBox_Record( BLACKBOX_REC_CMD, data, sizeof( data ) );
+}
+
+/*
+ * Count the CMD records of the dump that carry n.
+ */
+static int simDumped( uint8 n )
+{
+  uint8 chunk[BLACKBOX_CHUNK_SIZE];
+  uint16 cnt = BlackBox_DumpStart();
+  int found = 0;
+  uint16 idx;
+  uint8 i;
+
+  for ( idx = 0; idx < cnt; idx++ )
+  {
+    BlackBox_DumpRead( idx, chunk );
+    for ( i = 0; i + BLACKBOX_REC_HDR_LEN <= BLACKBOX_CHUNK_SIZE; )
+    {
+      uint8 type = chunk[i] >> 4;
+      uint8 len = chunk[i] & 0x0F;
+
+      if ( type == BLACKBOX_REC_END )
+      {
+        break;
+      }
+      if ( ( type == BLACKBOX_REC_CMD ) && ( chunk[i + BLACKBOX_REC_HDR_LEN] == n ) )
+      {
+        found++;
+      }
+      i += BLACKBOX_REC_HDR_LEN + len;
+    }
+  }
+  BlackBox_DumpEnd();
+
+  return ( found );
+}
+
+int main( void )
+{
+  uint64_t words;
+  int sets;
+
+  flashsimInit( NULL );
+  simMs = 1000;
+  BlackBox_Init( SIM_TASK, SIM_EVT );
+  simTask( FALSE );
+
+  BlackBox_SetConnected( TRUE );
+  simCheck( "open boot chunk not pending before it is due", !BlackBox_Pending() );
+  simCheck( "clean steps while the boot chunk comes due",
+            simConnected( BLACKBOX_FLUSH_DELAY + 100 ) );
+  simCheck( "boot chunk written once due, notices off after",
+            !BlackBox_Pending() && !simNotice && ( flashsim->words != 0 ) );
+
+  sets = simEventSets;
+  simRecord( 1 );
+  simRecord( 2 );
+  simRecord( 3 );
+  simCheck( "records while connected set the event once", simEventSets == sets + 1 );
+  simCheck( "closed chunks pending", BlackBox_Pending() );
+  simCheck( "clean steps while the records are written", simConnected( 200 ) );
+  simCheck( "closed chunks written, notices off", !simNotice && !BlackBox_Pending() );
+
+  // Two pages more, of which the steps erase each first
+  for ( sets = 0; sets < BLACKBOX_PAGE_CHUNKS; sets++ )
+  {
+    simRecord( 4 );
+    simRecord( 4 );
+    if ( !simConnected( 100 ) )
+    {
+      break;
+    }
+  }
+  simCheck( "no step erased and wrote", sets == BLACKBOX_PAGE_CHUNKS );
+  simCheck( "clean steps while the last chunk comes due",
+            simConnected( BLACKBOX_FLUSH_DELAY + 100 ) );
+
+  // A dump that starts with records waiting
+  simRecord( 5 );
+  simRecord( 5 );
+  BlackBox_DumpStart();
+  words = flashsim->words;
+  simConnected( 100 );
+  simRecord( 5 );
+  simCheck( "nothing pending or written during a dump",
+            !BlackBox_Pending() && !simNotice && ( flashsim->words == words ) );
+  sets = simEventSets;
+  BlackBox_DumpEnd();
+  simCheck( "end of the dump sets the event for the records", simEventSets == sets + 1 );
+  simCheck( "records of the dump written after it",
+            simConnected( 200 ) && simConnected( BLACKBOX_FLUSH_DELAY + 100 ) && !BlackBox_Pending() );
+
+  simCheck( "records come back from the dump", ( simDumped( 3 ) == 1 ) && ( simDumped( 5 ) == 3 ) );
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
@@ -0,0 +1,149 @@
+/**************************************************************************************************
+  Filename:       bmbench.c
+
+  Description:    Host benchmark of the buffer manager in osal_bufmgr.c. Keeps a
+                  growing number of buffers outstanding and reports the cost of
+                  osal_bm_free on a buffer picked at random, which is then
+                  allocated again: the median and the 99.9th percentile, and the
+                  99.9th percentile of its interrupts off section.
+
+                  Two cases are measured. Freeing the pointer osal_bm_alloc
+                  returned finds the buffer descriptor in front of it. Freeing
+                  a pointer moved into the payload by osal_bm_adjust_header
+                  finds it one remembered offset further back. Before it runs,
+                  it checks that more distinct offsets than are remembered
+                  still free every buffer, by the walk of the buffer list.
+
+                  Buffers come from malloc, so that only the buffer manager is
+                  measured. Times are host nanoseconds; they show how the cost
+                  grows with the number of buffers, not CC2541 cycle counts.
+
+                  Build:  sh build.sh bmbench
+                  Usage:  bmbench [frees]
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../Components/osal/common/osal_bufmgr.c"
+
+#define BENCH_MAX_BUFS         128
+#define BENCH_HDR_LEN          8        // Header room skipped by the moved pointers
+
+void *osal_mem_alloc( uint16 size )
+{
+  return ( malloc( size ) );
+}
+
+void osal_mem_free( void *ptr )
+{
+  free( ptr );
+}
+
+static void *benchBufs[BENCH_MAX_BUFS];
+
+static hostsimHist_t benchFree;
+static hostsimHist_t benchFreeOff;
+static hostsimHist_t benchMoved;
+static hostsimHist_t benchMovedOff;
+
+static void *benchAlloc( uint8 moved )
+{
+  uint8 *p = osal_bm_alloc( 27 + BENCH_HDR_LEN + rand() % 8 );
+
+  if ( p == NULL )
+  {
+    fprintf( stderr, "out of memory\n" );
+    exit( 2 );
+  }
+
+  return ( moved ? osal_bm_adjust_header( p, -BENCH_HDR_LEN ) : p );
+}
+
+/*
+ * Free and allocate again buffers picked at random out of bufs outstanding.
+ */
+static void benchRun( int bufs, long frees, uint8 moved,
+                      hostsimHist_t *pHist, hostsimHist_t *pOff )
+{
+  uint64_t t0;
+  long i;
+  int n;
+
+  srand( 1 );
+  for ( n = 0; n < bufs; n++ )
+  {
+    benchBufs[n] = benchAlloc( moved );
+  }
+
+  hostsimHistReset( pHist );
+  hostsimHistReset( &hostsimIntOffHist );
+  for ( i = 0; i < frees; i++ )
+  {
+    n = rand() % bufs;
+    t0 = hostsimNow();
+    osal_bm_free( benchBufs[n] );
+    hostsimHistTime( pHist, t0 );
+    benchBufs[n] = benchAlloc( moved );
+  }
+  *pOff = hostsimIntOffHist;
+
+  for ( n = 0; n < bufs; n++ )
+  {
+    osal_bm_free( benchBufs[n] );
+  }
+  if ( bm_list_ptr != NULL )
+  {
+    fprintf( stderr, "buffers left on the list\n" );
+    exit( 2 );
+  }
+}
+
+/*
+ * Free buffers moved by more distinct offsets than are remembered.
+ */
+static void benchOffsets( void )
+{
+  int n;
+
+  for ( n = 0; n < BM_PAYLOAD_OFFSETS + 4; n++ )
+  {
+    benchBufs[n] = osal_bm_adjust_header( benchAlloc( FALSE ), -( n + 1 ) );
+  }
+  for ( n = 0; n < BM_PAYLOAD_OFFSETS + 4; n++ )
+  {
+    osal_bm_free( benchBufs[n] );
+  }
+  if ( bm_list_ptr != NULL )
+  {
+    fprintf( stderr, "buffers moved by forgotten offsets left on the list\n" );
+    exit( 2 );
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  static const int counts[] = { 1, 4, 8, 16, 32, 64, BENCH_MAX_BUFS };
+  long frees = ( argc > 1 ) ? atol( argv[1] ) : 200000;
+  unsigned i;
+
+  hostsimInit();
+  benchOffsets();
+  printf( "             free of the start, ns    free of a moved pointer, ns\n" );
+  printf( "buffers   median    99.9%%  ints off   median    99.9%%  ints off\n" );
+  for ( i = 0; i < sizeof( counts ) / sizeof( counts[0] ); i++ )
+  {
+    benchRun( counts[i], frees, FALSE, &benchFree, &benchFreeOff );
+    benchRun( counts[i], frees, TRUE, &benchMoved, &benchMovedOff );
+    printf( "%7d %8llu %8llu %8llu %8llu %8llu %8llu\n", counts[i],
+            (unsigned long long)hostsimHistPct( &benchFree, 50.0 ),
+            (unsigned long long)hostsimHistPct( &benchFree, 99.9 ),
+            (unsigned long long)hostsimHistPct( &benchFreeOff, 99.9 ),
+            (unsigned long long)hostsimHistPct( &benchMoved, 50.0 ),
+            (unsigned long long)hostsimHistPct( &benchMoved, 99.9 ),
+            (unsigned long long)hostsimHistPct( &benchMovedOff, 99.9 ) );
+  }
+
+  return ( 0 );
+}
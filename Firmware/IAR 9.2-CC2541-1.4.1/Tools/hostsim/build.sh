@@ -0,0 +1,32 @@
+#!/bin/sh
+# Build a host simulator program from its source in this directory:
+#
+#     sh build.sh timerbench [gcc options]
+#
+# OUT names the program, for builds of one source with different options.
+# The firmware sources under test are included by the program's own source.
+
+cd "$(dirname "$0")" || exit 1
+prog=$1
+shift
+
+FW=../..
+C=$FW/Components
+P=$FW/Projects/ble
+INC="$C/hal/include $C/hal/target/CC2540EB $C/osal/include $C/osal/mcu/cc2540 $C/services/saddr $P/common/cc2540 $P/include"
+
+# The sources were written on Windows and name some headers in another case
+# (osal.h for OSAL.h); give the compiler a lower case link to each header.
+lc=$(mktemp -d) || exit 1
+trap 'rm -rf "$lc"' EXIT
+for d in $INC; do
+  for h in "$d"/*.h; do
+    [ -e "$h" ] || continue
+    l=$(basename "$h" | tr 'A-Z' 'a-z')
+    [ -e "$lc/$l" ] || ln -s "$PWD/$h" "$lc/$l"
+  done
+done
+
+gcc -std=gnu99 -O2 -g -Wall -Wno-unused-function -Wno-unused-variable -Wno-unknown-pragmas \
+  -include hostsim.h -I. $(for d in $INC; do echo "-I$d"; done) -I"$lc" \
+  -o "${OUT:-$prog}" hostsim.c "$prog.c" "$@"
@@ -0,0 +1,533 @@
+/**************************************************************************************************
+  Filename:       cmdauthsim.c
+
+  Description:    Host test of the authenticated motor commands of the BLE_Bridge
+                  cmdAuth.c: its AES-CCM, built from ECB blocks of the AES
+                  engine, and the counter that refuses replays.
+
+                  The AES engine is replaced by AES-128 in software, checked
+                  against the FIPS-197 examples. The commands are sealed by a
+                  reference CCM written from NIST SP 800-38C for any nonce,
+                  length field and MIC length, with associated data, and
+                  checked against SP 800-38C example 1 (a 4 byte MIC, an
+                  8 byte length field) and RFC 3610 packet vector #1 (an
+                  8 byte MIC, a 2 byte length field). cmdAuth.c uses a 4 byte
+                  MIC, a 2 byte length field and no associated data. NV is a
+                  model of one item, whose reads and writes can be made to
+                  fail.
+
+                  The checks: commands sealed by the reference open to their
+                  data, and a change of any bit of the counter, the data or
+                  the MIC, a wrong BD address or a wrong key is refused with
+                  CMD_AUTH_ERR_MIC; a counter not above the last one accepted
+                  is refused with CMD_AUTH_ERR_REPLAY, and refused commands
+                  leave the counter alone; the counter is saved
+                  CMD_AUTH_SAVE_STEP ahead once per step, and after a reset
+                  every counter up to the saved one is refused; a failed save
+                  refuses the command with CMD_AUTH_ERR_NV, leaving the
+                  counter and the output alone, and the same command opens
+                  once NV works again; a failed read at start up refuses
+                  nothing; and the saved counter stops at 0xFFFFFFFF.
+
+                  Build:  sh build.sh cmdauthsim -I../../Components/ble/include
+                  Usage:  cmdauthsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CMD_AUTH               TRUE
+#define CMD_AUTH_KEY           0x5A, 0x19, 0xC3, 0x07, 0x8E, 0x61, 0xF2, 0x3D, \
+                               0xB4, 0x90, 0x2E, 0xD7, 0x46, 0x0B, 0xA8, 0x75
+
+#include "../../Projects/ble/BLE_Bridge/Source/cmdAuth.c"
+
+static const uint8 simKey[KEY_BLENGTH] = { CMD_AUTH_KEY };
+static const uint8 simAddr[B_ADDR_LEN] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+static int simFails;
+
+/* ------------------------------------------------------------------------------------------------
+ *                                        AES-128 in software
+ * ------------------------------------------------------------------------------------------------
+ */
+static const uint8 simSbox[256] =
+{
+  0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+  0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+  0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+  0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+  0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+  0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+  0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+  0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+  0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+  0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+  0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+  0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+  0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+  0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+  0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+  0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static uint8 simXtime( uint8 b )
+{
+  return ( (uint8)( ( b << 1 ) ^ ( ( b & 0x80 ) ? 0x1B : 0x00 ) ) );
+}
+
+/*
+ * Encrypt a block in place, state in the byte order of FIPS-197.
+ */
+static void simAesEncrypt( const uint8 *pKey, uint8 *pBlock )
+{
+  uint8 rk[KEY_BLENGTH];
+  uint8 t[STATE_BLENGTH];
+  uint8 rcon = 0x01;
+  uint8 round, c, i, a0, a1, a2, a3;
+
+  memcpy( rk, pKey, KEY_BLENGTH );
+  for ( i = 0; i < STATE_BLENGTH; i++ )
+  {
+    pBlock[i] ^= rk[i];
+  }
+
+  for ( round = 1; round <= 10; round++ )
+  {
+    // SubBytes and ShiftRows
+    for ( c = 0; c < 4; c++ )
+    {
+      for ( i = 0; i < 4; i++ )
+      {
+        t[4 * c + i] = simSbox[pBlock[4 * ( ( c + i ) % 4 ) + i]];
+      }
+    }
+
+    // MixColumns, but in the last round
+    for ( c = 0; c < 4; c++ )
+    {
+      a0 = t[4 * c];
+      a1 = t[4 * c + 1];
+      a2 = t[4 * c + 2];
+      a3 = t[4 * c + 3];
+      if ( round < 10 )
+      {
+        pBlock[4 * c]     = simXtime( a0 ^ a1 ) ^ a1 ^ a2 ^ a3;
+        pBlock[4 * c + 1] = simXtime( a1 ^ a2 ) ^ a2 ^ a3 ^ a0;
+        pBlock[4 * c + 2] = simXtime( a2 ^ a3 ) ^ a3 ^ a0 ^ a1;
+        pBlock[4 * c + 3] = simXtime( a3 ^ a0 ) ^ a0 ^ a1 ^ a2;
+      }
+      else
+      {
+        memcpy( &pBlock[4 * c], &t[4 * c], 4 );
+      }
+    }
+
+    // Next round key
+    rk[0] ^= simSbox[rk[13]] ^ rcon;
+    rk[1] ^= simSbox[rk[14]];
+    rk[2] ^= simSbox[rk[15]];
+    rk[3] ^= simSbox[rk[12]];
+    for ( i = 4; i < KEY_BLENGTH; i++ )
+    {
+      rk[i] ^= rk[i - 4];
+    }
+    rcon = simXtime( rcon );
+
+    for ( i = 0; i < STATE_BLENGTH; i++ )
+    {
+      pBlock[i] ^= rk[i];
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------------------------------
+ *                                     AES engine and NV models
+ * ------------------------------------------------------------------------------------------------
+ */
+static uint8 simEngineKey[KEY_BLENGTH];     // Key loaded in the engine
+static int simBlocks;                       // Blocks encrypted
+
+static uint32 simNv;                        // The NV item
+static uint8 simNvSet;
+static uint8 simNvReadFail;
+static uint8 simNvWriteFail;
+static int simNvWrites;
+
+void ssp_HW_KeyInit( uint8 *pKey )
+{
+  memcpy( simEngineKey, pKey, KEY_BLENGTH );
+}
+
+void sspAesEncryptHW( uint8 *pKey, uint8 *pBlock )
+{
+  // The engine encrypts with the key loaded, whatever the key passed
+  simAesEncrypt( simEngineKey, pBlock );
+  simBlocks++;
+}
+
+uint8 osal_snv_read( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
+{
+  if ( ( id != CMD_AUTH_NVID ) || ( len != sizeof( simNv ) ) || !simNvSet || simNvReadFail )
+  {
+    return ( NV_OPER_FAILED );
+  }
+  memcpy( pBuf, &simNv, len );
+
+  return ( SUCCESS );
+}
+
+uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf )
+{
+  if ( ( id != CMD_AUTH_NVID ) || ( len != sizeof( simNv ) ) || simNvWriteFail )
+  {
+    return ( NV_OPER_FAILED );
+  }
+  memcpy( &simNv, pBuf, len );
+  simNvSet = TRUE;
+  simNvWrites++;
+
+  return ( SUCCESS );
+}
+
+void *osal_memcpy( void *dst, const void GENERIC *src, unsigned int len )
+{
+  return ( (uint8 *)memcpy( dst, src, len ) + len );
+}
+
+void *osal_memset( void *dest, uint8 value, int len )
+{
+  return ( memset( dest, value, len ) );
+}
+
+uint32 halSleepReadTimer( void )
+{
+  return ( 0 );
+}
+
+/* ------------------------------------------------------------------------------------------------
+ *                                         Reference CCM
+ * ------------------------------------------------------------------------------------------------
+ */
+
+/*
+ * Seal a message as NIST SP 800-38C does it: the nonce of nLen bytes
+ * (length field 15 - nLen), aLen bytes of associated data (up to 0xFEFF)
+ * and a MIC of mLen bytes. pOut gets the encrypted message, then the MIC.
+ */
+static void simCcmSeal( const uint8 *pKey, const uint8 *pNonce, uint8 nLen,
+                        const uint8 *pA, uint16 aLen, const uint8 *pMsg, uint16 len,
+                        uint8 mLen, uint8 *pOut )
+{
+  uint8 x[STATE_BLENGTH], b[STATE_BLENGTH], s[STATE_BLENGTH];
+  uint8 q = 15 - nLen;
+  uint16 ctr, i, j, n;
+
+  // B0, then the CBC-MAC of the length of the associated data, the data
+  // and the message, each padded with zeros to whole blocks
+  memset( x, 0, sizeof( x ) );
+  x[0] = ( aLen ? 0x40 : 0 ) | ( ( ( mLen - 2 ) / 2 ) << 3 ) | ( q - 1 );
+  memcpy( &x[1], pNonce, nLen );
+  x[14] = HI_UINT16( len );
+  x[15] = LO_UINT16( len );
+  simAesEncrypt( pKey, x );
+
+  if ( aLen )
+  {
+    memset( b, 0, sizeof( b ) );
+    b[0] = HI_UINT16( aLen );
+    b[1] = LO_UINT16( aLen );
+    for ( i = 0, j = 2; i < aLen; i++ )
+    {
+      b[j++] = pA[i];
+      if ( ( j == STATE_BLENGTH ) || ( i + 1 == aLen ) )
+      {
+        for ( n = 0; n < STATE_BLENGTH; n++ )
+        {
+          x[n] ^= b[n];
+        }
+        simAesEncrypt( pKey, x );
+        memset( b, 0, sizeof( b ) );
+        j = 0;
+      }
+    }
+  }
+
+  for ( i = 0; i < len; i += STATE_BLENGTH )
+  {
+    for ( n = 0; ( n < STATE_BLENGTH ) && ( i + n < len ); n++ )
+    {
+      x[n] ^= pMsg[i + n];
+    }
+    simAesEncrypt( pKey, x );
+  }
+
+  // CTR: block 0 encrypts the MIC, blocks 1 on the message
+  for ( ctr = 0; ctr <= ( len + STATE_BLENGTH - 1 ) / STATE_BLENGTH; ctr++ )
+  {
+    memset( s, 0, sizeof( s ) );
+    s[0] = q - 1;
+    memcpy( &s[1], pNonce, nLen );
+    s[14] = HI_UINT16( ctr );
+    s[15] = LO_UINT16( ctr );
+    simAesEncrypt( pKey, s );
+
+    if ( ctr == 0 )
+    {
+      for ( n = 0; n < mLen; n++ )
+      {
+        pOut[len + n] = x[n] ^ s[n];
+      }
+    }
+    else
+    {
+      for ( n = 0; ( n < STATE_BLENGTH ) && ( ( ctr - 1 ) * STATE_BLENGTH + n < len ); n++ )
+      {
+        i = ( ctr - 1 ) * STATE_BLENGTH + n;
+        pOut[i] = pMsg[i] ^ s[n];
+      }
+    }
+  }
+}
+
+/*
+ * Seal a motor command as a client does: the counter (LSB first), then the
+ * command encrypted under the nonce of the counter, the BD address and 3
+ * zero bytes, then the MIC.
+ */
+static void simSeal( const uint8 *pKey, const uint8 *pAddr, uint32 cnt, const uint8 *pData,
+                     uint8 *pCmd )
+{
+  uint8 nonce[CMD_AUTH_NONCE_LEN];
+
+  memset( nonce, 0, sizeof( nonce ) );
+  nonce[0] = BREAK_UINT32( cnt, 0 );
+  nonce[1] = BREAK_UINT32( cnt, 1 );
+  nonce[2] = BREAK_UINT32( cnt, 2 );
+  nonce[3] = BREAK_UINT32( cnt, 3 );
+  memcpy( &nonce[CMD_AUTH_CNT_LEN], pAddr, B_ADDR_LEN );
+
+  memcpy( pCmd, nonce, CMD_AUTH_CNT_LEN );
+  simCcmSeal( pKey, nonce, CMD_AUTH_NONCE_LEN, NULL, 0, pData, CMD_AUTH_DATA_LEN,
+              CMD_AUTH_MIC_LEN, &pCmd[CMD_AUTH_CNT_LEN] );
+}
+
+/* ------------------------------------------------------------------------------------------------
+ *                                              Test
+ * ------------------------------------------------------------------------------------------------
+ */
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+static void simHex( const char *pHex, uint8 *pBuf )
+{
+  unsigned v;
+
+  while ( sscanf( pHex, "%2x", &v ) == 1 )
+  {
+    *pBuf++ = (uint8)v;
+    pHex += 2;
+  }
+}
+
+/*
+ * TRUE if the AES block of the hex key and plain text is the hex cipher text.
+ */
+static int simAesVector( const char *pKey, const char *pPlain, const char *pCipher )
+{
+  uint8 key[KEY_BLENGTH], block[STATE_BLENGTH], expect[STATE_BLENGTH];
+
+  simHex( pKey, key );
+  simHex( pPlain, block );
+  simHex( pCipher, expect );
+  simAesEncrypt( key, block );
+
+  return ( memcmp( block, expect, STATE_BLENGTH ) == 0 );
+}
+
+/*
+ * TRUE if the reference CCM seals the hex message as the hex output, the
+ * encrypted message then the MIC.
+ */
+static int simCcmVector( const char *pKey, const char *pNonce, const char *pA, const char *pMsg,
+                         uint8 mLen, const char *pExpect )
+{
+  uint8 key[KEY_BLENGTH], nonce[STATE_BLENGTH], a[64], msg[64], out[80], expect[80];
+  uint8 nLen = strlen( pNonce ) / 2;
+  uint16 aLen = strlen( pA ) / 2;
+  uint16 len = strlen( pMsg ) / 2;
+
+  simHex( pKey, key );
+  simHex( pNonce, nonce );
+  simHex( pA, a );
+  simHex( pMsg, msg );
+  simHex( pExpect, expect );
+  simCcmSeal( key, nonce, nLen, a, aLen, msg, len, mLen, out );
+
+  return ( memcmp( out, expect, len + mLen ) == 0 );
+}
+
+int main( void )
+{
+  static const uint8 wrongAddr[B_ADDR_LEN] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x67 };
+  uint8 wrongKey[KEY_BLENGTH];
+  uint8 data[CMD_AUTH_DATA_LEN], out[CMD_AUTH_DATA_LEN], none[CMD_AUTH_DATA_LEN];
+  uint8 cmd[CMD_AUTH_LEN], bad[CMD_AUTH_LEN];
+  cmdAuthStats_t stats;
+  uint32 cnt;
+  int opened, refused, blocks, i, j;
+  uint8 status;
+
+  srand( 1 );
+
+  // The software AES, FIPS-197 appendices B and C.1
+  simCheck( "AES-128, FIPS-197 appendix B",
+            simAesVector( "2b7e151628aed2a6abf7158809cf4f3c", "3243f6a8885a308d313198a2e0370734",
+                          "3925841d02dc09fbdc118597196a0b32" ) );
+  simCheck( "AES-128, FIPS-197 appendix C.1",
+            simAesVector( "000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff",
+                          "69c4e0d86a7b0430d8cdb78070b4c55a" ) );
+
+  // The reference CCM, SP 800-38C example 1 (4 byte MIC) and RFC 3610
+  // packet vector #1 (2 byte length field, 13 byte nonce)
+  simCheck( "reference CCM, SP 800-38C example 1",
+            simCcmVector( "404142434445464748494a4b4c4d4e4f", "10111213141516", "0001020304050607",
+                          "20212223", 4, "7162015b4dac255d" ) );
+  simCheck( "reference CCM, RFC 3610 packet vector #1",
+            simCcmVector( "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf", "00000003020100a0a1a2a3a4a5",
+                          "0001020304050607", "08090a0b0c0d0e0f101112131415161718191a1b1c1d1e",
+                          8, "588c979a61c663d2f066d0c2c0f989806d5f6b61dac38417e8d12cfdf926e0" ) );
+
+  memset( none, 0xA5, sizeof( none ) );
+  CmdAuth_Init();
+  CmdAuth_SetAddress( (uint8 *)simAddr );
+  simCheck( "no counter refused without a saved one", CmdAuth_GetCounter() == 1 );
+
+  // Commands sealed by the reference open to their data
+  cnt = 0;
+  opened = 0;
+  for ( i = 0; i < 1000; i++ )
+  {
+    for ( j = 0; j < CMD_AUTH_DATA_LEN; j++ )
+    {
+      data[j] = (uint8)rand();
+    }
+    cnt += 1 + rand() % 1000;
+    simSeal( simKey, simAddr, cnt, data, cmd );
+    blocks = simBlocks;
+    if ( ( CmdAuth_Open( cmd, out ) == SUCCESS ) && ( memcmp( out, data, sizeof( data ) ) == 0 ) &&
+         ( CmdAuth_GetCounter() == cnt + 1 ) && ( simBlocks - blocks == 4 ) )
+    {
+      opened++;
+    }
+  }
+  simCheck( "1000 commands sealed by the reference opened, 4 blocks each", opened == 1000 );
+
+  // Any bit of the counter, the data or the MIC changed
+  cnt += 1000;
+  simSeal( simKey, simAddr, cnt, data, cmd );
+  refused = 0;
+  for ( i = 0; i < CMD_AUTH_LEN * 8; i++ )
+  {
+    memcpy( bad, cmd, sizeof( cmd ) );
+    bad[i / 8] ^= BV( i % 8 );
+    memcpy( out, none, sizeof( out ) );
+    status = CmdAuth_Open( bad, out );
+    // A counter changed downwards is a replay, caught before the MIC
+    if ( ( ( status == CMD_AUTH_ERR_MIC ) ||
+           ( ( status == CMD_AUTH_ERR_REPLAY ) && ( i < CMD_AUTH_CNT_LEN * 8 ) ) ) &&
+         ( memcmp( out, none, sizeof( out ) ) == 0 ) )
+    {
+      refused++;
+    }
+  }
+  simSeal( (uint8 *)simKey, wrongAddr, cnt, data, bad );
+  refused += ( CmdAuth_Open( bad, out ) == CMD_AUTH_ERR_MIC );
+  memcpy( wrongKey, simKey, sizeof( wrongKey ) );
+  wrongKey[KEY_BLENGTH - 1] ^= 0x01;
+  simSeal( wrongKey, simAddr, cnt, data, bad );
+  refused += ( CmdAuth_Open( bad, out ) == CMD_AUTH_ERR_MIC );
+  simCheck( "any bit changed, a wrong address or key refused",
+            refused == CMD_AUTH_LEN * 8 + 2 );
+  simCheck( "refused commands leave the counter alone", CmdAuth_GetCounter() == cnt - 1000 + 1 );
+  simCheck( "the command itself still opens", CmdAuth_Open( cmd, out ) == SUCCESS );
+
+  // Replays
+  CmdAuth_GetStats( &stats, TRUE );
+  simCheck( "the same command again refused as a replay",
+            CmdAuth_Open( cmd, out ) == CMD_AUTH_ERR_REPLAY );
+  simSeal( simKey, simAddr, cnt - 1, data, bad );
+  simCheck( "a lower counter refused as a replay", CmdAuth_Open( bad, out ) == CMD_AUTH_ERR_REPLAY );
+  simSeal( simKey, simAddr, cnt + 1, data, bad );
+  bad[CMD_AUTH_LEN - 1] ^= 0x80;
+  VOID CmdAuth_Open( bad, out );
+  CmdAuth_GetStats( &stats, FALSE );
+  simCheck( "refused commands counted",
+            ( stats.accepted == 0 ) && ( stats.replays == 2 ) && ( stats.micErrors == 1 ) );
+
+  // The counter saved once per step, ahead of it: at 1, 1 + CMD_AUTH_SAVE_STEP...
+  simNv = 0;
+  simNvSet = FALSE;
+  CmdAuth_Init();
+  simNvWrites = 0;
+  for ( cnt = 1; cnt <= 3 * CMD_AUTH_SAVE_STEP; cnt++ )
+  {
+    simSeal( simKey, simAddr, cnt, data, cmd );
+    VOID CmdAuth_Open( cmd, out );
+  }
+  simCheck( "the counter saved once per CMD_AUTH_SAVE_STEP commands",
+            ( simNvWrites == 3 ) && ( simNv == 2 * CMD_AUTH_SAVE_STEP + 1 + CMD_AUTH_SAVE_STEP ) );
+
+  // A reset: every counter up to the saved one is refused
+  cnt = simNv;
+  CmdAuth_Init();
+  simSeal( simKey, simAddr, cnt, data, cmd );
+  status = CmdAuth_Open( cmd, out );
+  simSeal( simKey, simAddr, cnt + 1, data, cmd );
+  simCheck( "after a reset the counters up to the saved one refused",
+            ( CmdAuth_GetCounter() == cnt + 1 ) && ( status == CMD_AUTH_ERR_REPLAY ) &&
+            ( CmdAuth_Open( cmd, out ) == SUCCESS ) && ( simNv == cnt + 1 + CMD_AUTH_SAVE_STEP ) );
+
+  // A failed save
+  cnt = simNv;
+  simNvWriteFail = TRUE;
+  simNvWrites = 0;
+  simSeal( simKey, simAddr, cnt, data, cmd );
+  memcpy( out, none, sizeof( out ) );
+  simCheck( "a command refused when its counter cannot be saved",
+            ( CmdAuth_Open( cmd, out ) == CMD_AUTH_ERR_NV ) &&
+            ( memcmp( out, none, sizeof( out ) ) == 0 ) &&
+            ( CmdAuth_GetCounter() == cnt - CMD_AUTH_SAVE_STEP + 1 ) );
+  simNvWriteFail = FALSE;
+  simCheck( "the same command opens once NV works again",
+            ( CmdAuth_Open( cmd, out ) == SUCCESS ) && ( memcmp( out, data, sizeof( data ) ) == 0 ) &&
+            ( simNvWrites == 1 ) && ( simNv == cnt + CMD_AUTH_SAVE_STEP ) );
+
+  // A failed read at start up
+  simNvReadFail = TRUE;
+  CmdAuth_Init();
+  simNvReadFail = FALSE;
+  simSeal( simKey, simAddr, 1, data, cmd );
+  simCheck( "a failed NV read at start up refuses nothing",
+            ( CmdAuth_GetCounter() == 1 ) && ( CmdAuth_Open( cmd, out ) == SUCCESS ) );
+
+  // The top of the counter
+  simSeal( simKey, simAddr, 0xFFFFFFFF - CMD_AUTH_SAVE_STEP + 1, data, cmd );
+  status = CmdAuth_Open( cmd, out );
+  simCheck( "the saved counter stops at 0xFFFFFFFF",
+            ( status == SUCCESS ) && ( simNv == 0xFFFFFFFF ) );
+  simSeal( simKey, simAddr, 0xFFFFFFFF, data, cmd );
+  simCheck( "the last counter opens, once",
+            ( CmdAuth_Open( cmd, out ) == SUCCESS ) &&
+            ( CmdAuth_Open( cmd, out ) == CMD_AUTH_ERR_REPLAY ) );
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
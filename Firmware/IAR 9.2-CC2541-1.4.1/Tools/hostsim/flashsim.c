@@ -0,0 +1,145 @@
+/**************************************************************************************************
+  Filename:       flashsim.c
+
+  Description:    Host stand-in for the CC2541 flash driver, see flashsim.h.
+
+                  A torn word write clears a random part of the bits it was
+                  to clear. A torn erase sets a random part of the bits of the
+                  page, as an erase cut short leaves cells partly charged.
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_flash.h"
+#include "flashsim.h"
+
+flashsim_t *flashsim;
+
+void (*flashsimCutCB)( void );
+
+static long flashsimCutOps = -1;
+
+/*
+ * Count a write or erase; TRUE when it is the one to tear.
+ */
+static uint8 flashsimCutNow( void )
+{
+  if ( flashsimCutOps < 0 )
+  {
+    return ( FALSE );
+  }
+
+  return ( flashsimCutOps-- == 0 );
+}
+
+static void flashsimPowerOff( void )
+{
+  flashsimCutOps = -1;
+  if ( flashsimCutCB != NULL )
+  {
+    flashsimCutCB();
+  }
+
+  fprintf( stderr, "flashsim: power lost with no handler\n" );
+  exit( 2 );
+}
+
+void flashsimInit( flashsim_t *pFlash )
+{
+  if ( pFlash == NULL )
+  {
+    pFlash = malloc( sizeof( flashsim_t ) );
+    if ( pFlash == NULL )
+    {
+      fprintf( stderr, "flashsim: out of memory\n" );
+      exit( 2 );
+    }
+  }
+
+  memset( pFlash, 0, sizeof( flashsim_t ) );
+  memset( pFlash->mem, 0xFF, sizeof( pFlash->mem ) );
+  flashsim = pFlash;
+  flashsimCutOps = -1;
+}
+
+void flashsimCut( long ops )
+{
+  flashsimCutOps = ops;
+}
+
+void HalFlashRead( uint8 pg, uint16 offset, uint8 *buf, uint16 cnt )
+{
+  if ( ( pg >= FLASHSIM_PAGES ) || ( (uint32)offset + cnt > HAL_FLASH_PAGE_SIZE ) )
+  {
+    fprintf( stderr, "flashsim: read of %u bytes at page %u offset %u\n", cnt, pg, offset );
+    exit( 2 );
+  }
+
+  memcpy( buf, &flashsim->mem[pg][offset], cnt );
+}
+
+void HalFlashWrite( uint16 addr, uint8 *buf, uint16 cnt )
+{
+  uint8 pg = addr / FLASHSIM_WORDS;
+  uint16 word = addr % FLASHSIM_WORDS;
+  uint8 i;
+
+  if ( ( pg >= FLASHSIM_PAGES ) || ( (uint32)word + cnt > FLASHSIM_WORDS ) )
+  {
+    fprintf( stderr, "flashsim: write of %u words at address 0x%04X\n", cnt, addr );
+    exit( 2 );
+  }
+
+  for ( ; cnt != 0; cnt--, word++, buf += HAL_FLASH_WORD_SIZE )
+  {
+    uint8 *pMem = &flashsim->mem[pg][word * HAL_FLASH_WORD_SIZE];
+
+    if ( flashsimCutNow() )
+    {
+      for ( i = 0; i < HAL_FLASH_WORD_SIZE; i++ )
+      {
+        pMem[i] &= buf[i] | (uint8)rand();
+      }
+      flashsimPowerOff();
+    }
+
+    for ( i = 0; i < HAL_FLASH_WORD_SIZE; i++ )
+    {
+      pMem[i] &= buf[i];
+    }
+
+    if ( ++flashsim->writes[pg][word] > 2 )
+    {
+      flashsim->overwrites++;
+    }
+    flashsim->words++;
+    flashsim->busyUs += FLASHSIM_WORD_US;
+  }
+}
+
+void HalFlashErase( uint8 pg )
+{
+  uint16 i;
+
+  if ( pg >= FLASHSIM_PAGES )
+  {
+    fprintf( stderr, "flashsim: erase of page %u\n", pg );
+    exit( 2 );
+  }
+
+  if ( flashsimCutNow() )
+  {
+    for ( i = 0; i < HAL_FLASH_PAGE_SIZE; i++ )
+    {
+      flashsim->mem[pg][i] |= (uint8)rand();
+    }
+    flashsimPowerOff();
+  }
+
+  memset( flashsim->mem[pg], 0xFF, HAL_FLASH_PAGE_SIZE );
+  memset( flashsim->writes[pg], 0, FLASHSIM_WORDS );
+  flashsim->erases[pg]++;
+  flashsim->busyUs += FLASHSIM_ERASE_US;
+}
@@ -0,0 +1,51 @@
+/**************************************************************************************************
+  Filename:       flashsim.h
+
+  Description:    Host stand-in for the CC2541 flash driver in hal_flash.h. The
+                  128 pages of 2 KB live in a flashsim_t, which may be shared
+                  between processes so that a power loss test can reboot by
+                  forking. A write can only clear bits, as on the part.
+
+                  Each word write costs FLASHSIM_WORD_US and each page erase
+                  FLASHSIM_ERASE_US of modeled time, the datasheet figures the
+                  CPU stalls for. Words written more than twice between erases
+                  are counted, to check a driver against the write limit of
+                  the part.
+
+                  flashsimCut() models a power loss: after the given number of
+                  word writes and page erases, the next one is left torn and
+                  flashsimCutCB is called, which must not return.
+**************************************************************************************************/
+
+#ifndef FLASHSIM_H
+#define FLASHSIM_H
+
+#include "hal_board.h"
+
+#define FLASHSIM_PAGES      128
+#define FLASHSIM_WORDS      (HAL_FLASH_PAGE_SIZE / HAL_FLASH_WORD_SIZE)
+
+#define FLASHSIM_WORD_US    20
+#define FLASHSIM_ERASE_US   20000
+
+typedef struct
+{
+  uint8 mem[FLASHSIM_PAGES][HAL_FLASH_PAGE_SIZE];
+  uint8 writes[FLASHSIM_PAGES][FLASHSIM_WORDS];   // Writes to each word since its erase
+  uint32 erases[FLASHSIM_PAGES];
+  uint32 overwrites;      // Word writes past the second since the erase
+  uint64_t words;         // Words written
+  uint64_t busyUs;        // Modeled time spent writing and erasing
+} flashsim_t;
+
+extern flashsim_t *flashsim;
+
+/* Uses pFlash, or allocates the flash if NULL, and erases all of it */
+void flashsimInit( flashsim_t *pFlash );
+
+/* Tears the write or erase after the next ops of them; a negative count disarms */
+void flashsimCut( long ops );
+
+extern void (*flashsimCutCB)( void );
+
+#endif
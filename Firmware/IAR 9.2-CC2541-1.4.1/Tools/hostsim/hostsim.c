@@ -0,0 +1,106 @@
+/**************************************************************************************************
+  Filename:       hostsim.c
+
+  Description:    Host side of hostsim.h: the interrupt flag and its timing, and the
+                  SFRs.
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hostsim.h"
+
+volatile uint8 EA = 1;
+
+hostsimHist_t hostsimIntOffHist;
+
+uint64_t hostsimNowNs;
+
+// When interrupts went off
+static uint64_t hostsimIntOffStart;
+
+uint64_t hostsimNow( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ( (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec );
+}
+
+void hostsimHistReset( hostsimHist_t *pHist )
+{
+  memset( pHist, 0, sizeof( *pHist ) );
+}
+
+void hostsimHistAdd( hostsimHist_t *pHist, uint64_t ns )
+{
+  pHist->cnt[( ns < HOSTSIM_HIST_NS ) ? ns : HOSTSIM_HIST_NS]++;
+  pHist->n++;
+}
+
+void hostsimHistTime( hostsimHist_t *pHist, uint64_t t0 )
+{
+  uint64_t ns = hostsimNow() - t0;
+
+  hostsimHistAdd( pHist, ( ns > hostsimNowNs ) ? ns - hostsimNowNs : 0 );
+}
+
+uint64_t hostsimHistPct( const hostsimHist_t *pHist, double pct )
+{
+  uint64_t want = (uint64_t)( pHist->n * pct / 100.0 );
+  uint64_t seen = 0;
+  uint32_t ns;
+
+  for ( ns = 0; ns < HOSTSIM_HIST_NS; ns++ )
+  {
+    seen += pHist->cnt[ns];
+    if ( seen > want )
+    {
+      break;
+    }
+  }
+
+  return ( ns );
+}
+
+void hostsimInit( void )
+{
+  static hostsimHist_t cal;
+  uint64_t t0;
+  int i;
+
+  hostsimNowNs = 0;
+  hostsimHistReset( &cal );
+  for ( i = 0; i < 100000; i++ )
+  {
+    t0 = hostsimNow();
+    hostsimHistTime( &cal, t0 );
+  }
+  hostsimNowNs = hostsimHistPct( &cal, 50.0 );
+}
+
+void hostsimIntOff( void )
+{
+  if ( EA )
+  {
+    EA = 0;
+    hostsimIntOffStart = hostsimNow();
+  }
+}
+
+void hostsimIntOn( void )
+{
+  if ( !EA )
+  {
+    hostsimHistTime( &hostsimIntOffHist, hostsimIntOffStart );
+    EA = 1;
+  }
+}
+
+void hostsimReset( void )
+{
+  fprintf( stderr, "HAL_SYSTEM_RESET\n" );
+  exit( 2 );
+}
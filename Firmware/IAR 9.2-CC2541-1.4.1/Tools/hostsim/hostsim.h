@@ -0,0 +1,138 @@
+/**************************************************************************************************
+  Filename:       hostsim.h
+
+  Description:    Host port of the CC2541 target headers, so OSAL and HAL sources
+                  can be built with gcc and run on Linux. build.sh includes it ahead
+                  of every source; it stands in for hal_types.h and hal_mcu.h, which
+                  need the IAR compiler, and for the SFRs the sources touch.
+
+                  Interrupts are a flag. The critical section macros keep track of
+                  how long it stays cleared, which is the host measure of how long
+                  the target would hold interrupts off. Host times include the
+                  odd preemption of the benchmark by Linux, so the programs report
+                  percentiles rather than the maximum.
+**************************************************************************************************/
+
+#ifndef HOSTSIM_H
+#define HOSTSIM_H
+
+#include <stdint.h>
+
+/* ------------------------------------------------------------------------------------------------
+ *                                    hal_types.h replacement
+ * ------------------------------------------------------------------------------------------------
+ */
+#define _HAL_TYPES_H
+
+typedef int8_t          int8;
+typedef uint8_t         uint8;
+typedef int16_t         int16;
+typedef uint16_t        uint16;
+typedef int32_t         int32;
+typedef uint32_t        uint32;
+typedef unsigned char   bool;
+typedef uint8           halDataAlign_t;
+
+#define CODE
+#define XDATA
+#define DATA
+#define NEAR_FUNC
+#define ASM_NOP
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
+/* IAR memory and function keywords */
+#define __code
+#define __xdata
+#define __data
+#define __idata
+#define __near_func
+#define __no_init
+#define __root
+#define __monitor
+
+/* ------------------------------------------------------------------------------------------------
+ *                                     hal_mcu.h replacement
+ * ------------------------------------------------------------------------------------------------
+ */
+#define _HAL_MCU_H
+
+#include "hal_defs.h"
+
+#define HAL_MCU_CC2540
+#define HAL_MCU_LITTLE_ENDIAN()         1
+#define HAL_ISR_FUNCTION(f,v)           void f(void)
+
+typedef unsigned char halIntState_t;
+
+#define HAL_ENABLE_INTERRUPTS()         hostsimIntOn()
+#define HAL_DISABLE_INTERRUPTS()        hostsimIntOff()
+#define HAL_INTERRUPTS_ARE_ENABLED()    (EA)
+
+#define HAL_ENTER_CRITICAL_SECTION(x)   st( x = EA; hostsimIntOff(); )
+#define HAL_EXIT_CRITICAL_SECTION(x)    st( if ( x ) hostsimIntOn(); )
+#define HAL_CRITICAL_STATEMENT(x)       st( halIntState_t _s; HAL_ENTER_CRITICAL_SECTION(_s); x; HAL_EXIT_CRITICAL_SECTION(_s); )
+
+#define HAL_ENTER_ISR()
+#define HAL_EXIT_ISR()
+
+#define WD_KICK()
+#define HAL_SYSTEM_RESET()              hostsimReset()
+
+#define CLEAR_SLEEP_MODE()
+#define ALLOW_SLEEP_MODE()
+
+/* ------------------------------------------------------------------------------------------------
+ *                                              SFRs
+ * ------------------------------------------------------------------------------------------------
+ */
+extern volatile uint8 EA;
+
+/* ------------------------------------------------------------------------------------------------
+ *                                           Functions
+ * ------------------------------------------------------------------------------------------------
+ */
+
+/* Distribution of times in ns, with 1 ns resolution up to HOSTSIM_HIST_NS */
+#define HOSTSIM_HIST_NS  100000
+
+typedef struct
+{
+  uint32_t cnt[HOSTSIM_HIST_NS + 1];  // The last counts everything longer
+  uint64_t n;
+} hostsimHist_t;
+
+void hostsimHistReset( hostsimHist_t *pHist );
+void hostsimHistAdd( hostsimHist_t *pHist, uint64_t ns );
+void hostsimHistTime( hostsimHist_t *pHist, uint64_t t0 );  // Adds the time since t0
+uint64_t hostsimHistPct( const hostsimHist_t *pHist, double pct );
+
+/* Interrupts off and on; each time they stay off goes into hostsimIntOffHist */
+void hostsimIntOff( void );
+void hostsimIntOn( void );
+
+extern hostsimHist_t hostsimIntOffHist;
+
+/* Monotonic time in ns */
+uint64_t hostsimNow( void );
+
+/* Time taken by hostsimNow() itself, to take off measured times */
+extern uint64_t hostsimNowNs;
+
+/* Measures hostsimNowNs; call first */
+void hostsimInit( void );
+
+/* HAL_SYSTEM_RESET(), which ends the program */
+void hostsimReset( void );
+
+#endif
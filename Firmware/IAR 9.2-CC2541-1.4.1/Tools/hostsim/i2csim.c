@@ -0,0 +1,285 @@
+/**************************************************************************************************
+  Filename:       i2csim.c
+
+  Description:    Host test of the interrupt driven transaction queue in the
+                  CC2541ST hal_i2c.c, against a model of the I2C controller and
+                  of one slave with a register pointer, such as the sensors on
+                  the SensorTag.
+
+                  The model plays the controller: it acts on STA, STO and the
+                  data written to I2CDATA, sets I2CSTAT and SI, and runs the
+                  I2C interrupt while SI is set and IEN2.P2IE enables it, as the
+                  ISR in hal_interrupt.c would. Time is in modeled ms; the bus
+                  runs to the end of its work in each ms, then HalI2CPoll() is
+                  called as Hal_ProcessPoll() would.
+
+                  The checks: the queue keeps its order and its data, a NACK
+                  of the address or of a middle byte fails the transaction and
+                  a NACK of the last byte does not, the port 2 interrupt stays
+                  enabled and SI clear once the queue is done, and a slave that
+                  holds the bus fails its transactions with HAL_I2C_TIMEOUT and
+                  lets the Hal task go back to power saving.
+
+                  The blocking HalI2CRead() and HalI2CWrite() spin on SI in line
+                  and are not modeled.
+
+                  Build:  sh build.sh i2csim -DPOWER_SAVING
+                  Usage:  i2csim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#define HAL_I2C_ASYNC          TRUE
+
+uint8 I2CCFG, I2CSTAT, I2CDATA, I2CWC, I2CADDR, IEN2, P2IFG, P2IF;
+
+#include "../../Components/hal/target/CC2541ST/hal_i2c.c"
+
+#define SIM_SLAVE              0x40
+
+uint8 Hal_TaskID;
+
+static uint32 simMs;
+static uint8 simHold;          // The Hal task holds off power saving
+static uint8 simReg[256];
+static uint8 simRegPtr;
+static int simWrCnt;           // Bytes written since the address, -1 for none
+static int simNackAt = -1;     // Data byte of a write the slave NACKs
+static uint8 simStuck;         // The slave holds SCL low
+static uint8 simBusy;          // Between START and STOP
+
+static int simFails;
+
+uint32 osal_GetSystemClock( void )
+{
+  return ( simMs );
+}
+
+uint8 osal_pwrmgr_task_state( uint8 task_id, uint8 state )
+{
+  simHold = ( state == PWRMGR_HOLD );
+  return ( SUCCESS );
+}
+
+/*
+ * Run the controller, the slave and the I2C interrupt until the bus waits
+ * for the driver or for the slave.
+ */
+static void simBus( void )
+{
+  int guard;
+
+  for ( guard = 0; guard < 10000; guard++ )
+  {
+    if ( simStuck )
+    {
+      return;
+    }
+
+    if ( I2CCFG & I2C_SI )
+    {
+      if ( ( IEN2 & I2C_IE ) == 0 )
+      {
+        return;
+      }
+      halI2CProcessInterrupt();
+      P2IFG = 0;
+      P2IF = 0;
+      if ( I2CCFG & I2C_SI )
+      {
+        return;
+      }
+      continue;
+    }
+
+    if ( I2CCFG & I2C_STO )
+    {
+      I2CCFG &= ~I2C_STO;
+      simBusy = FALSE;
+      continue;
+    }
+
+    if ( I2CCFG & I2C_STA )
+    {
+      I2CSTAT = simBusy ? mstRepStart : mstStarted;
+      simBusy = TRUE;
+      simWrCnt = -1;
+      I2CCFG |= I2C_SI;
+      continue;
+    }
+
+    switch ( I2CSTAT )
+    {
+    case mstStarted:
+    case mstRepStart:
+      if ( ( I2CDATA >> 1 ) != SIM_SLAVE )
+      {
+        I2CSTAT = ( I2CDATA & I2C_MST_RD_BIT ) ? mstAddrNackR : mstAddrNackW;
+      }
+      else
+      {
+        I2CSTAT = ( I2CDATA & I2C_MST_RD_BIT ) ? mstAddrAckR : mstAddrAckW;
+      }
+      break;
+
+    case mstAddrAckW:
+    case mstDataAckW:
+      if ( ++simWrCnt == 0 )
+      {
+        simRegPtr = I2CDATA;
+      }
+      else
+      {
+        simReg[simRegPtr++] = I2CDATA;
+      }
+      I2CSTAT = ( simWrCnt == simNackAt ) ? mstDataNackW : mstDataAckW;
+      break;
+
+    case mstAddrAckR:
+    case mstDataAckR:
+      I2CDATA = simReg[simRegPtr++];
+      I2CSTAT = ( I2CCFG & I2C_AA ) ? mstDataAckR : mstDataNackR;
+      break;
+
+    default:
+      return;
+    }
+    I2CCFG |= I2C_SI;
+  }
+
+  printf( "the bus did not settle\n" );
+  simFails++;
+}
+
+/*
+ * Run the bus and HalI2CPoll() for ms.
+ */
+static void simRun( uint32 ms )
+{
+  for ( ; ms != 0; ms-- )
+  {
+    simBus();
+    HalI2CPoll();
+    simMs++;
+  }
+}
+
+static void simCheck( const char *pName, int ok )
+{
+  printf( "%-48s %s\n", pName, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+static halI2CTrans_t *simDone[8];
+static int simDoneCnt;
+
+static void simCB( halI2CTrans_t *pTrans )
+{
+  if ( simDoneCnt < 8 )
+  {
+    simDone[simDoneCnt] = pTrans;
+  }
+  simDoneCnt++;
+}
+
+static void simTrans( halI2CTrans_t *pTrans, uint8 addr,
+                      uint8 wrLen, uint8 *pWr, uint8 rdLen, uint8 *pRd )
+{
+  memset( pTrans, 0, sizeof( halI2CTrans_t ) );
+  pTrans->addr = addr;
+  pTrans->wrLen = wrLen;
+  pTrans->pWr = pWr;
+  pTrans->rdLen = rdLen;
+  pTrans->pRd = pRd;
+  pTrans->callBackFunc = simCB;
+}
+
+int main( void )
+{
+  uint8 reg[] = { 0x10 };
+  uint8 wr[] = { 0x20, 1, 2, 3 };
+  uint8 rd6[6], rd1[1];
+  halI2CTrans_t t1, t2, t3, t4;
+  uint32 t0;
+  int i;
+
+  for ( i = 0; i < 256; i++ )
+  {
+    simReg[i] = i ^ 0x5A;
+  }
+
+  HalI2CInit( SIM_SLAVE, i2cClock_267KHZ );
+  simCheck( "port 2 interrupt enabled by HalI2CInit", ( IEN2 & I2C_IE ) != 0 );
+
+  // A read of 6 registers, a write of 3, an address NACK, then a read of 1.
+  simTrans( &t1, SIM_SLAVE, 1, reg, 6, rd6 );
+  simTrans( &t2, SIM_SLAVE, 4, wr, 0, NULL );
+  simTrans( &t3, SIM_SLAVE + 1, 1, reg, 1, rd1 );
+  simTrans( &t4, SIM_SLAVE, 0, NULL, 1, rd1 );
+  HalI2CSubmit( &t1 );
+  HalI2CSubmit( &t2 );
+  HalI2CSubmit( &t3 );
+  HalI2CSubmit( &t4 );
+  simCheck( "hold while queued", simHold && HalI2CBusy() );
+  simRun( 1 );
+  simCheck( "callbacks in the order queued", ( simDoneCnt == 4 ) &&
+            ( simDone[0] == &t1 ) && ( simDone[1] == &t2 ) &&
+            ( simDone[2] == &t3 ) && ( simDone[3] == &t4 ) );
+  simCheck( "write then read", ( t1.status == HAL_I2C_SUCCESS ) && ( t1.cnt == 7 ) &&
+            ( rd6[0] == ( 0x10 ^ 0x5A ) ) && ( rd6[5] == ( 0x15 ^ 0x5A ) ) );
+  simCheck( "write", ( t2.status == HAL_I2C_SUCCESS ) && ( t2.cnt == 4 ) &&
+            ( simReg[0x20] == 1 ) && ( simReg[0x22] == 3 ) );
+  simCheck( "address NACK", t3.status == HAL_I2C_NACK );
+  simCheck( "read", ( t4.status == HAL_I2C_SUCCESS ) && ( t4.cnt == 1 ) &&
+            ( rd1[0] == ( 0x23 ^ 0x5A ) ) );
+  simCheck( "port 2 interrupt enabled and SI clear when done",
+            ( ( IEN2 & I2C_IE ) != 0 ) && ( ( I2CCFG & I2C_SI ) == 0 ) && !simBusy );
+  simCheck( "hold released when done", !simHold && !HalI2CBusy() );
+
+  simNackAt = 2;
+  simDoneCnt = 0;
+  HalI2CSubmit( &t2 );
+  simRun( 1 );
+  simCheck( "NACK of a middle byte", ( simDoneCnt == 1 ) && ( t2.status == HAL_I2C_NACK ) );
+
+  simNackAt = 3;
+  simDoneCnt = 0;
+  HalI2CSubmit( &t2 );
+  simRun( 1 );
+  simCheck( "NACK of the last byte", ( simDoneCnt == 1 ) && ( t2.status == HAL_I2C_SUCCESS ) );
+  simNackAt = -1;
+
+  // The slave holds SCL low from the START of the first of two transactions.
+  simDoneCnt = 0;
+  simRun( 100 );
+  simStuck = TRUE;
+  HalI2CSubmit( &t1 );
+  HalI2CSubmit( &t4 );
+  t0 = simMs;
+  for ( i = 0; ( i < 1000 ) && ( simDoneCnt == 0 ); i++ )
+  {
+    simRun( 1 );
+  }
+  printf( "stuck bus given up after %u ms\n", (unsigned)( simMs - t0 ) );
+  simCheck( "stuck bus times out", ( simMs - t0 ) <= HAL_I2C_STUCK_TIMEOUT + 2 );
+  simCheck( "stuck bus fails all queued", ( simDoneCnt == 2 ) &&
+            ( t1.status == HAL_I2C_TIMEOUT ) && ( t4.status == HAL_I2C_TIMEOUT ) );
+  simCheck( "hold released after the timeout", !simHold && !HalI2CBusy() );
+  simCheck( "controller reset, SI, STA, STO clear", ( I2CCFG & ( I2C_ENS1 | I2C_SI | I2C_STA | I2C_STO ) ) == I2C_ENS1 );
+
+  // The slave lets go of the bus.
+  simStuck = FALSE;
+  simBusy = FALSE;
+  simDoneCnt = 0;
+  HalI2CSubmit( &t1 );
+  simRun( 1 );
+  simCheck( "next transaction after the timeout", ( simDoneCnt == 1 ) &&
+            ( t1.status == HAL_I2C_SUCCESS ) && ( rd6[5] == ( 0x15 ^ 0x5A ) ) );
+
+  printf( "%s\n", simFails ? "FAILED" : "passed" );
+  return ( simFails ? 1 : 0 );
+}
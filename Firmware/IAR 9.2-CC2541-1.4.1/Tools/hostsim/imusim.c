@@ -0,0 +1,218 @@
+/**************************************************************************************************
+  Filename:       imusim.c
+
+  Description:    Host test of the attitude filter in the CC2541ST hal_imu.c.
+                  Readings of the accelerometer and magnetometer are made up
+                  from a known attitude and earth field, quantized to the LSB
+                  of the sensors, and fed to HalImuUpdate() with a gyro that
+                  has a bias on z.
+
+                  The checks: the filter settles on each attitude, heading
+                  follows a turn on the gyro alone and comes back to the
+                  magnetometer heading, and atan2, sin and sqrt are within
+                  their stated errors.
+
+                  The accelerometer is set to 64 LSB per g, the 2 g range, in
+                  which one LSB is about 0.9 degrees of tilt; the limits allow
+                  for that. The filter runs at 20 ms, the magnetometer at
+                  100 ms.
+
+                  Build:  sh build.sh imusim -lm
+                  Usage:  imusim
+**************************************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../Components/hal/target/CC2541ST/hal_imu.c"
+
+#define SIM_PERIOD             20       // ms
+#define SIM_ONE_G              64
+#define SIM_MAG_EVERY          5        // Filter periods per magnetometer sample
+#define SIM_MAG_OFFSET_X       30
+#define SIM_GYRO_BIAS_Z        100      // LSB, 0.76 deg/s
+
+#define SIM_DEG(d)             ( (d) * M_PI / 180 )
+
+static int simFails;
+
+static void simRotX( double a, double *v )
+{
+  double y = v[1] * cos( a ) - v[2] * sin( a );
+  double z = v[1] * sin( a ) + v[2] * cos( a );
+
+  v[1] = y;
+  v[2] = z;
+}
+
+static void simRotY( double a, double *v )
+{
+  double x = v[0] * cos( a ) + v[2] * sin( a );
+  double z = -v[0] * sin( a ) + v[2] * cos( a );
+
+  v[0] = x;
+  v[2] = z;
+}
+
+static void simRotZ( double a, double *v )
+{
+  double x = v[0] * cos( a ) - v[1] * sin( a );
+  double y = v[0] * sin( a ) + v[1] * cos( a );
+
+  v[0] = x;
+  v[1] = y;
+}
+
+/*
+ * Readings of the accelerometer and magnetometer for an attitude in degrees,
+ * heading clockwise from north, pitch nose up and roll right side down.
+ */
+static void simSample( double heading, double pitch, double roll, uint8 *pAcc, uint8 *pMag )
+{
+  double g[3] = { 0, 0, 1 };
+  double m[3] = { 200, 0, -400 };   // North and down, in magnetometer LSB
+  int16 v;
+  int i;
+
+  simRotZ( SIM_DEG( heading ), g );
+  simRotY( SIM_DEG( pitch ), g );
+  simRotX( SIM_DEG( -roll ), g );
+  simRotZ( SIM_DEG( heading ), m );
+  simRotY( SIM_DEG( pitch ), m );
+  simRotX( SIM_DEG( -roll ), m );
+
+  for ( i = 0; i < 3; i++ )
+  {
+    pAcc[i] = (uint8)(int8)lround( g[i] * SIM_ONE_G );
+    v = (int16)lround( m[i] ) + ( ( i == 0 ) ? SIM_MAG_OFFSET_X : 0 );
+    pMag[2 * i] = LO_UINT16( v );
+    pMag[2 * i + 1] = HI_UINT16( v );
+  }
+}
+
+static void simGyro( uint8 *pGyro, int16 z )
+{
+  memset( pGyro, 0, 6 );
+  pGyro[4] = LO_UINT16( z );
+  pGyro[5] = HI_UINT16( z );
+}
+
+static void simAttitude( double *pOut )
+{
+  uint8 buf[HAL_IMU_ATTITUDE_LEN];
+
+  HalImuGetAttitude( buf );
+  pOut[0] = (uint16)BUILD_UINT16( buf[0], buf[1] ) / 100.0;
+  pOut[1] = (int16)BUILD_UINT16( buf[2], buf[3] ) / 100.0;
+  pOut[2] = (int16)BUILD_UINT16( buf[4], buf[5] ) / 100.0;
+}
+
+static double simAngleErr( double a, double b )
+{
+  return ( fabs( remainder( a - b, 360 ) ) );
+}
+
+static void simCheck( const char *pName, double err, double limit )
+{
+  printf( "%-40s err %7.4f  limit %7.4f  %s\n", pName, err, limit, ( err <= limit ) ? "ok" : "FAIL" );
+  if ( err > limit )
+  {
+    simFails++;
+  }
+}
+
+static void simInit( void )
+{
+  HalImuInit( SIM_PERIOD, SIM_ONE_G );
+  HalImuSetMagOffset( SIM_MAG_OFFSET_X, 0, 0 );
+}
+
+int main( void )
+{
+  static const double cases[][3] =
+  {
+    { 0, 0, 0 }, { 90, 0, 0 }, { 200, 10, 0 }, { 45, 0, 20 },
+    { 300, -15, -25 }, { 10, 30, 40 }, { 359, 5, -5 }
+  };
+  uint8 acc[3], mag[6], gyro[6];
+  double att[3], err, maxErr;
+  char name[48];
+  unsigned c;
+  int i, k;
+
+  // Settling on a still board, 60 s with a gyro bias
+  for ( c = 0; c < sizeof( cases ) / sizeof( cases[0] ); c++ )
+  {
+    simInit();
+    simSample( cases[c][0], cases[c][1], cases[c][2], acc, mag );
+    simGyro( gyro, SIM_GYRO_BIAS_Z );
+    for ( i = 0; i < 3000; i++ )
+    {
+      HalImuUpdate( acc, gyro, ( i % SIM_MAG_EVERY == 0 ) ? mag : NULL );
+    }
+    simAttitude( att );
+    err = 0;
+    for ( k = 0; k < 3; k++ )
+    {
+      err = fmax( err, simAngleErr( att[k], cases[c][k] ) );
+    }
+    snprintf( name, sizeof( name ), "still at %.0f %.0f %.0f", cases[c][0], cases[c][1], cases[c][2] );
+    simCheck( name, err, 2.0 );
+  }
+
+  // A clockwise turn at 45 deg/s for 4 s on the gyro alone, then the same
+  // turn again with the magnetometer
+  simInit();
+  simSample( 0, 0, 0, acc, mag );
+  simGyro( gyro, 0 );
+  for ( i = 0; i < 100; i++ )
+  {
+    HalImuUpdate( acc, gyro, mag );
+  }
+  simGyro( gyro, (int16)lround( -45 * 65536.0 / 500 ) );
+  for ( i = 0; i < 4000 / SIM_PERIOD; i++ )
+  {
+    HalImuUpdate( acc, gyro, NULL );
+  }
+  simAttitude( att );
+  simCheck( "turn on the gyro alone", simAngleErr( att[0], 180 ), 0.5 );
+
+  for ( i = 0; i < 4000 / SIM_PERIOD; i++ )
+  {
+    simSample( fmod( 180 + 45 * ( i + 1 ) * SIM_PERIOD / 1000.0, 360 ), 0, 0, acc, mag );
+    HalImuUpdate( acc, gyro, mag );
+  }
+  simAttitude( att );
+  simCheck( "turn with the magnetometer", simAngleErr( att[0], 0 ), 0.5 );
+
+  maxErr = 0;
+  for ( k = -180; k < 180; k++ )
+  {
+    double a = k + 0.37;
+    int16 r = halImuAtan2( lround( 10000 * sin( SIM_DEG( a ) ) ), lround( 10000 * cos( SIM_DEG( a ) ) ) );
+    maxErr = fmax( maxErr, simAngleErr( r * 360.0 / 65536, a ) );
+  }
+  simCheck( "atan2, degrees", maxErr, 0.3 );
+
+  maxErr = 0;
+  for ( k = 0; k < 65536; k += 37 )
+  {
+    maxErr = fmax( maxErr, fabs( halImuSin( k ) / 32768.0 - sin( k * 2 * M_PI / 65536 ) ) );
+  }
+  simCheck( "sin", maxErr, 0.0005 );
+
+  maxErr = 0;
+  for ( k = 0; k < 2000000; k += 7 )
+  {
+    uint32 s = halImuSqrt( k );
+    if ( ( s * s > (uint32)k ) || ( ( s + 1 ) * ( s + 1 ) <= (uint32)k ) )
+    {
+      maxErr = 1;
+    }
+  }
+  simCheck( "sqrt, rounded down", maxErr, 0 );
+
+  printf( "%s\n", simFails ? "FAILED" : "passed" );
+  return ( simFails ? 1 : 0 );
+}
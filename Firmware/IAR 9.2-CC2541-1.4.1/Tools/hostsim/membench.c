@@ -0,0 +1,404 @@
+/**************************************************************************************************
+  Filename:       membench.c
+
+  Description:    Host benchmark of the OSAL heap in OSAL_Memory.c. Replays an
+                  allocation trace, or a model of the bridge under load, against
+                  the heap built as the bridge builds it (INT_HEAP_LEN 3072) and
+                  reports the cost of osal_mem_alloc and osal_mem_free, their
+                  interrupts off sections, failed allocations and fragmentation.
+
+                  Build the first fit heap and the segregated free lists as two
+                  programs and run both on the same trace:
+
+                  Build:  OUT=membench_ff sh build.sh membench
+                          OUT=membench_seg sh build.sh membench -DOSALMEM_SEGREGATED=TRUE
+                  Usage:  membench_ff [-s steps] [trace.txt]
+
+                  A trace has one operation per line, "a <id> <bytes>" or
+                  "f <id>". The lines osal_mem_alloc_dbg and osal_mem_free_dbg
+                  print in a DPRINTF_OSALHEAPTRACE build are read too, with the
+                  block address as the id. Without a trace, the model runs for
+                  the given number of connection events (default 200000): four
+                  notification buffers per event, UART and GATT messages, HCI
+                  events, the odd longer lived block and the rare big one, over
+                  a set of long lived task allocations.
+
+                  Fragmentation is sampled every 64 operations: the largest
+                  free block of the heap, and the share of the free bytes of
+                  the heap outside of it. The segregated pools are not part of
+                  the heap; the bytes they hold free are reported apart.
+
+                  Host pointers take 8 bytes, so a segregated class must hold
+                  10 bytes here rather than 4; the default classes do. Times
+                  are host nanoseconds, not CC2541 cycle counts.
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INT_HEAP_LEN           3072
+#define OSALMEM_METRICS        TRUE
+
+
+
+// Keep the 2 byte block header of the target
+#pragma pack(push, 2)
+#include "../../Components/osal/common/OSAL_Memory.c"
+#pragma pack(pop)
+
+HAL_ASSERT_SIZE( osalMemHdr_t, 2 );
+
+#define BENCH_LIVE_MAX         512
+#define BENCH_FRAG_PERIOD      64
+
+typedef struct
+{
+  unsigned long id;
+  void *ptr;
+  uint16 len;
+  long freeAt;            // Model step at which the block goes
+} benchBlk_t;
+
+static benchBlk_t benchLive[BENCH_LIVE_MAX];
+static int benchLiveCnt;
+
+static hostsimHist_t benchAllocHist;
+static hostsimHist_t benchFreeHist;
+
+static unsigned long benchOps;
+static unsigned long benchFails;
+static unsigned long benchFragSamples;
+static double benchFragSum;
+static double benchFreeSum;
+static unsigned benchLargestMin = 0xFFFF;
+static double benchLargestSum;
+static double benchPoolSum;
+
+void *osal_memset( void *dest, uint8 value, int len )
+{
+  return ( memset( dest, value, len ) );
+}
+
+uint8 osal_self( void )
+{
+  return ( 0 );
+}
+
+void halAssertHandler( void )
+{
+  fprintf( stderr, "heap assert\n" );
+  exit( 2 );
+}
+
+/*
+ * Walk the heap for the largest free block, coalescing neighbours as the
+ * first fit search would, and the free bytes; count the free pool bytes.
+ */
+static void benchFrag( void )
+{
+  osalMemHdr_t *hdr = theHeap;
+  unsigned run = 0, largest = 0, free = 0;
+#if OSALMEM_SEGREGATED
+  osalMemHdr_t *seg;
+  uint8 cls;
+
+  for ( cls = 0; cls < OSALMEM_SEG_CLASSES; cls++ )
+  {
+    for ( seg = osalMemSegList[cls]; seg != NULL; seg = OSALMEM_SEG_NEXT( seg ) )
+    {
+      benchPoolSum += seg->hdr.len;
+    }
+  }
+#endif
+
+  while ( hdr->val != 0 )
+  {
+    if ( hdr->hdr.inUse )
+    {
+      run = 0;
+    }
+    else
+    {
+      run += hdr->hdr.len;
+      free += hdr->hdr.len;
+      if ( run > largest )
+      {
+        largest = run;
+      }
+    }
+    hdr = (osalMemHdr_t *)((uint8 *)hdr + hdr->hdr.len);
+  }
+
+  benchFragSamples++;
+  benchFreeSum += free;
+  benchLargestSum += largest;
+  benchFragSum += free ? 1.0 - (double)largest / free : 0.0;
+  if ( largest < benchLargestMin )
+  {
+    benchLargestMin = largest;
+  }
+}
+
+static void benchOp( void )
+{
+  if ( (++benchOps % BENCH_FRAG_PERIOD) == 0 )
+  {
+    benchFrag();
+  }
+}
+
+static void benchAlloc( unsigned long id, uint16 len, long freeAt )
+{
+  uint64_t t0;
+  void *ptr;
+
+  if ( benchLiveCnt == BENCH_LIVE_MAX )
+  {
+    fprintf( stderr, "more than %d blocks live\n", BENCH_LIVE_MAX );
+    exit( 1 );
+  }
+
+  t0 = hostsimNow();
+  ptr = osal_mem_alloc( len );
+  hostsimHistTime( &benchAllocHist, t0 );
+  benchOp();
+
+  if ( ptr == NULL )
+  {
+    benchFails++;
+    return;
+  }
+
+  memset( ptr, (uint8)id, len );
+  benchLive[benchLiveCnt].id = id;
+  benchLive[benchLiveCnt].ptr = ptr;
+  benchLive[benchLiveCnt].len = len;
+  benchLive[benchLiveCnt].freeAt = freeAt;
+  benchLiveCnt++;
+}
+
+static void benchFreeIdx( int i )
+{
+  uint8 *p = benchLive[i].ptr;
+  uint64_t t0;
+  uint16 n;
+
+  // Blocks that overlap show in each other's data
+  for ( n = 0; n < benchLive[i].len; n++ )
+  {
+    if ( p[n] != (uint8)benchLive[i].id )
+    {
+      fprintf( stderr, "block %lu overwritten\n", benchLive[i].id );
+      exit( 1 );
+    }
+  }
+
+  t0 = hostsimNow();
+  osal_mem_free( benchLive[i].ptr );
+  hostsimHistTime( &benchFreeHist, t0 );
+  benchOp();
+
+  benchLive[i] = benchLive[--benchLiveCnt];
+}
+
+static void benchFree( unsigned long id )
+{
+  int i;
+
+  for ( i = 0; i < benchLiveCnt; i++ )
+  {
+    if ( benchLive[i].id == id )
+    {
+      benchFreeIdx( i );
+      return;
+    }
+  }
+}
+
+/*
+ * Replay a trace file.
+ */
+static void benchTrace( FILE *fp )
+{
+  char line[256];
+  const char *p;
+  unsigned long id;
+  unsigned len;
+
+  while ( fgets( line, sizeof( line ), fp ) != NULL )
+  {
+    if ( sscanf( line, "a %lu %u", &id, &len ) == 2 )
+    {
+      benchAlloc( id, (uint16)len, 0 );
+    }
+    else if ( sscanf( line, "f %lu", &id ) == 1 )
+    {
+      benchFree( id );
+    }
+    else if ( (p = strstr( line, "osal_mem_alloc(" )) != NULL &&
+              sscanf( p, "osal_mem_alloc(%u)->%lx", &len, &id ) == 2 )
+    {
+      // The size printed includes the 2 byte header of the target
+      if ( id != 0 )
+      {
+        benchAlloc( id, (uint16)( len > 2 ? len - 2 : 1 ), 0 );
+      }
+    }
+    else if ( (p = strstr( line, "osal_mem_free(" )) != NULL &&
+              sscanf( p, "osal_mem_free(%lx)", &id ) == 1 )
+    {
+      benchFree( id );
+    }
+  }
+}
+
+/*
+ * The bridge under load. One step is a connection event.
+ */
+static int benchChance( int percent )
+{
+  return ( (rand() % 1000) < percent * 10 );
+}
+
+static int benchRange( int lo, int hi )
+{
+  return ( lo + rand() % (hi - lo + 1) );
+}
+
+static void benchModel( long steps )
+{
+  static const uint16 longLived[] = { 26, 40, 16, 64, 120, 24, 90, 200, 32, 48 };
+  unsigned long id = 0;
+  long step;
+  int i;
+
+  srand( 1 );
+
+  // Task initialisation
+  for ( i = 0; i < (int)( sizeof( longLived ) / sizeof( longLived[0] ) ); i++ )
+  {
+    benchAlloc( ++id, longLived[i], -1 );
+  }
+  osal_mem_kick();
+
+  for ( step = 0; step < steps; step++ )
+  {
+    for ( i = 0; i < benchLiveCnt; )
+    {
+      if ( benchLive[i].freeAt >= 0 && benchLive[i].freeAt <= step )
+      {
+        benchFreeIdx( i );
+      }
+      else
+      {
+        i++;
+      }
+    }
+
+    // Notification buffers, sent within a couple of events
+    if ( benchChance( 90 ) )
+    {
+      for ( i = 0; i < 4; i++ )
+      {
+        benchAlloc( ++id, 29, step + benchRange( 1, 3 ) );
+      }
+    }
+    // UART data and serial command messages
+    if ( benchChance( 50 ) )
+    {
+      benchAlloc( ++id, benchRange( 12, 48 ), step + benchRange( 0, 1 ) );
+    }
+    // GATT writes from the phone
+    if ( benchChance( 30 ) )
+    {
+      benchAlloc( ++id, benchRange( 24, 40 ), step );
+    }
+    // HCI events
+    if ( benchChance( 50 ) )
+    {
+      benchAlloc( ++id, 10, step );
+    }
+    // Serial replies
+    if ( benchChance( 10 ) )
+    {
+      benchAlloc( ++id, benchRange( 15, 65 ), step );
+    }
+    // Longer lived blocks, such as queued prepare writes
+    if ( benchChance( 2 ) )
+    {
+      benchAlloc( ++id, benchRange( 64, 200 ), step + benchRange( 20, 200 ) );
+    }
+    // Rare big ones, such as dump frames
+    if ( (rand() % 500) == 0 )
+    {
+      benchAlloc( ++id, benchRange( 250, 300 ), step + benchRange( 1, 5 ) );
+    }
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  long steps = 200000;
+  const char *trace = NULL;
+  FILE *fp;
+  int i;
+
+  for ( i = 1; i < argc; i++ )
+  {
+    if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc )
+    {
+      steps = atol( argv[++i] );
+    }
+    else
+    {
+      trace = argv[i];
+    }
+  }
+
+  hostsimInit();
+  osal_mem_init();
+
+  if ( trace != NULL )
+  {
+    if ( (fp = fopen( trace, "r" )) == NULL )
+    {
+      perror( trace );
+      return ( 1 );
+    }
+    osal_mem_kick();
+    benchTrace( fp );
+    fclose( fp );
+  }
+  else
+  {
+    benchModel( steps );
+  }
+
+  printf( "%s heap, %lu operations, %lu failed allocations\n",
+          OSALMEM_SEGREGATED ? "segregated" : "first fit", benchOps, benchFails );
+  printf( "alloc     median %5llu ns  99.9%% %5llu ns  99.99%% %5llu ns\n",
+          (unsigned long long)hostsimHistPct( &benchAllocHist, 50.0 ),
+          (unsigned long long)hostsimHistPct( &benchAllocHist, 99.9 ),
+          (unsigned long long)hostsimHistPct( &benchAllocHist, 99.99 ) );
+  printf( "free      median %5llu ns  99.9%% %5llu ns  99.99%% %5llu ns\n",
+          (unsigned long long)hostsimHistPct( &benchFreeHist, 50.0 ),
+          (unsigned long long)hostsimHistPct( &benchFreeHist, 99.9 ),
+          (unsigned long long)hostsimHistPct( &benchFreeHist, 99.99 ) );
+  printf( "ints off  median %5llu ns  99.9%% %5llu ns  99.99%% %5llu ns\n",
+          (unsigned long long)hostsimHistPct( &hostsimIntOffHist, 50.0 ),
+          (unsigned long long)hostsimHistPct( &hostsimIntOffHist, 99.9 ),
+          (unsigned long long)hostsimHistPct( &hostsimIntOffHist, 99.99 ) );
+  if ( benchFragSamples )
+  {
+    printf( "free bytes %.0f, largest free block %.0f (smallest seen %u), fragmentation %.1f%%\n",
+            benchFreeSum / benchFragSamples, benchLargestSum / benchFragSamples,
+            benchLargestMin, 100.0 * benchFragSum / benchFragSamples );
+#if OSALMEM_SEGREGATED
+    printf( "free pool bytes %.0f\n", benchPoolSum / benchFragSamples );
+#endif
+  }
+  printf( "most bytes in use %u, most blocks %u\n", memMax, blkMax );
+
+  return ( 0 );
+}
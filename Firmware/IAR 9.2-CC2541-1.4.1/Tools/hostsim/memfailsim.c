@@ -0,0 +1,152 @@
+/**************************************************************************************************
+  Filename:       memfailsim.c
+
+  Description:    Host test of the failed allocation counters of the OSAL heap
+                  in OSAL_Memory.c, built with OSALMEM_METRICS as the bridge
+                  builds it.
+
+                  The heap is filled, then allocations are made that cannot
+                  fit while osal_self() returns one task or another. The
+                  checks: the total and the size of the last failure, the
+                  tasks in order of their first failure with their own counts,
+                  the tasks past OSALMEM_FAIL_SITES counted in the total only,
+                  the counters stopping at 0xFFFF, and successful allocations
+                  leaving them alone.
+
+                  Build:  sh build.sh memfailsim
+                  Usage:  memfailsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INT_HEAP_LEN           3072
+#define OSALMEM_METRICS        TRUE
+
+// Keep the 2 byte block header of the target
+#pragma pack(push, 2)
+#include "../../Components/osal/common/OSAL_Memory.c"
+#pragma pack(pop)
+
+#include "OSAL_Tasks.h"
+
+#define SIM_TOO_BIG            (INT_HEAP_LEN + 1)
+
+static uint8 simTask = TASK_NO_TASK;
+
+static int simFails;
+
+void *osal_memset( void *dest, uint8 value, int len )
+{
+  return ( memset( dest, value, len ) );
+}
+
+uint8 osal_self( void )
+{
+  return ( simTask );
+}
+
+void halAssertHandler( void )
+{
+  fprintf( stderr, "heap assert\n" );
+  exit( 2 );
+}
+
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+/*
+ * Make n allocations of len bytes as task; TRUE if all failed.
+ */
+static uint8 simFail( uint8 task, uint16 len, long n )
+{
+  uint8 allFailed = TRUE;
+
+  simTask = task;
+  while ( n-- > 0 )
+  {
+    if ( osal_mem_alloc( len ) != NULL )
+    {
+      allFailed = FALSE;
+    }
+  }
+
+  return ( allFailed );
+}
+
+/*
+ * TRUE if the task at idx of the failure sites is task with cnt failures.
+ */
+static uint8 simSite( uint8 idx, uint8 task, uint16 cnt )
+{
+  uint8 taskId;
+  uint16 siteCnt;
+
+  return ( osal_heap_fail_site( idx, &taskId, &siteCnt ) && ( taskId == task ) &&
+           ( siteCnt == cnt ) );
+}
+
+int main( void )
+{
+  uint8 taskId;
+  uint16 cnt;
+  void *p;
+
+  osal_mem_init();
+  osal_mem_kick();
+
+  simCheck( "no failure counted at start",
+            ( osal_heap_fail_cnt() == 0 ) && !osal_heap_fail_site( 0, &taskId, &cnt ) );
+
+  // Initialization, before any task runs
+  simCheck( "allocation too big fails", simFail( TASK_NO_TASK, SIM_TOO_BIG, 1 ) );
+  simCheck( "counted against TASK_NO_TASK with its size",
+            ( osal_heap_fail_cnt() == 1 ) && ( osal_heap_fail_len() == SIM_TOO_BIG ) &&
+            simSite( 0, TASK_NO_TASK, 1 ) );
+
+  // Fill the heap, and any segregated pools, down to the smallest size used
+  simTask = 2;
+  p = osal_mem_alloc( 8 );
+  while ( osal_mem_alloc( 40 ) != NULL )
+  {
+  }
+  while ( osal_mem_alloc( 8 ) != NULL )
+  {
+  }
+  simCheck( "full heap counted", ( osal_heap_fail_cnt() == 3 ) && simSite( 1, 2, 2 ) );
+
+  simFail( 5, 8, 3 );
+  simFail( 2, 8, 2 );
+  simFail( 7, 40, 1 );
+  simCheck( "total and size of the last failure",
+            ( osal_heap_fail_cnt() == 9 ) && ( osal_heap_fail_len() == 40 ) );
+  simCheck( "tasks in order of first failure with their counts",
+            simSite( 0, TASK_NO_TASK, 1 ) && simSite( 1, 2, 4 ) && simSite( 2, 5, 3 ) &&
+            simSite( 3, 7, 1 ) );
+
+  simFail( 9, 8, 4 );
+  simCheck( "a task past OSALMEM_FAIL_SITES counts in the total only",
+            ( osal_heap_fail_cnt() == 13 ) && !osal_heap_fail_site( OSALMEM_FAIL_SITES, &taskId, &cnt ) &&
+            simSite( 3, 7, 1 ) );
+
+  simFail( 5, 8, 0x10000L );
+  simCheck( "counters stop at 0xFFFF",
+            ( osal_heap_fail_cnt() == 0xFFFF ) && simSite( 2, 5, 0xFFFF ) );
+
+  // Room again: allocations that fit do not count
+  simTask = 2;
+  osal_mem_free( p );
+  simCheck( "allocation that fits is not counted",
+            ( osal_mem_alloc( 4 ) != NULL ) && ( osal_heap_fail_cnt() == 0xFFFF ) &&
+            simSite( 1, 2, 4 ) );
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
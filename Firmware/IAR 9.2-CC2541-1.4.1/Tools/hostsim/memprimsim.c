@@ -0,0 +1,305 @@
+/**************************************************************************************************
+  Filename:       memprimsim.c
+
+  Description:    Host test of the OSAL memory primitives in OSAL.c:
+                  osal_memcpy, osal_revmemcpy, osal_memdup, osal_memcmp and
+                  osal_memset. A replacement for any of them, such as a fast
+                  path written for the 8051, has to pass it unchanged.
+
+                  Every length up to SIM_MAX_LEN is tried at every alignment
+                  of source and destination up to SIM_ALIGNS, so that a loop
+                  that counts the low and high bytes of the length apart is
+                  tried across 256 bytes; one copy is longer than 0x7FFF.
+                  The checks: the bytes written match the C library, the
+                  bytes around them are left alone, the return values keep
+                  the OSAL conventions (the end of the destination for the
+                  copies, TRUE/FALSE for the compare), a difference in any
+                  byte is found, the copy goes forwards so that it can move
+                  data down within a buffer, and osal_memdup() returns NULL
+                  when the heap is out.
+
+                  Build:  sh build.sh memprimsim -Wno-pointer-sign
+                  Usage:  memprimsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// OSAL.h and OSAL.c declare _ltoa() with types that differ on the host
+#define _ltoa osalHdrLtoa
+#include "OSAL.h"
+#undef _ltoa
+#define _ltoa simLtoa
+
+// From the IAR library, which _ltoa() calls
+char *ltoa( unsigned long l, unsigned char *buf, unsigned char radix );
+
+#include "../../Components/osal/common/OSAL.c"
+
+#define SIM_MAX_LEN            300      // Longest length tried at every alignment
+#define SIM_ALIGNS             4        // Offsets tried for source and destination
+#define SIM_GUARD              8        // Bytes checked on each side of a destination
+#define SIM_LONG_LEN           0x9000   // Length of the one long copy
+#define SIM_FILL               0xA5     // Value of the bytes around a destination
+
+#define SIM_BUF_LEN            ( SIM_LONG_LEN + SIM_ALIGNS + 2 * SIM_GUARD )
+#define SIM_SPAN               ( SIM_MAX_LEN + SIM_ALIGNS + 2 * SIM_GUARD )
+
+const pTaskEventHandlerFn tasksArr[] = { NULL };
+const uint8 tasksCnt = 0;
+uint16 *tasksEvents;
+
+static uint8 simSrc[SIM_BUF_LEN];
+static uint8 simDst[SIM_BUF_LEN];
+static uint8 simRef[SIM_BUF_LEN];
+
+static uint8 simHeapOut;
+
+static int simFails;
+
+/*
+ * Link stubs for the rest of OSAL.c.
+ */
+void *osal_mem_alloc( uint16 size )
+{
+  return ( simHeapOut ? NULL : malloc( size ) );
+}
+
+void osal_mem_free( void *ptr )
+{
+  free( ptr );
+}
+
+void osal_mem_init( void ) {}
+void osal_mem_kick( void ) {}
+void osal_pwrmgr_init( void ) {}
+void osalInitTasks( void ) {}
+void osalTimerInit( void ) {}
+void osalTimeUpdate( void ) {}
+void Hal_ProcessPoll( void ) {}
+
+uint16 Onboard_rand( void )
+{
+  return ( (uint16)rand() );
+}
+
+char *ltoa( unsigned long l, unsigned char *buf, unsigned char radix )
+{
+  sprintf( (char *)buf, ( radix == 16 ) ? "%lx" : "%lu", l );
+  return ( (char *)buf );
+}
+
+void halAssertHandler( void )
+{
+  fprintf( stderr, "assert\n" );
+  exit( 2 );
+}
+
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+/*
+ * Fill span bytes of the source with new bytes and of the destination
+ * with the guard value.
+ */
+static void simFill( unsigned int span )
+{
+  unsigned int i;
+
+  for ( i = 0; i < span; i++ )
+  {
+    simSrc[i] = (uint8)rand();
+  }
+  memset( simDst, SIM_FILL, span );
+}
+
+/*
+ * TRUE if span bytes of the destination match the reference, which has
+ * the guard value outside the len bytes at dst.
+ */
+static uint8 simSame( unsigned int span, unsigned int dst, unsigned int len )
+{
+  memset( simRef, SIM_FILL, span );
+  memcpy( simRef + dst, simDst + dst, len );
+  return ( memcmp( simDst, simRef, span ) == 0 );
+}
+
+/*
+ * Copy every length at every alignment; TRUE if all were right.
+ */
+static uint8 simCopies( uint8 reverse )
+{
+  unsigned int len, s, d, i;
+  uint8 *pDst, *pEnd;
+
+  for ( len = 0; len <= SIM_MAX_LEN; len++ )
+  {
+    for ( s = 0; s < SIM_ALIGNS; s++ )
+    {
+      for ( d = 0; d < SIM_ALIGNS; d++ )
+      {
+        simFill( SIM_SPAN );
+        pDst = simDst + SIM_GUARD + d;
+        if ( reverse )
+        {
+          pEnd = osal_revmemcpy( pDst, simSrc + s, len );
+        }
+        else
+        {
+          pEnd = osal_memcpy( pDst, simSrc + s, len );
+        }
+
+        if ( ( pEnd != pDst + len ) || !simSame( SIM_SPAN, SIM_GUARD + d, len ) )
+        {
+          return ( FALSE );
+        }
+        for ( i = 0; i < len; i++ )
+        {
+          if ( pDst[i] != simSrc[s + ( reverse ? len - 1 - i : i )] )
+          {
+            return ( FALSE );
+          }
+        }
+      }
+    }
+  }
+
+  return ( TRUE );
+}
+
+/*
+ * Set every length at every alignment; TRUE if all were right.
+ */
+static uint8 simSets( void )
+{
+  unsigned int len, d, i;
+  uint8 *pDst;
+
+  for ( len = 0; len <= SIM_MAX_LEN; len++ )
+  {
+    for ( d = 0; d < SIM_ALIGNS; d++ )
+    {
+      simFill( SIM_SPAN );
+      pDst = simDst + SIM_GUARD + d;
+      if ( ( osal_memset( pDst, (uint8)len, len ) != pDst ) ||
+           !simSame( SIM_SPAN, SIM_GUARD + d, len ) )
+      {
+        return ( FALSE );
+      }
+      for ( i = 0; i < len; i++ )
+      {
+        if ( pDst[i] != (uint8)len )
+        {
+          return ( FALSE );
+        }
+      }
+    }
+  }
+
+  return ( TRUE );
+}
+
+/*
+ * Compare every length at every alignment, equal and with a difference at
+ * each byte; TRUE if all were right.
+ */
+static uint8 simCompares( void )
+{
+  unsigned int len, s, d, i;
+  uint8 *p1, *p2;
+
+  for ( len = 0; len <= SIM_MAX_LEN; len++ )
+  {
+    for ( s = 0; s < SIM_ALIGNS; s++ )
+    {
+      for ( d = 0; d < SIM_ALIGNS; d++ )
+      {
+        simFill( SIM_SPAN );
+        p1 = simSrc + s;
+        p2 = simDst + SIM_GUARD + d;
+        memcpy( p2, p1, len );
+
+        // A difference just past the end does not count
+        p2[len] = (uint8)~p1[len];
+        if ( osal_memcmp( p1, p2, len ) != TRUE )
+        {
+          return ( FALSE );
+        }
+
+        for ( i = 0; i < len; i++ )
+        {
+          p2[i] ^= 0x80;
+          if ( osal_memcmp( p1, p2, len ) != FALSE )
+          {
+            return ( FALSE );
+          }
+          p2[i] ^= 0x80;
+        }
+      }
+    }
+  }
+
+  return ( TRUE );
+}
+
+int main( void )
+{
+  uint8 *p;
+  unsigned int i;
+
+  srand( 1 );
+
+  simCheck( "osal_memcpy: lengths 0..300 at every alignment", simCopies( FALSE ) );
+  simCheck( "osal_revmemcpy: lengths 0..300 at every alignment", simCopies( TRUE ) );
+  simCheck( "osal_memset: lengths 0..300 at every alignment", simSets() );
+  simCheck( "osal_memcmp: lengths 0..300, a difference at each byte", simCompares() );
+
+  simFill( SIM_BUF_LEN );
+  p = osal_memcpy( simDst + SIM_GUARD + 1, simSrc + 3, SIM_LONG_LEN );
+  simCheck( "osal_memcpy: copy longer than 0x7FFF",
+            ( p == simDst + SIM_GUARD + 1 + SIM_LONG_LEN ) &&
+            ( memcmp( simDst + SIM_GUARD + 1, simSrc + 3, SIM_LONG_LEN ) == 0 ) &&
+            simSame( SIM_BUF_LEN, SIM_GUARD + 1, SIM_LONG_LEN ) );
+  simCheck( "osal_memcmp: compare longer than 0x7FFF",
+            osal_memcmp( simDst + SIM_GUARD + 1, simSrc + 3, SIM_LONG_LEN ) &&
+            ( simDst[SIM_GUARD + 1 + SIM_LONG_LEN - 1]++,
+              !osal_memcmp( simDst + SIM_GUARD + 1, simSrc + 3, SIM_LONG_LEN ) ) );
+
+  // Move data down within a buffer, as callers do to drop a header
+  simFill( SIM_SPAN );
+  memcpy( simDst, simSrc, SIM_MAX_LEN );
+  p = osal_memcpy( simDst, simDst + 5, SIM_MAX_LEN - 5 );
+  simCheck( "osal_memcpy: moves data down within a buffer",
+            ( p == simDst + SIM_MAX_LEN - 5 ) &&
+            ( memcmp( simDst, simSrc + 5, SIM_MAX_LEN - 5 ) == 0 ) );
+
+  simFill( SIM_SPAN );
+  p = osal_memdup( simSrc, 100 );
+  simCheck( "osal_memdup: copy in a new buffer",
+            ( p != NULL ) && ( p != simSrc ) && ( memcmp( p, simSrc, 100 ) == 0 ) );
+  free( p );
+
+  simHeapOut = TRUE;
+  simCheck( "osal_memdup: NULL when the heap is out", osal_memdup( simSrc, 100 ) == NULL );
+  simHeapOut = FALSE;
+
+  // The zero lengths leave everything alone
+  simFill( SIM_SPAN );
+  memcpy( simRef, simDst, SIM_SPAN );
+  i = ( osal_memcpy( simDst + 1, simSrc, 0 ) == simDst + 1 ) &&
+      ( osal_revmemcpy( simDst + 1, simSrc + 1, 0 ) == simDst + 1 ) &&
+      ( osal_memset( simDst + 1, 0, 0 ) == simDst + 1 ) &&
+      osal_memcmp( simSrc, simDst, 0 );
+  simCheck( "zero lengths touch nothing",
+            i && ( memcmp( simRef, simDst, SIM_SPAN ) == 0 ) );
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
@@ -0,0 +1,136 @@
+/**************************************************************************************************
+  Filename:       pwrsim.c
+
+  Description:    Host test of the sleep residency counters of OSAL_PwrMgr.c,
+                  built with POWER_SAVING and OSAL_PWRMGR_STATS as the
+                  CC2541-UART-PM configuration builds it.
+
+                  The 24 bit sleep timer is modeled; halSleep() moves it on by
+                  the sleep it was asked for, or by a fixed time when no OSAL
+                  timer runs, and the OSAL loop moves it on between idle passes
+                  by the time the tasks ran.
+
+                  The checks: awake and sleep ticks add up to the time passed
+                  across the wrap of the timer, the sleeps without a timer are
+                  told apart, idle passes held off by a task are counted with
+                  the task's bit, osal_pwrmgr_stats() adds the time since the
+                  last sleep to the awake time, the counts stop at 0xFFFF, and
+                  osal_pwrmgr_stats_reset() starts over from the timer reading.
+
+                  Build:  sh build.sh pwrsim -DPOWER_SAVING
+                  Usage:  pwrsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#define OSAL_PWRMGR_STATS      TRUE
+
+#include "../../Components/osal/common/OSAL_PwrMgr.c"
+
+#define SIM_UNTIMED_SLEEP      1000     // Ticks an untimed sleep lasts
+
+const uint8 tasksCnt = 4;
+
+static uint32 simTimer;                 // Sleep timer, 24 bits
+static uint32 simNext;                  // What osal_next_timeout() returns
+
+static int simFails;
+
+uint32 halSleepReadTimer( void )
+{
+  return ( simTimer & 0x00FFFFFF );
+}
+
+void halSleep( uint32 osal_timeout )
+{
+  simTimer += osal_timeout ? osal_timeout : SIM_UNTIMED_SLEEP;
+}
+
+uint32 osal_next_timeout( void )
+{
+  return ( simNext );
+}
+
+void *osal_memset( void *dest, uint8 value, int len )
+{
+  return ( memset( dest, value, len ) );
+}
+
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+/*
+ * Run the tasks for awake ticks, then an idle pass.
+ */
+static void simPass( uint32 awake, uint32 next )
+{
+  simTimer += awake;
+  simNext = next;
+  osal_pwrmgr_powerconserve();
+}
+
+int main( void )
+{
+  pwrmgr_stats_t stats;
+  uint32 start;
+  long i;
+
+  // Start a little before the timer wraps
+  simTimer = 0x00FFFFFF - 5000;
+  osal_pwrmgr_init();
+  osal_pwrmgr_device( PWRMGR_BATTERY );
+  start = simTimer;
+
+  simPass( 100, 2000 );
+  simPass( 300, 0 );
+  simPass( 50, 4000 );
+  simPass( 250, 3000 );
+  osal_pwrmgr_stats( &stats );
+  simCheck( "the run crossed the wrap of the timer", simTimer > 0x00FFFFFF );
+  simCheck( "awake ticks across the wrap", stats.awakeTicks == 100 + 300 + 50 + 250 );
+  simCheck( "sleep ticks across the wrap", stats.sleepTicks == 2000 + SIM_UNTIMED_SLEEP + 4000 + 3000 );
+  simCheck( "awake and sleep add up to the time passed",
+            stats.awakeTicks + stats.sleepTicks == simTimer - start );
+  simCheck( "sleeps and untimed sleeps", ( stats.sleeps == 4 ) && ( stats.untimedSleeps == 1 ) );
+
+  simTimer += 77;
+  osal_pwrmgr_stats( &stats );
+  simCheck( "stats adds the time since the last sleep to awake",
+            stats.awakeTicks == 700 + 77 );
+
+  osal_pwrmgr_task_state( 2, PWRMGR_HOLD );
+  simPass( 40, 2000 );
+  simPass( 60, 2000 );
+  osal_pwrmgr_task_state( 2, PWRMGR_CONSERVE );
+  osal_pwrmgr_stats( &stats );
+  simCheck( "held passes counted with the task's bit, no sleep",
+            ( stats.holds == 2 ) && ( stats.holdTasks == ( 1 << 2 ) ) && ( stats.sleeps == 4 ) );
+  simCheck( "held passes count as awake", stats.awakeTicks == 700 + 77 + 100 );
+
+  osal_pwrmgr_stats_reset();
+  simPass( 10, 20 );
+  osal_pwrmgr_stats( &stats );
+  simCheck( "reset starts over from the timer",
+            ( stats.awakeTicks == 10 ) && ( stats.sleepTicks == 20 ) && ( stats.sleeps == 1 ) &&
+            ( stats.holds == 0 ) && ( stats.holdTasks == 0 ) );
+
+  for ( i = 0; i < 0x10010L; i++ )
+  {
+    simPass( 1, 0 );
+  }
+  osal_pwrmgr_stats( &stats );
+  simCheck( "counts stop at 0xFFFF", ( stats.sleeps == 0xFFFF ) && ( stats.untimedSleeps == 0xFFFF ) );
+  simCheck( "times go on past the counts and several wraps",
+            ( stats.awakeTicks == 10 + 0x10010L ) &&
+            ( stats.sleepTicks == 20 + 0x10010L * SIM_UNTIMED_SLEEP ) );
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
@@ -0,0 +1,607 @@
+/**************************************************************************************************
+  Filename:       sensorsim.c
+
+  Description:    Host test of the sampling scheduler of the CC2541ST hal_sensor.c
+                  with the six SensorTag drivers, against models of the sensors
+                  on the I2C bus: the TMP006, SHT21, MAG3110, KXTI9, C953 and
+                  MPU-3050 at the register level, with their conversions.
+
+                  hal_i2c.c is replaced by the bus model (i2csim covers it). The
+                  blocking HalI2CRead() and HalI2CWrite() are done at once, and
+                  fail while transactions are queued, as in hal_i2c.c. With
+                  HAL_I2C_ASYNC each transaction queued by HalI2CSubmit() is
+                  done by the next modeled ms, and its callback is made from
+                  HalI2CPoll() after that, so a burst of n register accesses
+                  takes n ms.
+
+                  The checks, in both builds: over 3 s of sampling each sensor
+                  gives the samples its period calls for, each with the data of
+                  the model in the byte order of the driver's read function and
+                  from the conversion started in the burst before. With
+                  HAL_I2C_ASYNC also: no blocking bus access is made once the
+                  sensors are started, HalSensorSchedRun() returns with the
+                  burst queued, a run during a burst does not start another, a
+                  sensor stopped during a burst is stopped at its end, and a
+                  sensor that does not answer leaves the others sampled.
+
+                  Build:  sh build.sh sensorsim
+                          OUT=sensorsim_async sh build.sh sensorsim -DHAL_I2C_ASYNC=TRUE
+                  Usage:  sensorsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#define HAL_SENSOR_SCHED       TRUE
+
+uint8 P0_7;
+
+#define DCDC_SBIT              P0_7
+#define HAL_LED_2              0x02
+#define HAL_TOGGLE_LED2()
+
+#include "../../Components/hal/target/CC2541ST/hal_sensor.c"
+#include "../../Components/hal/target/CC2541ST/hal_irtemp.c"
+#include "../../Components/hal/target/CC2541ST/hal_humi.c"
+#include "../../Components/hal/target/CC2541ST/hal_mag.c"
+#include "../../Components/hal/target/CC2541ST/hal_acc.c"
+#include "../../Components/hal/target/CC2541ST/hal_bar.c"
+#include "../../Components/hal/target/CC2541ST/hal_gyro.c"
+
+#define SIM_RUN_MS             3000     // Sampling time of the counts
+
+/* Sampling periods in ms */
+#define SIM_PER_IRTEMP         300
+#define SIM_PER_HUMID          100
+#define SIM_PER_MAGN           100
+#define SIM_PER_ACC            50
+#define SIM_PER_PRESS          100
+#define SIM_PER_GYRO           100
+
+static uint32 simMs;
+static int simFails;
+
+/* ------------------------------------------------------------------------------------------------
+ *                                         Sensor models
+ * ------------------------------------------------------------------------------------------------
+ */
+static uint8 simAbsent;                 // 7-bit address of a sensor that does not answer
+static uint8 simPtr[0x80];              // Register pointer of each slave
+static uint8 simReg[0x80][256];         // 8-bit registers of the MAG3110, KXTI9 and MPU-3050
+
+static uint16 simIrCfg;                 // TMP006
+static uint32 simIrOnAt;
+static uint16 simIrN;                   // Conversions started
+
+static uint16 simShtRes;                // SHT21 result of the last command
+static uint32 simShtAt;
+static uint16 simShtTn, simShtHn;
+
+static uint16 simBarRes;                // C953 result of the last command
+static uint16 simBarTn, simBarPn;
+
+static uint16 simGyroN;                 // MPU-3050 wake ups
+
+#define SIM_IR_V( n )          ( 0x1000 + ( n ) )
+#define SIM_IR_T( n )          ( 0x2000 + ( n ) )
+#define SIM_SHT_T( n )         ( 0x6000 + ( ( n ) << 2 ) )
+#define SIM_SHT_H( n )         ( 0x7000 + ( ( n ) << 2 ) )
+#define SIM_BAR_T( n )         ( 0x3000 + ( n ) )
+#define SIM_BAR_P( n )         ( 0x4000 + ( n ) )
+
+/*
+ * A write transaction to a slave: the register pointer, or the command,
+ * then the data. FALSE if the slave does not acknowledge.
+ */
+static uint8 simSlaveWrite( uint8 addr, uint8 *pBuf, uint8 len )
+{
+  uint8 i;
+
+  if ( ( addr == simAbsent ) || ( len == 0 ) )
+  {
+    return ( FALSE );
+  }
+
+  switch ( addr )
+  {
+  case TMP006_I2C_ADDRESS:
+    simPtr[addr] = pBuf[0];
+    if ( ( len == 3 ) && ( pBuf[0] == TMP006_REG_ADDR_CONFIG ) )
+    {
+      simIrCfg = BUILD_UINT16( pBuf[2], pBuf[1] );
+      if ( simIrCfg & 0x7000 )
+      {
+        simIrN++;
+        simIrOnAt = simMs;
+      }
+    }
+    return ( TRUE );
+
+  case HAL_SHT21_I2C_ADDRESS:
+    if ( pBuf[0] == SHT21_CMD_TEMP_T_NH )
+    {
+      simShtRes = SIM_SHT_T( ++simShtTn );
+      simShtAt = simMs;
+    }
+    else if ( pBuf[0] == SHT21_CMD_HUMI_T_NH )
+    {
+      simShtRes = SIM_SHT_H( ++simShtHn );
+      simShtAt = simMs;
+    }
+    return ( TRUE );
+
+  case HAL_C953_I2C_ADDRESS:
+    simPtr[addr] = pBuf[0];
+    if ( ( len == 2 ) && ( pBuf[0] == C953_REG_ADDR_COMMAND ) )
+    {
+      if ( pBuf[1] == C953_TEMP_READ_COMMAND )
+      {
+        simBarRes = SIM_BAR_T( ++simBarTn );
+      }
+      else if ( pBuf[1] == C953_PRESS_READ_COMMAND )
+      {
+        simBarRes = SIM_BAR_P( ++simBarPn );
+      }
+    }
+    return ( TRUE );
+
+  case HAL_MAG3110_I2C_ADDRESS:
+  case HAL_KXTI9_I2C_ADDRESS:
+  case HAL_GYRO_I2C_ADDRESS:
+    simPtr[addr] = pBuf[0];
+    for ( i = 1; i < len; i++ )
+    {
+      if ( ( addr == HAL_GYRO_I2C_ADDRESS ) && ( simPtr[addr] == HAL_GYRO_REG_PWR_MGM ) &&
+           ( ( pBuf[i] & HAL_GYRO_PWR_MGM_SLEEP ) == 0 ) )
+      {
+        simGyroN++;
+      }
+      simReg[addr][simPtr[addr]++] = pBuf[i];
+    }
+    return ( TRUE );
+
+  default:
+    return ( FALSE );
+  }
+}
+
+/*
+ * A read transaction from a slave, from its register pointer. FALSE if the
+ * slave does not acknowledge.
+ */
+static uint8 simSlaveRead( uint8 addr, uint8 *pBuf, uint8 len )
+{
+  uint16 val = 0;
+  uint8 i;
+
+  if ( addr == simAbsent )
+  {
+    return ( FALSE );
+  }
+
+  switch ( addr )
+  {
+  case TMP006_I2C_ADDRESS:
+    switch ( simPtr[addr] )
+    {
+    case TMP006_REG_ADDR_VOLTAGE:
+      val = SIM_IR_V( simIrN );
+      break;
+    case TMP006_REG_ADDR_TEMPERATURE:
+      val = SIM_IR_T( simIrN );
+      break;
+    case TMP006_REG_ADDR_CONFIG:
+      // Data ready once a conversion of 0.25 s is done
+      val = simIrCfg;
+      if ( ( simIrCfg & 0x7000 ) && ( ( simMs - simIrOnAt ) >= 250 ) )
+      {
+        val |= DATA_RDY_BIT >> 8;
+      }
+      break;
+    }
+    for ( i = 0; i < len; i++ )
+    {
+      pBuf[i] = ( i & 1 ) ? LO_UINT16( val ) : HI_UINT16( val );
+    }
+    return ( TRUE );
+
+  case HAL_SHT21_I2C_ADDRESS:
+    // No hold master: the read header is not acknowledged during a conversion
+    if ( ( simMs - simShtAt ) < 15 )
+    {
+      return ( FALSE );
+    }
+    for ( i = 0; i < len; i++ )
+    {
+      pBuf[i] = ( i == 0 ) ? HI_UINT16( simShtRes ) : ( i == 1 ) ? LO_UINT16( simShtRes ) : 0;
+    }
+    return ( TRUE );
+
+  case HAL_C953_I2C_ADDRESS:
+    for ( i = 0; i < len; i++ )
+    {
+      pBuf[i] = ( i & 1 ) ? HI_UINT16( simBarRes ) : LO_UINT16( simBarRes );
+    }
+    return ( TRUE );
+
+  case HAL_MAG3110_I2C_ADDRESS:
+    // Data, and data ready, while active
+    for ( i = 0; i < MAG_REG_READ_ALL_LEN; i++ )
+    {
+      simReg[addr][MAG_REG_ADDR_X_MSB + i] = 0x11 + i;
+    }
+    simReg[addr][MAG_REG_ADDR_DR_STATUS] = 0x0F;
+    if ( ( simReg[addr][MAG_REG_ADDR_CTRL_1] & MAG_REG_CTRL_EN ) == 0 )
+    {
+      memset( &simReg[addr][MAG_REG_ADDR_DR_STATUS], 0, 1 + MAG_REG_READ_ALL_LEN );
+    }
+    break;
+
+  case HAL_KXTI9_I2C_ADDRESS:
+    // Data while on
+    simReg[addr][ACC_REG_ADDR_XOUT_H] = 0x31;
+    simReg[addr][ACC_REG_ADDR_YOUT_L] = 0xEE;
+    simReg[addr][ACC_REG_ADDR_YOUT_H] = 0x32;
+    simReg[addr][ACC_REG_ADDR_ZOUT_L] = 0xEE;
+    simReg[addr][ACC_REG_ADDR_ZOUT_H] = 0x33;
+    if ( ( simReg[addr][ACC_REG_ADDR_CTRL_REG1] & ACC_REG_CTRL_PC ) == 0 )
+    {
+      memset( &simReg[addr][ACC_REG_ADDR_XOUT_L], 0, 6 );
+    }
+    break;
+
+  case HAL_GYRO_I2C_ADDRESS:
+    // Data of the last wake up while awake
+    for ( i = 0; i < HAL_GYRO_DATA_SIZE; i++ )
+    {
+      simReg[addr][HAL_GYRO_REG_GYRO_XOUT_H + i] = ( i & 1 ) ? (uint8)simGyroN : 0x41 + i / 2;
+    }
+    if ( simReg[addr][HAL_GYRO_REG_PWR_MGM] & HAL_GYRO_PWR_MGM_SLEEP )
+    {
+      memset( &simReg[addr][HAL_GYRO_REG_GYRO_XOUT_H], 0, HAL_GYRO_DATA_SIZE );
+    }
+    break;
+
+  default:
+    return ( FALSE );
+  }
+
+  for ( i = 0; i < len; i++ )
+  {
+    pBuf[i] = simReg[addr][simPtr[addr]++];
+  }
+  return ( TRUE );
+}
+
+/* ------------------------------------------------------------------------------------------------
+ *                                  Bus model in place of hal_i2c.c
+ * ------------------------------------------------------------------------------------------------
+ */
+static uint8 simAddr;                   // Slave of HalI2CInit()
+static uint8 simClock;
+static int simQCnt;                     // Transactions queued, and on the bus
+static int simBlocking;                 // Blocking reads and writes
+static int simRefused;                  // Blocking reads and writes refused for the queue
+static int simTrans;                    // Transactions queued
+
+void HalI2CInit( uint8 address, i2cClock_t clockRate )
+{
+  simAddr = address;
+  simClock = clockRate;
+}
+
+uint8 HalI2CRead( uint8 len, uint8 *pBuf )
+{
+  simBlocking++;
+  if ( simQCnt != 0 )
+  {
+    simRefused++;
+    return ( 0 );
+  }
+  return ( simSlaveRead( simAddr, pBuf, len ) ? len : 0 );
+}
+
+uint8 HalI2CWrite( uint8 len, uint8 *pBuf )
+{
+  simBlocking++;
+  if ( simQCnt != 0 )
+  {
+    simRefused++;
+    return ( 0 );
+  }
+  return ( simSlaveWrite( simAddr, pBuf, len ) ? len : 0 );
+}
+
+#if HAL_I2C_ASYNC
+static halI2CTrans_t *simQ[8];
+static halI2CTrans_t *simDoneQ[8];      // Done, waiting for HalI2CPoll()
+static int simDoneCnt;
+
+void HalI2CSubmit( halI2CTrans_t *pTrans )
+{
+  pTrans->next = NULL;
+  pTrans->cnt = 0;
+  pTrans->status = HAL_I2C_PENDING;
+  if ( simQCnt < 8 )
+  {
+    simQ[simQCnt++] = pTrans;
+  }
+  simTrans++;
+}
+
+uint8 HalI2CBusy( void )
+{
+  return ( simQCnt != 0 );
+}
+
+/*
+ * Do the queued transactions, each a write then a read after a repeated
+ * START, at the clock every sensor takes.
+ */
+static void simBus( void )
+{
+  int i;
+
+  for ( i = 0; i < simQCnt; i++ )
+  {
+    halI2CTrans_t *pTrans = simQ[i];
+    uint8 ok = ( simClock == i2cClock_267KHZ );
+
+    if ( ok && ( pTrans->wrLen != 0 ) )
+    {
+      ok = simSlaveWrite( pTrans->addr, pTrans->pWr, pTrans->wrLen );
+      pTrans->cnt = ok ? pTrans->wrLen : 0;
+    }
+    if ( ok && ( pTrans->rdLen != 0 ) )
+    {
+      ok = simSlaveRead( pTrans->addr, pTrans->pRd, pTrans->rdLen );
+      pTrans->cnt += ok ? pTrans->rdLen : 0;
+    }
+    pTrans->status = ok ? HAL_I2C_SUCCESS : HAL_I2C_NACK;
+    simDoneQ[simDoneCnt++] = pTrans;
+  }
+  simQCnt = 0;
+}
+
+void HalI2CPoll( void )
+{
+  halI2CTrans_t *done[8];
+  int cnt = simDoneCnt;
+  int i;
+
+  memcpy( done, simDoneQ, sizeof( done ) );
+  simDoneCnt = 0;
+  for ( i = 0; i < cnt; i++ )
+  {
+    if ( done[i]->callBackFunc != NULL )
+    {
+      done[i]->callBackFunc( done[i] );
+    }
+  }
+}
+#else
+static void simBus( void )
+{
+}
+
+void HalI2CPoll( void )
+{
+}
+#endif
+
+/* ------------------------------------------------------------------------------------------------
+ *                                       Other stand-ins
+ * ------------------------------------------------------------------------------------------------
+ */
+uint32 osal_GetSystemClock( void )
+{
+  return ( simMs );
+}
+
+uint8 HalLedSet( uint8 led, uint8 mode )
+{
+  return ( 0 );
+}
+
+/* ------------------------------------------------------------------------------------------------
+ *                                             Test
+ * ------------------------------------------------------------------------------------------------
+ */
+static halSensorFrame_t simFrame;
+static uint32 simRunAt;                 // Next HalSensorSchedRun()
+static int simSamples[6];               // Valid samples of each sensor
+static int simBadData[6];               // Of them, with other than the model's data
+static int simFrames;
+static uint8 simLastValid;
+
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+static int simSame16( uint8 *p, uint16 val )
+{
+  return ( ( p[0] == LO_UINT16( val ) ) && ( p[1] == HI_UINT16( val ) ) );
+}
+
+/*
+ * A frame of a burst: count its samples and check their data against the
+ * models, in the byte order of the drivers' read functions.
+ */
+static void simTake( halSensorFrame_t *pFrame )
+{
+  uint8 mag[6] = { 0x12, 0x11, 0x14, 0x13, 0x16, 0x15 };
+  uint8 acc[3] = { 0x31, 0x32, 0x33 };
+  uint8 gyro[6] = { (uint8)simGyroN, 0x41, (uint8)simGyroN, 0x42, (uint8)simGyroN, 0x43 };
+  int ok[6];
+  int i;
+
+  // The sample read is of the conversion started by the burst before, which
+  // the burst has since restarted
+  ok[0] = simSame16( &pFrame->irtemp[0], SIM_IR_V( simIrN - 1 ) ) &&
+          simSame16( &pFrame->irtemp[2], SIM_IR_T( simIrN - 1 ) );
+  ok[1] = simSame16( &pFrame->humi[0], SIM_SHT_T( simShtTn - 1 ) ) &&
+          simSame16( &pFrame->humi[2], SIM_SHT_H( simShtHn ) );
+  ok[2] = ( memcmp( pFrame->mag, mag, 6 ) == 0 );
+  ok[3] = ( memcmp( pFrame->acc, acc, 3 ) == 0 );
+  ok[4] = ( simBarRes == SIM_BAR_T( simBarTn ) )
+          ? simSame16( &pFrame->bar[2], SIM_BAR_P( simBarPn ) ) &&
+            simSame16( &pFrame->bar[0], SIM_BAR_T( simBarTn - 1 ) )
+          : simSame16( &pFrame->bar[0], SIM_BAR_T( simBarTn ) ) &&
+            ( ( simBarPn == 1 ) ? ( pFrame->bar[2] == 0 && pFrame->bar[3] == 0 )
+                                : simSame16( &pFrame->bar[2], SIM_BAR_P( simBarPn - 1 ) ) );
+  // Read, put to sleep and woken up again in the burst
+  gyro[0] = gyro[2] = gyro[4] = (uint8)( simGyroN - 1 );
+  ok[5] = ( memcmp( pFrame->gyro, gyro, 6 ) == 0 );
+
+  for ( i = 0; i < 6; i++ )
+  {
+    if ( pFrame->valid & BV( i ) )
+    {
+      simSamples[i]++;
+      if ( !ok[i] )
+      {
+        simBadData[i]++;
+      }
+    }
+  }
+  simLastValid = pFrame->valid;
+  simFrames++;
+}
+
+#if HAL_I2C_ASYNC
+static void simCback( halSensorFrame_t *pFrame )
+{
+  simTake( pFrame );
+}
+#endif
+
+/*
+ * Run the scheduler, the bus and HalI2CPoll() for ms, up to the time given
+ * for the runs of the scheduler.
+ */
+static void simRun( uint32 ms, uint32 runUntil )
+{
+  uint16 delay;
+
+  for ( ; ms != 0; ms-- )
+  {
+    if ( ( simMs >= simRunAt ) && ( simMs <= runUntil ) )
+    {
+      delay = HalSensorSchedRun( &simFrame );
+#if !HAL_I2C_ASYNC
+      simTake( &simFrame );
+#endif
+      simRunAt = simMs + delay;
+    }
+    simMs++;
+    simBus();
+    HalI2CPoll();
+  }
+}
+
+static void simSetAll( uint8 on )
+{
+  static const uint16 per[6] =
+  {
+    SIM_PER_IRTEMP, SIM_PER_HUMID, SIM_PER_MAGN, SIM_PER_ACC, SIM_PER_PRESS, SIM_PER_GYRO
+  };
+  uint16 delay = 0;
+  int i;
+
+  for ( i = 0; i < 6; i++ )
+  {
+    delay = HalSensorSchedSet( BV( i ), on ? per[i] : 0 );
+  }
+  simRunAt = simMs + delay;
+}
+
+int main( void )
+{
+  static const char *names[6] = { "IR temperature", "humidity", "magnetometer",
+                                  "accelerometer", "barometer", "gyro" };
+  // Samples in SIM_RUN_MS; the humidity sensor alternates its two conversions
+  int expect[6] =
+  {
+    SIM_RUN_MS / SIM_PER_IRTEMP, SIM_RUN_MS / SIM_PER_HUMID, SIM_RUN_MS / SIM_PER_MAGN,
+    SIM_RUN_MS / SIM_PER_ACC, SIM_RUN_MS / SIM_PER_PRESS, SIM_RUN_MS / SIM_PER_GYRO
+  };
+  char what[80];
+  int i;
+#if HAL_I2C_ASYNC
+  int blocking;
+#endif
+
+  simAbsent = 0xFF;
+  HalAccInit();
+#if HAL_I2C_ASYNC
+  HalSensorSchedRegister( simCback );
+  printf( "Bursts queued on the I2C bus (HAL_I2C_ASYNC)\n" );
+#else
+  printf( "Bursts of blocking reads\n" );
+#endif
+
+  // The first bursts fall on the next multiple of each period after 0 ms
+  simSetAll( TRUE );
+#if HAL_I2C_ASYNC
+  blocking = simBlocking;
+#endif
+  simRun( SIM_RUN_MS + 50, SIM_RUN_MS );
+
+  for ( i = 0; i < 6; i++ )
+  {
+    sprintf( what, "%s: %d samples, the data of the conversions", names[i], simSamples[i] );
+    simCheck( what, ( simSamples[i] == expect[i] ) && ( simBadData[i] == 0 ) );
+  }
+
+#if HAL_I2C_ASYNC
+  simCheck( "no blocking bus access while sampling", simBlocking == blocking );
+
+  // A burst is queued and goes on from HalI2CPoll()
+  simRun( 1000, simMs + 1000 );
+  simRunAt = simMs + 1000;
+  while ( ( simMs % 300 ) != 0 )
+  {
+    simMs++;
+  }
+  simFrames = 0;
+  simTrans = 0;
+  (void)HalSensorSchedRun( &simFrame );
+  simCheck( "HalSensorSchedRun() returns with the burst queued",
+            HalI2CBusy() && ( simFrames == 0 ) );
+
+  // Another run during the burst does not start a burst
+  (void)HalSensorSchedRun( &simFrame );
+  simCheck( "a run during a burst is skipped", ( simTrans == 1 ) && ( simFrames == 0 ) );
+
+  // A sensor stopped during the burst is stopped at its end
+  (void)HalSensorSchedSet( ST_GYRO, 0 );
+  simCheck( "the gyro stopped during a burst is still on",
+            ( simReg[HAL_GYRO_I2C_ADDRESS][HAL_GYRO_REG_PWR_MGM] & HAL_GYRO_PWR_MGM_SLEEP ) == 0 );
+  simRun( 30, 0 );
+  simCheck( "the burst is done, with all the sensors",
+            ( simFrames == 1 ) && ( simLastValid == ( ST_IRTEMP | ST_MAGN | ST_ACC | ST_PRESS |
+                                                      ST_GYRO ) ) );
+  simCheck( "the gyro is stopped at its end, with the bus free",
+            ( simReg[HAL_GYRO_I2C_ADDRESS][HAL_GYRO_REG_PWR_MGM] & HAL_GYRO_PWR_MGM_SLEEP ) &&
+            ( simRefused == 0 ) );
+
+  // A sensor that does not answer
+  simSetAll( FALSE );
+  memset( simSamples, 0, sizeof( simSamples ) );
+  memset( simBadData, 0, sizeof( simBadData ) );
+  simAbsent = HAL_MAG3110_I2C_ADDRESS;
+  simSetAll( TRUE );
+  simRun( 1000, simMs + 1000 );
+  simCheck( "a sensor that does not answer leaves the others sampled",
+            ( simSamples[2] == 0 ) && ( simSamples[3] >= 1000 / SIM_PER_ACC - 1 ) &&
+            ( simSamples[5] >= 1000 / SIM_PER_GYRO - 1 ) && ( simBadData[3] == 0 ) );
+#endif
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
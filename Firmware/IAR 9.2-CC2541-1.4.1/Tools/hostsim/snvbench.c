@@ -0,0 +1,514 @@
+/**************************************************************************************************
+  Filename:       snvbench.c
+
+  Description:    Host benchmark and power loss test of the NV driver in
+                  osal_snv.c, on the flash of flashsim.c.
+
+                  Build:  sh build.sh snvbench flashsim.c
+                  Usage:  snvbench [-i] [-n writes] [mix]
+                          snvbench [-i] -p boots
+
+                  The benchmark runs a write mix for the given number of
+                  writes (default 1000000), with a read of a random item after
+                  each, and reports the host time of osal_snv_read and
+                  osal_snv_write, the modeled flash time a write stalls the
+                  CPU for, how often the page is compacted and how often the
+                  caller pays for it, the erases of each NV page and the
+                  writes the pages last at the mix. The mixes are settings
+                  (small items, half of the writes unchanged), telemetry (a
+                  few records rewritten all the time), bonds (GAP bond and
+                  characteristic configuration records) and mixed (all
+                  three); without one all four run.
+
+                  -p boots the mixed set of items over the given number of
+                  boots, each a forked process that runs osal_snv_init, checks
+                  every item and writes until the power is cut at a random
+                  word write or page erase. Every item must read back with
+                  its last written value, or for the item being written when
+                  the power went, with the value before.
+
+                  -i registers an event with osal_snv_compact_register and runs
+                  one osal_snv_compact_step after each operation while it is
+                  set, as the bridge does, rather than compacting inside
+                  osal_snv_write. Host times are host nanoseconds, not CC2541
+                  cycle counts; flash times are the datasheet word write and
+                  page erase times.
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define OSAL_SNV_STATS         TRUE
+
+#include "../../Components/osal/mcu/cc2540/osal_snv.c"
+
+#include "flashsim.h"
+
+#define BENCH_ID_MAX           256
+#define BENCH_LEN_MAX          32
+#define BENCH_ENDURANCE        20000    // Page erases the datasheet guarantees
+
+#define BENCH_COMPACT_TASK     1
+#define BENCH_COMPACT_EVT      0x0001
+
+typedef struct
+{
+  osalSnvId_t id;         // First item
+  uint8 cnt;              // Items
+  osalSnvLen_t len;
+  uint8 weight;           // Share of the writes
+} benchClass_t;
+
+typedef struct
+{
+  const char *name;
+  uint8 samePct;          // Writes that leave the value as it is
+  benchClass_t classes[4];
+} benchMix_t;
+
+static const benchMix_t benchMixes[] =
+{
+  { "settings",  50, { { 0x80, 16,  8, 100 } } },
+  { "telemetry",  0, { { 0xA0,  4, 20, 100 } } },
+  { "bonds",      0, { { 0x20,  6, 28,  40 }, { 0x30, 6,  4, 60 } } },
+  { "mixed",     20, { { 0x80, 16,  8,  20 }, { 0xA0, 4, 20, 70 },
+                       { 0x20,  6, 28,   2 }, { 0x30, 6,  4,  8 } } },
+};
+
+#define BENCH_MIX_CNT          ( sizeof( benchMixes ) / sizeof( benchMixes[0] ) )
+#define BENCH_MIX_PWR          ( &benchMixes[BENCH_MIX_CNT - 1] )
+
+/* What the flash must hold, shared with the boots of the power loss test */
+typedef struct
+{
+  flashsim_t flash;
+  uint8 len[BENCH_ID_MAX];                    // 0 until written
+  uint8 val[BENCH_ID_MAX][BENCH_LEN_MAX];
+  uint8 pend;                                 // A write was under way
+  osalSnvId_t pendId;
+  uint8 pendLen;
+  uint8 pendVal[BENCH_LEN_MAX];
+  unsigned long boots;
+  unsigned long newer;                        // Cut writes found written
+  unsigned long older;                        // and found not written
+} benchState_t;
+
+static benchState_t *bench;
+
+static uint8 benchIncremental;
+static uint8 benchCompactPending;
+
+static hostsimHist_t benchReadHist;
+static hostsimHist_t benchWriteHist;
+static hostsimHist_t benchStepHist;
+static hostsimHist_t benchWriteUsHist;
+static hostsimHist_t benchStepUsHist;
+static uint64_t benchWriteUsMax;
+static uint64_t benchStepUsMax;
+
+bool HalAdcCheckVdd( uint8 limit )
+{
+  return ( TRUE );
+}
+
+uint8 osal_set_event( uint8 task_id, uint16 event_flag )
+{
+  benchCompactPending = TRUE;
+  return ( SUCCESS );
+}
+
+uint8 osal_memcmp( const void GENERIC *src1, const void GENERIC *src2, unsigned int len )
+{
+  return ( memcmp( src1, src2, len ) == 0 );
+}
+
+void halAssertHandler( void )
+{
+  fprintf( stderr, "NV assert\n" );
+  exit( 2 );
+}
+
+/*
+ * Pick an item of the mix and a value for it.
+ */
+static osalSnvId_t benchPick( const benchMix_t *pMix, uint8 *pVal, osalSnvLen_t *pLen )
+{
+  const benchClass_t *pCls = pMix->classes;
+  int pick = rand() % 100;
+  osalSnvId_t id;
+  uint8 i;
+
+  while ( pick >= pCls->weight && pCls < &pMix->classes[3] && pCls[1].weight != 0 )
+  {
+    pick -= pCls->weight;
+    pCls++;
+  }
+
+  id = pCls->id + rand() % pCls->cnt;
+  *pLen = pCls->len;
+
+  if ( bench->len[id] != 0 && (rand() % 100) < pMix->samePct )
+  {
+    memcpy( pVal, bench->val[id], pCls->len );
+  }
+  else
+  {
+    for ( i = 0; i < pCls->len; i++ )
+    {
+      pVal[i] = (uint8)rand();
+    }
+  }
+
+  return ( id );
+}
+
+/*
+ * Add the flash time since us0 to the histogram and the maximum.
+ */
+static void benchUs( hostsimHist_t *pHist, uint64_t *pMax, uint64_t us0 )
+{
+  uint64_t us = flashsim->busyUs - us0;
+
+  hostsimHistAdd( pHist, us );
+  if ( us > *pMax )
+  {
+    *pMax = us;
+  }
+}
+
+static void benchStep( void )
+{
+  uint64_t t0, us0;
+
+  if ( benchIncremental && benchCompactPending )
+  {
+    us0 = flashsim->busyUs;
+    t0 = hostsimNow();
+    benchCompactPending = osal_snv_compact_step();
+    hostsimHistTime( &benchStepHist, t0 );
+    benchUs( &benchStepUsHist, &benchStepUsMax, us0 );
+  }
+}
+
+static void benchStart( void )
+{
+  benchCompactPending = FALSE;
+  if ( benchIncremental )
+  {
+    osal_snv_compact_register( BENCH_COMPACT_TASK, BENCH_COMPACT_EVT );
+  }
+}
+
+/*
+ * Read item id back and check it against what was written. For the item of
+ * a write cut by the power, take either value and remember the one found.
+ */
+static int benchCheck( osalSnvId_t id )
+{
+  uint8 buf[BENCH_LEN_MAX];
+  uint8 len = bench->len[id];
+  uint8 pend = bench->pend && ( bench->pendId == id );
+  uint8 status;
+
+  status = osal_snv_read( id, len ? len : 1, buf );
+
+  if ( len == 0 && !pend )
+  {
+    return ( status != SUCCESS );
+  }
+
+  if ( pend )
+  {
+    if ( len == 0 )
+    {
+      // The cut write was the first of the item
+      status = osal_snv_read( id, bench->pendLen, buf );
+    }
+    if ( status == SUCCESS && memcmp( buf, bench->pendVal, bench->pendLen ) == 0 )
+    {
+      memcpy( bench->val[id], buf, bench->pendLen );
+      bench->len[id] = bench->pendLen;
+      bench->newer++;
+      return ( TRUE );
+    }
+    if ( bench->len[id] == 0 ? ( status != SUCCESS ) :
+         ( status == SUCCESS && memcmp( buf, bench->val[id], len ) == 0 ) )
+    {
+      bench->older++;
+      return ( TRUE );
+    }
+    return ( FALSE );
+  }
+
+  return ( status == SUCCESS && memcmp( buf, bench->val[id], len ) == 0 );
+}
+
+static void benchFail( const char *what, osalSnvId_t id )
+{
+  printf( "%s of item 0x%02X failed after %lu boots\n", what, id, bench->boots );
+  exit( 1 );
+}
+
+/*
+ * Run the write mix, checking each read.
+ */
+static void benchRun( const benchMix_t *pMix, long writes )
+{
+  osalSnvStats_t *pStats = osal_snv_stats();
+  uint8 val[BENCH_LEN_MAX];
+  uint8 buf[BENCH_LEN_MAX];
+  osalSnvLen_t len;
+  osalSnvId_t id;
+  uint64_t t0, us0;
+  uint32 mostErases = 0;
+  long n;
+  int pg;
+
+  memset( bench, 0, sizeof( benchState_t ) );
+  flashsimInit( &bench->flash );
+  hostsimHistReset( &benchReadHist );
+  hostsimHistReset( &benchWriteHist );
+  hostsimHistReset( &benchStepHist );
+  hostsimHistReset( &benchWriteUsHist );
+  hostsimHistReset( &benchStepUsHist );
+  benchWriteUsMax = 0;
+  benchStepUsMax = 0;
+  srand( 1 );
+
+  if ( osal_snv_init() != SUCCESS )
+  {
+    benchFail( "init", 0 );
+  }
+  memset( pStats, 0, sizeof( osalSnvStats_t ) );
+  benchStart();
+
+  for ( n = 0; n < writes; n++ )
+  {
+    id = benchPick( pMix, val, &len );
+    us0 = flashsim->busyUs;
+    t0 = hostsimNow();
+    if ( osal_snv_write( id, len, val ) != SUCCESS )
+    {
+      benchFail( "write", id );
+    }
+    hostsimHistTime( &benchWriteHist, t0 );
+    benchUs( &benchWriteUsHist, &benchWriteUsMax, us0 );
+    memcpy( bench->val[id], val, len );
+    bench->len[id] = len;
+    benchStep();
+
+    id = benchPick( pMix, val, &len );
+    if ( bench->len[id] != 0 )
+    {
+      t0 = hostsimNow();
+      osal_snv_read( id, len, buf );
+      hostsimHistTime( &benchReadHist, t0 );
+      if ( memcmp( buf, bench->val[id], len ) != 0 )
+      {
+        benchFail( "read", id );
+      }
+    }
+    benchStep();
+  }
+
+  printf( "%s, %ld writes, %u unchanged, %s compaction\n", pMix->name, writes,
+          pStats->unchanged, benchIncremental ? "incremental" : "blocking" );
+  printf( "  read          median %6llu ns  99%% %6llu ns  99.9%% %6llu ns\n",
+          (unsigned long long)hostsimHistPct( &benchReadHist, 50.0 ),
+          (unsigned long long)hostsimHistPct( &benchReadHist, 99.0 ),
+          (unsigned long long)hostsimHistPct( &benchReadHist, 99.9 ) );
+  printf( "  write         median %6llu ns  99%% %6llu ns  99.9%% %6llu ns\n",
+          (unsigned long long)hostsimHistPct( &benchWriteHist, 50.0 ),
+          (unsigned long long)hostsimHistPct( &benchWriteHist, 99.0 ),
+          (unsigned long long)hostsimHistPct( &benchWriteHist, 99.9 ) );
+  printf( "  write flash   median %6llu us  99%% %6llu us  99.9%% %6llu us  max %llu us\n",
+          (unsigned long long)hostsimHistPct( &benchWriteUsHist, 50.0 ),
+          (unsigned long long)hostsimHistPct( &benchWriteUsHist, 99.0 ),
+          (unsigned long long)hostsimHistPct( &benchWriteUsHist, 99.9 ),
+          (unsigned long long)benchWriteUsMax );
+  if ( benchIncremental )
+  {
+    printf( "  step          median %6llu ns  99%% %6llu ns  99.9%% %6llu ns\n",
+            (unsigned long long)hostsimHistPct( &benchStepHist, 50.0 ),
+            (unsigned long long)hostsimHistPct( &benchStepHist, 99.0 ),
+            (unsigned long long)hostsimHistPct( &benchStepHist, 99.9 ) );
+    printf( "  step flash    median %6llu us  99%% %6llu us  max %llu us, %llu steps\n",
+            (unsigned long long)hostsimHistPct( &benchStepUsHist, 50.0 ),
+            (unsigned long long)hostsimHistPct( &benchStepUsHist, 99.0 ),
+            (unsigned long long)benchStepUsMax,
+            (unsigned long long)benchStepUsHist.n );
+  }
+  printf( "  compactions %u, one per %.0f writes, %u blocking\n", pStats->compactions,
+          pStats->compactions ? (double)pStats->writes / pStats->compactions : 0.0,
+          pStats->blocking );
+  printf( "  erases" );
+  for ( pg = 0; pg < HAL_NV_PAGE_CNT; pg++ )
+  {
+    printf( " page %d: %u", HAL_NV_PAGE_BEG + pg, flashsim->erases[HAL_NV_PAGE_BEG + pg] );
+    if ( flashsim->erases[HAL_NV_PAGE_BEG + pg] > mostErases )
+    {
+      mostErases = flashsim->erases[HAL_NV_PAGE_BEG + pg];
+    }
+  }
+  printf( ", words written more than twice %u\n", flashsim->overwrites );
+  if ( mostErases )
+  {
+    printf( "  %.3g writes of the mix to %u erases of a page\n",
+            (double)writes * BENCH_ENDURANCE / mostErases, BENCH_ENDURANCE );
+  }
+}
+
+static void benchPowerOff( void )
+{
+  _exit( 0 );
+}
+
+/*
+ * One boot of the power loss test: init, check, then write until the cut.
+ */
+static void benchBoot( long cut )
+{
+  uint8 val[BENCH_LEN_MAX];
+  osalSnvLen_t len;
+  osalSnvId_t id;
+  int i;
+
+  flashsim = &bench->flash;
+  flashsimCutCB = benchPowerOff;
+  flashsimCut( cut );
+
+  if ( osal_snv_init() != SUCCESS )
+  {
+    benchFail( "init", 0 );
+  }
+  for ( i = 1; i < BENCH_ID_MAX; i++ )
+  {
+    if ( !benchCheck( (osalSnvId_t)i ) )
+    {
+      benchFail( "check", (osalSnvId_t)i );
+    }
+  }
+  bench->pend = FALSE;
+  benchStart();
+
+  for ( ;; )
+  {
+    id = benchPick( BENCH_MIX_PWR, val, &len );
+    memcpy( bench->pendVal, val, len );
+    bench->pendLen = len;
+    bench->pendId = id;
+    bench->pend = TRUE;
+    if ( osal_snv_write( id, len, val ) != SUCCESS )
+    {
+      benchFail( "write", id );
+    }
+    memcpy( bench->val[id], val, len );
+    bench->len[id] = len;
+    bench->pend = FALSE;
+    benchStep();
+  }
+}
+
+static void benchPower( unsigned long boots )
+{
+  unsigned long boot;
+  uint32 erases = 0;
+  int status;
+  int pg;
+  pid_t pid;
+
+  bench = mmap( NULL, sizeof( benchState_t ), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+  if ( bench == MAP_FAILED )
+  {
+    perror( "mmap" );
+    exit( 2 );
+  }
+  memset( bench, 0, sizeof( benchState_t ) );
+  flashsimInit( &bench->flash );
+
+  for ( boot = 0; boot < boots; boot++ )
+  {
+    fflush( stdout );
+    pid = fork();
+    if ( pid == 0 )
+    {
+      srand( boot + 1 );
+      // Cut anywhere from init to a couple of compactions later
+      benchBoot( rand() % 3000 );
+    }
+    if ( pid < 0 || waitpid( pid, &status, 0 ) != pid )
+    {
+      perror( "fork" );
+      exit( 2 );
+    }
+    if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+    {
+      exit( 1 );
+    }
+    bench->boots++;
+  }
+
+  printf( "%lu power losses, %s compaction: cut writes found written %lu, not written %lu\n",
+          bench->boots, benchIncremental ? "incremental" : "blocking",
+          bench->newer, bench->older );
+  for ( pg = HAL_NV_PAGE_BEG; pg < HAL_NV_PAGE_BEG + HAL_NV_PAGE_CNT; pg++ )
+  {
+    erases += bench->flash.erases[pg];
+  }
+  printf( "  %llu words written, %u page erases, words written more than twice %u\n",
+          (unsigned long long)bench->flash.words, erases, bench->flash.overwrites );
+}
+
+int main( int argc, char *argv[] )
+{
+  static benchState_t state;
+  long writes = 1000000;
+  long boots = 0;
+  const char *mix = NULL;
+  unsigned m;
+  int i;
+
+  for ( i = 1; i < argc; i++ )
+  {
+    if ( strcmp( argv[i], "-i" ) == 0 )
+    {
+      benchIncremental = TRUE;
+    }
+    else if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc )
+    {
+      writes = atol( argv[++i] );
+    }
+    else if ( strcmp( argv[i], "-p" ) == 0 && i + 1 < argc )
+    {
+      boots = atol( argv[++i] );
+    }
+    else
+    {
+      mix = argv[i];
+    }
+  }
+
+  hostsimInit();
+
+  if ( boots )
+  {
+    benchPower( boots );
+    return ( 0 );
+  }
+
+  bench = &state;
+  for ( m = 0; m < BENCH_MIX_CNT; m++ )
+  {
+    if ( mix == NULL || strcmp( mix, benchMixes[m].name ) == 0 )
+    {
+      benchRun( &benchMixes[m], writes );
+    }
+  }
+
+  return ( 0 );
+}
@@ -0,0 +1,450 @@
+/**************************************************************************************************
+  Filename:       telemsim.c
+
+  Description:    Host test of the notifications of the SensorProfile telemetry
+                  service, decoded by a client as the service describes them.
+
+                  The test plays the application and the stack: it stores
+                  samples with Telemetry_SetSample(), calls Telemetry_Notify()
+                  and hands each notification sent on its one connection to the
+                  client decoder. The decoder keeps the last sample of each
+                  sensor, applies the delta coded samples to it, and ignores
+                  the delta coded samples of a sensor after a gap in the
+                  sequence numbers until it gets that sensor in full.
+
+                  The checks: every sample the client decodes is the one the
+                  application stored last, with and without delta coding, and
+                  the client never has to ignore one; every
+                  TELEMETRY_KEY_INTERVAL notifications a key notification
+                  starts, after which each sensor comes in full before it is
+                  delta coded again; a failed notification is followed by one
+                  in full; when the samples do not fit in one notification
+                  every sensor still gets its turn; and the IR temperature
+                  sample, two big endian words, is delta coded word by word.
+
+                  Build:  sh build.sh telemsim -I../../Components/ble/include -I../../Components/ble/host
+                            -I../../Projects/ble/Include -I../../Projects/ble/Profiles/SensorProfile/CC254x
+                  Usage:  telemsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../Projects/ble/Profiles/SensorProfile/CC254x/telemetryservice.c"
+
+#define SIM_CONN_HANDLE        0
+#define SIM_ROUNDS             2000     // Notifications of the random walk
+
+// Most notifications a sensor waits for with all of them stored each time:
+// the 33 bytes of samples take two notifications of the default
+// TELEMETRY_MAX_LEN, and a third when the packing falls badly
+#define SIM_FAIR_WAIT          3
+
+static int simFails;
+
+/* ------------------------------------------------------------------------------------------------
+ *                                         Stack stand-ins
+ * ------------------------------------------------------------------------------------------------
+ */
+CONST uint8 primaryServiceUUID[ATT_BT_UUID_SIZE] = { LO_UINT16( GATT_PRIMARY_SERVICE_UUID ),
+                                                     HI_UINT16( GATT_PRIMARY_SERVICE_UUID ) };
+CONST uint8 characterUUID[ATT_BT_UUID_SIZE] = { LO_UINT16( GATT_CHARACTER_UUID ),
+                                                HI_UINT16( GATT_CHARACTER_UUID ) };
+CONST uint8 clientCharCfgUUID[ATT_BT_UUID_SIZE] = { LO_UINT16( GATT_CLIENT_CHAR_CFG_UUID ),
+                                                    HI_UINT16( GATT_CLIENT_CHAR_CFG_UUID ) };
+CONST uint8 charUserDescUUID[ATT_BT_UUID_SIZE] = { LO_UINT16( GATT_CHAR_USER_DESC_UUID ),
+                                                   HI_UINT16( GATT_CHAR_USER_DESC_UUID ) };
+
+static uint8 simBm[ATT_MTU_SIZE];
+static uint8 simFailNext;               // Fail the next GATT_Notification()
+static uint8 simRx[ATT_MTU_SIZE];       // Last notification the client got
+static uint8 simRxLen;
+static uint8 simRxNew;
+
+void *osal_memcpy( void *dst, const void GENERIC *src, unsigned int len )
+{
+  return ( (uint8 *)memcpy( dst, src, len ) + len );
+}
+
+bStatus_t util_initCharacteristicConfig( gattCharCfg_t **pDataConfig )
+{
+  return ( SUCCESS );
+}
+
+bStatus_t utilExtractUuid16( gattAttribute_t *pAttr, uint16 *pValue )
+{
+  return ( FAILURE );
+}
+
+bStatus_t GATTServApp_RegisterService( gattAttribute_t *pAttrs, uint16 numAttrs, uint8 encKeySize,
+                                       CONST gattServiceCBs_t *pServiceCBs )
+{
+  return ( SUCCESS );
+}
+
+bStatus_t GATTServApp_ProcessCCCWriteReq( uint16 connHandle, gattAttribute_t *pAttr,
+                                          uint8 *pValue, uint8 len, uint16 offset,
+                                          uint16 validCfg )
+{
+  return ( SUCCESS );
+}
+
+uint16 GATTServApp_ReadCharCfg( uint16 connHandle, gattCharCfg_t *charCfgTbl )
+{
+  return ( GATT_CLIENT_CFG_NOTIFY );
+}
+
+void linkDB_PerformFunc( pfnPerformFuncCB_t cb )
+{
+  linkDBItem_t item;
+
+  memset( &item, 0, sizeof( item ) );
+  item.connectionHandle = SIM_CONN_HANDLE;
+  item.stateFlags = LINK_CONNECTED;
+  cb( &item );
+}
+
+uint16 linkDB_MTU( uint16 connectionHandle )
+{
+  return ( ATT_MTU_SIZE );
+}
+
+void *GATT_bm_alloc( uint16 connHandle, uint8 opcode, uint16 size, uint16 *pSizeAlloc )
+{
+  return ( ( size <= sizeof( simBm ) ) ? simBm : NULL );
+}
+
+void GATT_bm_free( gattMsg_t *pMsg, uint8 opcode )
+{
+}
+
+bStatus_t GATT_Notification( uint16 connHandle, attHandleValueNoti_t *pNoti, uint8 authenticated )
+{
+  if ( simFailNext )
+  {
+    simFailNext = FALSE;
+    return ( MSG_BUFFER_NOT_AVAIL );
+  }
+
+  memcpy( simRx, pNoti->pValue, pNoti->len );
+  simRxLen = pNoti->len;
+  simRxNew = TRUE;
+
+  return ( SUCCESS );
+}
+
+/* ------------------------------------------------------------------------------------------------
+ *                                            Client
+ * ------------------------------------------------------------------------------------------------
+ */
+static uint8 cliSample[TELEMETRY_SAMPLES_LEN];  // Last sample of each sensor
+static uint8 cliKnown;                          // Sensors with cliSample in step
+static uint8 cliSeq;                            // Sequence number expected next
+static uint8 cliSynced;
+static uint8 cliGot;                            // Sensors in the last notification
+static int cliIgnored;                          // Delta coded samples ignored after a gap
+static int cliBad;                              // Notifications that did not parse
+
+/*
+ * Decode a notification into cliSample.
+ */
+static void cliDecode( uint8 *p, uint8 len )
+{
+  uint8 *pEnd = p + len;
+  uint8 seq, map, delta;
+  uint8 *pSample;
+  uint16 word;
+  uint8 idx, i;
+
+  seq = *p++;
+  map = *p++;
+  delta = *p++;
+  if ( cliSynced && ( seq != cliSeq ) )
+  {
+    cliKnown = 0;
+  }
+  cliSynced = TRUE;
+  cliSeq = seq + 1;
+  cliGot = map;
+
+  for ( idx = 0; idx < TELEMETRY_NUM_SENSORS; idx++ )
+  {
+    if ( ( map & BV( idx ) ) == 0 )
+    {
+      continue;
+    }
+    pSample = &cliSample[telemetrySampleOfs[idx]];
+
+    if ( delta & BV( idx ) )
+    {
+      if ( ( cliKnown & BV( idx ) ) == 0 )
+      {
+        cliIgnored++;
+      }
+      for ( i = 0; i < telemetrySampleLen[idx]; i += 2 )
+      {
+        // The IR temperature words are big endian, the others little endian
+        if ( BV( idx ) == TELEMETRY_IRTEMP )
+        {
+          word = BUILD_UINT16( pSample[i + 1], pSample[i] ) + (int8)*p++;
+          pSample[i] = HI_UINT16( word );
+          pSample[i + 1] = LO_UINT16( word );
+        }
+        else
+        {
+          word = BUILD_UINT16( pSample[i], pSample[i + 1] ) + (int8)*p++;
+          pSample[i] = LO_UINT16( word );
+          pSample[i + 1] = HI_UINT16( word );
+        }
+      }
+    }
+    else
+    {
+      memcpy( pSample, p, telemetrySampleLen[idx] );
+      p += telemetrySampleLen[idx];
+      cliKnown |= BV( idx );
+    }
+  }
+
+  if ( ( delta & ~map ) || ( p != pEnd ) )
+  {
+    cliBad++;
+  }
+}
+
+/* ------------------------------------------------------------------------------------------------
+ *                                         Application
+ * ------------------------------------------------------------------------------------------------
+ */
+static uint16 simWord[TELEMETRY_SAMPLES_LEN / 2];  // The words of the samples
+static uint8 simSample[TELEMETRY_SAMPLES_LEN];     // Samples stored last
+static uint8 simTx[TELEMETRY_MAX_LEN];             // Header of the last notification built
+static uint8 simBuilt;                             // The last Telemetry_Notify() built one
+
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+static void simConfig( uint8 cfg )
+{
+  VOID Telemetry_SetParameter( SENSOR_CONF, sizeof( cfg ), &cfg );
+}
+
+/*
+ * Store a sample of a sensor, made of its words in the byte order of its
+ * HAL read function.
+ */
+static void simStore( uint8 idx, uint16 *pWord )
+{
+  uint8 *p = &simSample[telemetrySampleOfs[idx]];
+  uint8 i;
+
+  for ( i = 0; i < telemetrySampleLen[idx]; i += 2 )
+  {
+    if ( i + 1 == telemetrySampleLen[idx] )
+    {
+      p[i] = LO_UINT16( pWord[i / 2] );
+    }
+    else if ( BV( idx ) == TELEMETRY_IRTEMP )
+    {
+      p[i] = HI_UINT16( pWord[i / 2] );
+      p[i + 1] = LO_UINT16( pWord[i / 2] );
+    }
+    else
+    {
+      p[i] = LO_UINT16( pWord[i / 2] );
+      p[i + 1] = HI_UINT16( pWord[i / 2] );
+    }
+  }
+  VOID Telemetry_SetSample( BV( idx ), p );
+}
+
+/*
+ * Move each word of the sensors in the map by a small random step, or now
+ * and then by a large one, and store their samples.
+ */
+static void simWalk( uint8 sensors )
+{
+  uint8 idx, i;
+
+  for ( idx = 0; idx < TELEMETRY_NUM_SENSORS; idx++ )
+  {
+    if ( sensors & BV( idx ) )
+    {
+      for ( i = 0; i < ( telemetrySampleLen[idx] + 1 ) / 2; i++ )
+      {
+        simWord[telemetrySampleOfs[idx] / 2 + i] +=
+          ( rand() % 20 == 0 ) ? rand() : ( rand() % 241 ) - 120;
+      }
+      simStore( idx, &simWord[telemetrySampleOfs[idx] / 2] );
+    }
+  }
+}
+
+/*
+ * Send a notification; TRUE if the client decoded the samples it carries
+ * as the ones stored last.
+ */
+static uint8 simNotify( void )
+{
+  uint8 seq = telemetrySeq;
+  uint8 idx;
+
+  simRxNew = FALSE;
+  VOID Telemetry_Notify();
+  simBuilt = ( telemetrySeq != seq );
+  memcpy( simTx, sensorData, TELEMETRY_HDR_LEN );
+  if ( !simRxNew )
+  {
+    return ( TRUE );
+  }
+
+  cliDecode( simRx, simRxLen );
+  for ( idx = 0; idx < TELEMETRY_NUM_SENSORS; idx++ )
+  {
+    if ( ( cliGot & BV( idx ) ) && ( cliKnown & BV( idx ) ) &&
+         ( memcmp( &cliSample[telemetrySampleOfs[idx]], &simSample[telemetrySampleOfs[idx]],
+                   telemetrySampleLen[idx] ) != 0 ) )
+    {
+      return ( FALSE );
+    }
+  }
+
+  return ( TRUE );
+}
+
+int main( void )
+{
+  uint8 waitFor[TELEMETRY_NUM_SENSORS];
+  uint8 fullSinceKey;
+  int worstWait, deltas, built, keys, keyBad, bad, n;
+  uint8 idx, i;
+  uint16 ir[2];
+  char what[80];
+
+  srand( 1 );
+  VOID Telemetry_AddService();
+
+  printf( "Notifications of up to %u bytes, a key notification every %u\n",
+          (unsigned)TELEMETRY_MAX_LEN, (unsigned)TELEMETRY_KEY_INTERVAL );
+
+  // Random walk of random sensors, delta coded
+  simConfig( TELEMETRY_CFG_SENSORS | TELEMETRY_CFG_DELTA );
+  bad = 0;
+  deltas = 0;
+  built = 0;
+  keys = 0;
+  keyBad = 0;
+  fullSinceKey = 0;
+  for ( n = 0; n < SIM_ROUNDS; n++ )
+  {
+    simWalk( rand() & TELEMETRY_CFG_SENSORS );
+    if ( !simNotify() )
+    {
+      bad++;
+    }
+    if ( !simBuilt )
+    {
+      continue;
+    }
+    built++;
+
+    // After a key notification each sensor comes in full before it is
+    // delta coded again
+    if ( ( simTx[0] % TELEMETRY_KEY_INTERVAL ) == 0 )
+    {
+      keys++;
+      fullSinceKey = 0;
+    }
+    if ( simTx[2] & ~fullSinceKey )
+    {
+      keyBad++;
+    }
+    fullSinceKey |= simTx[1] & ~simTx[2];
+    for ( idx = 0; idx < TELEMETRY_NUM_SENSORS; idx++ )
+    {
+      deltas += ( simTx[2] & BV( idx ) ) ? 1 : 0;
+    }
+  }
+  sprintf( what, "%d notifications decoded, %d delta coded samples", built, deltas );
+  simCheck( what, ( bad == 0 ) && ( cliBad == 0 ) && ( deltas > built ) );
+  simCheck( "no delta coded sample ignored by the client", cliIgnored == 0 );
+  simCheck( "each sensor in full after each key notification",
+            ( keys == ( built + TELEMETRY_KEY_INTERVAL - 1 ) / TELEMETRY_KEY_INTERVAL ) &&
+            ( keyBad == 0 ) );
+
+  // A failed notification: the client sees a gap, then every sensor in full
+  simWalk( TELEMETRY_CFG_SENSORS );
+  simFailNext = TRUE;
+  bad = !simNotify();
+  for ( n = 0; n < 4; n++ )
+  {
+    simWalk( TELEMETRY_CFG_SENSORS );
+    bad |= !simNotify();
+    if ( n == 0 )
+    {
+      simCheck( "a failed notification is followed by one in full", simTx[2] == 0 );
+    }
+  }
+  simCheck( "the client back in step after it", !bad && ( cliIgnored == 0 ) &&
+            ( cliKnown == TELEMETRY_CFG_SENSORS ) );
+
+  // Every sensor with a sample each time, more than fit in one notification
+  simConfig( TELEMETRY_CFG_SENSORS );
+  memset( waitFor, 0, sizeof( waitFor ) );
+  worstWait = 0;
+  bad = 0;
+  for ( n = 0; n < 100; n++ )
+  {
+    simWalk( TELEMETRY_CFG_SENSORS );
+    bad |= !simNotify();
+    for ( idx = 0; idx < TELEMETRY_NUM_SENSORS; idx++ )
+    {
+      waitFor[idx] = ( simTx[1] & BV( idx ) ) ? 0 : waitFor[idx] + 1;
+      if ( waitFor[idx] + 1 > worstWait )
+      {
+        worstWait = waitFor[idx] + 1;
+      }
+    }
+  }
+  sprintf( what, "every sensor sent within %d notifications when they overflow",
+           worstWait );
+  simCheck( what, !bad && ( worstWait <= SIM_FAIR_WAIT ) );
+
+  // IR temperature alone: its words are big endian, so a step across the
+  // low byte is a small delta and a step of the high byte is not
+  simConfig( TELEMETRY_IRTEMP | TELEMETRY_CFG_DELTA );
+  ir[0] = 0x12FF;
+  ir[1] = 0x3400;
+  simStore( 0, ir );
+  bad = !simNotify();
+  simStore( 0, ir );
+  bad |= !simNotify();
+  ir[0] += 2;
+  ir[1] -= 2;
+  simStore( 0, ir );
+  bad |= !simNotify();
+  simCheck( "IR temperature steps of +2 and -2 across a byte delta coded",
+            !bad && ( simTx[2] == TELEMETRY_IRTEMP ) && ( simRxLen == TELEMETRY_HDR_LEN + 2 ) &&
+            ( simRx[3] == 2 ) && ( simRx[4] == (uint8)-2 ) );
+  ir[0] += 0x100;
+  simStore( 0, ir );
+  bad |= !simNotify();
+  simCheck( "an IR temperature step of 256 sent in full",
+            !bad && ( simTx[1] == TELEMETRY_IRTEMP ) && ( simTx[2] == 0 ) );
+  for ( i = 0; i < 20; i++ )
+  {
+    simWalk( TELEMETRY_IRTEMP );
+    bad |= !simNotify();
+  }
+  simCheck( "IR temperature decoded as stored", !bad && ( cliIgnored == 0 ) && ( cliBad == 0 ) );
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
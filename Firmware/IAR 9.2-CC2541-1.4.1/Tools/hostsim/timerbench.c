@@ -0,0 +1,131 @@
+/**************************************************************************************************
+  Filename:       timerbench.c
+
+  Description:    Host benchmark of the OSAL timer list in OSAL_Timers.c. Runs a
+                  set of reload timers with random periods, as the bridge tasks
+                  do, and reports for a growing number of timers the cost of a
+                  1 ms tick (osalTimerUpdate), of restarting a running timer
+                  (osal_start_timerEx) and of the interrupts off sections in each:
+                  the median and the 99.9th percentile of each operation, and the
+                  99.9th percentile of its interrupts off sections.
+
+                  Times are host nanoseconds. They show how the cost grows with
+                  the number of timers; they are not CC2541 cycle counts.
+
+                  Build:  sh build.sh timerbench
+                  Usage:  timerbench [ticks]
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Room for every timer of the benchmark, so none come from the heap
+#define OSAL_TIMERS_POOL_SIZE  64
+
+#include "../../Components/osal/common/OSAL_Timers.c"
+
+#define BENCH_MAX_TIMERS       OSAL_TIMERS_POOL_SIZE
+
+// Events delivered by the timers
+static unsigned long benchFired;
+
+uint8 osal_set_event( uint8 task_id, uint16 event_flag )
+{
+  benchFired++;
+  return ( SUCCESS );
+}
+
+void *osal_mem_alloc( uint16 size )
+{
+  return ( malloc( size ) );
+}
+
+void osal_mem_free( void *ptr )
+{
+  free( ptr );
+}
+
+// Timer n belongs to task n / 16, event bit n % 16
+#define BENCH_TASK( n )        ( (uint8)((n) / 16) )
+#define BENCH_EVENT( n )       ( (uint16)(1 << ((n) % 16)) )
+
+// Period from 10 ms to 5 s, most of them short
+static uint32 benchPeriod( void )
+{
+  return ( (rand() % 4) ? 10 + rand() % 200 : 200 + rand() % 4800 );
+}
+
+static hostsimHist_t benchTick;
+static hostsimHist_t benchTickOff;
+static hostsimHist_t benchStart;
+static hostsimHist_t benchStartOff;
+
+static void benchRun( int timers, long ticks )
+{
+  uint64_t t0;
+  unsigned long fired;
+  long i;
+  int n;
+
+  osalTimerInit();
+  srand( 1 );
+  for ( n = 0; n < timers; n++ )
+  {
+    osal_start_reload_timer( BENCH_TASK( n ), BENCH_EVENT( n ), benchPeriod() );
+  }
+
+  benchFired = 0;
+  hostsimHistReset( &benchTick );
+  hostsimHistReset( &hostsimIntOffHist );
+  for ( i = 0; i < ticks; i++ )
+  {
+    t0 = hostsimNow();
+    osalTimerUpdate( 1 );
+    hostsimHistTime( &benchTick, t0 );
+  }
+  benchTickOff = hostsimIntOffHist;
+  fired = benchFired;
+
+  // Restart one-shot timers at random; this moves them within the list
+  for ( n = 0; n < timers; n++ )
+  {
+    osal_start_timerEx( BENCH_TASK( n ), BENCH_EVENT( n ), benchPeriod() );
+  }
+  hostsimHistReset( &benchStart );
+  hostsimHistReset( &hostsimIntOffHist );
+  for ( i = 0; i < ticks; i++ )
+  {
+    n = rand() % timers;
+    t0 = hostsimNow();
+    osal_start_timerEx( BENCH_TASK( n ), BENCH_EVENT( n ), benchPeriod() );
+    hostsimHistTime( &benchStart, t0 );
+  }
+  benchStartOff = hostsimIntOffHist;
+
+  printf( "%6d %8llu %8llu %8llu %8llu %8llu %8llu %10.2f\n", timers,
+          (unsigned long long)hostsimHistPct( &benchTick, 50.0 ),
+          (unsigned long long)hostsimHistPct( &benchTick, 99.9 ),
+          (unsigned long long)hostsimHistPct( &benchTickOff, 99.9 ),
+          (unsigned long long)hostsimHistPct( &benchStart, 50.0 ),
+          (unsigned long long)hostsimHistPct( &benchStart, 99.9 ),
+          (unsigned long long)hostsimHistPct( &benchStartOff, 99.9 ),
+          (double)fired / ticks );
+}
+
+int main( int argc, char *argv[] )
+{
+  static const int counts[] = { 1, 4, 8, 16, 32, 48, BENCH_MAX_TIMERS };
+  long ticks = ( argc > 1 ) ? atol( argv[1] ) : 200000;
+  unsigned i;
+
+  hostsimInit();
+  printf( "                 tick, ns           start_timerEx, ns\n" );
+  printf( "timers   median    99.9%%  ints off   median    99.9%%  ints off  fired/tick\n" );
+  for ( i = 0; i < sizeof( counts ) / sizeof( counts[0] ); i++ )
+  {
+    benchRun( counts[i], ticks );
+  }
+
+  return ( 0 );
+}
@@ -0,0 +1,336 @@
+/**************************************************************************************************
+  Filename:       uartsim.c
+
+  Description:    Host test of the Rx ring of the CC2540EB _hal_uart_dma.c, built
+                  as the BLE_Bridge DMA configurations build it: Tx by ISR, no
+                  flow control, HAL_UART_DMA_IDLE and HAL_UART_STATS.
+
+                  The Rx DMA channel is modeled: each received byte goes into
+                  the next ring entry with the DMA_PAD byte above it, as the
+                  word transfer from UxDBUF and UxBAUD leaves it. The sleep
+                  timer byte ST0 is moved on by the test; at 115200 baud a
+                  byte takes about 3 of its ticks.
+
+                  The checks: random bursts and partial reads keep the count
+                  of HalUARTRxAvailDMA() and the bytes read right, a count
+                  leaves the tail where the DMA writes next and a partial read
+                  leaves it alone, so bytes are not scanned twice, a 255 byte
+                  frame (the largest, a 250 byte payload with its header and
+                  check) fits in a 256 entry ring, the idle callback comes
+                  within a tick of HAL_UART_DMA_IDLE after the line goes
+                  quiet whatever ST0 reads when it does, no idle callback comes
+                  during a burst, a partial read restarts the idle timeout,
+                  a ring filled to HAL_UART_DMA_FULL calls back at once, and
+                  the statistics hold the high-water marks and count full
+                  polls and refused writes.
+
+                  Build:  sh build.sh uartsim -Wno-pointer-to-int-cast [-DHAL_UART_DMA_RX_MAX=n]
+                  Usage:  uartsim
+**************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HAL_UART               TRUE
+#define HAL_UART_DMA           1
+#define HAL_UART_STATS         TRUE
+
+#if !defined HAL_UART_DMA_RX_MAX
+#define HAL_UART_DMA_RX_MAX    256
+#endif
+#if !defined HAL_UART_DMA_IDLE
+#define HAL_UART_DMA_IDLE      33
+#endif
+
+uint8 U0CSR, U0UCR, U0DBUF, U0BAUD, U0GCR, PERCFG, P0SEL, P2DIR, P0DIR, P0IEN, P0IFG, P0IF;
+uint8 P0_4, P0_5, PICTL, IEN1, IEN2, UTX0IF, ST0, DMAARM, DMAREQ, DMAIRQ;
+
+#include "hal_dma.h"
+
+halDMADesc_t dmaCh1234[4];
+
+#include "../../Components/hal/target/CC2540EB/_hal_uart_dma.c"
+
+#define SIM_TICKS_PER_BYTE     3        // ST0 ticks a byte takes at 115200 baud
+#define SIM_FRAME_MAX          255      // A 250 byte payload with its header and check
+
+static uint16 simW;                     // Ring entry the DMA writes next
+static uint32 simSent;                  // Bytes received so far
+static uint32 simGot;                   // Bytes read so far
+
+static uint8 simEvt;                    // Events of the callbacks since cleared
+static uint16 simCbCnt;                 // Callbacks since cleared
+
+static int simFails;
+
+static void simCheck( const char *what, int ok )
+{
+  printf( "%-60s %s\n", what, ok ? "ok" : "FAIL" );
+  if ( !ok )
+  {
+    simFails++;
+  }
+}
+
+static void simCback( uint8 port, uint8 event )
+{
+  (void)port;
+
+  simEvt |= event;
+  simCbCnt++;
+}
+
+/*
+ * Receive n bytes as the Rx DMA channel would, each the low byte of its
+ * number in the stream.
+ */
+static void simRx( uint16 n )
+{
+  while ( n-- )
+  {
+    dmaCfg.rxBuf[simW] = BUILD_UINT16( (uint8)simSent, U0BAUD );
+    simSent++;
+    if ( ++simW >= HAL_UART_DMA_RX_MAX )
+    {
+      simW = 0;
+    }
+  }
+}
+
+/*
+ * Read up to n bytes; TRUE if they carry on the stream.
+ */
+static uint8 simRead( uint16 n )
+{
+  uint8 buf[HAL_UART_DMA_RX_MAX];
+  uint16 cnt = HalUARTReadDMA( buf, n );
+  uint16 i;
+
+  for ( i = 0; i < cnt; i++ )
+  {
+    if ( buf[i] != (uint8)simGot++ )
+    {
+      return ( FALSE );
+    }
+  }
+
+  return ( cnt == ( ( n < simSent - ( simGot - cnt ) ) ? n : simSent - ( simGot - cnt ) ) );
+}
+
+static void simPoll( void )
+{
+  simEvt = 0;
+  simCbCnt = 0;
+  HalUARTPollDMA();
+}
+
+/*
+ * Drain the ring and the idle timeout.
+ */
+static void simFlush( void )
+{
+  uint8 buf[HAL_UART_DMA_RX_MAX];
+
+  simGot += HalUARTReadDMA( buf, sizeof( buf ) );
+  HalUARTPollDMA();
+}
+
+/*
+ * Random bursts, polls and partial reads; TRUE if the counts and the data
+ * were right all through.
+ */
+static uint8 simRandom( void )
+{
+  rxIdx_t tail;
+  uint16 counted, n;
+  long i;
+
+  for ( i = 0; i < 200000; i++ )
+  {
+    uint16 waiting = simSent - simGot;
+
+    // Bytes come in between the count and the read as often as not
+    switch ( rand() % 4 )
+    {
+    case 0:
+      simRx( rand() % ( HAL_UART_DMA_RX_MAX - waiting + 1 ) );
+      break;
+    case 1:
+      ST0 += rand() % 8;
+      HalUARTPollDMA();
+      break;
+    case 2:
+      // A read short of the bytes counted leaves them counted
+      tail = dmaCfg.rxTail;
+      counted = HAL_UART_DMA_RX_DIST( tail );
+      n = rand() % ( HAL_UART_DMA_RX_MAX + 1 );
+      if ( !simRead( n ) || ( ( n < counted ) && ( dmaCfg.rxTail != tail ) ) )
+      {
+        return ( FALSE );
+      }
+      break;
+    default:
+      // A count leaves the tail where the DMA writes next
+      if ( ( HalUARTRxAvailDMA() != simSent - simGot ) || ( dmaCfg.rxTail != simW ) )
+      {
+        return ( FALSE );
+      }
+      break;
+    }
+  }
+
+  return ( TRUE );
+}
+
+/*
+ * Receive a burst of n bytes ending with ST0 at end, polling after each
+ * byte; then poll every tick until the idle callback. The ticks it took
+ * after the last byte, or -1 when a callback came during the burst or
+ * none came.
+ */
+static int simIdle( uint16 n, uint8 end )
+{
+  uint8 duringBurst = FALSE;
+  int ticks;
+
+  ST0 = (uint8)( end - n * SIM_TICKS_PER_BYTE );
+  while ( n-- )
+  {
+    ST0 += SIM_TICKS_PER_BYTE;
+    simRx( 1 );
+    simPoll();
+    if ( simEvt & HAL_UART_RX_TIMEOUT )
+    {
+      duringBurst = TRUE;
+    }
+  }
+
+  for ( ticks = 1; ticks < 600; ticks++ )
+  {
+    ST0++;
+    simPoll();
+    if ( simEvt & HAL_UART_RX_TIMEOUT )
+    {
+      return ( duringBurst ? -1 : ticks );
+    }
+  }
+
+  return ( -1 );
+}
+
+int main( void )
+{
+  halUARTCfg_t cfg;
+  halUARTStats_t stats;
+  int ticks, worst, best, cnt;
+  uint16 end;
+
+  srand( 1 );
+
+  memset( &cfg, 0, sizeof( cfg ) );
+  cfg.baudRate = HAL_UART_BR_115200;
+  cfg.callBackFunc = simCback;
+  // The ring as HalUARTInitDMA() leaves it; its DMA setup reads UxDBUF at
+  // its XDATA address, which the host does not have
+  (void)memset( dmaCfg.rxBuf, ( DMA_PAD ^ 0xFF ), sizeof( dmaCfg.rxBuf ) );
+  HalUARTOpenDMA( &cfg );
+
+  printf( "Rx ring of %u entries, idle timeout %u ticks\n",
+          (unsigned)HAL_UART_DMA_RX_MAX, (unsigned)HAL_UART_DMA_IDLE );
+
+  simCheck( "random bursts and partial reads keep count and data", simRandom() );
+  simFlush();
+
+  // The largest frame, with nothing read until it is all in
+  simRx( ( SIM_FRAME_MAX < HAL_UART_DMA_RX_MAX ) ? SIM_FRAME_MAX : HAL_UART_DMA_RX_MAX );
+  simCheck( "a 255 byte frame fits in the ring",
+            ( HAL_UART_DMA_RX_MAX < SIM_FRAME_MAX ) ||
+            ( ( HalUARTRxAvailDMA() == SIM_FRAME_MAX ) && simRead( SIM_FRAME_MAX ) &&
+              ( HalUARTRxAvailDMA() == 0 ) ) );
+  simFlush();
+
+  // The idle callback, with the line going quiet at every reading of ST0
+  worst = 0;
+  best = 600;
+  for ( end = 0; end < 256; end++ )
+  {
+    ticks = simIdle( 40, (uint8)end );
+    if ( ( ticks < 0 ) || ( ticks > worst ) )
+    {
+      worst = ( ticks < 0 ) ? 600 : ticks;
+    }
+    if ( ( ticks >= 0 ) && ( ticks < best ) )
+    {
+      best = ticks;
+    }
+    simFlush();
+  }
+  printf( "idle callback %d to %d ticks after the last byte\n", best, worst );
+  // A tick early when ST0 read zero at the last byte, as zero stops the timeout
+  simCheck( "idle callback within a tick of the timeout, at any ST0",
+            ( best >= HAL_UART_DMA_IDLE ) && ( worst <= HAL_UART_DMA_IDLE + 1 ) );
+
+  // Only one callback for a quiet line
+  cnt = 0;
+  for ( ticks = 0; ticks < 600; ticks++ )
+  {
+    ST0++;
+    simPoll();
+    cnt += ( simEvt & HAL_UART_RX_TIMEOUT ) ? 1 : 0;
+  }
+  simCheck( "no idle callback while the ring stays empty", cnt == 0 );
+
+  simRx( 20 );
+  simPoll();
+  cnt = 0;
+  for ( ticks = 0; ticks < 600; ticks++ )
+  {
+    ST0++;
+    simPoll();
+    cnt += ( simEvt & HAL_UART_RX_TIMEOUT ) ? 1 : 0;
+    if ( ( simEvt & HAL_UART_RX_TIMEOUT ) && ( cnt == 1 ) )
+    {
+      // A partial read, as a parser waiting for the rest of a frame does
+      (void)simRead( 5 );
+    }
+  }
+  simCheck( "a partial read restarts the idle timeout, once", cnt == 2 );
+  simFlush();
+
+  // A full ring calls back without waiting for the line to go quiet
+  simRx( HAL_UART_DMA_FULL - 1 );
+  simPoll();
+  simCheck( "no full callback short of HAL_UART_DMA_FULL", ( simEvt & HAL_UART_RX_FULL ) == 0 );
+  simRx( 1 );
+  simPoll();
+  simCheck( "full callback at HAL_UART_DMA_FULL", ( simEvt & HAL_UART_RX_FULL ) != 0 );
+  simFlush();
+
+  // Statistics
+  HalUARTStatsDMA( &stats, TRUE );
+  simRx( 100 );
+  simPoll();
+  (void)simRead( 100 );
+  simRx( HAL_UART_DMA_RX_MAX );
+  simPoll();
+  simPoll();
+  simFlush();
+  cnt = HalUARTWriteDMA( (uint8 *)"0123456789", 10 );
+  while ( HalUARTWriteDMA( (uint8 *)"0123456789", 10 ) != 0 )
+  {
+  }
+  HalUARTStatsDMA( &stats, FALSE );
+  simCheck( "Rx high-water mark and polls of a full ring",
+            ( stats.rxHigh == HAL_UART_DMA_RX_MAX ) && ( stats.rxFull == 2 ) );
+  simCheck( "Tx high-water mark and refused writes",
+            ( cnt == 10 ) && ( stats.txHigh > HAL_UART_DMA_TX_MAX - 11 ) &&
+            ( stats.txHigh <= HAL_UART_DMA_TX_MAX - 1 ) && ( stats.txFull == 1 ) );
+  HalUARTStatsDMA( &stats, TRUE );
+  HalUARTStatsDMA( &stats, FALSE );
+  simCheck( "statistics cleared", ( stats.rxHigh == 0 ) && ( stats.rxFull == 0 ) &&
+            ( stats.txHigh == 0 ) && ( stats.txFull == 0 ) );
+
+  printf( simFails ? "FAILED\n" : "passed\n" );
+  return ( simFails ? 1 : 0 );
+}
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Run setbaud.py against a stand-in for the bridge on a pty, to check the
+baud rate handshake without hardware.
+
+The stand-in answers CMD_REQ_DEVICE_VERSION and CMD_REQ_BAUD as
+serialInterface.c does: it acknowledges a new rate at the old one, switches
+5 ms later and goes back to the old rate, sending CMD_ERR_BAUD there, if no
+confirmation arrives within a second. It reads the rate setbaud.py set on
+its side of the pty, and while the two differ every byte between them is
+garbled, as on a real line at the wrong rate. --no-confirm makes it miss
+the confirmation, to check the fall back.
+
+A pty moves bytes at memory speed whatever the rate, so the bytes/s that
+setbaud.py reports here say nothing about the UART; measure those on the
+bridge with setbaud.py --sweep. What this checks is that each switch
+succeeds or falls back, and that no answer is lost at matching rates.
+
+The arguments after the options go to setbaud.py, the port excepted.
+
+    loopback.py [--no-confirm] --sweep [--count 50]
+    loopback.py [--no-confirm] 921600 --bench
+"""
+
+import os
+import pty
+import random
+import select
+import sys
+import termios
+import threading
+import time
+import tty
+
+import setbaud
+
+VERSION = b'FanDao SLBM04 V4.0.0 2015-09-05\0'
+
+# Time from the acknowledgement to the switch, one Tx drain period
+SWITCH_DELAY = 0.005
+
+
+class Bridge(threading.Thread):
+    """The serialInterface.c side of the pty."""
+
+    def __init__(self, master, slave, confirm):
+        super().__init__(daemon=True)
+        self.master = master
+        self.slave = slave
+        self.confirm = confirm
+        self.rate = setbaud.RATES.index(115200)
+        self.old = None
+        self.deadline = None
+        self.buf = bytearray()
+
+    def host_rate(self):
+        speed = termios.tcgetattr(self.slave)[5]
+        for i, r in enumerate(setbaud.RATES):
+            if getattr(termios, 'B%d' % r, None) == speed:
+                return i
+        return None
+
+    def garble(self, data):
+        if self.host_rate() == self.rate:
+            return data
+        return bytes(random.getrandbits(8) for _ in data)
+
+    def send(self, cmd, payload=b''):
+        os.write(self.master, self.garble(setbaud.frame(cmd, payload)))
+
+    def handle(self, cmd, payload):
+        if cmd == setbaud.CMD_REQ_DEVICE_VERSION:
+            self.send(setbaud.CMD_ACK_DEVICE_VERSION, VERSION)
+        elif cmd == setbaud.CMD_REQ_BAUD and payload:
+            if payload[0] >= len(setbaud.RATES) or self.deadline is not None:
+                self.send(setbaud.CMD_ERR_BAUD)
+                return
+            self.send(setbaud.CMD_ACK_BAUD, payload[:2])
+            time.sleep(SWITCH_DELAY)
+            self.old, self.rate = self.rate, payload[0]
+            self.deadline = time.monotonic() + setbaud.CONFIRM_TIMEOUT
+        elif cmd == setbaud.CMD_REQ_BAUD:
+            if self.deadline is not None and not self.confirm:
+                return
+            self.deadline = None
+            self.send(setbaud.CMD_ACK_BAUD, bytes((self.rate, 0)))
+
+    def run(self):
+        while True:
+            if self.deadline is not None and time.monotonic() >= self.deadline:
+                self.rate, self.deadline = self.old, None
+                self.send(setbaud.CMD_ERR_BAUD)
+            r, _, _ = select.select([self.master], [], [], 0.01)
+            if not r:
+                continue
+            self.buf += self.garble(os.read(self.master, 1024))
+            while True:
+                i = self.buf.find(setbaud.HEADER)
+                if i < 0:
+                    del self.buf[:-1]
+                    break
+                del self.buf[:i]
+                if len(self.buf) < 5 or len(self.buf) < 5 + self.buf[3]:
+                    break
+                n = self.buf[3]
+                x = 0
+                for b in self.buf[:4 + n]:
+                    x ^= b
+                if x != self.buf[4 + n]:
+                    del self.buf[:1]
+                    continue
+                cmd, payload = self.buf[2], bytes(self.buf[4:4 + n])
+                del self.buf[:5 + n]
+                self.handle(cmd, payload)
+
+
+def main():
+    args = sys.argv[1:]
+    confirm = '--no-confirm' not in args
+    if not confirm:
+        args.remove('--no-confirm')
+
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    Bridge(master, slave, confirm).start()
+
+    sys.argv = ['setbaud.py', os.ttyname(slave)] + args
+    setbaud.main()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Switch the NPI UART of the bridge to another baud rate and measure the link.
+
+Sends CMD_REQ_BAUD with the new rate, switches the host port when the bridge
+acknowledges it and confirms at the new rate; the bridge goes back to the old
+rate if the confirmation does not arrive within a second. With --bench, or
+--sweep to go through every rate from the current one up, the link is then
+measured by requesting the version string --count times and counting the
+answers that are missing or damaged. --flow asks for RTS/CTS flow control,
+which needs P0.4 (CTS) and P0.5 (RTS) wired to the host.
+
+The bridge does not keep the rate over a reset.
+
+Needs pyserial.
+
+    setbaud.py /dev/ttyUSB0 921600 [--from 115200] [--flow] [--bench] [--count 500]
+    setbaud.py /dev/ttyUSB0 --sweep [--from 115200] [--flow]
+"""
+
+import argparse
+import sys
+import time
+
+import serial
+
+HEADER = b'\xAB\x55'
+CMD_REQ_DEVICE_VERSION = 0x02
+CMD_ACK_DEVICE_VERSION = 0xC2
+CMD_REQ_BAUD = 0x0D
+CMD_ACK_BAUD = 0xCD
+CMD_ERR_BAUD = 0xDD
+
+# HAL_UART_BR_xxx, see hal_uart.h
+RATES = (9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1000000)
+
+# Time the bridge gives the host to confirm, see BAUD_CONFIRM_TIMEOUT
+CONFIRM_TIMEOUT = 1.0
+
+
+def frame(cmd, payload=b''):
+    body = HEADER + bytes((cmd, len(payload))) + payload
+    x = 0
+    for b in body:
+        x ^= b
+    return body + bytes((x,))
+
+
+def read_frame(port, cmds, timeout=1.0):
+    """Return the type and payload of the next valid frame with a type in cmds."""
+    buf = bytearray()
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        buf += port.read(port.in_waiting or 1)
+        while True:
+            i = buf.find(HEADER)
+            if i < 0:
+                del buf[:-1]
+                break
+            del buf[:i]
+            if len(buf) < 5 or len(buf) < 5 + buf[3]:
+                break
+            n = buf[3]
+            x = 0
+            for b in buf[:4 + n]:
+                x ^= b
+            if x != buf[4 + n]:
+                del buf[:1]
+                continue
+            cmd, payload = buf[2], bytes(buf[4:4 + n])
+            del buf[:5 + n]
+            if cmd in cmds:
+                return cmd, payload
+    return None, None
+
+
+def switch(port, rate, flow):
+    """Move both sides to rate; return True if the bridge confirmed it."""
+    index = RATES.index(rate)
+    port.reset_input_buffer()
+    port.write(frame(CMD_REQ_BAUD, bytes((index, int(flow)))))
+    cmd, payload = read_frame(port, (CMD_ACK_BAUD, CMD_ERR_BAUD))
+    if cmd != CMD_ACK_BAUD or payload[:1] != bytes((index,)):
+        return False
+
+    old = port.baudrate
+    port.flush()
+    port.baudrate = rate
+    port.rtscts = flow
+
+    # The bridge switches a few milliseconds after its answer went out
+    end = time.monotonic() + CONFIRM_TIMEOUT * 0.8
+    time.sleep(0.02)
+    while time.monotonic() < end:
+        port.reset_input_buffer()
+        port.write(frame(CMD_REQ_BAUD))
+        cmd, payload = read_frame(port, (CMD_ACK_BAUD,), timeout=0.1)
+        if cmd == CMD_ACK_BAUD and payload[:1] == bytes((index,)):
+            return True
+
+    # The bridge falls back on its own
+    port.baudrate = old
+    port.rtscts = False
+    read_frame(port, (CMD_ERR_BAUD,), timeout=CONFIRM_TIMEOUT)
+    return False
+
+
+def bench(port, count):
+    """Return bytes per second and the fraction of lost or damaged answers."""
+    good = 0
+    nbytes = 0
+    start = time.monotonic()
+    for _ in range(count):
+        port.write(frame(CMD_REQ_DEVICE_VERSION))
+        cmd, payload = read_frame(port, (CMD_ACK_DEVICE_VERSION,), timeout=0.2)
+        if cmd is not None:
+            good += 1
+            nbytes += 5 + len(payload) + 5
+    elapsed = time.monotonic() - start
+    return nbytes / elapsed, 1.0 - good / count
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    ap.add_argument('port')
+    ap.add_argument('rate', type=int, nargs='?', choices=RATES)
+    ap.add_argument('--from', dest='start', type=int, default=115200, choices=RATES,
+                    help='rate the bridge is at now')
+    ap.add_argument('--flow', action='store_true', help='use RTS/CTS flow control')
+    ap.add_argument('--bench', action='store_true', help='measure the link after the switch')
+    ap.add_argument('--sweep', action='store_true', help='switch to and measure every higher rate')
+    ap.add_argument('--count', type=int, default=500)
+    args = ap.parse_args()
+
+    if args.rate is None and not args.sweep:
+        ap.error('give a rate or --sweep')
+
+    port = serial.Serial(args.port, args.start, timeout=0.01)
+    if args.sweep:
+        rates = [r for r in RATES if r >= args.start]
+    else:
+        rates = [args.rate]
+
+    ok = True
+    for rate in rates:
+        if rate != port.baudrate and not switch(port, rate, args.flow):
+            print('%7d: switch failed, bridge stays at %d' % (rate, port.baudrate))
+            ok = False
+            break
+        if args.bench or args.sweep:
+            bps, lost = bench(port, args.count)
+            print('%7d: %8.0f bytes/s, %.2f%% lost' % (rate, bps, lost * 100))
+        else:
+            print('%7d: ok' % rate)
+
+    if args.sweep and port.baudrate != args.start:
+        switch(port, args.start, False)
+
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,331 @@
+/**************************************************************************************************
+  Filename:       trace2json.cpp
+
+  Description:    Host side decoder of the OSAL event trace. Reads the bytes
+                  received from the NPI UART in answer to CMD_REQ_TRACE and
+                  writes the records as Chrome trace event JSON, which can be
+                  opened in chrome://tracing or ui.perfetto.dev.
+
+                  Build:  g++ -std=c++11 -O2 -o trace2json trace2json.cpp
+                  Usage:  trace2json [-t name,name,...] [capture.bin] > trace.json
+
+                  -t gives the OSAL task names in task id order; the default
+                  is the BLE_Bridge task table.
+**************************************************************************************************/
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// Frame layout, see FrameParser.h
+const uint8_t FRAME_HEADER_0 = 0xAB;
+const uint8_t FRAME_HEADER_1 = 0x55;
+const size_t  FRAME_OVERHEAD = 5;
+
+// CMD_ACK_TRACE, see serialInterface.h
+const uint8_t CMD_ACK_TRACE = 0xC9;
+
+// Record layout and tags, see osal_trace.h
+const size_t  TRACE_REC_LEN   = 7;
+const uint8_t TRACE_TASK_BEGIN = 0x01;
+const uint8_t TRACE_TASK_END   = 0x02;
+const uint8_t TRACE_TIMER      = 0x03;
+const uint8_t TRACE_UART_RX    = 0x04;
+const uint8_t TRACE_NOTIFY     = 0x05;
+
+// The time stamps are 24 bit sleep timer ticks of 1/32768 s
+const uint32_t TICKS_MASK = 0x00FFFFFF;
+const double   TICK_US    = 1000000.0 / 32768.0;
+
+// Trace viewer threads
+enum Track
+{
+  TRACK_TASKS = 1,
+  TRACK_TIMERS,
+  TRACK_UART,
+  TRACK_NOTIFY,
+  TRACK_USER
+};
+
+const char *const DEFAULT_TASKS =
+  "LL,HAL,HCI,CbTimer,L2CAP,GAP,GATT,SM,GAPRole,GAPBondMgr,GATTServApp,Serial,BLE_Bridge";
+
+std::vector<std::string> split( const std::string &s, char sep )
+{
+  std::vector<std::string> out;
+  std::stringstream ss( s );
+  std::string item;
+
+  while ( std::getline( ss, item, sep ) )
+  {
+    out.push_back( item );
+  }
+  return out;
+}
+
+std::string hex16( unsigned v )
+{
+  char buf[8];
+  std::snprintf( buf, sizeof( buf ), "0x%04X", v & 0xFFFF );
+  return buf;
+}
+
+class TraceWriter
+{
+public:
+  explicit TraceWriter( const std::vector<std::string> &tasks )
+    : tasks_( tasks ), open_( tasks.size(), false ), first_( true ),
+      haveTime_( false ), lastTicks_( 0 ), ticks_( 0 )
+  {
+    std::cout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    meta( TRACK_TASKS, "tasks" );
+    meta( TRACK_TIMERS, "timers" );
+    meta( TRACK_UART, "uart rx" );
+    meta( TRACK_NOTIFY, "notifications" );
+    meta( TRACK_USER, "user" );
+  }
+
+  ~TraceWriter()
+  {
+    std::cout << "\n]}\n";
+  }
+
+  void frame( const uint8_t *p, size_t len )
+  {
+    if ( len < 2 || ( len - 2 ) % TRACE_REC_LEN != 0 )
+    {
+      std::cerr << "trace2json: bad trace frame length " << len << "\n";
+      return;
+    }
+
+    unsigned lost = p[0] | ( p[1] << 8 );
+    bool reportLost = ( lost != 0 );
+
+    for ( p += 2, len -= 2; len != 0; p += TRACE_REC_LEN, len -= TRACE_REC_LEN )
+    {
+      uint32_t raw = p[4] | ( p[5] << 8 ) | ( uint32_t( p[6] ) << 16 );
+      advance( raw );
+
+      if ( reportLost )
+      {
+        // The records before this one are gone, so are their open slices
+        std::ostringstream args;
+        args << "{\"records\":" << lost << "}";
+        event( "lost", "i", TRACK_TASKS, args.str(), ",\"s\":\"g\"" );
+        closeAll();
+        reportLost = false;
+      }
+
+      record( p[0], p[1], p[2] | ( p[3] << 8 ) );
+    }
+  }
+
+private:
+  void advance( uint32_t raw )
+  {
+    // Records are read out in order, so the timer wrapped if it went back
+    if ( haveTime_ )
+    {
+      ticks_ += ( raw - lastTicks_ ) & TICKS_MASK;
+    }
+    else
+    {
+      ticks_ = raw;
+      haveTime_ = true;
+    }
+    lastTicks_ = raw;
+  }
+
+  std::string taskName( unsigned id ) const
+  {
+    if ( id < tasks_.size() )
+    {
+      return tasks_[id];
+    }
+    return "task " + std::to_string( id );
+  }
+
+  void record( uint8_t tag, uint8_t arg, unsigned data )
+  {
+    std::ostringstream args;
+
+    switch ( tag )
+    {
+      case TRACE_TASK_BEGIN:
+        args << "{\"events\":\"" << hex16( data ) << "\"}";
+        if ( arg < open_.size() && open_[arg] )
+        {
+          // The end of the previous call was lost
+          event( taskName( arg ), "E", TRACK_TASKS, "{}" );
+        }
+        event( taskName( arg ), "B", TRACK_TASKS, args.str() );
+        if ( arg < open_.size() )
+        {
+          open_[arg] = true;
+        }
+        break;
+
+      case TRACE_TASK_END:
+        // Skip the end of a call whose beginning was lost
+        if ( arg < open_.size() && open_[arg] )
+        {
+          args << "{\"handed back\":\"" << hex16( data ) << "\"}";
+          event( taskName( arg ), "E", TRACK_TASKS, args.str() );
+          open_[arg] = false;
+        }
+        break;
+
+      case TRACE_TIMER:
+        args << "{\"event\":\"" << hex16( data ) << "\"}";
+        event( "timer " + taskName( arg ), "i", TRACK_TIMERS, args.str(), ",\"s\":\"t\"" );
+        break;
+
+      case TRACE_UART_RX:
+        args << "{\"port\":" << unsigned( arg ) << ",\"bytes\":" << data << "}";
+        event( "rx", "i", TRACK_UART, args.str(), ",\"s\":\"t\"" );
+        break;
+
+      case TRACE_NOTIFY:
+        args << "{\"status\":" << unsigned( arg ) << ",\"bytes\":" << data << "}";
+        event( arg == 0 ? "notify" : "notify failed", "i", TRACK_NOTIFY, args.str(), ",\"s\":\"t\"" );
+        break;
+
+      default:
+        args << "{\"arg\":" << unsigned( arg ) << ",\"data\":" << data << "}";
+        event( "tag " + std::to_string( tag ), "i", TRACK_USER, args.str(), ",\"s\":\"t\"" );
+        break;
+    }
+  }
+
+  void closeAll()
+  {
+    for ( size_t id = 0; id < open_.size(); id++ )
+    {
+      if ( open_[id] )
+      {
+        event( taskName( unsigned( id ) ), "E", TRACK_TASKS, "{}" );
+        open_[id] = false;
+      }
+    }
+  }
+
+  void meta( Track tid, const char *name )
+  {
+    separator();
+    std::cout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << int( tid )
+              << ",\"args\":{\"name\":\"" << name << "\"}}";
+  }
+
+  void event( const std::string &name, const char *ph, Track tid,
+              const std::string &args, const char *extra = "" )
+  {
+    char ts[32];
+    std::snprintf( ts, sizeof( ts ), "%.1f", double( ticks_ ) * TICK_US );
+
+    separator();
+    std::cout << "{\"name\":\"" << name << "\",\"ph\":\"" << ph << "\",\"ts\":" << ts
+              << ",\"pid\":1,\"tid\":" << int( tid ) << extra << ",\"args\":" << args << "}";
+  }
+
+  void separator()
+  {
+    std::cout << ( first_ ? "\n" : ",\n" );
+    first_ = false;
+  }
+
+  std::vector<std::string> tasks_;
+  std::vector<bool> open_;
+  bool first_;
+  bool haveTime_;
+  uint32_t lastTicks_;
+  uint64_t ticks_;
+};
+
+} // namespace
+
+int main( int argc, char **argv )
+{
+  std::string taskList = DEFAULT_TASKS;
+  const char *path = nullptr;
+
+  for ( int i = 1; i < argc; i++ )
+  {
+    std::string a = argv[i];
+    if ( a == "-t" && i + 1 < argc )
+    {
+      taskList = argv[++i];
+    }
+    else if ( a[0] != '-' && path == nullptr )
+    {
+      path = argv[i];
+    }
+    else
+    {
+      std::cerr << "usage: trace2json [-t name,name,...] [capture.bin]\n";
+      return 2;
+    }
+  }
+
+  std::vector<uint8_t> in;
+  if ( path )
+  {
+    std::ifstream f( path, std::ios::binary );
+    if ( !f )
+    {
+      std::cerr << "trace2json: cannot open " << path << "\n";
+      return 1;
+    }
+    in.assign( std::istreambuf_iterator<char>( f ), std::istreambuf_iterator<char>() );
+  }
+  else
+  {
+    std::cin >> std::noskipws;
+    in.assign( std::istreambuf_iterator<char>( std::cin ), std::istreambuf_iterator<char>() );
+  }
+
+  TraceWriter out( split( taskList, ',' ) );
+
+  // Look for frames, skipping other traffic and damaged frames a byte at a time
+  size_t i = 0;
+  while ( i + FRAME_OVERHEAD <= in.size() )
+  {
+    if ( in[i] != FRAME_HEADER_0 || in[i + 1] != FRAME_HEADER_1 )
+    {
+      i++;
+      continue;
+    }
+
+    size_t len = in[i + 3];
+    if ( i + FRAME_OVERHEAD + len > in.size() )
+    {
+      break;
+    }
+
+    uint8_t x = 0;
+    for ( size_t k = 0; k < 4 + len; k++ )
+    {
+      x ^= in[i + k];
+    }
+    if ( x != in[i + 4 + len] )
+    {
+      i++;
+      continue;
+    }
+
+    if ( in[i + 2] == CMD_ACK_TRACE )
+    {
+      out.frame( &in[i + 4], len );
+    }
+    i += FRAME_OVERHEAD + len;
+  }
+
+  return 0;
+}